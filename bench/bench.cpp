@@ -0,0 +1,185 @@
+#include "bench.hpp"
+
+#include <smorgasbord/import/loadobj.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
+#include <smorgasbord/util/timer.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+double MeasureBest(const std::function<void()> &run, uint32_t numRuns)
+{
+	double best = std::numeric_limits<double>::infinity();
+	Timer timer;
+	for (uint32_t i = 0; i < numRuns; i++)
+	{
+		timer.Reset();
+		timer.Start();
+		run();
+		best = std::min(best, timer.GetSeconds());
+	}
+	
+	return best;
+}
+
+std::string MakeBenchOBJ(const BenchContext &context)
+{
+	std::shared_ptr<ResourceManager> resourceManager =
+		std::make_shared<ResourceManager>(context.dataPath);
+	std::unique_ptr<MeshData> town = LoadOBJ(resourceManager->Get("town.obj"));
+	const MeshData &mesh = *town;
+	
+	const uint32_t gridSize =
+		uint32_t(std::ceil(std::sqrt(double(context.numCopies))));
+	const glm::vec3 extent = mesh.boundingMax - mesh.boundingMin;
+	const glm::vec2 spacing = glm::vec2(extent.x, extent.z) * 1.1f;
+	const bool hasNormal = mesh.fn.size() == mesh.fp.size();
+	const bool hasTexCoord = mesh.ft.size() == mesh.fp.size();
+	
+	fmt::memory_buffer text;
+	auto out = std::back_inserter(text);
+	for (uint32_t copy = 0; copy < context.numCopies; copy++)
+	{
+		const glm::vec3 offset = glm::vec3(
+			spacing.x * float(copy % gridSize),
+			0,
+			spacing.y * float(copy / gridSize));
+		
+		for (const glm::vec3 &p : mesh.p)
+		{
+			fmt::format_to(out, "v {} {} {}\n", p.x + offset.x, p.y, p.z + offset.z);
+		}
+		
+		for (const glm::vec2 &t : mesh.t)
+		{
+			fmt::format_to(out, "vt {} {}\n", t.x, t.y);
+		}
+		
+		for (const glm::vec3 &n : mesh.n)
+		{
+			fmt::format_to(out, "vn {} {} {}\n", n.x, n.y, n.z);
+		}
+		
+		/// OBJ indexes from 1, and the indices of every copy start after
+		/// the elements of the previous ones
+		const size_t pBase = copy * mesh.p.size() + 1;
+		const size_t tBase = copy * mesh.t.size() + 1;
+		const size_t nBase = copy * mesh.n.size() + 1;
+		size_t corner = 0;
+		for (int32_t count : mesh.c)
+		{
+			fmt::format_to(out, "f");
+			for (int32_t v = 0; v < count; v++, corner++)
+			{
+				fmt::format_to(out, " {}", pBase + mesh.fp[corner]);
+				if (hasTexCoord || hasNormal)
+				{
+					fmt::format_to(out, "/");
+				}
+				
+				if (hasTexCoord)
+				{
+					fmt::format_to(out, "{}", tBase + mesh.ft[corner]);
+				}
+				
+				if (hasNormal)
+				{
+					fmt::format_to(out, "/{}", nBase + mesh.fn[corner]);
+				}
+			}
+			fmt::format_to(out, "\n");
+		}
+	}
+	
+	return fmt::to_string(text);
+}
+
+std::unique_ptr<MeshData> MakeBenchMesh(const BenchContext &context)
+{
+	std::string text = MakeBenchOBJ(context);
+	return LoadOBJ(text.data(), text.size(), 0);
+}
+
+struct BenchEntry
+{
+	const char *name;
+	void (*run)(const BenchContext &context);
+};
+
+int main(int argc, char *argv[])
+{
+	const BenchEntry benches[] =
+	{
+		{ "obj", BenchOBJ },
+		{ "layout", BenchLayout },
+		{ "meshbuild", BenchMeshBuild },
+		{ "meshcodec", BenchMeshCodec },
+		{ "meshbvh", BenchMeshBVH },
+		{ "pngdecode", BenchPNGDecode },
+		{ "pngencode", BenchPNGEncode },
+		{ "mip", BenchMip },
+		{ "bc", BenchBlockCompress },
+		{ "pixelconvert", BenchPixelConvert },
+	};
+	
+	BenchContext context;
+	context.dataPath = SMORGASBORD_BENCH_DATA;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--data") == 0 && i + 1 < argc)
+		{
+			context.dataPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--copies") == 0 && i + 1 < argc)
+		{
+			context.numCopies = uint32_t(std::max(1, std::atoi(argv[++i])));
+		}
+		else
+		{
+			names.push_back(argv[i]);
+		}
+	}
+	
+	/// Resources are looked up relative to the directory
+	if (!context.dataPath.empty() && context.dataPath.back() != '/')
+	{
+		context.dataPath += '/';
+	}
+	
+	for (const std::string &name : names)
+	{
+		if (std::none_of(
+			std::begin(benches),
+			std::end(benches),
+			[&name](const BenchEntry &bench) { return name == bench.name; }))
+		{
+			LogE("Unknown benchmark {0}", name);
+			return 1;
+		}
+	}
+	
+	for (const BenchEntry &bench : benches)
+	{
+		if (names.empty()
+			|| std::find(names.begin(), names.end(), bench.name) != names.end())
+		{
+			fmt::print("{0}\n", bench.name);
+			bench.run(context);
+		}
+	}
+	
+	return 0;
+}
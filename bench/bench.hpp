@@ -0,0 +1,52 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/*
+
+Benchmarks
+----------
+
+"bench" runs every benchmark, "bench <name>..." only the named ones, see
+main() for the names. Every time printed is the fastest of several runs,
+next to the throughput it gives.
+
+Mesh benchmarks work on copies of samples/liltown/data/town.obj, placed
+side by side on a grid, to get meshes of a realistic size out of the one
+model in the repository.
+	
+	--data <directory>  reads town.obj from another directory
+	--copies <n>        number of town.obj copies, 256 by default
+
+*/
+
+struct BenchContext
+{
+	std::string dataPath; // directory holding town.obj
+	uint32_t numCopies = 256;
+};
+
+/// Fastest of numRuns calls of run, in seconds
+double MeasureBest(const std::function<void()> &run, uint32_t numRuns = 5);
+
+/// OBJ text of context.numCopies copies of town.obj
+std::string MakeBenchOBJ(const BenchContext &context);
+
+/// MeshData of context.numCopies copies of town.obj
+std::unique_ptr<Smorgasbord::MeshData> MakeBenchMesh(const BenchContext &context);
+
+void BenchOBJ(const BenchContext &context);
+void BenchLayout(const BenchContext &context);
+void BenchMeshBuild(const BenchContext &context);
+void BenchMeshCodec(const BenchContext &context);
+void BenchMeshBVH(const BenchContext &context);
+void BenchPNGDecode(const BenchContext &context);
+void BenchPNGEncode(const BenchContext &context);
+void BenchMip(const BenchContext &context);
+void BenchBlockCompress(const BenchContext &context);
+void BenchPixelConvert(const BenchContext &context);
@@ -0,0 +1,152 @@
+#include "bench.hpp"
+
+#include <smorgasbord/image/blockcompress.hpp>
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/log.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace Smorgasbord;
+
+/// RGBA images: smooth gradients with mild noise and an alpha ramp,
+/// random pixels, and a stripe pattern with cutout alpha
+static std::shared_ptr<Image> MakeBenchBlockImage(
+	glm::uvec2 size, uint32_t content, uint32_t seed)
+{
+	std::shared_ptr<Image> image = std::make_shared<Image>(size);
+	std::mt19937 random(seed);
+	for (uint32_t y = 0; y < size.y; y++)
+	{
+		for (uint32_t x = 0; x < size.x; x++)
+		{
+			uint8_t *pixel = &image->data[(size_t(y) * size.x + x) * 4];
+			const float fx = float(x) / float(size.x);
+			const float fy = float(y) / float(size.y);
+			if (content == 0)
+			{
+				pixel[0] = uint8_t(std::min(
+					255.0f, 128 + 100 * std::sin(fx * 9) + float(random() % 9)));
+				pixel[1] = uint8_t(255 * fy);
+				pixel[2] = uint8_t(128 + 120 * std::cos((fx + fy) * 7));
+				pixel[3] = uint8_t(255 * fx);
+			}
+			else if (content == 1)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					pixel[c] = uint8_t(random());
+				}
+			}
+			else
+			{
+				pixel[0] = uint8_t(x * 7);
+				pixel[1] = uint8_t(y * 5);
+				pixel[2] = 90;
+				pixel[3] = ((x / 3 + y / 5) & 1) ? 255 : 0;
+			}
+		}
+	}
+	
+	return image;
+}
+
+/// PSNR over the channels the format stores. BC1 pixels that are meant to
+/// be transparent only count by whether they are
+static double GetBlockPSNR(
+	const Image &image, const Image &decoded, TextureFormat format, uint32_t numChannels)
+{
+	const bool punchThrough = format == TextureFormat::BC1_RGBA_UNorm;
+	double squaredError = 0;
+	size_t count = 0;
+	for (size_t i = 0; i < image.data.size(); i += 4)
+	{
+		if (punchThrough && image.data[i + 3] < 128)
+		{
+			double error = decoded.data[i + 3] == 0 ? 0 : 255;
+			squaredError += error * error;
+			count++;
+			continue;
+		}
+		
+		for (uint32_t c = 0; c < numChannels; c++)
+		{
+			double error = double(image.data[i + c]) - double(decoded.data[i + c]);
+			squaredError += error * error;
+			count++;
+		}
+	}
+	
+	if (squaredError == 0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	
+	return 10 * std::log10(255.0 * 255.0 * double(count) / squaredError);
+}
+
+/// CompressImage() rate on one and on all threads, and the quality of the
+/// result as decoded by DecompressImage(), per BC format
+void BenchBlockCompress(const BenchContext &)
+{
+	struct BenchFormat
+	{
+		TextureFormat format;
+		const char *name;
+		uint32_t numChannels; // compared channels, starting at red
+	};
+	
+	const BenchFormat formats[] =
+	{
+		{ TextureFormat::BC1_RGBA_UNorm, "BC1", 3 },
+		{ TextureFormat::BC3_RGBA_UNorm, "BC3", 4 },
+		{ TextureFormat::BC4_R_UNorm, "BC4", 1 },
+		{ TextureFormat::BC5_RG_UNorm, "BC5", 2 },
+		{ TextureFormat::BC7_RGBA_UNorm, "BC7", 4 },
+	};
+	
+	const char *imageNames[] = { "smooth", "random", "cutout" };
+	const glm::uvec2 size(1024, 1024);
+	const double megapixels = double(size.x) * size.y / 1e6;
+	
+	for (uint32_t content = 0; content < 3; content++)
+	{
+		std::shared_ptr<Image> image = MakeBenchBlockImage(size, content, content + 1);
+		for (const BenchFormat &format : formats)
+		{
+			std::vector<uint8_t> blocks;
+			double seconds[2];
+			for (uint32_t numThreads : { 1u, 0u })
+			{
+				seconds[numThreads == 0] = MeasureBest(
+					[&]()
+					{
+						CompressImage(*image, format.format, blocks, numThreads);
+					},
+					3);
+			}
+			
+			std::shared_ptr<Image> decoded = DecompressImage(
+				blocks.data(), blocks.size(), size, format.format);
+			if (!decoded)
+			{
+				LogE("Can't decompress {0} blocks", format.name);
+				continue;
+			}
+			
+			fmt::print(
+				"  {0:<6} {1}  PSNR {2:6.2f} dB, 1 thread {3:6.1f} MPix/s, "
+				"threads {4:6.1f} MPix/s\n",
+				imageNames[content],
+				format.name,
+				GetBlockPSNR(*image, *decoded, format.format, format.numChannels),
+				megapixels / seconds[0],
+				megapixels / seconds[1]);
+		}
+	}
+}
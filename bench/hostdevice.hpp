@@ -0,0 +1,91 @@
+#pragma once
+
+#include <smorgasbord/gpu/gpuapi.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Buffer in host memory, to measure the host side of mesh builds without
+/// a graphics context
+class HostBuffer : public Smorgasbord::Buffer
+{
+public:
+	std::vector<uint8_t> data;
+	
+	HostBuffer(Smorgasbord::BufferType bufferType, uint32_t size)
+		: Buffer(
+			bufferType,
+			Smorgasbord::BufferUsageType::Draw,
+			Smorgasbord::BufferUsageFrequency::Static,
+			int(size))
+		, data(size)
+	{
+	}
+	
+	uint8_t *GetMappedData() override
+	{
+		return data.data();
+	}
+	
+	void Map(Smorgasbord::MappedDataAccessType) override { }
+	void Unmap() override { }
+};
+
+/// Creates HostBuffers, everything else is nullptr
+class HostDevice : public Smorgasbord::Device
+{
+	Smorgasbord::DeviceInfo info;
+
+public:
+	const Smorgasbord::DeviceInfo &GetDeviceInfo() const override
+	{
+		return info;
+	}
+	
+	std::vector<std::shared_ptr<Smorgasbord::Queue>> GetQueues() override
+	{
+		return { };
+	}
+	
+	std::shared_ptr<Smorgasbord::Queue> GetDisplayQueue() override
+	{
+		return nullptr;
+	}
+	
+	std::shared_ptr<Smorgasbord::SwapChain> CreateSwapChain(uint32_t) override
+	{
+		return nullptr;
+	}
+	
+	std::shared_ptr<Smorgasbord::FrameBuffer> CreateFrameBuffer() override
+	{
+		return nullptr;
+	}
+	
+	std::shared_ptr<Smorgasbord::CommandBuffer> CreateCommandBuffer() override
+	{
+		return nullptr;
+	}
+	
+	std::shared_ptr<Smorgasbord::RasterizationShader> CreateRasterizationShader(
+		std::string) override
+	{
+		return nullptr;
+	}
+	
+	std::shared_ptr<Smorgasbord::Buffer> CreateBuffer(
+		Smorgasbord::BufferType bufferType,
+		Smorgasbord::BufferUsageType,
+		Smorgasbord::BufferUsageFrequency,
+		uint32_t size) override
+	{
+		return std::make_shared<HostBuffer>(bufferType, size);
+	}
+	
+	std::shared_ptr<Smorgasbord::Texture> CreateTexture(
+		glm::uvec2, Smorgasbord::TextureFormat, uint32_t) override
+	{
+		return nullptr;
+	}
+};
@@ -0,0 +1,74 @@
+#include "bench.hpp"
+#include "hostdevice.hpp"
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <fmt/format.h>
+
+#include <vector>
+
+using namespace Smorgasbord;
+
+/// Host side cost of filling the vertex buffer in each VertexLayout:
+/// Append() copies the face corners as they are, so it measures the
+/// interleaving alone, the full build adds welding and optimization
+void BenchLayout(const BenchContext &context)
+{
+	std::unique_ptr<MeshData> mesh = MakeBenchMesh(context);
+	std::shared_ptr<HostDevice> device = std::make_shared<HostDevice>();
+	
+	const bool hasNormal = !mesh->n.empty() && mesh->fn.size() == mesh->fp.size();
+	const bool hasTexCoord = !mesh->t.empty() && mesh->ft.size() == mesh->fp.size();
+	const double vertexBytes = double(mesh->fp.size())
+		* double(sizeof(glm::vec3)
+			+ (hasNormal ? sizeof(glm::vec3) : 0)
+			+ (hasTexCoord ? sizeof(glm::vec2) : 0));
+	
+	fmt::print(
+		"  {0} faces, {1:.1f} MB of vertices\n",
+		mesh->c.size(), vertexBytes / 1e6);
+	
+	const char *names[] = { "planar", "interleaved", "separate position" };
+	for (uint32_t layout = 0; layout < 3; layout++)
+	{
+		/// Buffers are allocated up front, so only the copy is measured
+		const uint32_t numRuns = 5;
+		std::vector<std::unique_ptr<StaticMesh>> staticMeshes;
+		for (uint32_t i = 0; i < numRuns; i++)
+		{
+			staticMeshes.emplace_back(new StaticMesh(
+				device,
+				uint32_t(mesh->c.size()),
+				3,
+				hasNormal,
+				hasTexCoord,
+				VertexLayout(layout)));
+		}
+		
+		uint32_t run = 0;
+		double appendSeconds = MeasureBest(
+			[&]()
+			{
+				staticMeshes[run++]->Append(*mesh);
+			},
+			numRuns);
+		staticMeshes.clear();
+		
+		double buildSeconds = MeasureBest(
+			[&]()
+			{
+				StaticMesh staticMesh(
+					device,
+					std::unique_ptr<MeshData>(new MeshData(*mesh)),
+					VertexLayout(layout));
+			},
+			3);
+		
+		fmt::print(
+			"  {0:<18} append {1:7.1f} ms {2:6.2f} GB/s, build {3:7.1f} ms\n",
+			names[layout],
+			appendSeconds * 1e3,
+			vertexBytes / appendSeconds / 1e9,
+			buildSeconds * 1e3);
+	}
+}
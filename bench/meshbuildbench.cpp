@@ -0,0 +1,57 @@
+#include "bench.hpp"
+#include "hostdevice.hpp"
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <fmt/format.h>
+
+using namespace Smorgasbord;
+
+/// MeshData::UpdateStatistics() on one and on all threads, and the whole
+/// StaticMesh build, in bytes of the mesh per second
+void BenchMeshBuild(const BenchContext &context)
+{
+	std::unique_ptr<MeshData> mesh = MakeBenchMesh(context);
+	std::shared_ptr<HostDevice> device = std::make_shared<HostDevice>();
+	
+	const double statisticsBytes = double(mesh->c.size() * sizeof(int32_t)
+		+ mesh->p.size() * sizeof(glm::vec3));
+	
+	fmt::print(
+		"  {0} faces, {1} positions\n", mesh->c.size(), mesh->p.size());
+	
+	for (uint32_t numThreads : { 1u, 0u })
+	{
+		double seconds = MeasureBest(
+			[&]()
+			{
+				mesh->UpdateStatistics(numThreads);
+			});
+		
+		fmt::print(
+			"  statistics, {0:<9}{1:7.2f} ms {2:6.2f} GB/s\n",
+			numThreads == 0 ? "threads" : "1 thread",
+			seconds * 1e3,
+			statisticsBytes / seconds / 1e9);
+	}
+	
+	/// Welding shrinks the buffers to a fraction of the mesh, so the rate
+	/// is given in attribute bytes of the face corners it started from
+	const double cornerBytes = double(mesh->fp.size())
+		* double(sizeof(glm::vec3)
+			+ (mesh->fn.empty() ? 0 : sizeof(glm::vec3))
+			+ (mesh->ft.empty() ? 0 : sizeof(glm::vec2)));
+	
+	double seconds = MeasureBest(
+		[&]()
+		{
+			StaticMesh staticMesh(
+				device, std::unique_ptr<MeshData>(new MeshData(*mesh)));
+		},
+		3);
+	
+	fmt::print(
+		"  StaticMesh build      {0:7.2f} ms {1:6.2f} GB/s of face corners\n",
+		seconds * 1e3,
+		cornerBytes / seconds / 1e9);
+}
@@ -0,0 +1,88 @@
+#include "bench.hpp"
+
+#include <smorgasbord/rendering/meshbvh.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Smorgasbord;
+
+/// MeshBVH build on one and on all threads, and picking: closest hit and
+/// any hit queries of rays from above the copies of town.obj, towards
+/// random points on the ground, in microseconds per ray
+void BenchMeshBVH(const BenchContext &context)
+{
+	std::unique_ptr<MeshData> mesh = MakeBenchMesh(context);
+	
+	size_t numTriangles = 0;
+	for (int32_t count : mesh->c)
+	{
+		numTriangles += size_t(std::max(count - 2, 0));
+	}
+	
+	fmt::print("  {0} triangles\n", numTriangles);
+	
+	for (uint32_t numThreads : { 1u, 0u })
+	{
+		double seconds = MeasureBest(
+			[&]()
+			{
+				MeshBVH bvh(*mesh, numThreads);
+			},
+			3);
+		
+		fmt::print(
+			"  build, {0:<9}{1:8.1f} ms {2:6.2f} M triangles/s\n",
+			numThreads == 0 ? "threads" : "1 thread",
+			seconds * 1e3,
+			double(numTriangles) / seconds / 1e6);
+	}
+	
+	MeshBVH bvh(*mesh);
+	
+	const glm::vec3 boundsMin = mesh->boundingMin;
+	const glm::vec3 boundsMax = mesh->boundingMax;
+	const glm::vec3 extent = boundsMax - boundsMin;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::vector<Ray> rays(100000);
+	for (Ray &ray : rays)
+	{
+		const glm::vec3 target = boundsMin
+			+ glm::vec3(unit(random), 0, unit(random)) * extent;
+		ray.origin = target + glm::vec3(unit(random) - 0.5f, 1, unit(random) - 0.5f)
+			* std::max(extent.y, 1.0f) * 2.0f;
+		ray.direction = target - ray.origin;
+	}
+	
+	size_t numHits = 0;
+	double closestSeconds = MeasureBest(
+		[&]()
+		{
+			numHits = 0;
+			for (const Ray &ray : rays)
+			{
+				RayHit hit;
+				numHits += bvh.Intersect(ray, hit);
+			}
+		});
+	
+	double anySeconds = MeasureBest(
+		[&]()
+		{
+			for (const Ray &ray : rays)
+			{
+				bvh.IntersectAny(ray);
+			}
+		});
+	
+	fmt::print(
+		"  {0} rays, {1:.0f}% hit: closest {2:6.3f} us/ray, any {3:6.3f} us/ray\n",
+		rays.size(),
+		100.0 * double(numHits) / double(rays.size()),
+		closestSeconds / double(rays.size()) * 1e6,
+		anySeconds / double(rays.size()) * 1e6);
+}
@@ -0,0 +1,103 @@
+#include "bench.hpp"
+
+#include <smorgasbord/rendering/meshcodec.hpp>
+#include <smorgasbord/rendering/meshoptimize.hpp>
+#include <smorgasbord/rendering/triangulate.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace Smorgasbord;
+
+/// Compression ratio and decode rate of the interleaved vertices and the
+/// indices of a mesh, welded and optimized as StaticMesh would
+static void BenchMeshCodecMesh(const char *name, MeshData &mesh)
+{
+	if (mesh.maxVerticesPerFace > 3)
+	{
+		TriangulateMeshData(mesh);
+	}
+	
+	IndexedMeshData indexed = WeldMeshData(mesh);
+	OptimizeIndexedMesh(indexed, mesh.ranges);
+	
+	const size_t count = indexed.p.size();
+	const bool hasNormal = !indexed.n.empty();
+	const bool hasTexCoord = !indexed.t.empty();
+	const size_t stride = sizeof(glm::vec3)
+		+ (hasNormal ? sizeof(glm::vec3) : 0)
+		+ (hasTexCoord ? sizeof(glm::vec2) : 0);
+	
+	std::vector<uint8_t> vertices(count * stride);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint8_t *vertex = &vertices[i * stride];
+		std::memcpy(vertex, &indexed.p[i], sizeof(glm::vec3));
+		vertex += sizeof(glm::vec3);
+		if (hasNormal)
+		{
+			std::memcpy(vertex, &indexed.n[i], sizeof(glm::vec3));
+			vertex += sizeof(glm::vec3);
+		}
+		
+		if (hasTexCoord)
+		{
+			std::memcpy(vertex, &indexed.t[i], sizeof(glm::vec2));
+		}
+	}
+	
+	const std::vector<uint32_t> &indices = indexed.indices;
+	const size_t indexSize = count <= 0x10000 ? 2 : 4;
+	
+	std::vector<uint8_t> vertexData =
+		EncodeVertexBuffer(vertices.data(), count, stride);
+	std::vector<uint8_t> indexData =
+		EncodeIndexBuffer(indices.data(), indices.size());
+	
+	std::vector<uint8_t> target(std::max(vertices.size(), indices.size() * indexSize));
+	double vertexSeconds = MeasureBest(
+		[&]()
+		{
+			DecodeVertexBuffer(
+				target.data(), count, stride, vertexData.data(), vertexData.size());
+		},
+		20);
+	
+	double indexSeconds = MeasureBest(
+		[&]()
+		{
+			DecodeIndexBuffer(
+				target.data(),
+				indices.size(),
+				indexSize,
+				indexData.data(),
+				indexData.size());
+		},
+		20);
+	
+	const double indexBytes = double(indices.size() * indexSize);
+	fmt::print(
+		"  {0}: {1} vertices of {2} bytes, {3} triangles\n"
+		"    vertices {4:5.2f}x, decode {5:5.2f} GB/s\n"
+		"    indices  {6:5.2f}x, {7:4.2f} bits per triangle, decode {8:5.2f} GB/s\n",
+		name,
+		count,
+		stride,
+		indices.size() / 3,
+		double(vertices.size()) / double(vertexData.size()),
+		double(vertices.size()) / vertexSeconds / 1e9,
+		indexBytes / double(indexData.size()),
+		double(indexData.size()) * 8 / double(indices.size() / 3),
+		indexBytes / indexSeconds / 1e9);
+}
+
+void BenchMeshCodec(const BenchContext &context)
+{
+	BenchContext townContext = context;
+	townContext.numCopies = 1;
+	BenchMeshCodecMesh("town.obj", *MakeBenchMesh(townContext));
+	BenchMeshCodecMesh("copies", *MakeBenchMesh(context));
+}
@@ -0,0 +1,51 @@
+#include "bench.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/image/mipmap.hpp>
+
+#include <fmt/format.h>
+
+#include <random>
+
+using namespace Smorgasbord;
+
+/// Full mip chain of a 3840x2160 RGBA image with each filter, in linear
+/// and in sRGB space, on one and on all threads. The rate is given in
+/// pixels of the source image per second
+void BenchMip(const BenchContext &)
+{
+	const glm::uvec2 size(3840, 2160);
+	const double megapixels = double(size.x) * size.y / 1e6;
+	
+	std::shared_ptr<Image> image = std::make_shared<Image>(size);
+	std::mt19937 random(1);
+	for (uint8_t &value : image->data)
+	{
+		value = uint8_t(random());
+	}
+	
+	const char *filterNames[] = { "Box", "Kaiser" };
+	for (uint32_t filter = 0; filter < 2; filter++)
+	{
+		for (bool sRGB : { false, true })
+		{
+			for (uint32_t numThreads : { 1u, 0u })
+			{
+				double seconds = MeasureBest(
+					[&]()
+					{
+						GenerateMipChain(image, MipFilter(filter), sRGB, 0, numThreads);
+					},
+					3);
+				
+				fmt::print(
+					"  {0:<6} {1:<6} {2:<9}{3:7.1f} ms {4:7.1f} MPix/s\n",
+					filterNames[filter],
+					sRGB ? "sRGB" : "linear",
+					numThreads == 0 ? "threads" : "1 thread",
+					seconds * 1e3,
+					megapixels / seconds);
+			}
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#include "bench.hpp"
+
+#include <smorgasbord/import/loadobj.hpp>
+
+#include <fmt/format.h>
+
+#include <sstream>
+
+using namespace Smorgasbord;
+
+/// The stream parser of LoadOBJ(std::istream) against the in place
+/// parser, on the same text in memory, so file reads are left out
+void BenchOBJ(const BenchContext &context)
+{
+	const std::string text = MakeBenchOBJ(context);
+	const double megabytes = double(text.size()) / 1e6;
+	size_t numFaces = 0;
+	
+	double streamSeconds = MeasureBest(
+		[&]()
+		{
+			std::unique_ptr<MeshData> mesh = LoadOBJ(
+				std::unique_ptr<std::istream>(new std::istringstream(text)));
+			numFaces = mesh->c.size();
+		},
+		3);
+	
+	fmt::print(
+		"  {0:.1f} MB, {1} faces\n"
+		"  stream parser      {2:8.1f} ms {3:8.1f} MB/s\n",
+		megabytes, numFaces, streamSeconds * 1e3, megabytes / streamSeconds);
+	
+	for (uint32_t numThreads : { 1u, 0u })
+	{
+		double seconds = MeasureBest(
+			[&]()
+			{
+				LoadOBJ(text.data(), text.size(), numThreads);
+			});
+		
+		fmt::print(
+			"  in place, {0:<9}{1:8.1f} ms {2:8.1f} MB/s {3:6.1f}x\n",
+			numThreads == 0 ? "threads" : "1 thread",
+			seconds * 1e3, megabytes / seconds, streamSeconds / seconds);
+	}
+}
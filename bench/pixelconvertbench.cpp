@@ -0,0 +1,97 @@
+#include "bench.hpp"
+
+#include <smorgasbord/image/pixelconvert.hpp>
+
+#include <fmt/format.h>
+
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace Smorgasbord;
+
+/// Each conversion on 16M values, 4M RGBA pixels, in values per second
+void BenchPixelConvert(const BenchContext &)
+{
+	const size_t count = size_t(1) << 24;
+	std::vector<float> floats(count);
+	std::vector<float> floatTarget(count);
+	std::vector<uint8_t> bytes(count);
+	std::vector<uint8_t> byteTarget(count);
+	std::vector<uint16_t> shorts(count);
+	std::vector<uint16_t> shortTarget(count);
+	
+	std::mt19937 random(1);
+	for (size_t i = 0; i < count; i++)
+	{
+		floats[i] = float(random() & 0xFFFFFF) / float(0xFFFFFF);
+		bytes[i] = uint8_t(random());
+		shorts[i] = uint16_t(random());
+	}
+	ConvertFloatToHalf(shorts.data(), floats.data(), count);
+	
+	struct BenchConversion
+	{
+		const char *name;
+		std::function<void()> run;
+	};
+	
+	const size_t numPixels = count / 4;
+	const BenchConversion conversions[] =
+	{
+		{
+			"unorm8 to float",
+			[&]() { ConvertUNorm8ToFloat(floatTarget.data(), bytes.data(), count); }
+		},
+		{
+			"float to unorm8",
+			[&]() { ConvertFloatToUNorm8(byteTarget.data(), floats.data(), count); }
+		},
+		{
+			"unorm16 to float",
+			[&]() { ConvertUNorm16ToFloat(floatTarget.data(), shorts.data(), count); }
+		},
+		{
+			"float to unorm16",
+			[&]() { ConvertFloatToUNorm16(shortTarget.data(), floats.data(), count); }
+		},
+		{
+			"sRGB to linear",
+			[&]() { ConvertSRGBToLinear(floatTarget.data(), bytes.data(), numPixels, 4); }
+		},
+		{
+			"linear to sRGB",
+			[&]() { ConvertLinearToSRGB(byteTarget.data(), floats.data(), numPixels, 4); }
+		},
+		{
+			"float to half",
+			[&]() { ConvertFloatToHalf(shortTarget.data(), floats.data(), count); }
+		},
+		{
+			"half to float",
+			[&]() { ConvertHalfToFloat(floatTarget.data(), shorts.data(), count); }
+		},
+		{
+			"swizzle bgra",
+			[&]() { SwizzlePixels(byteTarget.data(), 4, bytes.data(), 4, numPixels, "bgra"); }
+		},
+		{
+			"swizzle rgb to rgb1",
+			[&]() { SwizzlePixels(byteTarget.data(), 4, bytes.data(), 3, numPixels, "rgb1"); }
+		},
+		{
+			"swizzle rgba to rgb",
+			[&]() { SwizzlePixels(byteTarget.data(), 3, bytes.data(), 4, numPixels, "rgb"); }
+		},
+	};
+	
+	for (const BenchConversion &conversion : conversions)
+	{
+		double seconds = MeasureBest(conversion.run);
+		fmt::print(
+			"  {0:<20}{1:7.2f} ms {2:7.0f} M values/s\n",
+			conversion.name,
+			seconds * 1e3,
+			double(count) / seconds / 1e6);
+	}
+}
@@ -0,0 +1,164 @@
+#include "bench.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/import/decodepng.hpp>
+#include <smorgasbord/import/encodepng.hpp>
+
+#include <lodepng/lodepng.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Smorgasbord;
+
+enum class BenchImageContent
+{
+	Smooth = 0, // gradients and mild noise, like a photo or a render
+	Flat, // large areas of one color, like UI or a texture atlas
+	Noisy
+};
+
+static const char *benchImageNames[] = { "smooth", "flat", "noisy" };
+
+/// RGBA pixels, alpha varies slightly so it can't be dropped
+static std::vector<uint8_t> MakeBenchImage(
+	glm::uvec2 size, BenchImageContent content, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<uint8_t> pixels(size_t(size.x) * size.y * 4);
+	for (uint32_t y = 0; y < size.y; y++)
+	{
+		for (uint32_t x = 0; x < size.x; x++)
+		{
+			uint8_t *pixel = &pixels[(size_t(y) * size.x + x) * 4];
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				double value = 0;
+				switch (content)
+				{
+				case BenchImageContent::Smooth:
+					value = 128 + 100 * std::sin(x * 0.01 + c) * std::cos(y * 0.013)
+						+ random() % 9;
+					break;
+				case BenchImageContent::Flat:
+					value = ((x / 64 + y / 64) % 2) * 200 + c * 10;
+					break;
+				case BenchImageContent::Noisy:
+					value = 128 + 60 * std::sin(x * 0.02) * std::sin(y * 0.03 + c)
+						+ random() % 41;
+					break;
+				}
+				pixel[c] = uint8_t(std::clamp(value, 0.0, 255.0));
+			}
+			pixel[3] = uint8_t(255 - (x * y) % 3);
+		}
+	}
+	
+	return pixels;
+}
+
+/// DecodePNG() against lodepng, on PNGs encoded by lodepng
+void BenchPNGDecode(const BenchContext &)
+{
+	const glm::uvec2 size(2048, 2048);
+	const double megabytes = double(size.x) * size.y * 4 / 1e6;
+	
+	for (uint32_t content = 0; content < 3; content++)
+	{
+		std::vector<uint8_t> pixels =
+			MakeBenchImage(size, BenchImageContent(content), content);
+		
+		lodepng::State state;
+		state.encoder.auto_convert = 0;
+		std::vector<uint8_t> png;
+		lodepng::encode(png, pixels, size.x, size.y, state);
+		
+		double lodepngSeconds = MeasureBest(
+			[&]()
+			{
+				std::vector<uint8_t> decoded;
+				unsigned width, height;
+				lodepng::decode(decoded, width, height, png);
+			},
+			3);
+		
+		double seconds = MeasureBest(
+			[&]()
+			{
+				Image image;
+				DecodePNG(png.data(), png.size(), image);
+			},
+			3);
+		
+		fmt::print(
+			"  {0:<6} {1}x{2} RGBA, {3:5.2f} MB PNG: lodepng {4:6.1f} MB/s, "
+			"DecodePNG {5:6.1f} MB/s, {6:.2f}x\n",
+			benchImageNames[content],
+			size.x,
+			size.y,
+			double(png.size()) / 1e6,
+			megabytes / lodepngSeconds,
+			megabytes / seconds,
+			lodepngSeconds / seconds);
+	}
+}
+
+/// EncodePNG() at several levels, on one and on all threads, against
+/// lodepng with its default settings
+void BenchPNGEncode(const BenchContext &)
+{
+	const glm::uvec2 size(2048, 2048);
+	const double megabytes = double(size.x) * size.y * 4 / 1e6;
+	
+	for (uint32_t content = 0; content < 3; content++)
+	{
+		Image image;
+		image.imageSize = size;
+		image.data = MakeBenchImage(size, BenchImageContent(content), content);
+		image.UpdateCached();
+		
+		lodepng::State state;
+		state.encoder.auto_convert = 0;
+		std::vector<uint8_t> lodepngPNG;
+		double lodepngSeconds = MeasureBest(
+			[&]()
+			{
+				lodepngPNG.clear();
+				lodepng::encode(lodepngPNG, image.data, size.x, size.y, state);
+			},
+			1);
+		
+		fmt::print(
+			"  {0:<6} lodepng            {1:7.1f} MB/s, {2:5.2f} MB\n",
+			benchImageNames[content],
+			megabytes / lodepngSeconds,
+			double(lodepngPNG.size()) / 1e6);
+		
+		for (int level : { 1, 6, 9 })
+		{
+			for (uint32_t numThreads : { 1u, 0u })
+			{
+				std::vector<uint8_t> png;
+				double seconds = MeasureBest(
+					[&]()
+					{
+						EncodePNG(image, png, level, numThreads);
+					},
+					3);
+				
+				fmt::print(
+					"  {0:<6} level {1}, {2:<9}{3:7.1f} MB/s, {4:5.2f} MB, {5:5.2f}x\n",
+					benchImageNames[content],
+					level,
+					numThreads == 0 ? "threads" : "1 thread",
+					megabytes / seconds,
+					double(png.size()) / 1e6,
+					lodepngSeconds / seconds);
+			}
+		}
+	}
+}
@@ -118,7 +118,7 @@ void MainWidget::Setup(shared_ptr<Device> device)
 	m.camera.SetView(vec3(0,1,0), vec3(0,0,0));
 	
 	m.mesh = make_shared<StaticMesh>(
-		m.d, LoadOBJ(m.r->Get("town.obj")));
+		m.d, LoadOBJCached(m.r->Get("town.obj")));
 	m.testTexture = LoadTexture(m.d, m.r->GetPath("wtf.png"));
 	
 	m.meshShader->SetSource(m.r->Get("mesh.shader"));
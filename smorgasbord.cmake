@@ -3,6 +3,7 @@ set(CMAKE_CXX_STANDARD 17)
 find_package(glm REQUIRED)
 find_package(fmt REQUIRED)
 find_package(SDL2 REQUIRED)
+find_package(Threads REQUIRED)
 
 file(GLOB_RECURSE PUBLIC_HEADERS
 	"${CMAKE_CURRENT_SOURCE_DIR}/src/*.hpp"
@@ -25,6 +26,7 @@ target_link_libraries(${PROJECT_NAME}-static
 		fmt::fmt
 		glm
 		SDL2::SDL2main SDL2::SDL2-static
+		Threads::Threads
 )
 
 target_include_directories(${PROJECT_NAME}-static
@@ -40,6 +42,18 @@ target_compile_definitions(${PROJECT_NAME}-static
 		NOMINMAX # windows.h interferes with GLM under MSVC if not defined
 )
 
+# AVX2 kernels are only compiled in if the compiler may use AVX2 and F16C, see
+# util/simd.hpp. The library then needs a CPU with them (Haswell, Zen and later)
+option(SMORGASBORD_AVX2 "Build with AVX2, F16C and SSE4.1 kernels" OFF)
+
+if (SMORGASBORD_AVX2)
+	if (MSVC)
+		target_compile_options(${PROJECT_NAME}-static PUBLIC /arch:AVX2)
+	else()
+		target_compile_options(${PROJECT_NAME}-static PUBLIC -mavx2 -mf16c)
+	endif()
+endif()
+
 set_target_properties(${PROJECT_NAME}-static PROPERTIES
 	DEBUG_POSTFIX _d
 )
@@ -53,6 +67,8 @@ install(DIRECTORY "src/smorgasbord" DESTINATION "include" FILES_MATCHING REGEX "
 install(FILES "${PROJECT_BINARY_DIR}/${PROJECT_NAME}-static-config.cmake" DESTINATION "lib/cmake/${PROJECT_NAME}-static")
 
 option(SMORGASBORD_BUILD_SAMPLES "Build sample projects" ON)
+option(SMORGASBORD_BUILD_BENCHMARKS "Build the bench executable" OFF)
+option(SMORGASBORD_BUILD_TESTS "Build tests, run them with ctest" OFF)
 
 if (SMORGASBORD_BUILD_SAMPLES)
 	# samples would call find_library(smorgasbord-static REQUIRED), but we can make the call NOP with this
@@ -62,3 +78,12 @@ if (SMORGASBORD_BUILD_SAMPLES)
 
 	add_subdirectory("${PROJECT_SOURCE_DIR}/samples/liltown" liltown_sample)
 endif()
+
+if (SMORGASBORD_BUILD_BENCHMARKS)
+	add_subdirectory("${PROJECT_SOURCE_DIR}/bench" bench)
+endif()
+
+if (SMORGASBORD_BUILD_TESTS)
+	enable_testing()
+	add_subdirectory("${PROJECT_SOURCE_DIR}/tests" tests)
+endif()
@@ -39,6 +39,15 @@ STREAM:  The user will be changing the data after every use.
 
 using namespace Smorgasbord;
 
+/// EXT_texture_sRGB, not in glcorearb.h
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
 inline GLenum GetBufferType(Smorgasbord::BufferType type)
 {
 	switch (type)
@@ -147,6 +156,14 @@ inline GLenum GetAttributeDataType(AttributeDataType type)
 		return GL_UNSIGNED_SHORT;
 	case AttributeDataType::UInt32:
 		return GL_UNSIGNED_INT;
+	case AttributeDataType::Half:
+		return GL_HALF_FLOAT;
+	case AttributeDataType::Int_2_10_10_10_Rev:
+		return GL_INT_2_10_10_10_REV;
+	case AttributeDataType::UInt_2_10_10_10_Rev:
+		return GL_UNSIGNED_INT_2_10_10_10_REV;
+	case AttributeDataType::UFloat_10_11_11_Rev:
+		return GL_UNSIGNED_INT_10F_11F_11F_REV;
 	}
 	
 	LogF("Invalid enum value");
@@ -241,6 +258,24 @@ format is stored as. The following suffixes are used:
 		return { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT };
 	case TextureFormat::Depth_32_UNorm:
 		return { GL_DEPTH_COMPONENT32, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT };
+	/// BC1 and BC3 are S3TC, BC4 and BC5 RGTC, BC7 BPTC. format and
+	/// dataType are not used by the glCompressedTex* calls
+	case TextureFormat::BC1_RGBA_UNorm:
+		return { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_RGBA, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC1_RGBA_sRGB:
+		return { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, GL_RGBA, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC3_RGBA_UNorm:
+		return { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC3_RGBA_sRGB:
+		return { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GL_RGBA, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC4_R_UNorm:
+		return { GL_COMPRESSED_RED_RGTC1, GL_RED, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC5_RG_UNorm:
+		return { GL_COMPRESSED_RG_RGTC2, GL_RG, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC7_RGBA_UNorm:
+		return { GL_COMPRESSED_RGBA_BPTC_UNORM, GL_RGBA, GL_UNSIGNED_BYTE };
+	case TextureFormat::BC7_RGBA_sRGB:
+		return { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, GL_RGBA, GL_UNSIGNED_BYTE };
 	}
 	
 	return { GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE };
@@ -254,6 +289,14 @@ inline GLenum GetSamplerFilter(SamplerFilter filter)
 		return GL_NEAREST;
 	case SamplerFilter::Linear:
 		return GL_LINEAR;
+	case SamplerFilter::NearestMipmapNearest:
+		return GL_NEAREST_MIPMAP_NEAREST;
+	case SamplerFilter::NearestMipmapLinear:
+		return GL_NEAREST_MIPMAP_LINEAR;
+	case SamplerFilter::LinearMipmapNearest:
+		return GL_LINEAR_MIPMAP_NEAREST;
+	case SamplerFilter::LinearMipmapLinear:
+		return GL_LINEAR_MIPMAP_LINEAR;
 	}
 	
 	LogF("Invalid enum value");
@@ -371,8 +414,11 @@ void Smorgasbord::GL4Buffer::Unmap()
 
 
 Smorgasbord::GL4Texture::GL4Texture(
-	GL4Device& device, glm::uvec2 _size, TextureFormat _format)
-	: Texture(_size, _format)
+	GL4Device& device,
+	glm::uvec2 _size,
+	TextureFormat _format,
+	uint32_t _numLevels)
+	: Texture(_size, _format, _numLevels)
 	, gl(device.GetLoader())
 {
 	if (id != 0)
@@ -387,6 +433,12 @@ Smorgasbord::GL4Texture::GL4Texture(
 		return;
 	}
 	
+	if (numLevels == 0 || numLevels > GetMaxTextureLevels(size))
+	{
+		LogE("invalid mip level count {0}", numLevels);
+		numLevels = std::max(std::min(numLevels, GetMaxTextureLevels(size)), 1u);
+	}
+	
 	GL4TextureFormat nativeFormat = GetTextureFormat(format); 
 	
 	// Upload texture
@@ -399,13 +451,29 @@ Smorgasbord::GL4Texture::GL4Texture(
 	
 	/// OpenGL 3.2+ does not accept color component count as internalFormat,
 	/// must use one of the predifined constants
-	gl.glTexImage2D(
-		GL_TEXTURE_2D, 0,
-		nativeFormat.internalFormat,
-		size.x, size.y,
-		0,
-		nativeFormat.format, nativeFormat.dataType,
-		NULL);
+	for (uint32_t level = 0; level < numLevels; level++)
+	{
+		glm::uvec2 levelSize = GetTextureLevelDimensions(size, level);
+		if (IsCompressedTextureFormat(format))
+		{
+			gl.glCompressedTexImage2D(
+				GL_TEXTURE_2D, GLint(level),
+				nativeFormat.internalFormat,
+				levelSize.x, levelSize.y,
+				0,
+				GLsizei(GetTextureLevelSize(format, size, level)),
+				NULL);
+			continue;
+		}
+		
+		gl.glTexImage2D(
+			GL_TEXTURE_2D, GLint(level),
+			nativeFormat.internalFormat,
+			levelSize.x, levelSize.y,
+			0,
+			nativeFormat.format, nativeFormat.dataType,
+			NULL);
+	}
 	
 	/// Default mimpmap levels are 1000 and default tex filter is 
 	/// GL_NEAREST_MIPMAP_LINEAR, which makes the texture incomplete if
@@ -420,7 +488,7 @@ Smorgasbord::GL4Texture::GL4Texture(
 	gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
 	/// GL_TEXTURE_MAX_LEVEL is the index of the highest level,
 	/// not the number of level
-	gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(numLevels - 1));
 	SetTextureFilter(SamplerFilter::Nearest, SamplerFilter::Nearest);
 	SetTextureWrap(
 		SamplerWrap::Clamp, SamplerWrap::Clamp, SamplerWrap::Clamp);
@@ -475,6 +543,21 @@ void Smorgasbord::GL4Texture::SetTextureFilter(
 	//glActiveTexture(GL_TEXTURE0 + bindSlot);
 	gl.glTexParameteri(
 		GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GetSamplerFilter(minify));
+	/// Magnification only has the base level
+	switch (magnify)
+	{
+	case SamplerFilter::NearestMipmapNearest:
+	case SamplerFilter::NearestMipmapLinear:
+		magnify = SamplerFilter::Nearest;
+		break;
+	case SamplerFilter::LinearMipmapNearest:
+	case SamplerFilter::LinearMipmapLinear:
+		magnify = SamplerFilter::Linear;
+		break;
+	default:
+		break;
+	}
+	
 	gl.glTexParameteri(
 		GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GetSamplerFilter(magnify));
 }
@@ -502,6 +585,12 @@ void Smorgasbord::GL4Texture::Upload(Smorgasbord::Image &image)
 		return;
 	}
 	
+	if (IsCompressedTextureFormat(format))
+	{
+		LogE("compressed textures take blocks, see UploadLevels()");
+		return;
+	}
+	
 	Bind(0);
 	
 	GL4TextureFormat nativeFormat = GetTextureFormat(format);
@@ -516,8 +605,57 @@ void Smorgasbord::GL4Texture::Upload(Smorgasbord::Image &image)
 	Unbind();
 }
 
+void Smorgasbord::GL4Texture::UploadLevel(
+	uint32_t level, const uint8_t *data, size_t dataSize)
+{
+	if (level >= numLevels)
+	{
+		LogE("texture has no mip level {0}", level);
+		return;
+	}
+	
+	if (dataSize != GetTextureLevelSize(format, size, level))
+	{
+		LogE("data size {0} does not match mip level {1}", dataSize, level);
+		return;
+	}
+	
+	Bind(0);
+	
+	GL4TextureFormat nativeFormat = GetTextureFormat(format);
+	glm::uvec2 levelSize = GetTextureLevelDimensions(size, level);
+	
+	if (IsCompressedTextureFormat(format))
+	{
+		gl.glCompressedTexSubImage2D(
+			GL_TEXTURE_2D, GLint(level),
+			0, 0,
+			levelSize.x, levelSize.y,
+			nativeFormat.internalFormat,
+			GLsizei(dataSize),
+			data);
+	}
+	else
+	{
+		gl.glTexSubImage2D(
+			GL_TEXTURE_2D, GLint(level),
+			0, 0,
+			levelSize.x, levelSize.y,
+			nativeFormat.format, nativeFormat.dataType,
+			data);
+	}
+	
+	Unbind();
+}
+
 void Smorgasbord::GL4Texture::Verify(Smorgasbord::Image &image)
 {
+	if (IsCompressedTextureFormat(format))
+	{
+		LogE("cannot verify compressed textures");
+		return;
+	}
+	
 	Bind(0);
 	
 	std::vector<unsigned char> returnedImage;
@@ -551,6 +689,12 @@ void Smorgasbord::GL4Texture::Verify(Smorgasbord::Image &image)
 
 std::shared_ptr<Smorgasbord::Image> Smorgasbord::GL4Texture::Download()
 {
+	if (IsCompressedTextureFormat(format))
+	{
+		LogE("cannot download compressed textures");
+		return nullptr;
+	}
+	
 	Bind(0);
 	
 	std::shared_ptr<Image> image = std::make_shared<Image>(size, 4);
@@ -1105,6 +1249,31 @@ void GL4RasterizationShader::Set(
 	}
 }
 
+uint64_t Smorgasbord::GetGL4LayoutHash(const GeometryLayout &geometryLayout)
+{
+	/// FNV-1a over the fields, 64 bits make collisions between the few
+	/// layouts of a buffer practically impossible
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto add = [&](uint64_t value)
+	{
+		hash = (hash ^ value) * 0x100000001B3ull;
+	};
+	
+	add(geometryLayout.attributes.size());
+	for (const Attribute &attribute : geometryLayout.attributes)
+	{
+		add(attribute.location);
+		add(uint64_t(attribute.dataType));
+		add(attribute.numComponents);
+		add(uint64_t(attribute.accessType));
+		add(attribute.normalize ? 1 : 0);
+		add(attribute.stride);
+		add(attribute.offset);
+	}
+	
+	return hash;
+}
+
 GL4CommandBuffer::GL4CommandBuffer(GL4Device& _device)
 	: device(_device)
 	, gl(_device.GetLoader())
@@ -1207,6 +1376,7 @@ void GL4CommandBuffer::SetPipeline(
 	/// Store if for later. The index buffer is part of VAO state,
 	/// so we can't create the VAO yet
 	geometryLayout = _geometryLayout;
+	geometryLayoutHash = GetGL4LayoutHash(geometryLayout);
 	
 	// Set pipeline state
 	
@@ -1270,7 +1440,8 @@ void GL4CommandBuffer::Draw(
 	
 	GL4VAOKey key = {
 		vertexBuffer != nullptr ? vertexBuffer->GetID() : 0,
-		indexBuffer.IsValid() ? indexBuffer.buffer->GetID() : 0 };
+		indexBuffer.IsValid() ? indexBuffer.buffer->GetID() : 0,
+		geometryLayoutHash };
 	auto vaoResult = vaos.find(key);
 	if (vaoResult != vaos.end())
 	{
@@ -1620,7 +1791,9 @@ std::shared_ptr<Buffer> GL4Device::CreateBuffer(
 
 std::shared_ptr<Texture> GL4Device::CreateTexture(
 	glm::uvec2 imageSize,
-	TextureFormat textureFormat)
+	TextureFormat textureFormat,
+	uint32_t numLevels)
 {
-	return std::make_shared<GL4Texture>(*this, imageSize, textureFormat);
+	return std::make_shared<GL4Texture>(
+		*this, imageSize, textureFormat, numLevels);
 }
@@ -6,8 +6,6 @@
 #include <unordered_map>
 #include <set>
 
-/// TODO: GL4CommandBuffer::Draw() to support different GeometryLayouts over
-///			the same vertex buffer. Need to expand GL4VAOKey
 /// TODO: stencil buffer handling/clearing
 /// TODO: set some debug name to GraphicsShader::name if possible
 
@@ -83,7 +81,10 @@ private:
 	
 public:
 	GL4Texture(
-		GL4Device& device, glm::uvec2 imageSize, TextureFormat textureFormat);
+		GL4Device& device,
+		glm::uvec2 imageSize,
+		TextureFormat textureFormat,
+		uint32_t numLevels = 1);
 	~GL4Texture();
 	
 	void Bind(int slot);
@@ -98,6 +99,8 @@ public:
 	
 	// Texture interface
 	virtual void Upload(Image &image) override;
+	virtual void UploadLevel(
+		uint32_t level, const uint8_t *data, size_t size) override;
 	virtual void Verify(Image &image) override;
 	virtual std::shared_ptr<Image> Download() override;
 	
@@ -168,22 +171,29 @@ public:
 	}
 };
 
+/// The attribute pointers are VAO state, so the same buffers drawn with
+/// different GeometryLayouts, e.g. the primitives of a glTF file sharing
+/// one vertex buffer, need VAOs of their own
 struct GL4VAOKey
 {
 	GLuint vertexBufferID = 0;
 	GLuint indexBufferID = 0;
+	uint64_t layoutHash = 0; // see GetGL4LayoutHash()
 	
 	GL4VAOKey()
 	{ }
 	
-	GL4VAOKey(GLuint _vertexBufferID, GLuint _indexBufferID)
-		: vertexBufferID(_vertexBufferID), indexBufferID(_indexBufferID)
+	GL4VAOKey(GLuint _vertexBufferID, GLuint _indexBufferID, uint64_t _layoutHash)
+		: vertexBufferID(_vertexBufferID),
+		indexBufferID(_indexBufferID),
+		layoutHash(_layoutHash)
 	{ }
 	
 	bool operator==(const GL4VAOKey &b) const
 	{
 		return vertexBufferID == b.vertexBufferID
-			&& indexBufferID == b.indexBufferID;
+			&& indexBufferID == b.indexBufferID
+			&& layoutHash == b.layoutHash;
 	}
 };
 
@@ -191,10 +201,17 @@ struct GL4VAOKeyHash
 {
 	size_t operator()(const GL4VAOKey &key) const
 	{
-		return key.indexBufferID ^ (key.vertexBufferID << 10);
+		return size_t(key.layoutHash
+			^ (uint64_t(key.indexBufferID) * 0x9E3779B97F4A7C15ull)
+			^ (uint64_t(key.vertexBufferID) << 32));
 	}
 };
 
+/// Hash of what glVertexAttribPointer() takes from each attribute:
+/// location, data type, components, access type, normalization, stride
+/// and offset. Names don't matter to the VAO
+uint64_t GetGL4LayoutHash(const GeometryLayout &geometryLayout);
+
 class IGL4FrameBuffer : public FrameBuffer
 {
 public:
@@ -214,6 +231,7 @@ private:
 	const Pass *passAddress = nullptr;
 	std::shared_ptr<GL4RasterizationShader> shader;
 	GeometryLayout geometryLayout;
+	uint64_t geometryLayoutHash = 0;
 	RasterizationPipelineState pipelineState;
 	
 public:
@@ -329,7 +347,8 @@ public:
 		uint32_t size) override;
 	virtual std::shared_ptr<Texture> CreateTexture(
 		glm::uvec2 imageSize,
-		TextureFormat textureFormat) override;
+		TextureFormat textureFormat,
+		uint32_t numLevels = 1) override;
 };
 
 class GL4Backend : public Backend
@@ -15,6 +15,8 @@ SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCHECKFRAMEBUFFERSTATUSPROC, glCheckFramebuffe
 SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCLEARBUFFERFIPROC, glClearBufferfi)
 SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCLEARBUFFERFVPROC, glClearBufferfv)
 SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCOMPILESHADERPROC, glCompileShader)
+SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCOMPRESSEDTEXIMAGE2DPROC, glCompressedTexImage2D)
+SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC, glCompressedTexSubImage2D)
 SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCREATEPROGRAMPROC, glCreateProgram)
 SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLCREATESHADERPROC, glCreateShader)
 SMORGASBORD_GL_LOAD_PROCEDURE(PFNGLDELETEFRAMEBUFFERSPROC, glDeleteFramebuffers)
@@ -1,5 +1,6 @@
 #include "gpuapi.hpp"
 
+#include <smorgasbord/image/blockcompress.hpp>
 #include <smorgasbord/image/image.hpp>
 #include <smorgasbord/util/log.hpp>
 
@@ -132,11 +133,11 @@ void TextureSampler::ParseFilter(const std::string &text)
 	if (parameterStartPos != std::string::npos)
 	{
 		argumentStartPos = text.find_first_of(
-			"nlcrm", parameterStartPos + filterParameterNameLength);
+			"nlpqbtcrm", parameterStartPos + filterParameterNameLength);
 		if (argumentStartPos != std::string::npos)
 		{
 			argumentEndPos = text.find_first_not_of(
-				"nlcrm", argumentStartPos);
+				"nlpqbtcrm", argumentStartPos);
 			std::string filterString = text.substr(
 				argumentStartPos,
 				argumentEndPos == std::string::npos
@@ -160,6 +161,27 @@ void TextureSampler::ParseFilter(const std::string &text)
 	}
 }
 
+void Smorgasbord::Texture::UploadLevels(
+	const std::vector<std::shared_ptr<Image>> &levels)
+{
+	uint32_t count = std::min(numLevels, uint32_t(levels.size()));
+	for (uint32_t level = 0; level < count; level++)
+	{
+		if (IsCompressedTextureFormat(format))
+		{
+			std::vector<uint8_t> blocks;
+			if (CompressImage(*levels[level], format, blocks))
+			{
+				UploadLevel(level, blocks.data(), blocks.size());
+			}
+			
+			continue;
+		}
+		
+		UploadLevel(level, levels[level]->data.data(), levels[level]->data.size());
+	}
+}
+
 Smorgasbord::Buffer::Buffer(
 	BufferType _bufferType, 
 	BufferUsageType _accessType, 
@@ -171,8 +193,9 @@ Smorgasbord::Buffer::Buffer(
 	, size(_size)
 { }
 
-Smorgasbord::Texture::Texture(glm::uvec2 _imageSize, TextureFormat _textureFormat)
-	: size(_imageSize), format(_textureFormat)
+Smorgasbord::Texture::Texture(
+	glm::uvec2 _imageSize, TextureFormat _textureFormat, uint32_t _numLevels)
+	: size(_imageSize), format(_textureFormat), numLevels(_numLevels)
 { }
 
 const std::map<std::string, VariableType> &RasterizationShader::GetVariableTypes()
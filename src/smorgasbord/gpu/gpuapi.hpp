@@ -217,11 +217,16 @@ enum class AttributeDataType
 	Int32,
 	UInt8,
 	UInt16,
-	UInt32
+	UInt32,
+	Half,
+	
+	// Packed types, numComponents must be 4 for 2_10_10_10 and 3 for
+	// 10_11_11. Components are stored from the least significant bits
+	Int_2_10_10_10_Rev,
+	UInt_2_10_10_10_Rev,
+	UFloat_10_11_11_Rev
 	
-	// TODO?:
-	// GL_HALF_FLOAT, GL_FIXED, GL_INT_2_10_10_10_REV,
-	// GL_UNSIGNED_INT_2_10_10_10_REV and GL_UNSIGNED_INT_10F_11F_11F_REV
+	// TODO?: GL_FIXED
 };
 
 enum class AttributeAccessType
@@ -332,12 +337,23 @@ enum class StoreOp
 ///		UNorm: the stored uint value of [0,2^bits-1] is remapped to
 ///			a [0,1] float value
 ///		sRGB: UNorm were A is in linear space, RGB are in gamma space
+/// Block compressed formats are BC<n>_<channels>_<access_type>, they store
+/// 4x4 pixel blocks of GetTextureFormatBlockSize() bytes, see
+/// CompressImage()
 enum class TextureFormat
 {
 	RGBA_8_8_8_8_UNorm = 0,
 	R_16_UNorm,
 	Depth_24_UNorm,
 	Depth_32_UNorm,
+	BC1_RGBA_UNorm,
+	BC1_RGBA_sRGB,
+	BC3_RGBA_UNorm,
+	BC3_RGBA_sRGB,
+	BC4_R_UNorm,
+	BC5_RG_UNorm,
+	BC7_RGBA_UNorm,
+	BC7_RGBA_sRGB,
 	// TODO: more values
 };
 
@@ -351,10 +367,18 @@ enum class SetOp
 	Constants
 };
 
+/// The Mipmap filters also sample between mip levels when minifying:
+/// NearestMipmapNearest takes the nearest texel of the nearest level,
+/// LinearMipmapLinear (trilinear) blends bilinear samples of the two
+/// nearest levels. When magnifying they act as Nearest or Linear
 enum class SamplerFilter
 {
 	Nearest = 0,
-	Linear
+	Linear,
+	NearestMipmapNearest,
+	NearestMipmapLinear,
+	LinearMipmapNearest,
+	LinearMipmapLinear
 };
 
 enum class SamplerWrap
@@ -395,6 +419,85 @@ struct VariableType
 	{ }
 };
 
+inline uint32_t GetTextureFormatPixelSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::RGBA_8_8_8_8_UNorm:
+		return 4;
+	case TextureFormat::R_16_UNorm:
+		return 2;
+	case TextureFormat::Depth_24_UNorm:
+	case TextureFormat::Depth_32_UNorm:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/// Bytes of a 4x4 block of a block compressed format, 0 for the others
+inline uint32_t GetTextureFormatBlockSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1_RGBA_UNorm:
+	case TextureFormat::BC1_RGBA_sRGB:
+	case TextureFormat::BC4_R_UNorm:
+		return 8;
+	case TextureFormat::BC3_RGBA_UNorm:
+	case TextureFormat::BC3_RGBA_sRGB:
+	case TextureFormat::BC5_RG_UNorm:
+	case TextureFormat::BC7_RGBA_UNorm:
+	case TextureFormat::BC7_RGBA_sRGB:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+inline bool IsCompressedTextureFormat(TextureFormat format)
+{
+	return GetTextureFormatBlockSize(format) != 0;
+}
+
+inline bool IsValidTextureFormat(uint32_t format)
+{
+	return format <= uint32_t(TextureFormat::BC7_RGBA_sRGB);
+}
+
+/// Each mip level is half the size of the one before, at least 1
+inline glm::uvec2 GetTextureLevelDimensions(glm::uvec2 size, uint32_t level)
+{
+	return glm::max(glm::uvec2(size.x >> level, size.y >> level), glm::uvec2(1));
+}
+
+/// Levels down to 1x1
+inline uint32_t GetMaxTextureLevels(glm::uvec2 size)
+{
+	uint32_t numLevels = 1;
+	for (uint32_t s = std::max(size.x, size.y); s > 1; s >>= 1)
+	{
+		numLevels++;
+	}
+	
+	return numLevels;
+}
+
+/// Bytes of a tightly packed mip level. Compressed levels are rounded up
+/// to whole blocks
+inline size_t GetTextureLevelSize(
+	TextureFormat format, glm::uvec2 size, uint32_t level)
+{
+	glm::uvec2 dimensions = GetTextureLevelDimensions(size, level);
+	if (IsCompressedTextureFormat(format))
+	{
+		return size_t((dimensions.x + 3) / 4) * ((dimensions.y + 3) / 4)
+			* GetTextureFormatBlockSize(format);
+	}
+	
+	return size_t(dimensions.x) * dimensions.y * GetTextureFormatPixelSize(format);
+}
+
 inline uint32_t GetIndexDataTypeSize(IndexDataType type)
 {
 	switch (type)
@@ -410,6 +513,41 @@ inline uint32_t GetIndexDataTypeSize(IndexDataType type)
 	return 0;
 }
 
+/// Size of one component, or of the whole attribute for packed types
+inline uint32_t GetAttributeDataTypeSize(AttributeDataType type)
+{
+	switch (type)
+	{
+	case AttributeDataType::Int8:
+	case AttributeDataType::UInt8:
+		return 1;
+	case AttributeDataType::Int16:
+	case AttributeDataType::UInt16:
+	case AttributeDataType::Half:
+		return 2;
+	case AttributeDataType::Float:
+	case AttributeDataType::Int32:
+	case AttributeDataType::UInt32:
+	case AttributeDataType::Int_2_10_10_10_Rev:
+	case AttributeDataType::UInt_2_10_10_10_Rev:
+	case AttributeDataType::UFloat_10_11_11_Rev:
+		return 4;
+	case AttributeDataType::Double:
+		return 8;
+	}
+	
+	return 0;
+}
+
+inline bool IsPackedAttributeDataType(AttributeDataType type)
+{
+	return type == AttributeDataType::Int_2_10_10_10_Rev
+		|| type == AttributeDataType::UInt_2_10_10_10_Rev
+		|| type == AttributeDataType::UFloat_10_11_11_Rev;
+}
+
+/// Sampler modifier "filter: <minify><magnify><wrap s><wrap t><wrap r>",
+/// e.g. "filter: tlrrr" for trilinear filtering and repeat
 inline SamplerFilter ParseSamplerFilter(char c)
 {
 	switch (c)
@@ -418,6 +556,14 @@ inline SamplerFilter ParseSamplerFilter(char c)
 		return SamplerFilter::Nearest;
 	case 'l':
 		return SamplerFilter::Linear;
+	case 'p':
+		return SamplerFilter::NearestMipmapNearest;
+	case 'q':
+		return SamplerFilter::NearestMipmapLinear;
+	case 'b':
+		return SamplerFilter::LinearMipmapNearest;
+	case 't':
+		return SamplerFilter::LinearMipmapLinear;
 	
 	default:
 		return SamplerFilter::Nearest;
@@ -676,12 +822,23 @@ class Texture
 protected:
 	glm::uvec2 size = glm::vec2(0, 0);
 	TextureFormat format = TextureFormat::RGBA_8_8_8_8_UNorm;
+	uint32_t numLevels = 1;
 	
 public:
-	Texture(glm::uvec2 imageSize, TextureFormat textureFormat);
+	Texture(
+		glm::uvec2 imageSize,
+		TextureFormat textureFormat,
+		uint32_t numLevels = 1);
 	virtual ~Texture() { }
 	
 	virtual void Upload(Image &image) = 0;
+	/// Uploads one mip level as is, e.g. straight from a mapped file. size
+	/// has to be GetTextureLevelSize() of the level
+	virtual void UploadLevel(
+		uint32_t level, const uint8_t *data, size_t size) = 0;
+	/// Uploads a mip chain, e.g. from GenerateMipChain(), as many levels as
+	/// both have. Compressed textures compress the images first
+	void UploadLevels(const std::vector<std::shared_ptr<Image>> &levels);
 	virtual void Verify(Image &image) = 0;
 	virtual std::shared_ptr<Image> Download() = 0;
 	
@@ -694,6 +851,11 @@ public:
 	{
 		return format;
 	}
+	
+	uint32_t GetNumLevels()
+	{
+		return numLevels;
+	}
 };
 
 class TextureSampler
@@ -1279,9 +1441,11 @@ public:
 		BufferUsageType accessType, 
 		BufferUsageFrequency accessFrequency, 
 		uint32_t size) = 0;
+	/// numLevels mip levels, see GetMaxTextureLevels()
 	virtual std::shared_ptr<Texture> CreateTexture(
 		glm::uvec2 imageSize,
-		TextureFormat textureFormat) = 0;
+		TextureFormat textureFormat,
+		uint32_t numLevels = 1) = 0;
 	virtual std::vector<std::shared_ptr<CommandBuffer>> CreateCommandBuffers(
 		uint32_t num);
 };
@@ -0,0 +1,1691 @@
+#include "blockcompress.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+/// Least squares passes after the principal axis fit
+const uint32_t bcRefineIterations = 2;
+
+/// BC7 interpolation weights of 3 and 4 bit indices, out of 64
+const uint32_t bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+const uint32_t bc7Weights4[16] =
+	{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/// The 64 BC7 partitions into 2 subsets, bit i set if pixel i is in
+/// subset 1, and the pixel whose index is stored with one bit less in
+/// subset 1. Pixel 0 is the anchor of subset 0
+const uint16_t bc7Partitions2[64] =
+{
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+const uint8_t bc7Anchors2[64] =
+{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+/// Opaque blocks whose mode 6 error per pixel and channel is above this
+/// try the best partitions with mode 1
+const float bc7PartitionThreshold = 2.0f;
+const uint32_t bc7PartitionCandidates = 4;
+
+/// Linear palette position to BC1 index, 4 and 3 color mode
+const uint32_t bc1Indices4[4] = { 0, 2, 3, 1 };
+const uint32_t bc1Indices3[3] = { 0, 2, 1 };
+
+/// 16 pixels of a block, one array per channel, as floats in [0, 255]
+struct alignas(16) BCBlock
+{
+	float channels[4][16];
+};
+
+/// Blocks of a format: byte size and which encoder/decoder handles them
+enum class BCType
+{
+	None = 0,
+	BC1,
+	BC3,
+	BC4,
+	BC5,
+	BC7
+};
+
+static BCType GetBCType(Smorgasbord::TextureFormat format)
+{
+	using Smorgasbord::TextureFormat;
+	
+	switch (format)
+	{
+	case TextureFormat::BC1_RGBA_UNorm:
+	case TextureFormat::BC1_RGBA_sRGB:
+		return BCType::BC1;
+	case TextureFormat::BC3_RGBA_UNorm:
+	case TextureFormat::BC3_RGBA_sRGB:
+		return BCType::BC3;
+	case TextureFormat::BC4_R_UNorm:
+		return BCType::BC4;
+	case TextureFormat::BC5_RG_UNorm:
+		return BCType::BC5;
+	case TextureFormat::BC7_RGBA_UNorm:
+	case TextureFormat::BC7_RGBA_sRGB:
+		return BCType::BC7;
+	default:
+		return BCType::None;
+	}
+}
+
+/// Edge pixels are repeated into blocks which reach past the image
+static void LoadBCBlock(
+	const Smorgasbord::Image &image, uint32_t x0, uint32_t y0, BCBlock &block)
+{
+	const uint32_t width = image.imageSize.x;
+	const uint32_t height = image.imageSize.y;
+
+#ifdef SMORGASBORD_SSE2
+	if (x0 + 4 <= width && y0 + 4 <= height)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			__m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+				&image.data[(size_t(y0 + y) * width + x0) * 4]));
+			__m128i lo = _mm_unpacklo_epi8(row, zero);
+			__m128i hi = _mm_unpackhi_epi8(row, zero);
+			__m128 p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+			__m128 p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+			__m128 p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+			__m128 p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+			
+			/// Pixels to channels
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			_mm_store_ps(&block.channels[0][y * 4], p0);
+			_mm_store_ps(&block.channels[1][y * 4], p1);
+			_mm_store_ps(&block.channels[2][y * 4], p2);
+			_mm_store_ps(&block.channels[3][y * 4], p3);
+		}
+		
+		return;
+	}
+#endif
+	
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		uint32_t sy = std::min(y0 + y, height - 1);
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			uint32_t sx = std::min(x0 + x, width - 1);
+			const uint8_t *pixel = &image.data[(size_t(sy) * width + sx) * 4];
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				block.channels[c][y * 4 + x] = float(pixel[c]);
+			}
+		}
+	}
+}
+
+#ifdef SMORGASBORD_SSE2
+inline float SumBCLanes(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+/// All bits set in the lanes of pixels g * 4 .. g * 4 + 3 which are in mask
+inline __m128 GetBCPixelMask(uint32_t mask, uint32_t g)
+{
+	const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+	__m128i selected = _mm_and_si128(_mm_set1_epi32(int(mask >> (g * 4))), bits);
+	return _mm_castsi128_ps(_mm_cmpeq_epi32(selected, bits));
+}
+#endif
+
+/// Mean and normalized principal axis of the first numChannels channels
+/// over the pixels in pixelMask. The axis is zero for flat blocks
+static void GetBCPrincipalAxis(
+	const BCBlock &block,
+	uint32_t numChannels,
+	uint32_t pixelMask,
+	float mean[4],
+	float axis[4])
+{
+	float covariance[4][4] = { };
+	
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		count += (pixelMask >> i) & 1;
+	}
+	
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		float sum = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			if ((pixelMask >> i) & 1)
+			{
+				sum += block.channels[c][i];
+			}
+		}
+		
+		mean[c] = c < numChannels && count > 0 ? sum / count : 0;
+		axis[c] = 0;
+	}
+
+#ifdef SMORGASBORD_SSE2
+	__m128 centered[4][4];
+	for (uint32_t c = 0; c < numChannels; c++)
+	{
+		__m128 m = _mm_set1_ps(mean[c]);
+		for (uint32_t g = 0; g < 4; g++)
+		{
+			centered[c][g] = _mm_and_ps(
+				_mm_sub_ps(_mm_load_ps(&block.channels[c][g * 4]), m),
+				GetBCPixelMask(pixelMask, g));
+		}
+	}
+	
+	for (uint32_t i = 0; i < numChannels; i++)
+	{
+		for (uint32_t j = i; j < numChannels; j++)
+		{
+			__m128 sum = _mm_mul_ps(centered[i][0], centered[j][0]);
+			for (uint32_t g = 1; g < 4; g++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(centered[i][g], centered[j][g]));
+			}
+			
+			covariance[i][j] = covariance[j][i] = SumBCLanes(sum);
+		}
+	}
+#else
+	for (uint32_t i = 0; i < numChannels; i++)
+	{
+		for (uint32_t j = i; j < numChannels; j++)
+		{
+			float sum = 0;
+			for (uint32_t p = 0; p < 16; p++)
+			{
+				if ((pixelMask >> p) & 1)
+				{
+					sum += (block.channels[i][p] - mean[i]) * (block.channels[j][p] - mean[j]);
+				}
+			}
+			
+			covariance[i][j] = covariance[j][i] = sum;
+		}
+	}
+#endif
+	
+	/// Power iteration from the column of the largest variance
+	uint32_t start = 0;
+	for (uint32_t c = 1; c < numChannels; c++)
+	{
+		if (covariance[c][c] > covariance[start][start])
+		{
+			start = c;
+		}
+	}
+	
+	if (covariance[start][start] < 1e-3f)
+	{
+		return;
+	}
+	
+	float v[4] = { };
+	for (uint32_t c = 0; c < numChannels; c++)
+	{
+		v[c] = covariance[c][start];
+	}
+	
+	for (uint32_t iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { };
+		float maxComponent = 0;
+		for (uint32_t i = 0; i < numChannels; i++)
+		{
+			for (uint32_t j = 0; j < numChannels; j++)
+			{
+				next[i] += covariance[i][j] * v[j];
+			}
+			
+			maxComponent = std::max(maxComponent, std::abs(next[i]));
+		}
+		
+		if (maxComponent == 0)
+		{
+			return;
+		}
+		
+		for (uint32_t c = 0; c < numChannels; c++)
+		{
+			v[c] = next[c] / maxComponent;
+		}
+	}
+	
+	float length = 0;
+	for (uint32_t c = 0; c < numChannels; c++)
+	{
+		length += v[c] * v[c];
+	}
+	
+	length = std::sqrt(length);
+	for (uint32_t c = 0; c < numChannels; c++)
+	{
+		axis[c] = v[c] / length;
+	}
+}
+
+/// dot(pixel - origin, direction) of every pixel
+static void ProjectBCBlock(
+	const BCBlock &block,
+	const float origin[4],
+	const float direction[4],
+	float projections[16])
+{
+#ifdef SMORGASBORD_SSE2
+	for (uint32_t g = 0; g < 4; g++)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			__m128 d = _mm_sub_ps(
+				_mm_load_ps(&block.channels[c][g * 4]), _mm_set1_ps(origin[c]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(d, _mm_set1_ps(direction[c])));
+		}
+		
+		_mm_storeu_ps(&projections[g * 4], sum);
+	}
+#else
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float sum = 0;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			sum += (block.channels[c][i] - origin[c]) * direction[c];
+		}
+		
+		projections[i] = sum;
+	}
+#endif
+}
+
+/// Index of the nearest of numLevels evenly spaced points from a to b,
+/// for every pixel
+static void GetBCIndices(
+	const BCBlock &block,
+	const float a[4],
+	const float b[4],
+	uint32_t numLevels,
+	uint32_t indices[16])
+{
+	float direction[4];
+	float lengthSquared = 0;
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		direction[c] = b[c] - a[c];
+		lengthSquared += direction[c] * direction[c];
+	}
+	
+	if (lengthSquared < 1e-6f)
+	{
+		std::fill(indices, indices + 16, 0u);
+		return;
+	}
+	
+	float projections[16];
+	ProjectBCBlock(block, a, direction, projections);
+	
+	const float scale = (numLevels - 1) / lengthSquared;
+#ifdef SMORGASBORD_SSE2
+	const __m128 maxIndex = _mm_set1_ps(float(numLevels - 1));
+	for (uint32_t g = 0; g < 4; g++)
+	{
+		__m128 t = _mm_mul_ps(_mm_loadu_ps(&projections[g * 4]), _mm_set1_ps(scale));
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), maxIndex);
+		_mm_storeu_si128(
+			reinterpret_cast<__m128i*>(&indices[g * 4]), _mm_cvtps_epi32(t));
+	}
+#else
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float t = std::min(std::max(projections[i] * scale, 0.0f), float(numLevels - 1));
+		indices[i] = uint32_t(std::nearbyint(t));
+	}
+#endif
+}
+
+/// Squared error of decoded against block over the channels and pixels
+/// with a bit set in the masks
+static float GetBCBlockError(
+	const BCBlock &block,
+	const BCBlock &decoded,
+	uint32_t channelMask,
+	uint32_t pixelMask = 0xFFFF)
+{
+#ifdef SMORGASBORD_SSE2
+	__m128 sum = _mm_setzero_ps();
+	for (uint32_t g = 0; g < 4; g++)
+	{
+		__m128 keep = GetBCPixelMask(pixelMask, g);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if ((channelMask >> c) & 1)
+			{
+				__m128 d = _mm_sub_ps(
+					_mm_load_ps(&block.channels[c][g * 4]),
+					_mm_load_ps(&decoded.channels[c][g * 4]));
+				sum = _mm_add_ps(sum, _mm_and_ps(_mm_mul_ps(d, d), keep));
+			}
+		}
+	}
+	
+	return SumBCLanes(sum);
+#else
+	float sum = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		if ((pixelMask >> i) & 1)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				if ((channelMask >> c) & 1)
+				{
+					float d = block.channels[c][i] - decoded.channels[c][i];
+					sum += d * d;
+				}
+			}
+		}
+	}
+	
+	return sum;
+#endif
+}
+
+/// Endpoints a, b minimizing the squared error of (1 - w) * a + w * b over
+/// the masked pixels, only the masked channels are written. Returns false
+/// if the weights don't determine them
+static bool RefineBCEndpoints(
+	const BCBlock &block,
+	const float weights[16],
+	uint32_t channelMask,
+	uint32_t pixelMask,
+	float a[4],
+	float b[4])
+{
+	float alpha2 = 0;
+	float beta2 = 0;
+	float alphaBeta = 0;
+	float alphaX[4] = { };
+	float betaX[4] = { };
+
+#ifdef SMORGASBORD_SSE2
+	const __m128 one = _mm_set1_ps(1);
+	__m128 alpha2Sum = _mm_setzero_ps();
+	__m128 beta2Sum = _mm_setzero_ps();
+	__m128 alphaBetaSum = _mm_setzero_ps();
+	__m128 alphaXSum[4];
+	__m128 betaXSum[4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		alphaXSum[c] = betaXSum[c] = _mm_setzero_ps();
+	}
+	
+	for (uint32_t g = 0; g < 4; g++)
+	{
+		__m128 keep = GetBCPixelMask(pixelMask, g);
+		__m128 beta = _mm_loadu_ps(&weights[g * 4]);
+		__m128 alpha = _mm_and_ps(_mm_sub_ps(one, beta), keep);
+		beta = _mm_and_ps(beta, keep);
+		alpha2Sum = _mm_add_ps(alpha2Sum, _mm_mul_ps(alpha, alpha));
+		beta2Sum = _mm_add_ps(beta2Sum, _mm_mul_ps(beta, beta));
+		alphaBetaSum = _mm_add_ps(alphaBetaSum, _mm_mul_ps(alpha, beta));
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if ((channelMask >> c) & 1)
+			{
+				__m128 x = _mm_load_ps(&block.channels[c][g * 4]);
+				alphaXSum[c] = _mm_add_ps(alphaXSum[c], _mm_mul_ps(alpha, x));
+				betaXSum[c] = _mm_add_ps(betaXSum[c], _mm_mul_ps(beta, x));
+			}
+		}
+	}
+	
+	alpha2 = SumBCLanes(alpha2Sum);
+	beta2 = SumBCLanes(beta2Sum);
+	alphaBeta = SumBCLanes(alphaBetaSum);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		alphaX[c] = SumBCLanes(alphaXSum[c]);
+		betaX[c] = SumBCLanes(betaXSum[c]);
+	}
+#else
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		if (((pixelMask >> i) & 1) == 0)
+		{
+			continue;
+		}
+		
+		float beta = weights[i];
+		float alpha = 1 - beta;
+		alpha2 += alpha * alpha;
+		beta2 += beta * beta;
+		alphaBeta += alpha * beta;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			alphaX[c] += alpha * block.channels[c][i];
+			betaX[c] += beta * block.channels[c][i];
+		}
+	}
+#endif
+	
+	float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+	if (std::abs(determinant) < 1e-4f)
+	{
+		return false;
+	}
+	
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		if ((channelMask >> c) & 1)
+		{
+			a[c] = std::min(std::max(
+				(alphaX[c] * beta2 - betaX[c] * alphaBeta) / determinant, 0.0f), 255.0f);
+			b[c] = std::min(std::max(
+				(betaX[c] * alpha2 - alphaX[c] * alphaBeta) / determinant, 0.0f), 255.0f);
+		}
+	}
+	
+	return true;
+}
+
+/// Extremes of the block along its principal axis, clamped to [0, 255]
+static void GetBCAxisEndpoints(
+	const BCBlock &block,
+	uint32_t numChannels,
+	uint32_t mask,
+	float a[4],
+	float b[4])
+{
+	float mean[4];
+	float axis[4];
+	GetBCPrincipalAxis(block, numChannels, mask, mean, axis);
+	
+	float projections[16];
+	ProjectBCBlock(block, mean, axis, projections);
+	
+	float minT = 0;
+	float maxT = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		if ((mask >> i) & 1)
+		{
+			minT = std::min(minT, projections[i]);
+			maxT = std::max(maxT, projections[i]);
+		}
+	}
+	
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		a[c] = std::min(std::max(mean[c] + minT * axis[c], 0.0f), 255.0f);
+		b[c] = std::min(std::max(mean[c] + maxT * axis[c], 0.0f), 255.0f);
+	}
+}
+
+/// Rounds non-negative values, std::nearbyint is a library call
+inline uint32_t RoundBC(float value)
+{
+	return uint32_t(value + 0.5f);
+}
+
+inline void WriteBCUInt16(uint8_t *out, uint32_t value)
+{
+	out[0] = uint8_t(value);
+	out[1] = uint8_t(value >> 8);
+}
+
+inline uint32_t ReadBCUInt16(const uint8_t *in)
+{
+	return in[0] | (uint32_t(in[1]) << 8);
+}
+
+inline uint32_t QuantizeBC565(const float color[4])
+{
+	uint32_t r = RoundBC(color[0] * (31 / 255.0f));
+	uint32_t g = RoundBC(color[1] * (63 / 255.0f));
+	uint32_t b = RoundBC(color[2] * (31 / 255.0f));
+	return (r << 11) | (g << 5) | b;
+}
+
+inline void ExpandBC565(uint32_t color, uint32_t rgb[3])
+{
+	uint32_t r = (color >> 11) & 31;
+	uint32_t g = (color >> 5) & 63;
+	uint32_t b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+/// The 4 colors of a BC1 block, alpha 0 only for the transparent one
+static void GetBC1Palette(
+	uint32_t color0, uint32_t color1, bool fourColors, uint8_t palette[4][4])
+{
+	uint32_t c0[3];
+	uint32_t c1[3];
+	ExpandBC565(color0, c0);
+	ExpandBC565(color1, c1);
+	
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		palette[0][c] = uint8_t(c0[c]);
+		palette[1][c] = uint8_t(c1[c]);
+		if (fourColors)
+		{
+			palette[2][c] = uint8_t((2 * c0[c] + c1[c]) / 3);
+			palette[3][c] = uint8_t((c0[c] + 2 * c1[c]) / 3);
+		}
+		else
+		{
+			palette[2][c] = uint8_t((c0[c] + c1[c]) / 2);
+			palette[3][c] = 0;
+		}
+	}
+	
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	palette[3][3] = fourColors ? 255 : 0;
+}
+
+/// Endpoint pairs of 5 and 6 bits whose 1/3 point comes closest to each
+/// 8 bit value, for blocks of a single color. Among equally close pairs
+/// the one with the closer endpoints wins, it depends least on how a
+/// decoder rounds
+struct BC1SingleColorTables
+{
+	uint8_t match5[256][2];
+	uint8_t match6[256][2];
+	
+	BC1SingleColorTables()
+	{
+		Build(match5, 5);
+		Build(match6, 6);
+	}
+	
+	static void Build(uint8_t match[256][2], uint32_t bits)
+	{
+		const uint32_t count = 1u << bits;
+		for (uint32_t value = 0; value < 256; value++)
+		{
+			uint32_t bestError = ~0u;
+			for (uint32_t e0 = 0; e0 < count; e0++)
+			{
+				for (uint32_t e1 = 0; e1 < count; e1++)
+				{
+					uint32_t x0 = (e0 << (8 - bits)) | (e0 >> (2 * bits - 8));
+					uint32_t x1 = (e1 << (8 - bits)) | (e1 >> (2 * bits - 8));
+					int32_t third = int32_t((2 * x0 + x1) / 3);
+					uint32_t error = uint32_t(std::abs(third - int32_t(value))) * 1024
+						+ uint32_t(std::abs(int32_t(x0) - int32_t(x1)));
+					if (error < bestError)
+					{
+						bestError = error;
+						match[value][0] = uint8_t(e0);
+						match[value][1] = uint8_t(e1);
+					}
+				}
+			}
+		}
+	}
+};
+
+static const BC1SingleColorTables &GetBC1SingleColorTables()
+{
+	static const BC1SingleColorTables tables;
+	return tables;
+}
+
+/// A block of one color as the 1/3 point of the pair from the tables
+static void EncodeBC1SingleColorBlock(const BCBlock &block, uint8_t out[8])
+{
+	const BC1SingleColorTables &tables = GetBC1SingleColorTables();
+	const uint32_t r = uint32_t(block.channels[0][0]);
+	const uint32_t g = uint32_t(block.channels[1][0]);
+	const uint32_t b = uint32_t(block.channels[2][0]);
+	
+	uint32_t colors[2];
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		colors[i] = (uint32_t(tables.match5[r][i]) << 11)
+			| (uint32_t(tables.match6[g][i]) << 5) | tables.match5[b][i];
+	}
+	
+	/// Swapping turns the 1/3 point from index 2 into index 3
+	uint32_t index = 2;
+	if (colors[0] < colors[1])
+	{
+		std::swap(colors[0], colors[1]);
+		index = 3;
+	}
+	else if (colors[0] == colors[1])
+	{
+		index = 0;
+	}
+	
+	uint32_t bits = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		bits |= index << (i * 2);
+	}
+	
+	WriteBCUInt16(out, colors[0]);
+	WriteBCUInt16(out + 2, colors[1]);
+	WriteBCUInt16(out + 4, bits & 0xFFFF);
+	WriteBCUInt16(out + 6, bits >> 16);
+}
+
+/// 565 endpoints and 2 bit indices. With punchThrough, pixels with alpha
+/// below 128 take the transparent index of 3 color mode. BC3 color
+/// blocks are always decoded with 4 colors, so they never use it
+static void EncodeBC1Block(const BCBlock &block, bool punchThrough, uint8_t out[8])
+{
+	uint32_t opaque = 0xFFFF;
+	if (punchThrough)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			if (block.channels[3][i] < 128)
+			{
+				opaque &= ~(1u << i);
+			}
+		}
+	}
+	
+	if (opaque == 0)
+	{
+		WriteBCUInt16(out, 0);
+		WriteBCUInt16(out + 2, 0);
+		std::memset(out + 4, 0xFF, 4);
+		return;
+	}
+	
+	if (opaque == 0xFFFF)
+	{
+		bool singleColor = true;
+		for (uint32_t i = 1; i < 16 && singleColor; i++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				singleColor &= block.channels[c][i] == block.channels[c][0];
+			}
+		}
+		
+		if (singleColor)
+		{
+			EncodeBC1SingleColorBlock(block, out);
+			return;
+		}
+	}
+	
+	const uint32_t numLevels = opaque != 0xFFFF ? 3 : 4;
+	
+	float a[4];
+	float b[4];
+	GetBCAxisEndpoints(block, 3, opaque, a, b);
+	
+	float bestError = INFINITY;
+	uint32_t bestColors[2] = { };
+	uint32_t bestIndices[16] = { };
+	
+	for (uint32_t iteration = 0; iteration <= bcRefineIterations; iteration++)
+	{
+		uint32_t colors[2] = { QuantizeBC565(a), QuantizeBC565(b) };
+		uint32_t expanded[2][3];
+		ExpandBC565(colors[0], expanded[0]);
+		ExpandBC565(colors[1], expanded[1]);
+		
+		float qa[4] = { float(expanded[0][0]), float(expanded[0][1]), float(expanded[0][2]), 0 };
+		float qb[4] = { float(expanded[1][0]), float(expanded[1][1]), float(expanded[1][2]), 0 };
+		
+		uint32_t indices[16];
+		GetBCIndices(block, qa, qb, numLevels, indices);
+		
+		BCBlock decoded;
+		float weights[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			weights[i] = float(indices[i]) / (numLevels - 1);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				decoded.channels[c][i] = qa[c] + (qb[c] - qa[c]) * weights[i];
+			}
+			
+			decoded.channels[3][i] = 0;
+		}
+		
+		float error = GetBCBlockError(block, decoded, 0x7, opaque);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestColors[0] = colors[0];
+			bestColors[1] = colors[1];
+			std::copy(indices, indices + 16, bestIndices);
+		}
+		
+		if (error == 0 || iteration == bcRefineIterations
+			|| !RefineBCEndpoints(block, weights, 0x7, opaque, a, b))
+		{
+			break;
+		}
+	}
+	
+	/// 4 color mode needs color0 > color1, 3 color mode color0 <= color1.
+	/// Swapping the endpoints reverses the palette
+	const uint32_t maxIndex = numLevels - 1;
+	bool swap = numLevels == 4 ? bestColors[0] < bestColors[1] : bestColors[0] > bestColors[1];
+	if (swap)
+	{
+		std::swap(bestColors[0], bestColors[1]);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			bestIndices[i] = maxIndex - bestIndices[i];
+		}
+	}
+	
+	uint32_t bits = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t index;
+		if (((opaque >> i) & 1) == 0)
+		{
+			index = 3;
+		}
+		else if (bestColors[0] == bestColors[1])
+		{
+			index = 0;
+		}
+		else
+		{
+			index = numLevels == 4 ? bc1Indices4[bestIndices[i]] : bc1Indices3[bestIndices[i]];
+		}
+		
+		bits |= index << (i * 2);
+	}
+	
+	WriteBCUInt16(out, bestColors[0]);
+	WriteBCUInt16(out + 2, bestColors[1]);
+	WriteBCUInt16(out + 4, bits & 0xFFFF);
+	WriteBCUInt16(out + 6, bits >> 16);
+}
+
+/// The 8 values of a BC4 block
+static void GetBC4Palette(uint32_t value0, uint32_t value1, uint8_t palette[8])
+{
+	palette[0] = uint8_t(value0);
+	palette[1] = uint8_t(value1);
+	if (value0 > value1)
+	{
+		for (uint32_t i = 1; i < 7; i++)
+		{
+			palette[i + 1] = uint8_t(((7 - i) * value0 + i * value1 + 3) / 7);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 1; i < 5; i++)
+		{
+			palette[i + 1] = uint8_t(((5 - i) * value0 + i * value1 + 2) / 5);
+		}
+		
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+/// Endpoints and 3 bit indices of one channel, always in 8 value mode
+static void EncodeBC4Block(const BCBlock &block, uint32_t channel, uint8_t out[8])
+{
+	const float *values = block.channels[channel];
+	float minValue = values[0];
+	float maxValue = values[0];
+	for (uint32_t i = 1; i < 16; i++)
+	{
+		minValue = std::min(minValue, values[i]);
+		maxValue = std::max(maxValue, values[i]);
+	}
+	
+	uint32_t best[2] = { uint32_t(maxValue), uint32_t(minValue) };
+	uint32_t bestIndices[16] = { };
+	
+	if (best[0] != best[1])
+	{
+		/// The other channels stay 0 in both endpoints, so they don't
+		/// affect the indices
+		float a[4] = { };
+		float b[4] = { };
+		a[channel] = maxValue;
+		b[channel] = minValue;
+		
+		float bestError = INFINITY;
+		for (uint32_t iteration = 0; iteration <= bcRefineIterations; iteration++)
+		{
+			uint32_t value0 = RoundBC(a[channel]);
+			uint32_t value1 = RoundBC(b[channel]);
+			if (value0 <= value1)
+			{
+				break;
+			}
+			
+			float qa[4] = { };
+			float qb[4] = { };
+			qa[channel] = float(value0);
+			qb[channel] = float(value1);
+			
+			/// Positions 0 .. 7 from value0 to value1
+			uint32_t positions[16];
+			GetBCIndices(block, qa, qb, 8, positions);
+			
+			BCBlock decoded;
+			float weights[16];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				weights[i] = positions[i] / 7.0f;
+				decoded.channels[channel][i] = qa[channel] + (qb[channel] - qa[channel]) * weights[i];
+			}
+			
+			float error = GetBCBlockError(block, decoded, 1u << channel);
+			if (error < bestError)
+			{
+				bestError = error;
+				best[0] = value0;
+				best[1] = value1;
+				std::copy(positions, positions + 16, bestIndices);
+			}
+			
+			if (error == 0 || iteration == bcRefineIterations
+				|| !RefineBCEndpoints(block, weights, 1u << channel, 0xFFFF, a, b))
+			{
+				break;
+			}
+		}
+		
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			bestIndices[i] = bestIndices[i] == 0 ? 0
+				: bestIndices[i] == 7 ? 1 : bestIndices[i] + 1;
+		}
+	}
+	
+	out[0] = uint8_t(best[0]);
+	out[1] = uint8_t(best[1]);
+	
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		bits |= uint64_t(bestIndices[i]) << (i * 3);
+	}
+	
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		out[2 + i] = uint8_t(bits >> (i * 8));
+	}
+}
+
+/// Little endian bit stream of a 128 bit block
+struct BCBits
+{
+	uint8_t *data;
+	uint32_t position = 0;
+	
+	BCBits(uint8_t *_data)
+		: data(_data)
+	{ }
+	
+	void Write(uint32_t value, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++, position++)
+		{
+			data[position >> 3] |= uint8_t(((value >> i) & 1) << (position & 7));
+		}
+	}
+	
+	uint32_t Read(uint32_t count)
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < count; i++, position++)
+		{
+			value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+		}
+		
+		return value;
+	}
+};
+
+/// How a BC7 mode stores a subset: endpoints of endpointBits plus a
+/// p-bit, which becomes their low bit, per endpoint or shared by both
+struct BC7SubsetMode
+{
+	uint32_t channelMask;
+	uint32_t endpointBits;
+	bool sharedPBit;
+	uint32_t indexBits;
+	const uint32_t *weights;
+};
+
+/// Mode 6: RGBA, 7 bit endpoints, 4 bit indices
+const BC7SubsetMode bc7Mode6 = { 0xF, 7, false, 4, bc7Weights4 };
+/// Mode 1: 2 subsets, RGB, 6 bit endpoints, 3 bit indices
+const BC7SubsetMode bc7Mode1 = { 0x7, 6, true, 3, bc7Weights3 };
+
+struct BC7Subset
+{
+	uint32_t endpoints[2][4] = { };
+	uint32_t pBits[2] = { };
+	uint32_t indices[16] = { };
+	float error = INFINITY;
+};
+
+/// Endpoint and p-bit to the 8 bit value a decoder interpolates
+inline uint32_t ExpandBC7Endpoint(uint32_t value, uint32_t pBit, uint32_t endpointBits)
+{
+	uint32_t v = (value << 1) | pBit;
+	uint32_t bits = endpointBits + 1;
+	return bits == 8 ? v : (v << (8 - bits)) | (v >> (2 * bits - 8));
+}
+
+/// Decodes every pixel from the 8 bit endpoints a and b and the
+/// interpolation weights out of 64, the way BC7 does in integers
+static void InterpolateBC7Block(
+	const float a[4],
+	const float b[4],
+	const uint32_t weights[16],
+	uint32_t channelMask,
+	BCBlock &decoded)
+{
+#ifdef SMORGASBORD_SSE2
+	const __m128 sixtyFour = _mm_set1_ps(64);
+	const __m128 half = _mm_set1_ps(32);
+	const __m128 scale = _mm_set1_ps(1 / 64.0f);
+	for (uint32_t g = 0; g < 4; g++)
+	{
+		__m128 w = _mm_cvtepi32_ps(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(&weights[g * 4])));
+		__m128 inverse = _mm_sub_ps(sixtyFour, w);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if ((channelMask >> c) & 1)
+			{
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(inverse, _mm_set1_ps(a[c])), _mm_mul_ps(w, _mm_set1_ps(b[c]))),
+					half);
+				/// The sums are exact integers, truncating them is the shift
+				_mm_store_ps(
+					&decoded.channels[c][g * 4],
+					_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(sum, scale))));
+			}
+		}
+	}
+#else
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if ((channelMask >> c) & 1)
+			{
+				decoded.channels[c][i] = float(
+					((64 - weights[i]) * uint32_t(a[c]) + weights[i] * uint32_t(b[c]) + 32) >> 6);
+			}
+		}
+	}
+#endif
+}
+
+/// Fits the endpoints of the pixels in pixelMask, trying every p-bit
+/// combination for each endpoint pair
+static void EncodeBC7Subset(
+	const BCBlock &block,
+	uint32_t pixelMask,
+	const BC7SubsetMode &mode,
+	BC7Subset &subset)
+{
+	const uint32_t numChannels = mode.channelMask == 0xF ? 4 : 3;
+	const uint32_t numLevels = 1u << mode.indexBits;
+	const uint32_t maxEndpoint = (1u << mode.endpointBits) - 1;
+	const float endpointScale = float((1u << (mode.endpointBits + 1)) - 1) / 255;
+	
+	float a[4];
+	float b[4];
+	GetBCAxisEndpoints(block, numChannels, pixelMask, a, b);
+	
+	for (uint32_t iteration = 0; iteration <= bcRefineIterations; iteration++)
+	{
+		for (uint32_t pBits = 0; pBits < 4; pBits++)
+		{
+			const uint32_t p[2] = { pBits & 1, pBits >> 1 };
+			if (mode.sharedPBit && p[0] != p[1])
+			{
+				continue;
+			}
+			
+			uint32_t endpoints[2][4] = { };
+			float qa[4] = { };
+			float qb[4] = { };
+			for (uint32_t c = 0; c < numChannels; c++)
+			{
+				endpoints[0][c] = std::min(
+					RoundBC(std::max(a[c] * endpointScale - p[0], 0.0f) / 2), maxEndpoint);
+				endpoints[1][c] = std::min(
+					RoundBC(std::max(b[c] * endpointScale - p[1], 0.0f) / 2), maxEndpoint);
+				qa[c] = float(ExpandBC7Endpoint(endpoints[0][c], p[0], mode.endpointBits));
+				qb[c] = float(ExpandBC7Endpoint(endpoints[1][c], p[1], mode.endpointBits));
+			}
+			
+			uint32_t indices[16];
+			GetBCIndices(block, qa, qb, numLevels, indices);
+			
+			uint32_t weights[16];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				weights[i] = mode.weights[indices[i]];
+			}
+			
+			BCBlock decoded;
+			InterpolateBC7Block(qa, qb, weights, mode.channelMask, decoded);
+			
+			float error = GetBCBlockError(block, decoded, mode.channelMask, pixelMask);
+			if (error < subset.error)
+			{
+				subset.error = error;
+				std::memcpy(subset.endpoints, endpoints, sizeof(endpoints));
+				subset.pBits[0] = p[0];
+				subset.pBits[1] = p[1];
+				std::copy(indices, indices + 16, subset.indices);
+			}
+		}
+		
+		if (subset.error == 0 || iteration == bcRefineIterations)
+		{
+			break;
+		}
+		
+		float weights[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			weights[i] = mode.weights[subset.indices[i]] / 64.0f;
+		}
+		
+		if (!RefineBCEndpoints(block, weights, mode.channelMask, pixelMask, a, b))
+		{
+			break;
+		}
+	}
+}
+
+/// The high index bit of the anchor pixel is implied 0, swapping the
+/// endpoints clears it
+static void SetBC7Anchor(BC7Subset &subset, uint32_t anchor, uint32_t pixelMask, uint32_t indexBits)
+{
+	const uint32_t maxIndex = (1u << indexBits) - 1;
+	if (subset.indices[anchor] <= maxIndex >> 1)
+	{
+		return;
+	}
+	
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		std::swap(subset.endpoints[0][c], subset.endpoints[1][c]);
+	}
+	
+	std::swap(subset.pBits[0], subset.pBits[1]);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		if ((pixelMask >> i) & 1)
+		{
+			subset.indices[i] = maxIndex - subset.indices[i];
+		}
+	}
+}
+
+/// Ranks the 2 subset partitions by the variance their subsets leave off
+/// their principal axes, from running sums of the RGB values
+static void GetBC7PartitionCandidates(
+	const BCBlock &block, uint32_t partitions[bc7PartitionCandidates])
+{
+	/// r, g, b, rr, rg, rb, gg, gb, bb of every pixel
+	alignas(16) float moments[9][16];
+	float totals[9] = { };
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const float r = block.channels[0][i];
+		const float g = block.channels[1][i];
+		const float b = block.channels[2][i];
+		const float m[9] = { r, g, b, r * r, r * g, r * b, g * g, g * b, b * b };
+		for (uint32_t k = 0; k < 9; k++)
+		{
+			moments[k][i] = m[k];
+			totals[k] += m[k];
+		}
+	}
+	
+	float errors[bc7PartitionCandidates];
+	for (uint32_t k = 0; k < bc7PartitionCandidates; k++)
+	{
+		errors[k] = INFINITY;
+		partitions[k] = 0;
+	}
+	
+	for (uint32_t partition = 0; partition < 64; partition++)
+	{
+		const uint32_t mask1 = bc7Partitions2[partition];
+		float sums[2][9];
+		uint32_t counts[2] = { 0, 0 };
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			counts[1] += (mask1 >> i) & 1;
+		}
+
+#ifdef SMORGASBORD_SSE2
+		const __m128 keep[4] =
+		{
+			GetBCPixelMask(mask1, 0), GetBCPixelMask(mask1, 1),
+			GetBCPixelMask(mask1, 2), GetBCPixelMask(mask1, 3)
+		};
+		
+		for (uint32_t k = 0; k < 9; k++)
+		{
+			__m128 sum = _mm_and_ps(_mm_load_ps(&moments[k][0]), keep[0]);
+			for (uint32_t g = 1; g < 4; g++)
+			{
+				sum = _mm_add_ps(sum, _mm_and_ps(_mm_load_ps(&moments[k][g * 4]), keep[g]));
+			}
+			
+			sums[1][k] = SumBCLanes(sum);
+		}
+#else
+		for (uint32_t k = 0; k < 9; k++)
+		{
+			sums[1][k] = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				if ((mask1 >> i) & 1)
+				{
+					sums[1][k] += moments[k][i];
+				}
+			}
+		}
+#endif
+		
+		counts[0] = 16 - counts[1];
+		for (uint32_t k = 0; k < 9; k++)
+		{
+			sums[0][k] = totals[k] - sums[1][k];
+		}
+		
+		float error = 0;
+		for (uint32_t s = 0; s < 2; s++)
+		{
+			const float *sum = sums[s];
+			const float n = float(counts[s]);
+			const float covariance[3][3] =
+			{
+				{ sum[3] - sum[0] * sum[0] / n, sum[4] - sum[0] * sum[1] / n, sum[5] - sum[0] * sum[2] / n },
+				{ sum[4] - sum[0] * sum[1] / n, sum[6] - sum[1] * sum[1] / n, sum[7] - sum[1] * sum[2] / n },
+				{ sum[5] - sum[0] * sum[2] / n, sum[7] - sum[1] * sum[2] / n, sum[8] - sum[2] * sum[2] / n }
+			};
+			
+			const float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+			
+			/// Largest eigenvalue as the Rayleigh quotient of the column of
+			/// the largest variance, which is one power iteration from
+			/// that axis and close enough to rank partitions
+			uint32_t k = covariance[1][1] > covariance[0][0] ? 1 : 0;
+			k = covariance[2][2] > covariance[k][k] ? 2 : k;
+			const float *v = covariance[k];
+			float vv = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+			float largest = 0;
+			if (vv > 0)
+			{
+				float vCv = 0;
+				for (uint32_t r = 0; r < 3; r++)
+				{
+					vCv += v[r] * (covariance[r][0] * v[0] + covariance[r][1] * v[1] + covariance[r][2] * v[2]);
+				}
+				
+				largest = vCv / vv;
+			}
+			
+			error += std::max(trace - largest, 0.0f);
+		}
+		
+		/// Insert into the sorted candidates
+		for (uint32_t k = 0; k < bc7PartitionCandidates; k++)
+		{
+			if (error < errors[k])
+			{
+				for (uint32_t m = bc7PartitionCandidates - 1; m > k; m--)
+				{
+					errors[m] = errors[m - 1];
+					partitions[m] = partitions[m - 1];
+				}
+				
+				errors[k] = error;
+				partitions[k] = partition;
+				break;
+			}
+		}
+	}
+}
+
+static void WriteBC7Mode6(BC7Subset &subset, uint8_t out[16])
+{
+	SetBC7Anchor(subset, 0, 0xFFFF, 4);
+	
+	std::memset(out, 0, 16);
+	BCBits bits(out);
+	bits.Write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		bits.Write(subset.endpoints[0][c], 7);
+		bits.Write(subset.endpoints[1][c], 7);
+	}
+	
+	bits.Write(subset.pBits[0], 1);
+	bits.Write(subset.pBits[1], 1);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		bits.Write(subset.indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+static void WriteBC7Mode1(uint32_t partition, BC7Subset subsets[2], uint8_t out[16])
+{
+	const uint32_t mask1 = bc7Partitions2[partition];
+	const uint32_t anchor1 = bc7Anchors2[partition];
+	SetBC7Anchor(subsets[0], 0, ~mask1 & 0xFFFF, 3);
+	SetBC7Anchor(subsets[1], anchor1, mask1, 3);
+	
+	std::memset(out, 0, 16);
+	BCBits bits(out);
+	bits.Write(1 << 1, 2);
+	bits.Write(partition, 6);
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		for (uint32_t s = 0; s < 2; s++)
+		{
+			bits.Write(subsets[s].endpoints[0][c], 6);
+			bits.Write(subsets[s].endpoints[1][c], 6);
+		}
+	}
+	
+	bits.Write(subsets[0].pBits[0], 1);
+	bits.Write(subsets[1].pBits[0], 1);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const BC7Subset &subset = subsets[(mask1 >> i) & 1];
+		bits.Write(subset.indices[i], i == 0 || i == anchor1 ? 2 : 3);
+	}
+}
+
+/// Mode 6 for every block. Opaque blocks it doesn't fit well, e.g. at
+/// edges between two colors, also try mode 1 with the partitions which
+/// look best
+static void EncodeBC7Block(const BCBlock &block, uint8_t out[16])
+{
+	BC7Subset single;
+	EncodeBC7Subset(block, 0xFFFF, bc7Mode6, single);
+	
+	bool opaque = true;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		opaque &= block.channels[3][i] == 255;
+	}
+	
+	if (!opaque || single.error <= bc7PartitionThreshold * 16 * 3)
+	{
+		WriteBC7Mode6(single, out);
+		return;
+	}
+	
+	uint32_t candidates[bc7PartitionCandidates];
+	GetBC7PartitionCandidates(block, candidates);
+	
+	float bestError = single.error;
+	uint32_t bestPartition = 0;
+	BC7Subset bestSubsets[2];
+	for (uint32_t partition : candidates)
+	{
+		const uint32_t mask1 = bc7Partitions2[partition];
+		BC7Subset subsets[2];
+		EncodeBC7Subset(block, ~mask1 & 0xFFFF, bc7Mode1, subsets[0]);
+		if (subsets[0].error >= bestError)
+		{
+			continue;
+		}
+		
+		EncodeBC7Subset(block, mask1, bc7Mode1, subsets[1]);
+		if (subsets[0].error + subsets[1].error < bestError)
+		{
+			bestError = subsets[0].error + subsets[1].error;
+			bestPartition = partition;
+			bestSubsets[0] = subsets[0];
+			bestSubsets[1] = subsets[1];
+		}
+	}
+	
+	if (bestError < single.error)
+	{
+		WriteBC7Mode1(bestPartition, bestSubsets, out);
+	}
+	else
+	{
+		WriteBC7Mode6(single, out);
+	}
+}
+
+static void EncodeBCBlock(const BCBlock &block, BCType type, uint8_t *out)
+{
+	switch (type)
+	{
+	case BCType::BC1:
+		EncodeBC1Block(block, true, out);
+		break;
+	case BCType::BC3:
+		EncodeBC4Block(block, 3, out);
+		EncodeBC1Block(block, false, out + 8);
+		break;
+	case BCType::BC4:
+		EncodeBC4Block(block, 0, out);
+		break;
+	case BCType::BC5:
+		EncodeBC4Block(block, 0, out);
+		EncodeBC4Block(block, 1, out + 8);
+		break;
+	case BCType::BC7:
+		EncodeBC7Block(block, out);
+		break;
+	case BCType::None:
+		break;
+	}
+}
+
+static void DecodeBC1Block(const uint8_t *in, bool fourColors, uint8_t pixels[16][4])
+{
+	uint32_t color0 = ReadBCUInt16(in);
+	uint32_t color1 = ReadBCUInt16(in + 2);
+	uint8_t palette[4][4];
+	GetBC1Palette(color0, color1, fourColors || color0 > color1, palette);
+	
+	uint32_t bits = ReadBCUInt16(in + 4) | (ReadBCUInt16(in + 6) << 16);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		std::memcpy(pixels[i], palette[(bits >> (i * 2)) & 3], 4);
+	}
+}
+
+static void DecodeBC4Block(const uint8_t *in, uint32_t channel, uint8_t pixels[16][4])
+{
+	uint8_t palette[8];
+	GetBC4Palette(in[0], in[1], palette);
+	
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		bits |= uint64_t(in[2 + i]) << (i * 8);
+	}
+	
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		pixels[i][channel] = palette[(bits >> (i * 3)) & 7];
+	}
+}
+
+static void DecodeBC7Mode6(BCBits &bits, uint8_t pixels[16][4])
+{
+	uint32_t endpoints[2][4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = bits.Read(7) << 1;
+		endpoints[1][c] = bits.Read(7) << 1;
+	}
+	
+	uint32_t p0 = bits.Read(1);
+	uint32_t p1 = bits.Read(1);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		endpoints[0][c] |= p0;
+		endpoints[1][c] |= p1;
+	}
+	
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t w = bc7Weights4[bits.Read(i == 0 ? 3 : 4)];
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			pixels[i][c] = uint8_t(
+				((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6);
+		}
+	}
+}
+
+static void DecodeBC7Mode1(BCBits &bits, uint8_t pixels[16][4])
+{
+	const uint32_t partition = bits.Read(6);
+	const uint32_t mask1 = bc7Partitions2[partition];
+	const uint32_t anchor1 = bc7Anchors2[partition];
+	
+	uint32_t endpoints[2][2][3];
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		for (uint32_t s = 0; s < 2; s++)
+		{
+			endpoints[s][0][c] = bits.Read(6);
+			endpoints[s][1][c] = bits.Read(6);
+		}
+	}
+	
+	for (uint32_t s = 0; s < 2; s++)
+	{
+		uint32_t pBit = bits.Read(1);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			endpoints[s][0][c] = ExpandBC7Endpoint(endpoints[s][0][c], pBit, 6);
+			endpoints[s][1][c] = ExpandBC7Endpoint(endpoints[s][1][c], pBit, 6);
+		}
+	}
+	
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const uint32_t s = (mask1 >> i) & 1;
+		uint32_t w = bc7Weights3[bits.Read(i == 0 || i == anchor1 ? 2 : 3)];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			pixels[i][c] = uint8_t(
+				((64 - w) * endpoints[s][0][c] + w * endpoints[s][1][c] + 32) >> 6);
+		}
+		
+		pixels[i][3] = 255;
+	}
+}
+
+/// Only the modes the encoder writes
+static bool DecodeBC7Block(const uint8_t *in, uint8_t pixels[16][4])
+{
+	uint8_t data[16];
+	std::memcpy(data, in, 16);
+	BCBits bits(data);
+	
+	if ((in[0] & 0x03) == 0x02)
+	{
+		bits.Read(2);
+		DecodeBC7Mode1(bits, pixels);
+		return true;
+	}
+	
+	if ((in[0] & 0x7F) == 0x40)
+	{
+		bits.Read(7);
+		DecodeBC7Mode6(bits, pixels);
+		return true;
+	}
+	
+	return false;
+}
+
+static bool DecodeBCBlock(const uint8_t *in, BCType type, uint8_t pixels[16][4])
+{
+	switch (type)
+	{
+	case BCType::BC1:
+		DecodeBC1Block(in, false, pixels);
+		return true;
+	case BCType::BC3:
+		DecodeBC1Block(in + 8, true, pixels);
+		DecodeBC4Block(in, 3, pixels);
+		return true;
+	case BCType::BC4:
+	case BCType::BC5:
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			pixels[i][0] = pixels[i][1] = pixels[i][2] = 0;
+			pixels[i][3] = 255;
+		}
+		
+		DecodeBC4Block(in, 0, pixels);
+		if (type == BCType::BC5)
+		{
+			DecodeBC4Block(in + 8, 1, pixels);
+		}
+		
+		return true;
+	case BCType::BC7:
+		return DecodeBC7Block(in, pixels);
+	case BCType::None:
+		break;
+	}
+	
+	return false;
+}
+
+bool Smorgasbord::CompressImage(
+	const Image &image,
+	TextureFormat format,
+	std::vector<uint8_t> &blocks,
+	uint32_t numThreads)
+{
+	const BCType type = GetBCType(format);
+	if (type == BCType::None)
+	{
+		LogE("Not a block compressed texture format: {0}", int(format));
+		return false;
+	}
+	
+	if (image.pixelSize != 4 || image.imageSize.x == 0 || image.imageSize.y == 0
+		|| image.data.size() != size_t(image.imageSize.x) * image.imageSize.y * 4)
+	{
+		LogE("Block compression needs a non-empty RGBA image");
+		return false;
+	}
+	
+	const uint32_t blockSize = GetTextureFormatBlockSize(format);
+	const uint32_t numBlocksX = (image.imageSize.x + 3) / 4;
+	const uint32_t numBlocksY = (image.imageSize.y + 3) / 4;
+	blocks.resize(size_t(numBlocksX) * numBlocksY * blockSize);
+	
+	ParallelForRange(
+		numBlocksY,
+		1,
+		[&](size_t begin, size_t end)
+		{
+			BCBlock block;
+			for (size_t y = begin; y < end; y++)
+			{
+				for (uint32_t x = 0; x < numBlocksX; x++)
+				{
+					LoadBCBlock(image, x * 4, uint32_t(y) * 4, block);
+					EncodeBCBlock(
+						block, type, &blocks[(y * numBlocksX + x) * blockSize]);
+				}
+			}
+		},
+		numThreads);
+	
+	return true;
+}
+
+std::shared_ptr<Smorgasbord::Image> Smorgasbord::DecompressImage(
+	const uint8_t *blocks,
+	size_t size,
+	glm::uvec2 imageSize,
+	TextureFormat format,
+	uint32_t numThreads)
+{
+	const BCType type = GetBCType(format);
+	if (type == BCType::None || imageSize.x == 0 || imageSize.y == 0
+		|| size != GetTextureLevelSize(format, imageSize, 0))
+	{
+		LogE("Invalid block compressed image");
+		return nullptr;
+	}
+	
+	const uint32_t blockSize = GetTextureFormatBlockSize(format);
+	const uint32_t numBlocksX = (imageSize.x + 3) / 4;
+	const uint32_t numBlocksY = (imageSize.y + 3) / 4;
+	std::shared_ptr<Image> image = std::make_shared<Image>(imageSize);
+	std::atomic<bool> failed(false);
+	
+	ParallelForRange(
+		numBlocksY,
+		1,
+		[&](size_t begin, size_t end)
+		{
+			uint8_t pixels[16][4];
+			for (size_t by = begin; by < end; by++)
+			{
+				for (uint32_t bx = 0; bx < numBlocksX; bx++)
+				{
+					if (!DecodeBCBlock(
+						&blocks[(by * numBlocksX + bx) * blockSize], type, pixels))
+					{
+						failed = true;
+						continue;
+					}
+					
+					const uint32_t width = std::min(4u, imageSize.x - bx * 4);
+					const uint32_t height = std::min(4u, imageSize.y - uint32_t(by) * 4);
+					for (uint32_t y = 0; y < height; y++)
+					{
+						std::memcpy(
+							&image->data[((by * 4 + y) * imageSize.x + bx * 4) * 4],
+							pixels[y * 4],
+							width * 4);
+					}
+				}
+			}
+		},
+		numThreads);
+	
+	if (failed)
+	{
+		LogE("Only BC7 mode 1 and 6 blocks can be decoded");
+		return nullptr;
+	}
+	
+	return image;
+}
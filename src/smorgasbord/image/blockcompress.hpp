@@ -0,0 +1,67 @@
+#pragma once
+
+#include <smorgasbord/gpu/gpuapi.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+
+Block compression
+-----------------
+
+CompressImage() encodes an RGBA Image into one of the BC TextureFormats,
+4x4 pixel blocks of 8 or 16 bytes, laid out row by row the way
+Texture::UploadLevel() takes them. Sizes which are not multiples of 4
+repeat their last row and column into the partial blocks.
+	
+	- BC1: RGB at 4 bits per pixel. Pixels with alpha below 128 become
+	  transparent (punch-through alpha)
+	- BC3: BC1 color with a BC4 block for alpha, 8 bits per pixel
+	- BC4: R only, 4 bits per pixel
+	- BC5: R and G as two BC4 blocks, e.g. for normal maps
+	- BC7: RGBA at 8 bits per pixel. Mode 6, one 7 bit + p-bit endpoint
+	  pair and 4 bit indices, for every block. Opaque blocks it fits
+	  badly also try mode 1, which splits the block into two subsets by
+	  one of 64 partitions, for the few partitions that look best
+
+The endpoints of a block start at the extremes along its principal axis
+and are refined with a least squares fit to the chosen indices, keeping
+whichever quantized pair has the smaller error. sRGB formats are encoded
+like their UNorm counterparts, the error is measured on the stored
+values. Rows of blocks are encoded in parallel, the per-pixel loops use
+SSE2 on 4 pixels at once.
+
+DecompressImage() decodes every format CompressImage() writes, so that
+the encoder can be checked without a GPU. BC7 blocks of modes other than
+1 and 6 are not decoded.
+
+*/
+
+namespace Smorgasbord {
+
+class Image;
+
+/// blocks is resized to GetTextureLevelSize() of the image. numThreads == 0
+/// means one thread per hardware thread
+bool CompressImage(
+	const Image &image,
+	TextureFormat format,
+	std::vector<uint8_t> &blocks,
+	uint32_t numThreads = 0);
+
+/// Returns an RGBA image, or nullptr if size doesn't match imageSize or a
+/// block can't be decoded. BC4 decodes to (r, 0, 0, 255), BC5 to
+/// (r, g, 0, 255)
+std::shared_ptr<Image> DecompressImage(
+	const uint8_t *blocks,
+	size_t size,
+	glm::uvec2 imageSize,
+	TextureFormat format,
+	uint32_t numThreads = 0);
+
+}
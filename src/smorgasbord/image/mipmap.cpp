@@ -0,0 +1,444 @@
+#include "mipmap.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/// In pixels of the new level
+const double mipKaiserWidth = 3.0;
+const double mipKaiserAlpha = 4.0;
+
+/// Steps of the linear to sRGB table
+const uint32_t mipSRGBSteps = 65535;
+
+/// Bytes to linear floats and back
+struct MipConversionTables
+{
+	float linear[256]; // byte / 255
+	float sRGBToLinear[256];
+	uint8_t linearToSRGB[mipSRGBSteps + 1];
+	
+	MipConversionTables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			double v = i / 255.0;
+			linear[i] = float(v);
+			sRGBToLinear[i] = float(
+				v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+		}
+		
+		for (uint32_t i = 0; i <= mipSRGBSteps; i++)
+		{
+			double v = double(i) / mipSRGBSteps;
+			double s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1 / 2.4) - 0.055;
+			linearToSRGB[i] = uint8_t(std::min(std::max(s * 255 + 0.5, 0.0), 255.0));
+		}
+	}
+};
+
+static const MipConversionTables &GetMipConversionTables()
+{
+	static const MipConversionTables tables;
+	return tables;
+}
+
+/// Weights of the source pixels first .. first + count - 1 for each pixel
+/// of the new level, along one axis
+struct MipFilterTaps
+{
+	std::vector<uint32_t> first;
+	std::vector<uint32_t> offsets; // into weights, one more than pixels
+	std::vector<float> weights;
+	uint32_t maxCount = 0;
+	
+	uint32_t GetCount(uint32_t i) const
+	{
+		return offsets[i + 1] - offsets[i];
+	}
+};
+
+inline double GetMipBesselI0(double x)
+{
+	double sum = 1;
+	double term = 1;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	
+	return sum;
+}
+
+inline double GetMipKaiserWeight(double t)
+{
+	if (std::abs(t) >= mipKaiserWidth)
+	{
+		return 0;
+	}
+	
+	const double pi = 3.14159265358979323846;
+	double sinc = t == 0 ? 1 : std::sin(pi * t) / (pi * t);
+	double r = t / mipKaiserWidth;
+	return sinc * GetMipBesselI0(mipKaiserAlpha * std::sqrt(1 - r * r))
+		/ GetMipBesselI0(mipKaiserAlpha);
+}
+
+static MipFilterTaps GetMipFilterTaps(
+	uint32_t sourceSize, uint32_t targetSize, Smorgasbord::MipFilter filter)
+{
+	MipFilterTaps taps;
+	taps.offsets.push_back(0);
+	
+	const double scale = double(sourceSize) / targetSize;
+	std::vector<double> weights;
+	
+	for (uint32_t x = 0; x < targetSize; x++)
+	{
+		/// Source pixel s covers [s, s + 1), new pixel x covers
+		/// [x * scale, (x + 1) * scale)
+		double begin = x * scale;
+		double end = (x + 1) * scale;
+		if (filter == Smorgasbord::MipFilter::Kaiser)
+		{
+			double center = (x + 0.5) * scale;
+			begin = center - mipKaiserWidth * scale;
+			end = center + mipKaiserWidth * scale;
+		}
+		
+		/// Taps outside the image are clamped to the edge pixels
+		int64_t lowest = int64_t(std::floor(begin));
+		int64_t highest = int64_t(std::ceil(end)) - 1;
+		uint32_t first = uint32_t(std::max<int64_t>(lowest, 0));
+		uint32_t last = uint32_t(std::min<int64_t>(highest, sourceSize - 1));
+		weights.assign(last - first + 1, 0);
+		
+		double sum = 0;
+		for (int64_t s = lowest; s <= highest; s++)
+		{
+			double weight = 0;
+			if (filter == Smorgasbord::MipFilter::Box)
+			{
+				weight = std::min(end, double(s + 1)) - std::max(begin, double(s));
+			}
+			else
+			{
+				weight = GetMipKaiserWeight((s + 0.5 - (x + 0.5) * scale) / scale);
+			}
+			
+			int64_t clamped = std::min<int64_t>(std::max<int64_t>(s, first), last);
+			weights[size_t(clamped - first)] += weight;
+			sum += weight;
+		}
+		
+		/// Drop zero taps at the ends
+		size_t trimBegin = 0;
+		size_t trimEnd = weights.size();
+		while (trimEnd - trimBegin > 1 && weights[trimBegin] == 0)
+		{
+			trimBegin++;
+		}
+		
+		while (trimEnd - trimBegin > 1 && weights[trimEnd - 1] == 0)
+		{
+			trimEnd--;
+		}
+		
+		taps.first.push_back(first + uint32_t(trimBegin));
+		for (size_t i = trimBegin; i < trimEnd; i++)
+		{
+			taps.weights.push_back(float(weights[i] / sum));
+		}
+		taps.offsets.push_back(uint32_t(taps.weights.size()));
+		taps.maxCount = std::max(taps.maxCount, uint32_t(trimEnd - trimBegin));
+	}
+	
+	return taps;
+}
+
+/// Adds weight * source to target, count floats, a multiple of 4
+inline void AddWeightedMipRow(
+	float *target, const float *source, float weight, size_t count)
+{
+	size_t i = 0;
+#ifdef SMORGASBORD_SSE2
+	const __m128 w = _mm_set1_ps(weight);
+	for (; i < count; i += 4)
+	{
+		_mm_storeu_ps(&target[i], _mm_add_ps(
+			_mm_loadu_ps(&target[i]), _mm_mul_ps(w, _mm_loadu_ps(&source[i]))));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		target[i] += weight * source[i];
+	}
+}
+
+/// Filters one decoded row horizontally, 4 channels per pixel
+static void FilterMipRow(
+	float *target, const float *source, const MipFilterTaps &taps)
+{
+	const size_t width = taps.first.size();
+	for (size_t x = 0; x < width; x++)
+	{
+		const float *pixels = &source[size_t(taps.first[x]) * 4];
+		const float *weights = &taps.weights[taps.offsets[x]];
+		const uint32_t count = taps.GetCount(uint32_t(x));
+
+#ifdef SMORGASBORD_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (uint32_t k = 0; k < count; k++)
+		{
+			sum = _mm_add_ps(
+				sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&pixels[k * 4])));
+		}
+		_mm_storeu_ps(&target[x * 4], sum);
+#else
+		float sum[4] = { };
+		for (uint32_t k = 0; k < count; k++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				sum[c] += weights[k] * pixels[k * 4 + c];
+			}
+		}
+		std::copy(sum, sum + 4, &target[x * 4]);
+#endif
+	}
+}
+
+static void EncodeMipRow(
+	uint8_t *target, const float *source, size_t width, bool sRGB)
+{
+	const MipConversionTables &tables = GetMipConversionTables();
+
+#ifdef SMORGASBORD_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 scale = sRGB
+		? _mm_setr_ps(mipSRGBSteps, mipSRGBSteps, mipSRGBSteps, 255)
+		: _mm_set1_ps(255);
+	
+	for (size_t x = 0; x < width; x++)
+	{
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&source[x * 4]), zero), one);
+		__m128i steps = _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+		if (sRGB)
+		{
+			alignas(16) int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), steps);
+			target[x * 4 + 0] = tables.linearToSRGB[indices[0]];
+			target[x * 4 + 1] = tables.linearToSRGB[indices[1]];
+			target[x * 4 + 2] = tables.linearToSRGB[indices[2]];
+			target[x * 4 + 3] = uint8_t(indices[3]);
+		}
+		else
+		{
+			steps = _mm_packs_epi32(steps, steps);
+			int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(steps, steps));
+			std::memcpy(&target[x * 4], &bytes, 4);
+		}
+	}
+#else
+	for (size_t i = 0; i < width * 4; i++)
+	{
+		float v = std::min(std::max(source[i], 0.0f), 1.0f);
+		target[i] = sRGB && i % 4 != 3
+			? tables.linearToSRGB[uint32_t(v * mipSRGBSteps + 0.5f)]
+			: uint8_t(v * 255 + 0.5f);
+	}
+#endif
+}
+
+/// Box filter halving both sides without sRGB, in integers: 2x2 sums in
+/// 16 bit lanes, rounded like the float path
+static void DownsampleMipLevel2x2(
+	const Smorgasbord::Image &source,
+	Smorgasbord::Image &target,
+	uint32_t numThreads)
+{
+	const size_t sourceWidth = source.imageSize.x;
+	const size_t targetWidth = target.imageSize.x;
+	
+	Smorgasbord::ParallelForRange(
+		target.imageSize.y,
+		8,
+		[&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				const uint8_t *row0 = &source.data[y * 2 * sourceWidth * 4];
+				const uint8_t *row1 = row0 + sourceWidth * 4;
+				uint8_t *out = &target.data[y * targetWidth * 4];
+				
+				size_t x = 0;
+#ifdef SMORGASBORD_SSE2
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i two = _mm_set1_epi16(2);
+				for (; x + 4 <= targetWidth; x += 4)
+				{
+					/// 8 source pixels of each row, 4 new pixels
+					__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row0[x * 8]));
+					__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row1[x * 8]));
+					__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row0[x * 8 + 16]));
+					__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row1[x * 8 + 16]));
+					
+					/// Vertical sums of pixels 0, 1 and 2, 3 per register
+					__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+					__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+					__m128i lo2 = _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero));
+					__m128i hi2 = _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero));
+					
+					/// Horizontal pairs: add the upper pixel of each register
+					/// to the lower one
+					__m128i p0 = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+					__m128i p1 = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+					__m128i p2 = _mm_add_epi16(lo2, _mm_srli_si128(lo2, 8));
+					__m128i p3 = _mm_add_epi16(hi2, _mm_srli_si128(hi2, 8));
+					
+					__m128i first = _mm_unpacklo_epi64(p0, p1);
+					__m128i second = _mm_unpacklo_epi64(p2, p3);
+					first = _mm_srli_epi16(_mm_add_epi16(first, two), 2);
+					second = _mm_srli_epi16(_mm_add_epi16(second, two), 2);
+					_mm_storeu_si128(
+						reinterpret_cast<__m128i*>(&out[x * 4]), _mm_packus_epi16(first, second));
+				}
+#endif
+				for (; x < targetWidth; x++)
+				{
+					for (size_t c = 0; c < 4; c++)
+					{
+						uint32_t sum = row0[x * 8 + c] + row0[x * 8 + 4 + c]
+							+ row1[x * 8 + c] + row1[x * 8 + 4 + c];
+						out[x * 4 + c] = uint8_t((sum + 2) >> 2);
+					}
+				}
+			}
+		},
+		numThreads);
+}
+
+static void DownsampleMipLevel(
+	const Smorgasbord::Image &source,
+	Smorgasbord::Image &target,
+	Smorgasbord::MipFilter filter,
+	bool sRGB,
+	uint32_t numThreads)
+{
+	if (filter == Smorgasbord::MipFilter::Box && !sRGB
+		&& source.imageSize == target.imageSize * 2u)
+	{
+		DownsampleMipLevel2x2(source, target, numThreads);
+		return;
+	}
+	
+	const MipConversionTables &tables = GetMipConversionTables();
+	const float *decode[4] = {
+		sRGB ? tables.sRGBToLinear : tables.linear,
+		sRGB ? tables.sRGBToLinear : tables.linear,
+		sRGB ? tables.sRGBToLinear : tables.linear,
+		tables.linear };
+	
+	const MipFilterTaps tapsX = GetMipFilterTaps(
+		source.imageSize.x, target.imageSize.x, filter);
+	const MipFilterTaps tapsY = GetMipFilterTaps(
+		source.imageSize.y, target.imageSize.y, filter);
+	
+	const size_t sourceWidth = source.imageSize.x;
+	const size_t targetWidth = target.imageSize.x;
+	const size_t rowFloats = targetWidth * 4;
+	
+	Smorgasbord::ParallelForRange(
+		target.imageSize.y,
+		8,
+		[&](size_t begin, size_t end)
+		{
+			/// Horizontally filtered source rows, source row y in slot
+			/// y % ringSize. The taps of a row are consecutive and move
+			/// down with it, so each source row is filtered once per range
+			const uint32_t ringSize = tapsY.maxCount;
+			std::vector<float> ring(ringSize * rowFloats);
+			std::vector<int64_t> ringRows(ringSize, -1);
+			std::vector<float> decoded(sourceWidth * 4);
+			std::vector<float> sum(rowFloats);
+			
+			for (size_t y = begin; y < end; y++)
+			{
+				std::fill(sum.begin(), sum.end(), 0.0f);
+				
+				const float *weights = &tapsY.weights[tapsY.offsets[y]];
+				for (uint32_t k = 0; k < tapsY.GetCount(uint32_t(y)); k++)
+				{
+					const uint32_t sourceY = tapsY.first[y] + k;
+					float *filtered = &ring[(sourceY % ringSize) * rowFloats];
+					
+					if (ringRows[sourceY % ringSize] != sourceY)
+					{
+						const uint8_t *row = &source.data[sourceY * sourceWidth * 4];
+						for (size_t i = 0; i < sourceWidth * 4; i += 4)
+						{
+							decoded[i + 0] = decode[0][row[i + 0]];
+							decoded[i + 1] = decode[1][row[i + 1]];
+							decoded[i + 2] = decode[2][row[i + 2]];
+							decoded[i + 3] = decode[3][row[i + 3]];
+						}
+						
+						FilterMipRow(filtered, decoded.data(), tapsX);
+						ringRows[sourceY % ringSize] = sourceY;
+					}
+					
+					AddWeightedMipRow(sum.data(), filtered, weights[k], rowFloats);
+				}
+				
+				EncodeMipRow(
+					&target.data[y * targetWidth * 4], sum.data(), targetWidth, sRGB);
+			}
+		},
+		numThreads);
+}
+
+std::vector<std::shared_ptr<Smorgasbord::Image>> Smorgasbord::GenerateMipChain(
+	std::shared_ptr<Image> image,
+	MipFilter filter,
+	bool sRGB,
+	uint32_t numLevels,
+	uint32_t numThreads)
+{
+	if (!image || image->pixelSize != 4
+		|| image->imageSize.x == 0 || image->imageSize.y == 0
+		|| image->data.size() != size_t(image->imageSize.x) * image->imageSize.y * 4)
+	{
+		LogE("Mip chains need a non-empty RGBA image");
+		return { };
+	}
+	
+	uint32_t maxLevels = 1;
+	for (uint32_t s = std::max(image->imageSize.x, image->imageSize.y); s > 1; s >>= 1)
+	{
+		maxLevels++;
+	}
+	
+	numLevels = numLevels == 0 ? maxLevels : std::min(numLevels, maxLevels);
+	
+	std::vector<std::shared_ptr<Image>> levels = { image };
+	for (uint32_t level = 1; level < numLevels; level++)
+	{
+		const Image &source = *levels.back();
+		glm::uvec2 size = glm::max(
+			glm::uvec2(image->imageSize.x >> level, image->imageSize.y >> level),
+			glm::uvec2(1));
+		
+		std::shared_ptr<Image> target = std::make_shared<Image>(size);
+		DownsampleMipLevel(source, *target, filter, sRGB, numThreads);
+		levels.push_back(target);
+	}
+	
+	return levels;
+}
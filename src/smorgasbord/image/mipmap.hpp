@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+
+Mip chain generation
+--------------------
+
+GenerateMipChain() downsamples an RGBA Image level by level, down to 1x1
+or to numLevels levels. Level i is max(1, size >> i), like the levels of a
+Texture, so sizes which are not powers of two lose their odd row or
+column at each step.
+
+Filters, both separable:
+	- Box: averages the area of the level before which a pixel covers.
+	  Halving an even size is a 2x2 average, an odd one blends 3 pixels
+	  with weights that shift along the row, so nothing is dropped
+	- Kaiser: a Kaiser windowed sinc 3 pixels of the new level wide.
+	  Sharper, at the cost of slight ringing
+
+With sRGB the color channels are averaged in linear space, so that
+minified textures don't get darker. Alpha is always linear. The rows of a
+level are filtered in parallel, with SSE2 on 4 channels at once.
+
+The result starts with image itself, as level 0. Upload it with
+Texture::UploadLevels() to a texture created with as many levels.
+
+*/
+
+namespace Smorgasbord {
+
+class Image;
+
+enum class MipFilter
+{
+	Box = 0,
+	Kaiser
+};
+
+/// numLevels == 0 means all levels. numThreads == 0 means one thread per
+/// hardware thread
+std::vector<std::shared_ptr<Image>> GenerateMipChain(
+	std::shared_ptr<Image> image,
+	MipFilter filter = MipFilter::Box,
+	bool sRGB = true,
+	uint32_t numLevels = 0,
+	uint32_t numThreads = 0);
+
+}
@@ -0,0 +1,841 @@
+#include "pixelconvert.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/// Values per parallel range of the Image functions
+const size_t pixelMinRange = 1 << 16;
+
+/// Linear to sRGB: floats from 2^-13 on, where the first code starts
+/// above, are estimated per 1/8 octave, i.e. by the exponent and the top 3
+/// mantissa bits
+const uint32_t pixelSRGBMinBits = (127 - 13) << 23;
+const uint32_t pixelSRGBBucketShift = 20;
+const uint32_t pixelSRGBBuckets = 13 * 8 + 1; // the last one for 1.0
+
+inline uint32_t GetPixelFloatBits(float v)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &v, 4);
+	return bits;
+}
+
+inline float GetPixelBitsFloat(uint32_t bits)
+{
+	float v;
+	std::memcpy(&v, &bits, 4);
+	return v;
+}
+
+/// sRGB value of linear v, in double precision
+inline double GetPixelSRGB(double v)
+{
+	return v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1 / 2.4) - 0.055;
+}
+
+struct PixelSRGBTables
+{
+	float decode[512]; // sRGB codes to linear, then UNorm codes for alpha
+	/// thresholds[k] is the smallest float encoded to code k or above,
+	/// thresholds[256] is above 1
+	float thresholds[257];
+	// linear estimate of code + 0.5 within each bucket
+	float base[pixelSRGBBuckets];
+	float slope[pixelSRGBBuckets]; // per unit of the low 20 mantissa bits
+	
+	PixelSRGBTables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			double v = i / 255.0;
+			decode[i] = float(
+				v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+			decode[256 + i] = float(v);
+		}
+		
+		/// The sRGB curve is monotonic, so the threshold of each code is
+		/// found by a binary search over the bits of the floats in [0, 1]
+		thresholds[0] = 0;
+		for (uint32_t k = 1; k < 256; k++)
+		{
+			uint32_t low = 0;
+			uint32_t high = GetPixelFloatBits(1.0f);
+			while (low < high)
+			{
+				uint32_t middle = low + (high - low) / 2;
+				double s = GetPixelSRGB(GetPixelBitsFloat(middle));
+				if (std::floor(s * 255 + 0.5) >= k)
+				{
+					high = middle;
+				}
+				else
+				{
+					low = middle + 1;
+				}
+			}
+			
+			thresholds[k] = GetPixelBitsFloat(low);
+		}
+		thresholds[256] = 2;
+		
+		for (uint32_t i = 0; i < pixelSRGBBuckets; i++)
+		{
+			double begin = GetPixelSRGB(GetPixelBitsFloat(
+				pixelSRGBMinBits + (i << pixelSRGBBucketShift))) * 255;
+			double end = GetPixelSRGB(GetPixelBitsFloat(
+				pixelSRGBMinBits + ((i + 1) << pixelSRGBBucketShift))) * 255;
+			base[i] = float(begin + 0.5);
+			slope[i] = float((end - begin) / (1 << pixelSRGBBucketShift));
+		}
+	}
+};
+
+static const PixelSRGBTables &GetPixelSRGBTables()
+{
+	static const PixelSRGBTables tables;
+	return tables;
+}
+
+// Scalar definitions, the SIMD paths below compute the same values
+
+/// Clamps to [0, 1] like _mm_max_ps and _mm_min_ps, NaN becomes 0
+inline float ClampPixelUnit(float v)
+{
+	v = v > 0 ? v : 0;
+	return v < 1 ? v : 1;
+}
+
+inline uint32_t EncodePixelSRGB(float v, const PixelSRGBTables &tables)
+{
+	v = ClampPixelUnit(v);
+	uint32_t bits = GetPixelFloatBits(std::max(v, GetPixelBitsFloat(pixelSRGBMinBits)));
+	uint32_t bucket = (bits - pixelSRGBMinBits) >> pixelSRGBBucketShift;
+	float t = float(bits & ((1 << pixelSRGBBucketShift) - 1));
+	
+	/// The estimate is off by less than a code
+	uint32_t code = uint32_t(tables.base[bucket] + tables.slope[bucket] * t);
+	code += v >= tables.thresholds[code + 1];
+	code -= v < tables.thresholds[code];
+	return code;
+}
+
+inline uint16_t EncodePixelHalf(float f)
+{
+	const uint32_t bits = GetPixelFloatBits(f);
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t abs = bits & 0x7FFFFFFF;
+	
+	uint32_t half;
+	if (abs >= (127 + 16) << 23)
+	{
+		/// Infinity, or NaN quieted with the top of its payload
+		half = abs > 0x7F800000 ? 0x7E00 | ((abs >> 13) & 0x3FF) : 0x7C00;
+	}
+	else if (abs < (127 - 14) << 23)
+	{
+		/// Subnormal: adding 0.5 aligns the mantissa bits to the bottom,
+		/// rounded by the float addition
+		const uint32_t magic = (127 - 1) << 23;
+		half = GetPixelFloatBits(GetPixelBitsFloat(abs) + GetPixelBitsFloat(magic)) - magic;
+	}
+	else
+	{
+		/// Rebias, and round to nearest even by adding just under half a
+		/// unit, plus one if the result is odd
+		half = (abs + ((15u - 127u) << 23) + 0xFFF + ((abs >> 13) & 1)) >> 13;
+	}
+	
+	return uint16_t(half | sign);
+}
+
+inline float DecodePixelHalf(uint16_t h)
+{
+	const uint32_t expMant = h & 0x7FFF;
+	
+	/// Scaling by 2^112 rebiases the exponent, and normalizes subnormals
+	uint32_t bits = GetPixelFloatBits(
+		GetPixelBitsFloat(expMant << 13) * GetPixelBitsFloat((254 - 15) << 23));
+	if (expMant >= 0x7C00)
+	{
+		bits |= expMant > 0x7C00 ? 0x7FC00000 : 0x7F800000;
+	}
+	
+	return GetPixelBitsFloat(bits | (uint32_t(h & 0x8000) << 16));
+}
+
+// SIMD helpers
+
+#ifdef SMORGASBORD_SSE2
+
+/// 16 int32 values in [0, 255] to bytes
+inline __m128i PackPixelBytes(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+/// 8 int32 values in [0, 65535] to 16 bit, _mm_packus_epi32 is SSE4.1
+inline __m128i PackPixelWords(__m128i a, __m128i b)
+{
+	const __m128i bias = _mm_set1_epi32(0x8000);
+	return _mm_xor_si128(
+		_mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias)),
+		_mm_set1_epi16(-0x8000));
+}
+
+inline __m128i EncodePixelHalf4(__m128 f)
+{
+	const __m128i bits = _mm_castps_si128(f);
+	const __m128i abs = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+	const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+	
+	const __m128i isRegular = _mm_cmplt_epi32(abs, _mm_set1_epi32((127 + 16) << 23));
+	const __m128i isSubnormal = _mm_cmplt_epi32(abs, _mm_set1_epi32((127 - 14) << 23));
+	const __m128i isNaN = _mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7F800000));
+	
+	const __m128i infNaN = _mm_or_si128(
+		_mm_set1_epi32(0x7C00),
+		_mm_and_si128(isNaN, _mm_or_si128(
+			_mm_set1_epi32(0x200),
+			_mm_and_si128(_mm_srli_epi32(abs, 13), _mm_set1_epi32(0x3FF)))));
+	
+	const __m128i magic = _mm_set1_epi32((127 - 1) << 23);
+	const __m128i subnormal = _mm_sub_epi32(
+		_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(abs), _mm_castsi128_ps(magic))),
+		magic);
+	
+	const __m128i odd = _mm_and_si128(_mm_srli_epi32(abs, 13), _mm_set1_epi32(1));
+	const __m128i normal = _mm_srli_epi32(_mm_add_epi32(
+		_mm_add_epi32(abs, _mm_set1_epi32(int32_t((15u - 127u) << 23) + 0xFFF)), odd), 13);
+	
+	__m128i half = _mm_or_si128(
+		_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+	half = _mm_or_si128(
+		_mm_and_si128(isRegular, half), _mm_andnot_si128(isRegular, infNaN));
+	return _mm_or_si128(half, sign);
+}
+
+/// h holds one half in the low 16 bits of each lane
+inline __m128 DecodePixelHalf4(__m128i h)
+{
+	const __m128i expMant = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+	const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+	
+	__m128 scaled = _mm_mul_ps(
+		_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)),
+		_mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+	
+	const __m128i isInfNaN = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7BFF));
+	const __m128i isNaN = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7C00));
+	const __m128i infNaN = _mm_or_si128(
+		_mm_and_si128(isInfNaN, _mm_set1_epi32(0x7F800000)),
+		_mm_and_si128(isNaN, _mm_set1_epi32(0x7FC00000)));
+	
+	return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(infNaN, sign)));
+}
+
+#endif
+
+#ifdef SMORGASBORD_AVX2
+
+/// 16 int32 values in [0, 255] to bytes
+inline __m128i PackPixelBytes(__m256i a, __m256i b)
+{
+	/// Packing works per 128 bit lane, the permute restores the order
+	__m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_setzero_si256());
+	bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+	return _mm256_castsi256_si128(bytes);
+}
+
+inline __m256i EncodePixelSRGB8(__m256 v, const PixelSRGBTables &tables)
+{
+	const __m256i bits = _mm256_castps_si256(
+		_mm256_max_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(pixelSRGBMinBits))));
+	const __m256i bucket = _mm256_srli_epi32(
+		_mm256_sub_epi32(bits, _mm256_set1_epi32(pixelSRGBMinBits)), pixelSRGBBucketShift);
+	const __m256 t = _mm256_cvtepi32_ps(
+		_mm256_and_si256(bits, _mm256_set1_epi32((1 << pixelSRGBBucketShift) - 1)));
+	
+	__m256i code = _mm256_cvttps_epi32(_mm256_add_ps(
+		_mm256_i32gather_ps(tables.base, bucket, 4),
+		_mm256_mul_ps(_mm256_i32gather_ps(tables.slope, bucket, 4), t)));
+	
+	/// Comparison masks are -1 where true
+	const __m256 below = _mm256_i32gather_ps(tables.thresholds, code, 4);
+	const __m256 above = _mm256_i32gather_ps(tables.thresholds + 1, code, 4);
+	code = _mm256_sub_epi32(code, _mm256_castps_si256(_mm256_cmp_ps(v, above, _CMP_GE_OQ)));
+	code = _mm256_add_epi32(code, _mm256_castps_si256(_mm256_cmp_ps(v, below, _CMP_LT_OQ)));
+	return code;
+}
+
+#elif defined(SMORGASBORD_SSE2)
+
+inline __m128 GatherPixelTable(const float *table, __m128i index)
+{
+	alignas(16) int32_t indices[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+	return _mm_setr_ps(
+		table[indices[0]], table[indices[1]], table[indices[2]], table[indices[3]]);
+}
+
+inline __m128i EncodePixelSRGB4(__m128 v, const PixelSRGBTables &tables)
+{
+	const __m128i bits = _mm_castps_si128(
+		_mm_max_ps(v, _mm_castsi128_ps(_mm_set1_epi32(pixelSRGBMinBits))));
+	const __m128i bucket = _mm_srli_epi32(
+		_mm_sub_epi32(bits, _mm_set1_epi32(pixelSRGBMinBits)), pixelSRGBBucketShift);
+	const __m128 t = _mm_cvtepi32_ps(
+		_mm_and_si128(bits, _mm_set1_epi32((1 << pixelSRGBBucketShift) - 1)));
+	
+	__m128i code = _mm_cvttps_epi32(_mm_add_ps(
+		GatherPixelTable(tables.base, bucket),
+		_mm_mul_ps(GatherPixelTable(tables.slope, bucket), t)));
+	
+	const __m128 below = GatherPixelTable(tables.thresholds, code);
+	const __m128 above = GatherPixelTable(tables.thresholds + 1, code);
+	code = _mm_sub_epi32(code, _mm_castps_si128(_mm_cmpge_ps(v, above)));
+	code = _mm_add_epi32(code, _mm_castps_si128(_mm_cmplt_ps(v, below)));
+	return code;
+}
+
+#endif
+
+/// Source byte of each target channel, -1 for 0 and -2 for 255
+static bool GetPixelSwizzle(
+	int32_t channels[4],
+	uint32_t targetChannels,
+	uint32_t sourceChannels,
+	const char *swizzle)
+{
+	if (targetChannels < 1 || targetChannels > 4
+		|| sourceChannels < 1 || sourceChannels > 4
+		|| !swizzle || std::strlen(swizzle) != targetChannels)
+	{
+		LogE("Swizzle \"{0}\" doesn't convert {1} to {2} channels",
+			swizzle ? swizzle : "", sourceChannels, targetChannels);
+		return false;
+	}
+	
+	for (uint32_t i = 0; i < targetChannels; i++)
+	{
+		const char *names = "rgba";
+		const char *name = std::strchr(names, swizzle[i]);
+		if (swizzle[i] == '0' || swizzle[i] == '1')
+		{
+			channels[i] = swizzle[i] == '0' ? -1 : -2;
+		}
+		else if (swizzle[i] != 0 && name && uint32_t(name - names) < sourceChannels)
+		{
+			channels[i] = int32_t(name - names);
+		}
+		else
+		{
+			LogE("Swizzle \"{0}\" names a channel not in {1} channels",
+				swizzle, sourceChannels);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+bool Smorgasbord::SwizzlePixels(
+	uint8_t *target,
+	uint32_t targetChannels,
+	const uint8_t *source,
+	uint32_t sourceChannels,
+	size_t numPixels,
+	const char *swizzle)
+{
+	int32_t channels[4];
+	if (!GetPixelSwizzle(channels, targetChannels, sourceChannels, swizzle))
+	{
+		return false;
+	}
+	
+	size_t p = 0;
+
+#ifdef SMORGASBORD_SSE41
+	const size_t sourceSize = numPixels * sourceChannels;
+	
+	/// 4 pixels per shuffle, constants are shuffled in as 0 and or-ed
+	alignas(16) uint8_t shuffle[16];
+	alignas(16) uint8_t constants[16] = { };
+	std::memset(shuffle, 0x80, 16);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		for (uint32_t c = 0; c < targetChannels; c++)
+		{
+			if (channels[c] >= 0)
+			{
+				shuffle[i * targetChannels + c] = uint8_t(i * sourceChannels + channels[c]);
+			}
+			else if (channels[c] == -2)
+			{
+				constants[i * targetChannels + c] = 0xFF;
+			}
+		}
+	}
+	
+	const __m128i shuffleMask = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle));
+	const __m128i constantMask = _mm_load_si128(reinterpret_cast<const __m128i*>(constants));
+
+#ifdef SMORGASBORD_AVX2
+	if (targetChannels == 4)
+	{
+		/// Two shuffles of 4 pixels, one per 128 bit lane
+		const __m256i shuffleMask2 = _mm256_broadcastsi128_si256(shuffleMask);
+		const __m256i constantMask2 = _mm256_broadcastsi128_si256(constantMask);
+		for (; (p + 4) * sourceChannels + 16 <= sourceSize; p += 8)
+		{
+			__m256i pixels = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(&source[p * sourceChannels]))),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[(p + 4) * sourceChannels])),
+				1);
+			pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffleMask2), constantMask2);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&target[p * 4]), pixels);
+		}
+	}
+#endif
+	
+	for (; p * sourceChannels + 16 <= sourceSize; p += 4)
+	{
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[p * sourceChannels]));
+		pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffleMask), constantMask);
+		
+		uint8_t *out = &target[p * targetChannels];
+		if (targetChannels == 4)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), pixels);
+		}
+		else
+		{
+			/// Only the bytes of the 4 pixels
+			if (targetChannels >= 2)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out), pixels);
+			}
+			if (targetChannels != 2)
+			{
+				int32_t rest = _mm_cvtsi128_si32(
+					targetChannels == 3 ? _mm_srli_si128(pixels, 8) : pixels);
+				std::memcpy(out + (targetChannels == 3 ? 8 : 0), &rest, 4);
+			}
+		}
+	}
+#endif
+	
+	for (; p < numPixels; p++)
+	{
+		for (uint32_t c = 0; c < targetChannels; c++)
+		{
+			target[p * targetChannels + c] = channels[c] >= 0
+				? source[p * sourceChannels + channels[c]]
+				: (channels[c] == -2 ? 255 : 0);
+		}
+	}
+	
+	return true;
+}
+
+void Smorgasbord::ConvertUNorm8ToFloat(float *target, const uint8_t *source, size_t count)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_AVX2
+	const __m256 scale = _mm256_set1_ps(255);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i values = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&source[i])));
+		_mm256_storeu_ps(&target[i], _mm256_div_ps(_mm256_cvtepi32_ps(values), scale));
+	}
+#elif defined(SMORGASBORD_SSE2)
+	const __m128 scale = _mm_set1_ps(255);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[i]));
+		__m128i low = _mm_unpacklo_epi8(bytes, zero);
+		__m128i high = _mm_unpackhi_epi8(bytes, zero);
+		_mm_storeu_ps(&target[i + 0], _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+		_mm_storeu_ps(&target[i + 4], _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+		_mm_storeu_ps(&target[i + 8], _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+		_mm_storeu_ps(&target[i + 12], _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = source[i] / 255.0f;
+	}
+}
+
+void Smorgasbord::ConvertFloatToUNorm8(uint8_t *target, const float *source, size_t count)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_AVX2
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 scale = _mm256_set1_ps(255);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(
+			_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&source[i]), zero), one), scale));
+		__m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(
+			_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&source[i + 8]), zero), one), scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]), PackPixelBytes(a, b));
+	}
+#elif defined(SMORGASBORD_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 scale = _mm_set1_ps(255);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i values[4];
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			values[k] = _mm_cvtps_epi32(_mm_mul_ps(
+				_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&source[i + k * 4]), zero), one), scale));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]),
+			PackPixelBytes(values[0], values[1], values[2], values[3]));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = uint8_t(std::nearbyint(ClampPixelUnit(source[i]) * 255.0f));
+	}
+}
+
+void Smorgasbord::ConvertUNorm16ToFloat(float *target, const uint16_t *source, size_t count)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_AVX2
+	const __m256 scale = _mm256_set1_ps(65535);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i values = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[i])));
+		_mm256_storeu_ps(&target[i], _mm256_div_ps(_mm256_cvtepi32_ps(values), scale));
+	}
+#elif defined(SMORGASBORD_SSE2)
+	const __m128 scale = _mm_set1_ps(65535);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[i]));
+		_mm_storeu_ps(&target[i + 0], _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), scale));
+		_mm_storeu_ps(&target[i + 4], _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), scale));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = source[i] / 65535.0f;
+	}
+}
+
+void Smorgasbord::ConvertFloatToUNorm16(uint16_t *target, const float *source, size_t count)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_AVX2
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 scale = _mm256_set1_ps(65535);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(
+			_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&source[i]), zero), one), scale));
+		__m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(
+			_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&source[i + 8]), zero), one), scale));
+		__m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&target[i]), words);
+	}
+#elif defined(SMORGASBORD_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 scale = _mm_set1_ps(65535);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_cvtps_epi32(_mm_mul_ps(
+			_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&source[i]), zero), one), scale));
+		__m128i b = _mm_cvtps_epi32(_mm_mul_ps(
+			_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&source[i + 4]), zero), one), scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]), PackPixelWords(a, b));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = uint16_t(std::nearbyint(ClampPixelUnit(source[i]) * 65535.0f));
+	}
+}
+
+void Smorgasbord::ConvertSRGBToLinear(
+	float *target, const uint8_t *source, size_t numPixels, uint32_t channels)
+{
+	const PixelSRGBTables &tables = GetPixelSRGBTables();
+	const size_t count = numPixels * channels;
+	const uint32_t alphaOffset = channels == 4 ? 256 : 0;
+	size_t i = 0;
+
+#ifdef SMORGASBORD_AVX2
+	/// Groups of 8 values start at a pixel, so alpha is in lanes 3 and 7
+	const __m256i offsets = _mm256_setr_epi32(
+		0, 0, 0, alphaOffset, 0, 0, 0, alphaOffset);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i codes = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&source[i])));
+		_mm256_storeu_ps(&target[i], _mm256_i32gather_ps(
+			tables.decode, _mm256_add_epi32(codes, offsets), 4));
+	}
+#endif
+	
+	/// Without gathers, table lookups are as fast as it gets
+	for (; i < count; i++)
+	{
+		target[i] = tables.decode[source[i] + (i % 4 == 3 ? alphaOffset : 0)];
+	}
+}
+
+void Smorgasbord::ConvertLinearToSRGB(
+	uint8_t *target, const float *source, size_t numPixels, uint32_t channels)
+{
+	const PixelSRGBTables &tables = GetPixelSRGBTables();
+	const size_t count = numPixels * channels;
+	const bool hasAlpha = channels == 4;
+	size_t i = 0;
+
+#ifdef SMORGASBORD_AVX2
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 scale = _mm256_set1_ps(255);
+	const __m256i alpha = hasAlpha
+		? _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1)
+		: _mm256_setzero_si256();
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i codes[2];
+		for (uint32_t k = 0; k < 2; k++)
+		{
+			__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&source[i + k * 8]), zero), one);
+			codes[k] = _mm256_blendv_epi8(
+				EncodePixelSRGB8(v, tables),
+				_mm256_cvtps_epi32(_mm256_mul_ps(v, scale)),
+				alpha);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]), PackPixelBytes(codes[0], codes[1]));
+	}
+#elif defined(SMORGASBORD_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 scale = _mm_set1_ps(255);
+	const __m128i alpha = hasAlpha ? _mm_setr_epi32(0, 0, 0, -1) : _mm_setzero_si128();
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i codes[4];
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&source[i + k * 4]), zero), one);
+			codes[k] = _mm_or_si128(
+				_mm_andnot_si128(alpha, EncodePixelSRGB4(v, tables)),
+				_mm_and_si128(alpha, _mm_cvtps_epi32(_mm_mul_ps(v, scale))));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]),
+			PackPixelBytes(codes[0], codes[1], codes[2], codes[3]));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = hasAlpha && i % 4 == 3
+			? uint8_t(std::nearbyint(ClampPixelUnit(source[i]) * 255.0f))
+			: uint8_t(EncodePixelSRGB(source[i], tables));
+	}
+}
+
+void Smorgasbord::ConvertFloatToHalf(uint16_t *target, const float *source, size_t count)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_F16C
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]),
+			_mm256_cvtps_ph(_mm256_loadu_ps(&source[i]), _MM_FROUND_TO_NEAREST_INT));
+	}
+#elif defined(SMORGASBORD_SSE2)
+	for (; i + 8 <= count; i += 8)
+	{
+		/// Halves are sign extended, so that packing keeps their 16 bits
+		__m128i a = _mm_srai_epi32(_mm_slli_epi32(EncodePixelHalf4(_mm_loadu_ps(&source[i])), 16), 16);
+		__m128i b = _mm_srai_epi32(_mm_slli_epi32(EncodePixelHalf4(_mm_loadu_ps(&source[i + 4])), 16), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&target[i]), _mm_packs_epi32(a, b));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = EncodePixelHalf(source[i]);
+	}
+}
+
+void Smorgasbord::ConvertHalfToFloat(float *target, const uint16_t *source, size_t count)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_F16C
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(&target[i], _mm256_cvtph_ps(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[i]))));
+	}
+#elif defined(SMORGASBORD_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[i]));
+		_mm_storeu_ps(&target[i + 0], DecodePixelHalf4(_mm_unpacklo_epi16(halves, zero)));
+		_mm_storeu_ps(&target[i + 4], DecodePixelHalf4(_mm_unpackhi_epi16(halves, zero)));
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		target[i] = DecodePixelHalf(source[i]);
+	}
+}
+
+std::shared_ptr<Smorgasbord::Image> Smorgasbord::SwizzleImage(
+	const Image &image,
+	uint32_t channels,
+	const char *swizzle,
+	uint32_t numThreads)
+{
+	const uint32_t sourceChannels = image.pixelSize;
+	const size_t width = image.imageSize.x;
+	int32_t swizzleChannels[4];
+	if (!GetPixelSwizzle(swizzleChannels, channels, sourceChannels, swizzle))
+	{
+		return nullptr;
+	}
+	
+	if (image.data.size() != width * image.imageSize.y * sourceChannels)
+	{
+		LogE("Image data doesn't match its size");
+		return nullptr;
+	}
+	
+	std::shared_ptr<Image> result = std::make_shared<Image>(image.imageSize, channels);
+	ParallelForRange(
+		image.imageSize.y,
+		std::max<size_t>(pixelMinRange / std::max<size_t>(width, 1), 1),
+		[&](size_t begin, size_t end)
+		{
+			SwizzlePixels(
+				&result->data[begin * width * channels],
+				channels,
+				&image.data[begin * width * sourceChannels],
+				sourceChannels,
+				(end - begin) * width,
+				swizzle);
+		},
+		numThreads);
+	
+	return result;
+}
+
+std::vector<float> Smorgasbord::ConvertImageToFloat(
+	const Image &image, bool sRGB, uint32_t numThreads)
+{
+	const uint32_t channels = image.pixelSize == 2 ? 1 : image.pixelSize;
+	const size_t width = image.imageSize.x;
+	if (image.pixelSize < 1 || image.pixelSize > 4
+		|| image.data.size() != width * image.imageSize.y * image.pixelSize)
+	{
+		LogE("Image data doesn't match its size");
+		return { };
+	}
+	
+	std::vector<float> pixels(width * image.imageSize.y * channels);
+	ParallelForRange(
+		image.imageSize.y,
+		std::max<size_t>(pixelMinRange / std::max<size_t>(width, 1), 1),
+		[&](size_t begin, size_t end)
+		{
+			float *target = &pixels[begin * width * channels];
+			const size_t numPixels = (end - begin) * width;
+			if (image.pixelSize == 2)
+			{
+				ConvertUNorm16ToFloat(
+					target,
+					reinterpret_cast<const uint16_t*>(image.data.data()) + begin * width,
+					numPixels);
+			}
+			else if (sRGB)
+			{
+				ConvertSRGBToLinear(
+					target, &image.data[begin * width * channels], numPixels, channels);
+			}
+			else
+			{
+				ConvertUNorm8ToFloat(
+					target, &image.data[begin * width * channels], numPixels * channels);
+			}
+		},
+		numThreads);
+	
+	return pixels;
+}
+
+std::shared_ptr<Smorgasbord::Image> Smorgasbord::ConvertFloatToImage(
+	const std::vector<float> &pixels,
+	glm::uvec2 size,
+	uint32_t channels,
+	bool sRGB,
+	uint32_t numThreads)
+{
+	const size_t width = size.x;
+	if (channels < 1 || channels > 4 || pixels.size() != width * size.y * channels)
+	{
+		LogE("{0} floats aren't {1}x{2} pixels of {3} channels",
+			pixels.size(), size.x, size.y, channels);
+		return nullptr;
+	}
+	
+	std::shared_ptr<Image> image = std::make_shared<Image>(size, channels);
+	ParallelForRange(
+		size.y,
+		std::max<size_t>(pixelMinRange / std::max<size_t>(width, 1), 1),
+		[&](size_t begin, size_t end)
+		{
+			uint8_t *target = &image->data[begin * width * channels];
+			const float *source = &pixels[begin * width * channels];
+			const size_t numPixels = (end - begin) * width;
+			if (sRGB)
+			{
+				ConvertLinearToSRGB(target, source, numPixels, channels);
+			}
+			else
+			{
+				ConvertFloatToUNorm8(target, source, numPixels * channels);
+			}
+		},
+		numThreads);
+	
+	return image;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+
+Pixel format conversion
+-----------------------
+
+Conversions between the channel layouts and value types of pixel data,
+on plain arrays so they work on Image::data as well as on mapped buffers.
+	
+	- SwizzlePixels(): rearranges, expands or packs 8 bit channels, e.g.
+	  "bgra" swaps red and blue, "rrr1" expands R to opaque gray RGBA,
+	  "rg" packs RGBA to RG. Target channel i takes the source channel
+	  named by swizzle[i], one of r, g, b, a, or the constant 0 or 1
+	- UNorm: 8 and 16 bit values to floats in [0, 1] and back. Floats are
+	  clamped to [0, 1], NaN to 0, multiplied by 255 or 65535 in float
+	  precision, as GPUs do, and rounded to nearest, ties to even
+	- sRGB: 8 bit sRGB values to linear floats and back, with the 4th
+	  channel of 4 channel pixels as linear alpha
+	- Half: IEEE 754 binary16, rounded to nearest, ties to even, with
+	  subnormals, infinities and NaNs
+
+Every instruction set gives the same results as the scalar code. sRGB
+and half conversions are exact: sRGB values are rounded correctly from
+the curve evaluated in double precision, halves are bit for bit what F16C
+produces, NaNs included. The UNorm and sRGB conversions compute 8 values
+per step with AVX2 and 4 with SSE2, half floats use F16C or SSE2 integer
+code, swizzles use SSSE3 byte shuffles of 4 or 8 pixels with SSE4.1.
+Linear to sRGB estimates the code from a piecewise linear table indexed
+by the bits of the float, then corrects it by one against the thresholds
+between the 256 codes.
+
+The Image functions convert whole images, rows in parallel.
+
+*/
+
+namespace Smorgasbord {
+
+class Image;
+
+/// swizzle has targetChannels letters, channels are 1 to 4. Returns false
+/// if swizzle names a channel the source doesn't have
+bool SwizzlePixels(
+	uint8_t *target,
+	uint32_t targetChannels,
+	const uint8_t *source,
+	uint32_t sourceChannels,
+	size_t numPixels,
+	const char *swizzle);
+
+/// count values
+void ConvertUNorm8ToFloat(float *target, const uint8_t *source, size_t count);
+void ConvertFloatToUNorm8(uint8_t *target, const float *source, size_t count);
+void ConvertUNorm16ToFloat(float *target, const uint16_t *source, size_t count);
+void ConvertFloatToUNorm16(uint16_t *target, const float *source, size_t count);
+
+/// numPixels pixels of channels values, the 4th channel is linear alpha
+void ConvertSRGBToLinear(
+	float *target, const uint8_t *source, size_t numPixels, uint32_t channels);
+void ConvertLinearToSRGB(
+	uint8_t *target, const float *source, size_t numPixels, uint32_t channels);
+
+/// count values
+void ConvertFloatToHalf(uint16_t *target, const float *source, size_t count);
+void ConvertHalfToFloat(float *target, const uint16_t *source, size_t count);
+
+/// Returns an image of channels bytes per pixel, or nullptr if swizzle
+/// doesn't fit. numThreads == 0 means one thread per hardware thread
+std::shared_ptr<Image> SwizzleImage(
+	const Image &image,
+	uint32_t channels,
+	const char *swizzle,
+	uint32_t numThreads = 0);
+
+/// One float per channel and pixel, linear if sRGB is set. Images of 2
+/// bytes per pixel are read as R16 UNorm, others as 8 bit channels
+std::vector<float> ConvertImageToFloat(
+	const Image &image, bool sRGB = false, uint32_t numThreads = 0);
+
+/// pixels holds size.x * size.y * channels floats. Returns an image of
+/// channels bytes per pixel, sRGB encoded if sRGB is set
+std::shared_ptr<Image> ConvertFloatToImage(
+	const std::vector<float> &pixels,
+	glm::uvec2 size,
+	uint32_t channels,
+	bool sRGB = false,
+	uint32_t numThreads = 0);
+
+}
@@ -0,0 +1,460 @@
+#include "textureatlas.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/rendering/staticmesh.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+/// Cells are aligned at least to BC blocks
+const uint32_t atlasMinAlignment = 4;
+const uint32_t atlasMaxLevels = 16;
+
+struct AtlasRect
+{
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t w = 0;
+	uint32_t h = 0;
+	
+	bool Contains(const AtlasRect &b) const
+	{
+		return b.x >= x && b.y >= y && b.x + b.w <= x + w && b.y + b.h <= y + h;
+	}
+	
+	bool Overlaps(const AtlasRect &b) const
+	{
+		return b.x < x + w && x < b.x + b.w && b.y < y + h && y < b.y + b.h;
+	}
+};
+
+inline uint32_t RoundUpAtlasSize(uint32_t size, uint32_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+inline uint32_t GetAtlasPowerOfTwo(uint32_t size)
+{
+	uint32_t p = 1;
+	while (p < size)
+	{
+		p <<= 1;
+	}
+	
+	return p;
+}
+
+/// Splits the free rectangles overlapping used into the maximal rectangles
+/// around it, and drops those contained in others
+static void SplitAtlasFreeRects(std::vector<AtlasRect> &freeRects, const AtlasRect &used)
+{
+	std::vector<AtlasRect> split;
+	for (size_t i = 0; i < freeRects.size(); )
+	{
+		const AtlasRect f = freeRects[i];
+		if (!f.Overlaps(used))
+		{
+			i++;
+			continue;
+		}
+		
+		if (used.x > f.x)
+		{
+			split.push_back({ f.x, f.y, used.x - f.x, f.h });
+		}
+		if (used.x + used.w < f.x + f.w)
+		{
+			split.push_back({ used.x + used.w, f.y, f.x + f.w - used.x - used.w, f.h });
+		}
+		if (used.y > f.y)
+		{
+			split.push_back({ f.x, f.y, f.w, used.y - f.y });
+		}
+		if (used.y + used.h < f.y + f.h)
+		{
+			split.push_back({ f.x, used.y + used.h, f.w, f.y + f.h - used.y - used.h });
+		}
+		
+		freeRects[i] = freeRects.back();
+		freeRects.pop_back();
+	}
+	
+	/// Only the new pieces can be contained in another rectangle, the
+	/// untouched ones were maximal before
+	const size_t numOld = freeRects.size();
+	freeRects.insert(freeRects.end(), split.begin(), split.end());
+	for (size_t i = numOld; i < freeRects.size(); )
+	{
+		bool contained = false;
+		for (size_t j = 0; j < freeRects.size() && !contained; j++)
+		{
+			contained = j != i && freeRects[j].Contains(freeRects[i])
+				&& (j < i || !freeRects[i].Contains(freeRects[j]));
+		}
+		
+		if (contained)
+		{
+			freeRects.erase(freeRects.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+/// MaxRects with best short side fit, rects in the order given by order.
+/// Returns false if a rect doesn't fit
+static bool PackAtlasRects(
+	std::vector<AtlasRect> &rects,
+	const std::vector<uint32_t> &order,
+	glm::uvec2 atlasSize)
+{
+	std::vector<AtlasRect> freeRects = { { 0, 0, atlasSize.x, atlasSize.y } };
+	
+	for (uint32_t r : order)
+	{
+		AtlasRect &rect = rects[r];
+		
+		size_t best = freeRects.size();
+		uint32_t bestShort = UINT32_MAX;
+		uint32_t bestLong = UINT32_MAX;
+		for (size_t i = 0; i < freeRects.size(); i++)
+		{
+			const AtlasRect &f = freeRects[i];
+			if (f.w < rect.w || f.h < rect.h)
+			{
+				continue;
+			}
+			
+			uint32_t shortSide = std::min(f.w - rect.w, f.h - rect.h);
+			uint32_t longSide = std::max(f.w - rect.w, f.h - rect.h);
+			if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+			{
+				best = i;
+				bestShort = shortSide;
+				bestLong = longSide;
+			}
+		}
+		
+		if (best == freeRects.size())
+		{
+			return false;
+		}
+		
+		rect.x = freeRects[best].x;
+		rect.y = freeRects[best].y;
+		SplitAtlasFreeRects(freeRects, rect);
+	}
+	
+	return true;
+}
+
+/// Copies image into its cell, repeating the edge pixels of the image
+/// into the rest of the cell
+static void FillAtlasCell(
+	Smorgasbord::Image &atlas,
+	const Smorgasbord::Image &image,
+	const Smorgasbord::TextureAtlasEntry &entry)
+{
+	const glm::uvec2 offset = entry.position - entry.cellPosition;
+	const size_t w = image.imageSize.x;
+	const size_t h = image.imageSize.y;
+	
+	for (size_t cy = 0; cy < entry.cellSize.y; cy++)
+	{
+		size_t y = size_t(std::min<int64_t>(
+			std::max<int64_t>(int64_t(cy) - offset.y, 0), int64_t(h) - 1));
+		const uint8_t *source = &image.data[y * w * 4];
+		uint8_t *target = &atlas.data[
+			((entry.cellPosition.y + cy) * size_t(atlas.imageSize.x) + entry.cellPosition.x) * 4];
+		
+		for (size_t cx = 0; cx < offset.x; cx++)
+		{
+			std::memcpy(target + cx * 4, source, 4);
+		}
+		
+		std::memcpy(target + offset.x * 4, source, w * 4);
+		
+		for (size_t cx = offset.x + w; cx < entry.cellSize.x; cx++)
+		{
+			std::memcpy(target + cx * 4, source + (w - 1) * 4, 4);
+		}
+	}
+}
+
+Smorgasbord::TextureAtlas Smorgasbord::BuildTextureAtlas(
+	const std::vector<std::shared_ptr<Image>> &images,
+	const TextureAtlasSettings &settings,
+	uint32_t numThreads)
+{
+	TextureAtlas atlas;
+	atlas.numLevels = std::min(std::max(settings.numLevels, 1u), atlasMaxLevels);
+	const uint32_t alignment = std::max(atlasMinAlignment, 1u << (atlas.numLevels - 1));
+	
+	// Cells
+	
+	std::vector<AtlasRect> cells(images.size());
+	uint64_t area = 0;
+	glm::uvec2 minSize = glm::uvec2(alignment);
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const std::shared_ptr<Image> &image = images[i];
+		if (!image || image->pixelSize != 4
+			|| image->imageSize.x == 0 || image->imageSize.y == 0
+			|| image->data.size() != size_t(image->imageSize.x) * image->imageSize.y * 4)
+		{
+			LogE("Atlas image {0} is not a non-empty RGBA image", i);
+			return { };
+		}
+		
+		cells[i].w = RoundUpAtlasSize(image->imageSize.x + 2 * settings.padding, alignment);
+		cells[i].h = RoundUpAtlasSize(image->imageSize.y + 2 * settings.padding, alignment);
+		area += uint64_t(cells[i].w) * cells[i].h;
+		minSize = glm::max(minSize, glm::uvec2(cells[i].w, cells[i].h));
+	}
+	
+	/// The largest side the atlas can have
+	uint32_t maxSize = settings.maxSize / alignment * alignment;
+	if (settings.powerOfTwo)
+	{
+		maxSize = GetAtlasPowerOfTwo(maxSize + 1) >> 1;
+	}
+	
+	if (minSize.x > maxSize || minSize.y > maxSize)
+	{
+		LogE("Atlas images don't fit into {0}x{0} pixels", settings.maxSize);
+		return { };
+	}
+	
+	/// Largest first, by longer side then area, as usual for MaxRects
+	std::vector<uint32_t> order(images.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(
+		order.begin(),
+		order.end(),
+		[&](uint32_t a, uint32_t b)
+		{
+			uint32_t sideA = std::max(cells[a].w, cells[a].h);
+			uint32_t sideB = std::max(cells[b].w, cells[b].h);
+			if (sideA != sideB)
+			{
+				return sideA > sideB;
+			}
+			
+			return uint64_t(cells[a].w) * cells[a].h > uint64_t(cells[b].w) * cells[b].h;
+		});
+	
+	// Atlas size, grown from the area of the cells until they fit
+	
+	auto roundSize = [&](uint32_t size)
+	{
+		size = RoundUpAtlasSize(size, alignment);
+		return std::min(settings.powerOfTwo ? GetAtlasPowerOfTwo(size) : size, maxSize);
+	};
+	/// Grows the smaller side which can still grow, false if none can
+	auto grow = [&](glm::uvec2 &size)
+	{
+		if (size.x >= maxSize && size.y >= maxSize)
+		{
+			return false;
+		}
+		
+		uint32_t &side = size.y >= maxSize || (size.x <= size.y && size.x < maxSize)
+			? size.x : size.y;
+		side = roundSize(settings.powerOfTwo ? side * 2 : side + side / 8 + 1);
+		return true;
+	};
+	
+	/// Powers of two start below the square root, so that growing one
+	/// side gives 2:1 atlases as well
+	uint32_t side = uint32_t(std::min<double>(std::ceil(std::sqrt(double(area))), maxSize));
+	side = settings.powerOfTwo ? GetAtlasPowerOfTwo(side + 1) >> 1 : roundSize(side);
+	glm::uvec2 size = glm::max(
+		glm::uvec2(roundSize(minSize.x), roundSize(minSize.y)),
+		glm::uvec2(side));
+	while (uint64_t(size.x) * size.y < area && grow(size))
+	{
+	}
+	
+	while (!PackAtlasRects(cells, order, size))
+	{
+		if (!grow(size))
+		{
+			LogE("Atlas images don't fit into {0}x{0} pixels", settings.maxSize);
+			return { };
+		}
+	}
+	
+	/// Sizes which needn't be powers of two shrink to the cells
+	if (!settings.powerOfTwo)
+	{
+		size = glm::uvec2(alignment);
+		for (const AtlasRect &cell : cells)
+		{
+			size = glm::max(size, glm::uvec2(cell.x + cell.w, cell.y + cell.h));
+		}
+	}
+	
+	// Entries and image
+	
+	atlas.entries.resize(images.size());
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		TextureAtlasEntry &entry = atlas.entries[i];
+		entry.cellPosition = glm::uvec2(cells[i].x, cells[i].y);
+		entry.cellSize = glm::uvec2(cells[i].w, cells[i].h);
+		entry.position = entry.cellPosition + settings.padding;
+		entry.size = images[i]->imageSize;
+		entry.uvMin = glm::vec2(entry.position) / glm::vec2(size);
+		entry.uvMax = glm::vec2(entry.position + entry.size) / glm::vec2(size);
+	}
+	
+	atlas.image = std::make_shared<Image>(size);
+	std::fill(atlas.image->data.begin(), atlas.image->data.end(), uint8_t(0));
+	
+	ParallelFor(
+		images.size(),
+		[&](size_t i)
+		{
+			FillAtlasCell(*atlas.image, *images[i], atlas.entries[i]);
+		},
+		numThreads);
+	
+	return atlas;
+}
+
+std::vector<std::shared_ptr<Smorgasbord::Image>> Smorgasbord::GenerateTextureAtlasMips(
+	const TextureAtlas &atlas,
+	MipFilter filter,
+	bool sRGB,
+	uint32_t numThreads)
+{
+	if (!atlas.image || atlas.numLevels == 0)
+	{
+		LogE("Atlas has no image");
+		return { };
+	}
+	
+	std::vector<std::shared_ptr<Image>> levels = { atlas.image };
+	for (uint32_t level = 1; level < atlas.numLevels; level++)
+	{
+		glm::uvec2 size = glm::max(
+			glm::uvec2(atlas.image->imageSize.x >> level, atlas.image->imageSize.y >> level),
+			glm::uvec2(1));
+		
+		levels.push_back(std::make_shared<Image>(size));
+		std::fill(levels.back()->data.begin(), levels.back()->data.end(), uint8_t(0));
+	}
+	
+	/// Cells are aligned to 2^(numLevels - 1), so every level of a cell is
+	/// exactly half the size of the one before and lands on whole texels
+	ParallelFor(
+		atlas.entries.size(),
+		[&](size_t i)
+		{
+			const TextureAtlasEntry &entry = atlas.entries[i];
+			const size_t atlasWidth = atlas.image->imageSize.x;
+			
+			std::shared_ptr<Image> cell = std::make_shared<Image>(entry.cellSize);
+			for (size_t y = 0; y < entry.cellSize.y; y++)
+			{
+				std::memcpy(
+					&cell->data[y * entry.cellSize.x * 4],
+					&atlas.image->data[((entry.cellPosition.y + y) * atlasWidth + entry.cellPosition.x) * 4],
+					entry.cellSize.x * 4);
+			}
+			
+			std::vector<std::shared_ptr<Image>> cellLevels = GenerateMipChain(
+				cell, filter, sRGB, atlas.numLevels, 1);
+			
+			for (uint32_t level = 1; level < cellLevels.size(); level++)
+			{
+				const Image &source = *cellLevels[level];
+				Image &target = *levels[level];
+				const glm::uvec2 position = glm::uvec2(
+					entry.cellPosition.x >> level, entry.cellPosition.y >> level);
+				
+				for (size_t y = 0; y < source.imageSize.y; y++)
+				{
+					std::memcpy(
+						&target.data[((position.y + y) * target.imageSize.x + position.x) * 4],
+						&source.data[y * source.imageSize.x * 4],
+						source.imageSize.x * 4);
+				}
+			}
+		},
+		numThreads);
+	
+	return levels;
+}
+
+void Smorgasbord::RemapTextureCoordinates(
+	MeshData &mesh,
+	const TextureAtlas &atlas,
+	const std::vector<int32_t> &materialEntries)
+{
+	if (mesh.t.empty() || mesh.ft.empty())
+	{
+		return;
+	}
+	
+	std::vector<MeshRange> ranges = mesh.ranges;
+	if (ranges.empty())
+	{
+		MeshRange range;
+		range.numFaces = uint32_t(mesh.c.size());
+		range.materialIndex = 0;
+		ranges.push_back(range);
+	}
+	
+	/// Old coordinate index and entry + 1 to new coordinate index, so a
+	/// coordinate is only duplicated if its faces go to different entries
+	std::unordered_map<uint64_t, uint32_t> remapped;
+	std::vector<glm::vec2> t;
+	t.reserve(mesh.t.size());
+	
+	size_t corner = 0;
+	uint32_t face = 0;
+	auto remapFaces = [&](uint32_t end, int32_t entry)
+	{
+		for (; face < end; face++)
+		{
+			for (int32_t v = 0; v < mesh.c[face] && corner < mesh.ft.size(); v++, corner++)
+			{
+				uint32_t index = mesh.ft[corner];
+				uint64_t key = (uint64_t(index) << 32) | uint32_t(entry + 1);
+				auto inserted = remapped.emplace(key, uint32_t(t.size()));
+				if (inserted.second)
+				{
+					t.push_back(entry < 0 ? mesh.t[index] : atlas.entries[entry].Remap(mesh.t[index]));
+				}
+				
+				mesh.ft[corner] = inserted.first->second;
+			}
+		}
+	};
+	
+	for (const MeshRange &range : ranges)
+	{
+		int32_t entry = -1;
+		if (range.materialIndex >= 0 && size_t(range.materialIndex) < materialEntries.size()
+			&& materialEntries[range.materialIndex] >= 0
+			&& size_t(materialEntries[range.materialIndex]) < atlas.entries.size())
+		{
+			entry = materialEntries[range.materialIndex];
+		}
+		
+		remapFaces(range.firstFace, -1);
+		remapFaces(range.firstFace + range.numFaces, entry);
+	}
+	
+	remapFaces(uint32_t(mesh.c.size()), -1);
+	
+	mesh.t.swap(t);
+}
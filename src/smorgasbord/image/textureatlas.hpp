@@ -0,0 +1,102 @@
+#pragma once
+
+#include <smorgasbord/image/mipmap.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+
+Texture atlases
+---------------
+
+BuildTextureAtlas() packs many small RGBA Images, e.g. decals and icons,
+into one atlas Image, so they are drawn with a single texture binding.
+Rectangles are placed with MaxRects (best short side fit), largest first,
+into the smallest atlas that fits them, growing from the area of all
+images up to maxSize.
+
+Every image gets a cell of its own: the image, surrounded by padding
+pixels which repeat its edge, like clamp to edge sampling would. Cells
+start and end on multiples of 4 and of 2^(numLevels - 1), so neither BC
+blocks (see blockcompress.hpp) nor texels of the smaller mip levels are
+shared between images.
+
+GenerateTextureAtlasMips() downsamples every cell on its own, so images
+don't bleed into each other at any level. At level i the padding is
+padding >> i texels wide, keep it at least 1 on the last level for
+bilinear filtering to stay inside an image.
+
+RemapTextureCoordinates() moves the texture coordinates of a MeshData
+into the atlas rectangles of its materials. Atlases can't repeat their
+images, so coordinates outside [0, 1] are clamped.
+
+*/
+
+namespace Smorgasbord {
+
+class Image;
+struct MeshData;
+
+struct TextureAtlasSettings
+{
+	uint32_t padding = 4; // pixels around each image
+	uint32_t numLevels = 3; // mip levels the cells are aligned for
+	uint32_t maxSize = 4096; // of either side of the atlas
+	bool powerOfTwo = true; // atlas sides
+};
+
+struct TextureAtlasEntry
+{
+	// pixels of the image within the atlas, without padding
+	glm::uvec2 position = glm::uvec2(0);
+	glm::uvec2 size = glm::uvec2(0);
+	// cell of the image, padding included
+	glm::uvec2 cellPosition = glm::uvec2(0);
+	glm::uvec2 cellSize = glm::uvec2(0);
+	// texture coordinates of the image corners
+	glm::vec2 uvMin = glm::vec2(0);
+	glm::vec2 uvMax = glm::vec2(0);
+	
+	glm::vec2 Remap(glm::vec2 t) const
+	{
+		return uvMin + glm::clamp(t, glm::vec2(0), glm::vec2(1)) * (uvMax - uvMin);
+	}
+};
+
+struct TextureAtlas
+{
+	std::shared_ptr<Image> image;
+	std::vector<TextureAtlasEntry> entries; // in the order of the images
+	uint32_t numLevels = 1;
+};
+
+/// Returns an atlas without image if an image isn't RGBA or the images
+/// don't fit into maxSize. numThreads == 0 means one thread per hardware
+/// thread
+TextureAtlas BuildTextureAtlas(
+	const std::vector<std::shared_ptr<Image>> &images,
+	const TextureAtlasSettings &settings = TextureAtlasSettings(),
+	uint32_t numThreads = 0);
+
+/// atlas.numLevels levels, starting with atlas.image, for
+/// Texture::UploadLevels()
+std::vector<std::shared_ptr<Image>> GenerateTextureAtlasMips(
+	const TextureAtlas &atlas,
+	MipFilter filter = MipFilter::Box,
+	bool sRGB = true,
+	uint32_t numThreads = 0);
+
+/// materialEntries maps MeshRange::materialIndex to an index into
+/// atlas.entries, -1 leaves the coordinates of a material as they are. A
+/// mesh without ranges uses materialEntries[0]. Coordinates shared by
+/// materials of different entries are duplicated
+void RemapTextureCoordinates(
+	MeshData &mesh,
+	const TextureAtlas &atlas,
+	const std::vector<int32_t> &materialEntries);
+
+}
@@ -0,0 +1,1139 @@
+#include "decodepng.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/checksum.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Inflate
+
+const uint32_t inflateLiteralBits = 10; // index bits of the literal/length table
+const uint32_t inflateDistanceBits = 8;
+const uint32_t inflateCodeLengthBits = 7;
+/// Matches are copied in words and may write this far past their end
+const size_t inflateSlack = 32;
+
+/// Table entries: code bits in bits 0..4, kind in bits 5..7, extra bits
+/// (or subtable index bits) in bits 8..11, value in bits 16..31
+enum InflateEntryKind : uint32_t
+{
+	InflateLiteral = 0 << 5, // value is the literal, or the code length symbol
+	InflateLiteralPair = 1 << 5, // value is two literals, the first in the low byte
+	InflateBase = 2 << 5, // value is the length or distance base
+	InflateEndOfBlock = 3 << 5,
+	InflateSubtable = 4 << 5, // value is the subtable offset
+	InflateInvalid = 5 << 5
+};
+
+const uint32_t inflateKindMask = 7 << 5;
+
+const uint16_t inflateLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t inflateLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t inflateDistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+const uint8_t inflateDistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+enum class InflateAlphabet
+{
+	CodeLengths,
+	LiteralLengths,
+	Distances
+};
+
+inline uint32_t MakeInflateEntry(InflateAlphabet alphabet, uint32_t symbol, uint32_t bits)
+{
+	switch (alphabet)
+	{
+	case InflateAlphabet::CodeLengths:
+		return bits | InflateLiteral | (symbol << 16);
+	
+	case InflateAlphabet::LiteralLengths:
+		if (symbol < 256)
+		{
+			return bits | InflateLiteral | (symbol << 16);
+		}
+		else if (symbol == 256)
+		{
+			return bits | InflateEndOfBlock;
+		}
+		else if (symbol < 286)
+		{
+			return bits | InflateBase
+				| (uint32_t(inflateLengthExtra[symbol - 257]) << 8)
+				| (uint32_t(inflateLengthBase[symbol - 257]) << 16);
+		}
+		break;
+	
+	case InflateAlphabet::Distances:
+		if (symbol < 30)
+		{
+			return bits | InflateBase
+				| (uint32_t(inflateDistanceExtra[symbol]) << 8)
+				| (uint32_t(inflateDistanceBase[symbol]) << 16);
+		}
+		break;
+	}
+	
+	return bits | InflateInvalid;
+}
+
+/// Builds the lookup table of a canonical Huffman code. Codes longer than
+/// tableBits continue in subtables. Literal/length tables also get entries
+/// for two literals whose codes fit into tableBits together
+static bool BuildInflateTable(
+	const uint8_t *lengths,
+	uint32_t count,
+	uint32_t tableBits,
+	InflateAlphabet alphabet,
+	std::vector<uint32_t> &table)
+{
+	uint32_t lengthCounts[16] = { };
+	for (uint32_t i = 0; i < count; i++)
+	{
+		lengthCounts[lengths[i]]++;
+	}
+	lengthCounts[0] = 0;
+	
+	/// Over-subscribed codes are invalid, incomplete ones get invalid entries
+	int32_t left = 1;
+	uint32_t nextCode[16] = { };
+	for (uint32_t length = 1; length < 16; length++)
+	{
+		left = left * 2 - int32_t(lengthCounts[length]);
+		if (left < 0)
+		{
+			return false;
+		}
+		
+		nextCode[length] = (nextCode[length - 1] + lengthCounts[length - 1]) << 1;
+	}
+	
+	/// Deflate sends codes starting with the most significant bit, but the
+	/// bit buffer is read from the least significant one
+	std::vector<uint16_t> codes(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t code = nextCode[lengths[i]]++;
+		uint32_t reversed = 0;
+		for (uint32_t b = 0; b < lengths[i]; b++)
+		{
+			reversed |= ((code >> b) & 1) << (lengths[i] - 1 - b);
+		}
+		codes[i] = uint16_t(reversed);
+	}
+	
+	const uint32_t tableSize = 1 << tableBits;
+	const uint32_t tableMask = tableSize - 1;
+	table.assign(tableSize, InflateInvalid);
+	
+	// Subtables for the long codes, sized for the longest code of each
+	
+	std::vector<uint8_t> subtableLengths(tableSize, 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (lengths[i] > tableBits)
+		{
+			uint8_t &length = subtableLengths[codes[i] & tableMask];
+			length = std::max(length, lengths[i]);
+		}
+	}
+	
+	for (uint32_t i = 0; i < tableSize; i++)
+	{
+		if (subtableLengths[i] > 0)
+		{
+			uint32_t subtableBits = subtableLengths[i] - tableBits;
+			table[i] = tableBits | InflateSubtable
+				| (subtableBits << 8) | (uint32_t(table.size()) << 16);
+			table.resize(table.size() + (size_t(1) << subtableBits), InflateInvalid);
+		}
+	}
+	
+	// Codes, repeated for every value of the bits after them
+	
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t length = lengths[i];
+		if (length == 0)
+		{
+			continue;
+		}
+		
+		if (length <= tableBits)
+		{
+			uint32_t entry = MakeInflateEntry(alphabet, i, length);
+			for (uint32_t j = codes[i]; j < tableSize; j += 1 << length)
+			{
+				table[j] = entry;
+			}
+		}
+		else
+		{
+			uint32_t subtable = table[codes[i] & tableMask];
+			uint32_t offset = subtable >> 16;
+			uint32_t subtableSize = 1 << ((subtable >> 8) & 15);
+			uint32_t subLength = length - tableBits;
+			uint32_t entry = MakeInflateEntry(alphabet, i, subLength);
+			for (uint32_t j = codes[i] >> tableBits; j < subtableSize; j += 1 << subLength)
+			{
+				table[offset + j] = entry;
+			}
+		}
+	}
+	
+	// Literal pairs
+	
+	if (alphabet == InflateAlphabet::LiteralLengths)
+	{
+		std::vector<uint32_t> single(table.begin(), table.begin() + tableSize);
+		for (uint32_t i = 0; i < tableSize; i++)
+		{
+			uint32_t first = single[i];
+			uint32_t firstBits = first & 31;
+			if ((first & inflateKindMask) != InflateLiteral || firstBits >= tableBits)
+			{
+				continue;
+			}
+			
+			/// The bits above the table index are unknown, the second code
+			/// has to fit into the known ones
+			uint32_t second = single[i >> firstBits];
+			uint32_t secondBits = second & 31;
+			if ((second & inflateKindMask) == InflateLiteral
+				&& firstBits + secondBits <= tableBits)
+			{
+				table[i] = (firstBits + secondBits) | InflateLiteralPair
+					| (first & 0xFF0000) | ((second & 0xFF0000) << 8);
+			}
+		}
+	}
+	
+	return true;
+}
+
+/// Bit buffer over the deflate stream. Copied into a local while decoding,
+/// so that the byte stores of the output can't alias it
+struct InflateBitReader
+{
+	const uint8_t *in;
+	const uint8_t *inEnd;
+	uint64_t bits = 0;
+	uint32_t numBits = 0;
+	uint32_t numPaddingBytes = 0; // zeros read past inEnd
+	
+	/// Fills the bit buffer to at least 56 bits
+	void Refill()
+	{
+		if (inEnd - in >= 8)
+		{
+			/// A whole little endian word, then only the bytes that fit.
+			/// The bits above numBits are those of the next bytes
+			uint64_t word;
+			std::memcpy(&word, in, 8);
+			bits |= word << numBits;
+			in += (63 - numBits) >> 3;
+			numBits |= 56;
+		}
+		else
+		{
+			for (; numBits < 56; numBits += 8)
+			{
+				if (in < inEnd)
+				{
+					bits |= uint64_t(*in++) << numBits;
+				}
+				else
+				{
+					numPaddingBytes++;
+				}
+			}
+		}
+	}
+	
+	uint32_t Read(uint32_t count)
+	{
+		uint32_t value = uint32_t(bits & ((uint64_t(1) << count) - 1));
+		bits >>= count;
+		numBits -= count;
+		return value;
+	}
+	
+	/// Decodes one code, the bit buffer has to hold at least 15 bits
+	uint32_t Decode(const uint32_t *table, uint32_t tableBits)
+	{
+		uint32_t entry = table[bits & ((1 << tableBits) - 1)];
+		if ((entry & inflateKindMask) == InflateSubtable)
+		{
+			bits >>= tableBits;
+			numBits -= tableBits;
+			uint32_t subtableMask = (1 << ((entry >> 8) & 15)) - 1;
+			entry = table[(entry >> 16) + (bits & subtableMask)];
+		}
+		
+		bits >>= entry & 31;
+		numBits -= entry & 31;
+		return entry;
+	}
+};
+
+inline bool IsInflateLiteral(uint32_t entry)
+{
+	return (entry & inflateKindMask) <= InflateLiteralPair;
+}
+
+/// Stores both bytes, single literals then only advance by one
+inline void WriteInflateLiteral(uint8_t *&out, uint32_t entry)
+{
+	out[0] = uint8_t(entry >> 16);
+	out[1] = uint8_t(entry >> 24);
+	out += 1 + ((entry & inflateKindMask) == InflateLiteralPair);
+}
+
+struct Inflater
+{
+	InflateBitReader input;
+	
+	uint8_t *outBegin;
+	uint8_t *out;
+	uint8_t *outEnd; // followed by inflateSlack writable bytes
+	
+	std::vector<uint32_t> literalTable;
+	std::vector<uint32_t> distanceTable;
+	std::vector<uint32_t> codeLengthTable;
+	
+	bool StoredBlock()
+	{
+		/// Back to whole bytes, then copy straight from the input
+		input.Read(input.numBits & 7);
+		uint32_t bufferedBytes = input.numBits / 8;
+		if (bufferedBytes < input.numPaddingBytes)
+		{
+			return false;
+		}
+		
+		const uint8_t *in = input.in - (bufferedBytes - input.numPaddingBytes);
+		if (input.inEnd - in < 4)
+		{
+			return false;
+		}
+		
+		uint32_t length = in[0] | (in[1] << 8);
+		uint32_t invertedLength = in[2] | (in[3] << 8);
+		in += 4;
+		
+		if (length != (~invertedLength & 0xFFFF)
+			|| size_t(input.inEnd - in) < length
+			|| size_t(outEnd - out) < length)
+		{
+			return false;
+		}
+		
+		std::memcpy(out, in, length);
+		out += length;
+		
+		input.in = in + length;
+		input.bits = 0;
+		input.numBits = 0;
+		input.numPaddingBytes = 0;
+		return true;
+	}
+	
+	bool FixedTables()
+	{
+		uint8_t lengths[288];
+		std::fill(lengths, lengths + 144, 8);
+		std::fill(lengths + 144, lengths + 256, 9);
+		std::fill(lengths + 256, lengths + 280, 7);
+		std::fill(lengths + 280, lengths + 288, 8);
+		
+		uint8_t distanceLengths[32];
+		std::fill(distanceLengths, distanceLengths + 32, 5);
+		
+		return BuildInflateTable(
+				lengths, 288, inflateLiteralBits,
+				InflateAlphabet::LiteralLengths, literalTable)
+			&& BuildInflateTable(
+				distanceLengths, 32, inflateDistanceBits,
+				InflateAlphabet::Distances, distanceTable);
+	}
+	
+	bool DynamicTables()
+	{
+		static const uint8_t order[19] = {
+			16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		
+		input.Refill();
+		uint32_t numLiteralCodes = input.Read(5) + 257;
+		uint32_t numDistanceCodes = input.Read(5) + 1;
+		uint32_t numCodeLengthCodes = input.Read(4) + 4;
+		if (numLiteralCodes > 286 || numDistanceCodes > 30)
+		{
+			return false;
+		}
+		
+		uint8_t codeLengthLengths[19] = { };
+		for (uint32_t i = 0; i < numCodeLengthCodes; i++)
+		{
+			input.Refill();
+			codeLengthLengths[order[i]] = uint8_t(input.Read(3));
+		}
+		
+		if (!BuildInflateTable(
+			codeLengthLengths, 19, inflateCodeLengthBits,
+			InflateAlphabet::CodeLengths, codeLengthTable))
+		{
+			return false;
+		}
+		
+		/// Literal/length and distance code lengths are one sequence
+		uint8_t lengths[286 + 30] = { };
+		const uint32_t numLengths = numLiteralCodes + numDistanceCodes;
+		for (uint32_t i = 0; i < numLengths; )
+		{
+			input.Refill();
+			uint32_t entry = input.Decode(codeLengthTable.data(), inflateCodeLengthBits);
+			if ((entry & inflateKindMask) != InflateLiteral)
+			{
+				return false;
+			}
+			
+			uint32_t symbol = entry >> 16;
+			uint32_t repeat;
+			uint8_t length = 0;
+			if (symbol < 16)
+			{
+				lengths[i++] = uint8_t(symbol);
+				continue;
+			}
+			else if (symbol == 16)
+			{
+				if (i == 0)
+				{
+					return false;
+				}
+				
+				length = lengths[i - 1];
+				repeat = 3 + input.Read(2);
+			}
+			else if (symbol == 17)
+			{
+				repeat = 3 + input.Read(3);
+			}
+			else
+			{
+				repeat = 11 + input.Read(7);
+			}
+			
+			if (repeat > numLengths - i)
+			{
+				return false;
+			}
+			
+			std::fill(lengths + i, lengths + i + repeat, length);
+			i += repeat;
+		}
+		
+		/// Blocks without an end are invalid
+		if (lengths[256] == 0)
+		{
+			return false;
+		}
+		
+		return BuildInflateTable(
+				lengths, numLiteralCodes, inflateLiteralBits,
+				InflateAlphabet::LiteralLengths, literalTable)
+			&& BuildInflateTable(
+				lengths + numLiteralCodes, numDistanceCodes, inflateDistanceBits,
+				InflateAlphabet::Distances, distanceTable);
+	}
+	
+	bool HuffmanBlock()
+	{
+		InflateBitReader reader = input;
+		uint8_t *out = this->out;
+		const uint32_t *literals = literalTable.data();
+		const uint32_t *distances = distanceTable.data();
+		
+		auto finish = [&](bool valid)
+		{
+			input = reader;
+			this->out = out;
+			return valid;
+		};
+		
+		for (;;)
+		{
+			reader.Refill();
+			uint32_t entry = reader.Decode(literals, inflateLiteralBits);
+			
+			/// Up to three literals or pairs per refill, 15 bits each at most
+			if (IsInflateLiteral(entry) && outEnd - out >= 6)
+			{
+				WriteInflateLiteral(out, entry);
+				entry = reader.Decode(literals, inflateLiteralBits);
+				if (IsInflateLiteral(entry))
+				{
+					WriteInflateLiteral(out, entry);
+					entry = reader.Decode(literals, inflateLiteralBits);
+					if (IsInflateLiteral(entry))
+					{
+						WriteInflateLiteral(out, entry);
+						continue;
+					}
+				}
+			}
+			
+			uint32_t kind = entry & inflateKindMask;
+			if (kind == InflateLiteral || kind == InflateLiteralPair)
+			{
+				size_t count = kind == InflateLiteral ? 1 : 2;
+				if (size_t(outEnd - out) < count)
+				{
+					return finish(false);
+				}
+				
+				out[0] = uint8_t(entry >> 16);
+				if (count == 2)
+				{
+					out[1] = uint8_t(entry >> 24);
+				}
+				out += count;
+				continue;
+			}
+			
+			if (kind == InflateEndOfBlock)
+			{
+				return finish(true);
+			}
+			
+			if (kind != InflateBase)
+			{
+				return finish(false);
+			}
+			
+			size_t length = (entry >> 16) + reader.Read((entry >> 8) & 15);
+			
+			/// The distance code and its extra bits take up to 28 bits
+			if (reader.numBits < 28)
+			{
+				reader.Refill();
+			}
+			
+			entry = reader.Decode(distances, inflateDistanceBits);
+			if ((entry & inflateKindMask) != InflateBase)
+			{
+				return finish(false);
+			}
+			
+			size_t distance = (entry >> 16) + reader.Read((entry >> 8) & 15);
+			if (distance > size_t(out - outBegin) || length > size_t(outEnd - out))
+			{
+				return finish(false);
+			}
+			
+			// Copy, in words that don't overlap their source
+			
+			const uint8_t *source = out - distance;
+			uint8_t *end = out + length;
+			if (distance >= 16)
+			{
+				do
+				{
+#ifdef SMORGASBORD_SSE2
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+#else
+					std::memcpy(out, source, 16);
+#endif
+					out += 16;
+					source += 16;
+				}
+				while (out < end);
+			}
+			else if (distance >= 8)
+			{
+				do
+				{
+					std::memcpy(out, source, 8);
+					out += 8;
+					source += 8;
+				}
+				while (out < end);
+			}
+			else if (distance == 1)
+			{
+				std::memset(out, out[-1], length);
+			}
+			else
+			{
+				/// Repeats of short patterns, e.g. pixels, are continued in
+				/// words from a whole number of periods back
+				size_t period = distance * ((8 + distance - 1) / distance);
+				size_t i = 0;
+				for (; i < length && i < period; i++)
+				{
+					out[i] = source[i];
+				}
+				
+				for (; i < length; i += 8)
+				{
+					std::memcpy(&out[i], &out[i - period], 8);
+				}
+			}
+			
+			out = end;
+		}
+	}
+	
+	bool Inflate()
+	{
+		for (bool last = false; !last; )
+		{
+			input.Refill();
+			last = input.Read(1) != 0;
+			
+			bool valid;
+			switch (input.Read(2))
+			{
+			case 0:
+				valid = StoredBlock();
+				break;
+			case 1:
+				valid = FixedTables() && HuffmanBlock();
+				break;
+			case 2:
+				valid = DynamicTables() && HuffmanBlock();
+				break;
+			default:
+				valid = false;
+				break;
+			}
+			
+			/// Zeros past the end of the input decode as something too
+			if (!valid || input.numPaddingBytes * 8 > input.numBits)
+			{
+				return false;
+			}
+		}
+		
+		/// The Adler-32 follows in whole bytes
+		input.Read(input.numBits & 7);
+		input.in -= input.numBits / 8 - input.numPaddingBytes;
+		return out == outEnd;
+	}
+};
+
+// Row filters
+
+inline uint8_t GetPNGPaethPredictor(int a, int b, int c)
+{
+	int pa = std::abs(b - c);
+	int pb = std::abs(a - c);
+	int pc = std::abs(a + b - 2 * c);
+	return uint8_t(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+#ifdef SMORGASBORD_SSE2
+
+/// 3 byte pixels are put together in registers, a memcpy() into a word
+/// goes through the stack and stalls store forwarding on every pixel
+template<uint32_t bpp>
+inline __m128i LoadPNGPixel(const uint8_t *p)
+{
+	uint32_t value;
+	if (bpp == 4)
+	{
+		std::memcpy(&value, p, 4);
+	}
+	else
+	{
+		value = p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16);
+	}
+	return _mm_cvtsi32_si128(int(value));
+}
+
+template<uint32_t bpp>
+inline void StorePNGPixel(uint8_t *p, __m128i v)
+{
+	uint32_t value = uint32_t(_mm_cvtsi128_si32(v));
+	if (bpp == 4)
+	{
+		std::memcpy(p, &value, 4);
+	}
+	else
+	{
+		p[0] = uint8_t(value);
+		p[1] = uint8_t(value >> 8);
+		p[2] = uint8_t(value >> 16);
+	}
+}
+
+/// Sub, Avg and Paeth depend on the pixel before, so only the channels of
+/// one pixel are processed in parallel
+template<uint32_t bpp>
+static void UnfilterPNGRowSSE2(
+	uint8_t *out,
+	const uint8_t *in,
+	const uint8_t *prior,
+	size_t size,
+	uint8_t type)
+{
+	const __m128i zero = _mm_setzero_si128();
+	
+	if (type == 1) // Sub
+	{
+		__m128i a = zero;
+		for (size_t i = 0; i < size; i += bpp)
+		{
+			a = _mm_add_epi8(a, LoadPNGPixel<bpp>(&in[i]));
+			StorePNGPixel<bpp>(&out[i], a);
+		}
+	}
+	else if (type == 3) // Avg
+	{
+		const __m128i one = _mm_set1_epi8(1);
+		__m128i a = zero;
+		for (size_t i = 0; i < size; i += bpp)
+		{
+			__m128i b = LoadPNGPixel<bpp>(&prior[i]);
+			/// avg_epu8 rounds up, the filter rounds down
+			__m128i average = _mm_sub_epi8(
+				_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+			a = _mm_add_epi8(LoadPNGPixel<bpp>(&in[i]), average);
+			StorePNGPixel<bpp>(&out[i], a);
+		}
+	}
+	else // Paeth
+	{
+		/// In 16 bit lanes, the differences need 9 bits
+		__m128i a = zero;
+		__m128i c = zero;
+		for (size_t i = 0; i < size; i += bpp)
+		{
+			__m128i b = _mm_unpacklo_epi8(LoadPNGPixel<bpp>(&prior[i]), zero);
+			__m128i d = _mm_unpacklo_epi8(LoadPNGPixel<bpp>(&in[i]), zero);
+			
+			__m128i pa = _mm_sub_epi16(b, c); // p - a
+			__m128i pb = _mm_sub_epi16(a, c); // p - b
+			__m128i pc = _mm_add_epi16(pa, pb); // p - c
+			pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+			pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+			pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+			
+			/// Ties prefer a, then b
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i isA = _mm_cmpeq_epi16(smallest, pa);
+			__m128i isB = _mm_cmpeq_epi16(smallest, pb);
+			__m128i bOrC = _mm_or_si128(
+				_mm_and_si128(isB, b), _mm_andnot_si128(isB, c));
+			__m128i predictor = _mm_or_si128(
+				_mm_and_si128(isA, a), _mm_andnot_si128(isA, bOrC));
+			
+			/// Byte adds wrap modulo 256 and leave the zero high bytes
+			d = _mm_add_epi8(d, predictor);
+			StorePNGPixel<bpp>(&out[i], _mm_packus_epi16(d, d));
+			
+			a = d;
+			c = b;
+		}
+	}
+}
+
+#endif
+
+/// Reverses the filter of a row. out may be in, prior is the previous
+/// unfiltered row, zeros for the first one
+static bool UnfilterPNGRow(
+	uint8_t *out,
+	const uint8_t *in,
+	const uint8_t *prior,
+	size_t size,
+	uint32_t bpp,
+	uint8_t type)
+{
+	size_t i = 0;
+	
+	switch (type)
+	{
+	case 0: // None
+		if (out != in)
+		{
+			std::memcpy(out, in, size);
+		}
+		return true;
+	
+	case 2: // Up
+#ifdef SMORGASBORD_AVX2
+		for (; i + 32 <= size; i += 32)
+		{
+			__m256i sum = _mm256_add_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in[i])),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&prior[i])));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), sum);
+		}
+#endif
+#ifdef SMORGASBORD_SSE2
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i sum = _mm_add_epi8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[i])),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(&prior[i])));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), sum);
+		}
+#endif
+		for (; i < size; i++)
+		{
+			out[i] = uint8_t(in[i] + prior[i]);
+		}
+		return true;
+	
+	case 1: // Sub
+	case 3: // Avg
+	case 4: // Paeth
+#ifdef SMORGASBORD_SSE2
+		if (bpp == 3)
+		{
+			UnfilterPNGRowSSE2<3>(out, in, prior, size, type);
+			return true;
+		}
+		else if (bpp == 4)
+		{
+			UnfilterPNGRowSSE2<4>(out, in, prior, size, type);
+			return true;
+		}
+#endif
+		break;
+	
+	default:
+		return false;
+	}
+	
+	/// The first pixel has no left neighbor
+	for (; i < bpp && i < size; i++)
+	{
+		out[i] = uint8_t(in[i] + (type == 1 ? 0 : type == 3 ? prior[i] / 2 : prior[i]));
+	}
+	
+	if (type == 1)
+	{
+		for (; i < size; i++)
+		{
+			out[i] = uint8_t(in[i] + out[i - bpp]);
+		}
+	}
+	else if (type == 3)
+	{
+		for (; i < size; i++)
+		{
+			out[i] = uint8_t(in[i] + ((out[i - bpp] + prior[i]) >> 1));
+		}
+	}
+	else
+	{
+		for (; i < size; i++)
+		{
+			out[i] = uint8_t(in[i] + GetPNGPaethPredictor(
+				out[i - bpp], prior[i], prior[i - bpp]));
+		}
+	}
+	
+	return true;
+}
+
+// Conversion to RGBA
+
+static void ExpandPNGRGB(uint8_t *out, const uint8_t *in, size_t width)
+{
+	size_t x = 0;
+
+#ifdef SMORGASBORD_SSE41
+	/// Reads 4 bytes past the 12 it uses, there is always data after a row
+	const __m128i shuffle = _mm_setr_epi8(
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x * 3]));
+		__m128i rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[x * 4]), rgba);
+	}
+#endif
+	
+	for (; x < width; x++)
+	{
+		out[x * 4 + 0] = in[x * 3 + 0];
+		out[x * 4 + 1] = in[x * 3 + 1];
+		out[x * 4 + 2] = in[x * 3 + 2];
+		out[x * 4 + 3] = 255;
+	}
+}
+
+/// Returns false for palette indices out of the palette
+static bool ExpandPNGRow(
+	uint8_t *out,
+	const uint8_t *in,
+	size_t width,
+	uint8_t colorType,
+	const uint32_t *palette,
+	uint32_t paletteSize)
+{
+	switch (colorType)
+	{
+	case 0: // gray
+		for (size_t x = 0; x < width; x++)
+		{
+			uint32_t pixel = in[x] * 0x010101u | 0xFF000000u;
+			std::memcpy(&out[x * 4], &pixel, 4);
+		}
+		break;
+	
+	case 2: // RGB
+		ExpandPNGRGB(out, in, width);
+		break;
+	
+	case 3: // palette
+	{
+		uint8_t maxIndex = 0;
+		for (size_t x = 0; x < width; x++)
+		{
+			maxIndex = std::max(maxIndex, in[x]);
+			std::memcpy(&out[x * 4], &palette[in[x]], 4);
+		}
+		
+		return maxIndex < paletteSize;
+	}
+	
+	case 4: // gray + alpha
+		for (size_t x = 0; x < width; x++)
+		{
+			uint32_t pixel = in[x * 2] * 0x010101u | (uint32_t(in[x * 2 + 1]) << 24);
+			std::memcpy(&out[x * 4], &pixel, 4);
+		}
+		break;
+	}
+	
+	return true;
+}
+
+// PNG
+
+inline uint32_t ReadPNGUInt32(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16)
+		| (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+bool Smorgasbord::DecodePNG(const uint8_t *data, size_t size, Image &image)
+{
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (data == nullptr || size < 8 + 25 || std::memcmp(data, signature, 8) != 0)
+	{
+		return false;
+	}
+	
+	// Chunks
+	
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t colorType = 0;
+	
+	uint32_t palette[256]; // RGBA, little endian
+	uint32_t paletteSize = 0;
+	std::fill(palette, palette + 256, 0xFF000000u);
+	
+	std::vector<std::pair<const uint8_t*, size_t>> idat;
+	bool ended = false;
+	
+	for (size_t offset = 8; !ended; )
+	{
+		if (size - offset < 12)
+		{
+			return false;
+		}
+		
+		uint32_t length = ReadPNGUInt32(&data[offset]);
+		const uint8_t *type = &data[offset + 4];
+		const uint8_t *chunk = &data[offset + 8];
+		if (length > size - offset - 12)
+		{
+			return false;
+		}
+		
+		/// IHDR comes first, and only there
+		if ((offset == 8) != (std::memcmp(type, "IHDR", 4) == 0))
+		{
+			return false;
+		}
+		offset += size_t(length) + 12;
+		
+		if (std::memcmp(type, "IHDR", 4) == 0)
+		{
+			/// 8 bit depth, deflate, standard filters, not interlaced
+			width = ReadPNGUInt32(chunk);
+			height = ReadPNGUInt32(chunk + 4);
+			colorType = chunk[9];
+			if (length != 13 || chunk[8] != 8
+				|| (colorType != 0 && colorType != 2 && colorType != 3
+					&& colorType != 4 && colorType != 6)
+				|| chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0
+				|| width == 0 || height == 0 || width > 0x10000 || height > 0x10000)
+			{
+				return false;
+			}
+		}
+		else if (std::memcmp(type, "PLTE", 4) == 0)
+		{
+			if (length % 3 != 0 || length > 256 * 3)
+			{
+				return false;
+			}
+			
+			paletteSize = length / 3;
+			for (uint32_t i = 0; i < paletteSize; i++)
+			{
+				palette[i] = chunk[i * 3] | (chunk[i * 3 + 1] << 8)
+					| (chunk[i * 3 + 2] << 16) | 0xFF000000u;
+			}
+		}
+		else if (std::memcmp(type, "tRNS", 4) == 0)
+		{
+			/// Color keys of other color types are left to lodepng
+			if (colorType != 3 || length > paletteSize)
+			{
+				return false;
+			}
+			
+			for (uint32_t i = 0; i < length; i++)
+			{
+				palette[i] = (palette[i] & 0xFFFFFF) | (uint32_t(chunk[i]) << 24);
+			}
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			idat.emplace_back(chunk, length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0)
+		{
+			ended = true;
+		}
+		else if ((type[0] & 32) == 0)
+		{
+			/// Unknown critical chunk
+			return false;
+		}
+	}
+	
+	if (idat.empty() || (colorType == 3 && paletteSize == 0))
+	{
+		return false;
+	}
+	
+	// zlib stream, contiguous
+	
+	std::vector<uint8_t> joined;
+	const uint8_t *zlib = idat[0].first;
+	size_t zlibSize = idat[0].second;
+	if (idat.size() > 1)
+	{
+		size_t joinedSize = 0;
+		for (auto &chunk : idat)
+		{
+			joinedSize += chunk.second;
+		}
+		
+		joined.resize(joinedSize);
+		size_t offset = 0;
+		for (auto &chunk : idat)
+		{
+			std::memcpy(&joined[offset], chunk.first, chunk.second);
+			offset += chunk.second;
+		}
+		
+		zlib = joined.data();
+		zlibSize = joinedSize;
+	}
+	
+	/// Deflate without a preset dictionary
+	if (zlibSize < 6
+		|| (zlib[0] & 15) != 8 || (zlib[0] >> 4) > 7
+		|| ((zlib[0] << 8) | zlib[1]) % 31 != 0
+		|| (zlib[1] & 32) != 0)
+	{
+		return false;
+	}
+	
+	const uint32_t bpp =
+		colorType == 0 || colorType == 3 ? 1
+		: colorType == 4 ? 2
+		: colorType == 2 ? 3
+		: 4;
+	const size_t rowSize = size_t(width) * bpp;
+	const size_t filteredSize = (rowSize + 1) * height;
+	
+	std::vector<uint8_t> filtered(filteredSize + inflateSlack);
+	
+	Inflater inflater;
+	inflater.input.in = zlib + 2;
+	inflater.input.inEnd = zlib + zlibSize;
+	inflater.outBegin = filtered.data();
+	inflater.out = filtered.data();
+	inflater.outEnd = filtered.data() + filteredSize;
+	
+	if (!inflater.Inflate()
+		|| inflater.input.inEnd - inflater.input.in < 4
+		|| ReadPNGUInt32(inflater.input.in) != Smorgasbord::GetAdler32(filtered.data(), filteredSize))
+	{
+		return false;
+	}
+	
+	// Rows
+	
+	/// Decoded aside, so that image stays untouched if a row turns out
+	/// to be invalid
+	std::vector<uint8_t> pixels(size_t(width) * height * 4);
+	
+	const std::vector<uint8_t> zeros(rowSize, 0);
+	for (size_t y = 0; y < height; y++)
+	{
+		uint8_t *row = &filtered[y * (rowSize + 1)];
+		uint8_t *out = &pixels[y * width * 4];
+		
+		/// RGBA rows go straight to the image, others are unfiltered in
+		/// place and converted
+		if (colorType == 6)
+		{
+			const uint8_t *prior = y > 0 ? out - rowSize : zeros.data();
+			if (!UnfilterPNGRow(out, row + 1, prior, rowSize, bpp, row[0]))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			const uint8_t *prior = y > 0 ? row - rowSize : zeros.data();
+			if (!UnfilterPNGRow(row + 1, row + 1, prior, rowSize, bpp, row[0])
+				|| !ExpandPNGRow(out, row + 1, width, colorType, palette, paletteSize))
+			{
+				return false;
+			}
+		}
+	}
+	
+	image.imageSize = glm::uvec2(width, height);
+	image.pixelSize = 4;
+	image.data = std::move(pixels);
+	image.UpdateCached();
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+
+Fast PNG decoding
+-----------------
+
+DecodePNG() decodes the common PNG variants straight into an RGBA Image:
+8 bit gray, gray + alpha, RGB, RGBA and palette images, not interlaced.
+It returns false for everything else and for invalid files, leaving image
+as it was, and LoadImagePNG() then falls back to lodepng, which handles
+every variant and reports the errors.
+
+Compared to lodepng it
+	- inflates with lookup tables that decode a whole code, or two short
+	  literals at once, from a 64 bit bit buffer refilled a word at a time
+	- copies matches in 8 and 16 byte words
+	- reverses the row filters with SSE2 for 3 and 4 byte pixels, AVX2 for Up
+	- unfilters RGBA rows directly into the image
+Chunk CRCs are not checked, the Adler-32 of the zlib stream still covers
+the image data.
+
+*/
+
+namespace Smorgasbord {
+
+class Image;
+
+bool DecodePNG(const uint8_t *data, size_t size, Image &image);
+
+}
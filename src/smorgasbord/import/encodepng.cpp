@@ -0,0 +1,1092 @@
+#include "encodepng.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/checksum.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <lodepng/lodepng.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Deflate
+
+/// Filtered bytes deflated by one task
+const size_t deflateChunkSize = 256 * 1024;
+const size_t deflateWindowSize = 32768;
+const uint32_t deflateHashBits = 15;
+const size_t deflateBlockSymbols = 16384;
+const uint32_t deflateMaxMatch = 258;
+
+/// The parameters of zlib's levels
+struct DeflateLevel
+{
+	uint32_t goodLength; // search less after a match this long
+	uint32_t maxLazy; // don't look for a longer one after this, or, if not
+		// lazy, don't insert the positions of longer matches
+	uint32_t niceLength; // stop searching
+	uint32_t maxChain; // match candidates tried per position
+	bool lazy; // try a longer match at the next position first
+};
+
+const DeflateLevel deflateLevels[10] = {
+	{ 0, 0, 0, 0, false }, // stored
+	{ 4, 4, 8, 4, false },
+	{ 4, 5, 16, 8, false },
+	{ 4, 6, 32, 32, false },
+	{ 4, 4, 16, 16, true },
+	{ 8, 16, 32, 32, true },
+	{ 8, 16, 128, 128, true },
+	{ 8, 32, 128, 256, true },
+	{ 32, 128, 258, 1024, true },
+	{ 32, 258, 258, 4096, true } };
+
+const uint16_t deflateLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t deflateLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t deflateDistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+const uint8_t deflateDistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/// Symbols of match lengths and distances
+struct DeflateSymbolTables
+{
+	uint8_t lengthSymbols[deflateMaxMatch + 1]; // minus 257
+	/// Distance - 1 below 256, else 256 + ((distance - 1) >> 7)
+	uint8_t distanceSymbols[512];
+	
+	DeflateSymbolTables()
+	{
+		for (uint8_t s = 0; s < 29; s++)
+		{
+			uint32_t end = s == 28 ? 259 : deflateLengthBase[s + 1];
+			for (uint32_t length = deflateLengthBase[s]; length < end; length++)
+			{
+				lengthSymbols[length] = s;
+			}
+		}
+		
+		for (uint8_t s = 0; s < 30; s++)
+		{
+			uint32_t end = deflateDistanceBase[s] + (1 << deflateDistanceExtra[s]);
+			for (uint32_t distance = deflateDistanceBase[s]; distance < end; distance++)
+			{
+				uint32_t d = distance - 1;
+				distanceSymbols[d < 256 ? d : 256 + (d >> 7)] = s;
+			}
+		}
+	}
+	
+	uint32_t GetDistanceSymbol(uint32_t distance) const
+	{
+		uint32_t d = distance - 1;
+		return distanceSymbols[d < 256 ? d : 256 + (d >> 7)];
+	}
+};
+
+static const DeflateSymbolTables &GetDeflateSymbolTables()
+{
+	static const DeflateSymbolTables tables;
+	return tables;
+}
+
+struct DeflateSymbol
+{
+	uint16_t lengthOrLiteral;
+	uint16_t distance; // 0 for literals
+};
+
+struct DeflateBitWriter
+{
+	std::vector<uint8_t> &out;
+	uint64_t bits = 0;
+	uint32_t numBits = 0;
+	
+	DeflateBitWriter(std::vector<uint8_t> &out)
+		: out(out)
+	{ }
+	
+	/// Deflate packs bits starting with the least significant one
+	void Write(uint32_t value, uint32_t count)
+	{
+		bits |= uint64_t(value) << numBits;
+		numBits += count;
+		if (numBits >= 32)
+		{
+			uint8_t word[4] = {
+				uint8_t(bits), uint8_t(bits >> 8), uint8_t(bits >> 16), uint8_t(bits >> 24) };
+			out.insert(out.end(), word, word + 4);
+			bits >>= 32;
+			numBits -= 32;
+		}
+	}
+	
+	/// Pads to a whole byte and writes out every bit
+	void Align()
+	{
+		for (; numBits > 0; numBits = numBits > 8 ? numBits - 8 : 0)
+		{
+			out.push_back(uint8_t(bits));
+			bits >>= 8;
+		}
+		bits = 0;
+	}
+};
+
+/// Canonical codes, bit reversed for DeflateBitWriter
+static void AssignDeflateCodes(const uint8_t *lengths, uint32_t count, uint16_t *codes)
+{
+	uint32_t lengthCounts[16] = { };
+	for (uint32_t i = 0; i < count; i++)
+	{
+		lengthCounts[lengths[i]]++;
+	}
+	lengthCounts[0] = 0;
+	
+	uint32_t nextCode[16] = { };
+	for (uint32_t length = 1; length < 16; length++)
+	{
+		nextCode[length] = (nextCode[length - 1] + lengthCounts[length - 1]) << 1;
+	}
+	
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t code = nextCode[lengths[i]]++;
+		uint32_t reversed = 0;
+		for (uint32_t b = 0; b < lengths[i]; b++)
+		{
+			reversed |= ((code >> b) & 1) << (lengths[i] - 1 - b);
+		}
+		codes[i] = uint16_t(reversed);
+	}
+}
+
+/// Huffman code lengths of at most maxLength bits
+static void BuildDeflateCode(
+	const uint32_t *frequencies,
+	uint32_t count,
+	uint32_t maxLength,
+	uint8_t *lengths,
+	uint16_t *codes)
+{
+	std::fill(lengths, lengths + count, 0);
+	
+	std::vector<uint32_t> symbols;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (frequencies[i] > 0)
+		{
+			symbols.push_back(i);
+		}
+	}
+	
+	std::stable_sort(symbols.begin(), symbols.end(), [&](uint32_t a, uint32_t b)
+	{
+		return frequencies[a] < frequencies[b];
+	});
+	
+	const size_t n = symbols.size();
+	if (n == 1)
+	{
+		lengths[symbols[0]] = 1;
+	}
+	else if (n > 1)
+	{
+		/// Leaves sorted by frequency and internal nodes, which are created
+		/// in order of weight, form two queues to merge from
+		std::vector<uint64_t> weights(2 * n - 1);
+		std::vector<uint32_t> parents(2 * n - 1);
+		for (size_t i = 0; i < n; i++)
+		{
+			weights[i] = frequencies[symbols[i]];
+		}
+		
+		size_t leaf = 0;
+		size_t node = n;
+		auto pop = [&](size_t created)
+		{
+			if (leaf < n && (node >= created || weights[leaf] <= weights[node]))
+			{
+				return leaf++;
+			}
+			return node++;
+		};
+		
+		for (size_t created = n; created < 2 * n - 1; created++)
+		{
+			size_t a = pop(created);
+			size_t b = pop(created);
+			weights[created] = weights[a] + weights[b];
+			parents[a] = uint32_t(created);
+			parents[b] = uint32_t(created);
+		}
+		
+		/// Parents come after their children, the root is last
+		std::vector<uint32_t> depths(2 * n - 1, 0);
+		uint32_t lengthCounts[64] = { };
+		for (size_t i = 2 * n - 1; i-- > 0; )
+		{
+			if (i < 2 * n - 2)
+			{
+				depths[i] = depths[parents[i]] + 1;
+			}
+			
+			if (i < n)
+			{
+				lengthCounts[std::min<uint32_t>(depths[i], 63)]++;
+			}
+		}
+		
+		/// Limit the lengths: move codes down to maxLength, then, while the
+		/// code is over-subscribed, replace a maxLength code by splitting a
+		/// shorter one
+		for (uint32_t length = maxLength + 1; length < 64; length++)
+		{
+			lengthCounts[maxLength] += lengthCounts[length];
+			lengthCounts[length] = 0;
+		}
+		
+		uint64_t total = 0;
+		for (uint32_t length = 1; length <= maxLength; length++)
+		{
+			total += uint64_t(lengthCounts[length]) << (maxLength - length);
+		}
+		
+		for (; total > (uint64_t(1) << maxLength); total--)
+		{
+			lengthCounts[maxLength]--;
+			for (uint32_t length = maxLength - 1; length > 0; length--)
+			{
+				if (lengthCounts[length] > 0)
+				{
+					lengthCounts[length]--;
+					lengthCounts[length + 1] += 2;
+					break;
+				}
+			}
+		}
+		
+		/// The rarest symbols get the longest codes
+		size_t i = 0;
+		for (uint32_t length = maxLength; length > 0; length--)
+		{
+			for (uint32_t c = 0; c < lengthCounts[length]; c++)
+			{
+				lengths[symbols[i++]] = uint8_t(length);
+			}
+		}
+	}
+	
+	AssignDeflateCodes(lengths, count, codes);
+}
+
+/// Writes symbols as a dynamic, fixed or stored block, whichever is
+/// smallest. raw are the bytes the symbols encode
+static void WriteDeflateBlock(
+	DeflateBitWriter &writer,
+	const std::vector<DeflateSymbol> &symbols,
+	const uint8_t *raw,
+	size_t rawSize,
+	bool final)
+{
+	const DeflateSymbolTables &tables = GetDeflateSymbolTables();
+	
+	uint32_t literalFrequencies[286] = { };
+	uint32_t distanceFrequencies[30] = { };
+	for (const DeflateSymbol &symbol : symbols)
+	{
+		if (symbol.distance == 0)
+		{
+			literalFrequencies[symbol.lengthOrLiteral]++;
+		}
+		else
+		{
+			literalFrequencies[257 + tables.lengthSymbols[symbol.lengthOrLiteral]]++;
+			distanceFrequencies[tables.GetDistanceSymbol(symbol.distance)]++;
+		}
+	}
+	literalFrequencies[256] = 1;
+	
+	/// At least two codes, as some decoders reject codes of one
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		distanceFrequencies[i] = std::max<uint32_t>(distanceFrequencies[i], 1);
+	}
+	
+	/// 288 for the fixed code, which assigns codes to 286 and 287 too
+	uint8_t literalLengths[288];
+	uint16_t literalCodes[288];
+	uint8_t distanceLengths[30];
+	uint16_t distanceCodes[30];
+	BuildDeflateCode(literalFrequencies, 286, 15, literalLengths, literalCodes);
+	BuildDeflateCode(distanceFrequencies, 30, 15, distanceLengths, distanceCodes);
+	
+	// Code lengths, run length encoded
+	
+	uint32_t numLiteralCodes = 286;
+	while (numLiteralCodes > 257 && literalLengths[numLiteralCodes - 1] == 0)
+	{
+		numLiteralCodes--;
+	}
+	
+	uint32_t numDistanceCodes = 30;
+	while (numDistanceCodes > 1 && distanceLengths[numDistanceCodes - 1] == 0)
+	{
+		numDistanceCodes--;
+	}
+	
+	uint8_t allLengths[286 + 30];
+	std::memcpy(allLengths, literalLengths, numLiteralCodes);
+	std::memcpy(allLengths + numLiteralCodes, distanceLengths, numDistanceCodes);
+	const uint32_t numLengths = numLiteralCodes + numDistanceCodes;
+	
+	/// Symbol in the low byte, extra bits value above
+	std::vector<uint32_t> lengthSymbols;
+	auto emit = [&](uint32_t symbol, uint32_t extra)
+	{
+		lengthSymbols.push_back(symbol | (extra << 8));
+	};
+	
+	for (uint32_t i = 0; i < numLengths; )
+	{
+		uint8_t length = allLengths[i];
+		uint32_t run = 1;
+		while (i + run < numLengths && allLengths[i + run] == length)
+		{
+			run++;
+		}
+		i += run;
+		
+		if (length == 0)
+		{
+			for (; run >= 11; )
+			{
+				uint32_t repeat = std::min<uint32_t>(run, 138);
+				emit(18, repeat - 11);
+				run -= repeat;
+			}
+			
+			if (run >= 3)
+			{
+				emit(17, run - 3);
+				run = 0;
+			}
+		}
+		else
+		{
+			emit(length, 0);
+			run--;
+			for (; run >= 3; )
+			{
+				uint32_t repeat = std::min<uint32_t>(run, 6);
+				emit(16, repeat - 3);
+				run -= repeat;
+			}
+		}
+		
+		for (; run > 0; run--)
+		{
+			emit(length, 0);
+		}
+	}
+	
+	static const uint8_t lengthOrder[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	static const uint8_t lengthExtraBits[19] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+	
+	uint32_t codeLengthFrequencies[19] = { };
+	for (uint32_t symbol : lengthSymbols)
+	{
+		codeLengthFrequencies[symbol & 0xFF]++;
+	}
+	
+	uint8_t codeLengthLengths[19];
+	uint16_t codeLengthCodes[19];
+	BuildDeflateCode(codeLengthFrequencies, 19, 7, codeLengthLengths, codeLengthCodes);
+	
+	uint32_t numCodeLengthCodes = 19;
+	while (numCodeLengthCodes > 4
+		&& codeLengthLengths[lengthOrder[numCodeLengthCodes - 1]] == 0)
+	{
+		numCodeLengthCodes--;
+	}
+	
+	// Sizes of the block types, in bits
+	
+	uint8_t fixedLengths[288];
+	std::fill(fixedLengths, fixedLengths + 144, 8);
+	std::fill(fixedLengths + 144, fixedLengths + 256, 9);
+	std::fill(fixedLengths + 256, fixedLengths + 280, 7);
+	std::fill(fixedLengths + 280, fixedLengths + 288, 8);
+	
+	uint64_t dynamicSize = 3 + 14 + 3 * numCodeLengthCodes;
+	uint64_t fixedSize = 3;
+	for (uint32_t symbol : lengthSymbols)
+	{
+		dynamicSize += codeLengthLengths[symbol & 0xFF] + lengthExtraBits[symbol & 0xFF];
+	}
+	
+	for (uint32_t s = 0; s < 286; s++)
+	{
+		uint32_t extra = s > 256 ? deflateLengthExtra[s - 257] : 0;
+		dynamicSize += uint64_t(literalFrequencies[s]) * (literalLengths[s] + extra);
+		fixedSize += uint64_t(literalFrequencies[s]) * (fixedLengths[s] + extra);
+	}
+	
+	for (uint32_t s = 0; s < 30; s++)
+	{
+		/// Without the two codes forced above
+		uint64_t frequency = distanceFrequencies[s];
+		if (s < 2)
+		{
+			frequency = 0;
+			for (const DeflateSymbol &symbol : symbols)
+			{
+				frequency += symbol.distance != 0
+					&& tables.GetDistanceSymbol(symbol.distance) == s;
+			}
+		}
+		
+		dynamicSize += frequency * (distanceLengths[s] + deflateDistanceExtra[s]);
+		fixedSize += frequency * (5 + deflateDistanceExtra[s]);
+	}
+	
+	const size_t numStoredBlocks = std::max<size_t>((rawSize + 65534) / 65535, 1);
+	uint64_t storedSize = 7 + rawSize * 8 + numStoredBlocks * 40;
+	
+	// Stored
+	
+	/// Without symbols the raw bytes are stored as they are, for level 0
+	if (symbols.empty() || (storedSize <= dynamicSize && storedSize <= fixedSize))
+	{
+		for (size_t b = 0; b < numStoredBlocks; b++)
+		{
+			size_t offset = b * 65535;
+			uint32_t size = uint32_t(std::min<size_t>(rawSize - offset, 65535));
+			writer.Write(final && b + 1 == numStoredBlocks, 1);
+			writer.Write(0, 2);
+			writer.Align();
+			
+			uint8_t header[4] = {
+				uint8_t(size), uint8_t(size >> 8),
+				uint8_t(~size), uint8_t(~size >> 8) };
+			writer.out.insert(writer.out.end(), header, header + 4);
+			writer.out.insert(writer.out.end(), raw + offset, raw + offset + size);
+		}
+		
+		return;
+	}
+	
+	// Huffman codes
+	
+	writer.Write(final, 1);
+	if (fixedSize <= dynamicSize)
+	{
+		writer.Write(1, 2);
+		
+		uint8_t fixedDistanceLengths[30];
+		std::fill(fixedDistanceLengths, fixedDistanceLengths + 30, 5);
+		AssignDeflateCodes(fixedLengths, 288, literalCodes);
+		AssignDeflateCodes(fixedDistanceLengths, 30, distanceCodes);
+		std::memcpy(literalLengths, fixedLengths, 288);
+		std::memcpy(distanceLengths, fixedDistanceLengths, 30);
+	}
+	else
+	{
+		writer.Write(2, 2);
+		writer.Write(numLiteralCodes - 257, 5);
+		writer.Write(numDistanceCodes - 1, 5);
+		writer.Write(numCodeLengthCodes - 4, 4);
+		for (uint32_t i = 0; i < numCodeLengthCodes; i++)
+		{
+			writer.Write(codeLengthLengths[lengthOrder[i]], 3);
+		}
+		
+		for (uint32_t symbol : lengthSymbols)
+		{
+			uint32_t s = symbol & 0xFF;
+			writer.Write(codeLengthCodes[s], codeLengthLengths[s]);
+			writer.Write(symbol >> 8, lengthExtraBits[s]);
+		}
+	}
+	
+	for (const DeflateSymbol &symbol : symbols)
+	{
+		if (symbol.distance == 0)
+		{
+			uint32_t s = symbol.lengthOrLiteral;
+			writer.Write(literalCodes[s], literalLengths[s]);
+			continue;
+		}
+		
+		uint32_t length = symbol.lengthOrLiteral;
+		uint32_t s = tables.lengthSymbols[length];
+		writer.Write(literalCodes[257 + s], literalLengths[257 + s]);
+		writer.Write(length - deflateLengthBase[s], deflateLengthExtra[s]);
+		
+		uint32_t distance = symbol.distance;
+		s = tables.GetDistanceSymbol(distance);
+		writer.Write(distanceCodes[s], distanceLengths[s]);
+		writer.Write(distance - deflateDistanceBase[s], deflateDistanceExtra[s]);
+	}
+	
+	writer.Write(literalCodes[256], literalLengths[256]);
+}
+
+/// Deflates data[begin, end), with data[0, begin) as the dictionary
+/// matches may refer to. A chunk which is not final ends with an empty
+/// stored block, so that it ends on a whole byte
+static void DeflatePNGChunk(
+	const uint8_t *data,
+	size_t begin,
+	size_t end,
+	const DeflateLevel &level,
+	bool final,
+	std::vector<uint8_t> &out)
+{
+	DeflateBitWriter writer(out);
+	std::vector<DeflateSymbol> symbols;
+	symbols.reserve(deflateBlockSymbols);
+	
+	size_t blockBegin = begin;
+	size_t emitted = begin; // raw bytes covered by symbols
+	
+	auto flush = [&](bool finalBlock)
+	{
+		WriteDeflateBlock(
+			writer, symbols, &data[blockBegin], emitted - blockBegin, finalBlock);
+		symbols.clear();
+		blockBegin = emitted;
+	};
+	
+	auto emitLiteral = [&](size_t position)
+	{
+		symbols.push_back({ data[position], 0 });
+		emitted = position + 1;
+		if (symbols.size() == deflateBlockSymbols)
+		{
+			flush(false);
+		}
+	};
+	
+	auto emitMatch = [&](size_t position, uint32_t length, uint32_t distance)
+	{
+		symbols.push_back({ uint16_t(length), uint16_t(distance) });
+		emitted = position + length;
+		if (symbols.size() == deflateBlockSymbols)
+		{
+			flush(false);
+		}
+	};
+	
+	if (level.maxChain == 0)
+	{
+		emitted = end;
+	}
+	else
+	{
+		// Hash chains over 3 byte prefixes, including the dictionary
+		
+		std::vector<int32_t> head(size_t(1) << deflateHashBits, -1);
+		std::vector<int32_t> previous(end);
+		
+		auto hash = [&](size_t position)
+		{
+			uint32_t prefix = data[position]
+				| (data[position + 1] << 8) | (data[position + 2] << 16);
+			return (prefix * 2654435761u) >> (32 - deflateHashBits);
+		};
+		
+		auto insert = [&](size_t position)
+		{
+			if (position + 2 < end)
+			{
+				uint32_t h = hash(position);
+				previous[position] = head[h];
+				head[h] = int32_t(position);
+			}
+		};
+		
+		for (size_t p = 0; p < begin; p++)
+		{
+			insert(p);
+		}
+		
+		/// Longest match at position longer than minLength, from the
+		/// positions inserted before
+		auto findMatch = [&](size_t position, uint32_t minLength, uint32_t &distance)
+		{
+			uint32_t maxLength = uint32_t(std::min<size_t>(deflateMaxMatch, end - position));
+			if (maxLength < 3)
+			{
+				return uint32_t(0);
+			}
+			
+			const uint8_t *a = &data[position];
+			const int64_t limit = int64_t(position) - int64_t(deflateWindowSize);
+			uint32_t best = std::max<uint32_t>(minLength, 2);
+			if (best >= maxLength)
+			{
+				return uint32_t(0);
+			}
+			
+			uint32_t chain = minLength >= level.goodLength ? level.maxChain >> 2 : level.maxChain;
+			int64_t candidate = head[hash(position)];
+			
+			for (; candidate > limit && candidate >= 0 && chain > 0; chain--)
+			{
+				const uint8_t *b = &data[candidate];
+				if (b[best] == a[best] && b[best - 1] == a[best - 1]
+					&& b[0] == a[0] && b[1] == a[1])
+				{
+					uint32_t length = 0;
+					for (; length + 8 <= maxLength; length += 8)
+					{
+						uint64_t x, y;
+						std::memcpy(&x, a + length, 8);
+						std::memcpy(&y, b + length, 8);
+						if (x != y)
+						{
+							break;
+						}
+					}
+					
+					while (length < maxLength && a[length] == b[length])
+					{
+						length++;
+					}
+					
+					if (length > best)
+					{
+						best = length;
+						distance = uint32_t(position - size_t(candidate));
+						if (length >= level.niceLength || length == maxLength)
+						{
+							break;
+						}
+					}
+				}
+				
+				candidate = previous[size_t(candidate)];
+			}
+			
+			/// Short matches far away cost more than the literals
+			bool found = best > std::max<uint32_t>(minLength, 2)
+				&& (best > 3 || distance <= 4096);
+			return found ? best : 0;
+		};
+		
+		if (!level.lazy)
+		{
+			for (size_t p = begin; p < end; )
+			{
+				uint32_t distance = 0;
+				uint32_t length = findMatch(p, 0, distance);
+				insert(p);
+				
+				if (length == 0)
+				{
+					emitLiteral(p);
+					p++;
+					continue;
+				}
+				
+				emitMatch(p, length, distance);
+				if (length <= level.maxLazy)
+				{
+					for (size_t q = p + 1; q < p + length; q++)
+					{
+						insert(q);
+					}
+				}
+				p += length;
+			}
+		}
+		else
+		{
+			/// A match is only taken if the next position has no longer one
+			uint32_t pendingLength = 0;
+			uint32_t pendingDistance = 0;
+			bool pending = false;
+			
+			for (size_t p = begin; p < end; )
+			{
+				uint32_t distance = 0;
+				uint32_t length = pendingLength < level.maxLazy
+					? findMatch(p, pendingLength, distance)
+					: 0;
+				insert(p);
+				
+				if (pending && pendingLength >= 3 && length <= pendingLength)
+				{
+					size_t start = p - 1;
+					emitMatch(start, pendingLength, pendingDistance);
+					for (size_t q = p + 1; q < start + pendingLength; q++)
+					{
+						insert(q);
+					}
+					p = start + pendingLength;
+					pending = false;
+					pendingLength = 0;
+					continue;
+				}
+				
+				if (pending)
+				{
+					emitLiteral(p - 1);
+				}
+				
+				pending = true;
+				pendingLength = length;
+				pendingDistance = distance;
+				p++;
+			}
+			
+			if (pending)
+			{
+				if (pendingLength >= 3)
+				{
+					emitMatch(end - 1, pendingLength, pendingDistance);
+				}
+				else
+				{
+					emitLiteral(end - 1);
+				}
+			}
+		}
+	}
+	
+	flush(final);
+	
+	if (!final)
+	{
+		writer.Write(0, 3);
+		writer.Align();
+		const uint8_t sync[4] = { 0, 0, 0xFF, 0xFF };
+		out.insert(out.end(), sync, sync + 4);
+	}
+	
+	writer.Align();
+}
+
+// Row filters
+
+inline uint8_t PredictPNGPaeth(int a, int b, int c)
+{
+	int pa = std::abs(b - c);
+	int pb = std::abs(a - c);
+	int pc = std::abs(a + b - 2 * c);
+	return uint8_t(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+/// Returns the sum of absolute differences, the residuals as signed bytes
+static uint64_t ApplyPNGFilter(
+	uint8_t type,
+	uint8_t *out,
+	const uint8_t *row,
+	const uint8_t *prior,
+	size_t size,
+	uint32_t bpp)
+{
+	/// One loop per type, so that the simple ones vectorize
+	switch (type)
+	{
+	case 0:
+		std::memcpy(out, row, size);
+		break;
+	case 1:
+		std::memcpy(out, row, bpp);
+		for (size_t i = bpp; i < size; i++)
+		{
+			out[i] = uint8_t(row[i] - row[i - bpp]);
+		}
+		break;
+	case 2:
+		for (size_t i = 0; i < size; i++)
+		{
+			out[i] = uint8_t(row[i] - prior[i]);
+		}
+		break;
+	case 3:
+		for (size_t i = 0; i < bpp; i++)
+		{
+			out[i] = uint8_t(row[i] - (prior[i] >> 1));
+		}
+		for (size_t i = bpp; i < size; i++)
+		{
+			out[i] = uint8_t(row[i] - ((row[i - bpp] + prior[i]) >> 1));
+		}
+		break;
+	default:
+	{
+		for (size_t i = 0; i < bpp; i++)
+		{
+			out[i] = uint8_t(row[i] - prior[i]);
+		}
+		
+		size_t i = bpp;
+#ifdef SMORGASBORD_SSE2
+		/// Unlike when decoding, every predictor is known up front, so 8
+		/// bytes are done at once in 16 bit lanes
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= size; i += 8)
+		{
+			auto load = [&](const uint8_t *p)
+			{
+				return _mm_unpacklo_epi8(
+					_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), zero);
+			};
+			
+			__m128i a = load(&row[i - bpp]);
+			__m128i b = load(&prior[i]);
+			__m128i c = load(&prior[i - bpp]);
+			
+			__m128i pa = _mm_sub_epi16(b, c);
+			__m128i pb = _mm_sub_epi16(a, c);
+			__m128i pc = _mm_add_epi16(pa, pb);
+			pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+			pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+			pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+			
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i isA = _mm_cmpeq_epi16(smallest, pa);
+			__m128i isB = _mm_cmpeq_epi16(smallest, pb);
+			__m128i bOrC = _mm_or_si128(
+				_mm_and_si128(isB, b), _mm_andnot_si128(isB, c));
+			__m128i predictor = _mm_or_si128(
+				_mm_and_si128(isA, a), _mm_andnot_si128(isA, bOrC));
+			
+			__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&row[i]));
+			_mm_storel_epi64(
+				reinterpret_cast<__m128i *>(&out[i]),
+				_mm_sub_epi8(x, _mm_packus_epi16(predictor, predictor)));
+		}
+#endif
+		for (; i < size; i++)
+		{
+			out[i] = uint8_t(row[i] - PredictPNGPaeth(row[i - bpp], prior[i], prior[i - bpp]));
+		}
+		break;
+	}
+	}
+	
+	uint64_t sum = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		sum += uint32_t(std::abs(int(int8_t(out[i]))));
+	}
+	
+	return sum;
+}
+
+/// Filters a row with every filter type and keeps the one with the smallest
+/// sum of absolute differences. out holds the filter type and the row
+static void FilterPNGRow(
+	uint8_t *out,
+	const uint8_t *row,
+	const uint8_t *prior,
+	size_t size,
+	uint32_t bpp,
+	bool onlyNone,
+	std::vector<uint8_t> &candidate)
+{
+	out[0] = 0;
+	uint64_t bestSum = ApplyPNGFilter(0, out + 1, row, prior, size, bpp);
+	if (onlyNone)
+	{
+		return;
+	}
+	
+	candidate.resize(size);
+	for (uint8_t type = 1; type < 5; type++)
+	{
+		uint64_t sum = ApplyPNGFilter(type, candidate.data(), row, prior, size, bpp);
+		if (sum < bestSum)
+		{
+			bestSum = sum;
+			out[0] = type;
+			std::memcpy(out + 1, candidate.data(), size);
+		}
+	}
+}
+
+// PNG
+
+inline void AppendPNGUInt32(std::vector<uint8_t> &png, uint32_t value)
+{
+	uint8_t bytes[4] = {
+		uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+	png.insert(png.end(), bytes, bytes + 4);
+}
+
+/// Returns the offset to pass to EndPNGChunk() once the data is appended
+inline size_t BeginPNGChunk(std::vector<uint8_t> &png, const char *type)
+{
+	size_t offset = png.size();
+	AppendPNGUInt32(png, 0);
+	png.insert(png.end(), type, type + 4);
+	return offset;
+}
+
+inline void EndPNGChunk(std::vector<uint8_t> &png, size_t offset)
+{
+	uint32_t length = uint32_t(png.size() - offset - 8);
+	for (int i = 0; i < 4; i++)
+	{
+		png[offset + i] = uint8_t(length >> (24 - 8 * i));
+	}
+	
+	AppendPNGUInt32(png, lodepng_crc32(&png[offset + 4], length + 4));
+}
+
+bool Smorgasbord::EncodePNG(
+	const Image &image,
+	std::vector<uint8_t> &png,
+	int level,
+	uint32_t numThreads)
+{
+	const uint32_t width = image.imageSize.x;
+	const uint32_t height = image.imageSize.y;
+	if (width == 0 || height == 0 || image.pixelSize != 4
+		|| image.data.size() < size_t(width) * height * 4)
+	{
+		return false;
+	}
+	
+	level = std::min(std::max(level, 0), 9);
+	
+	bool opaque = true;
+	for (size_t i = 3; i < size_t(width) * height * 4 && opaque; i += 4)
+	{
+		opaque = image.data[i] == 255;
+	}
+	
+	const uint32_t bpp = opaque ? 3 : 4;
+	const size_t rowSize = size_t(width) * bpp;
+	const size_t filteredSize = (rowSize + 1) * height;
+	
+	// Filtering, the rows before each range are converted again
+	
+	std::vector<uint8_t> filtered(filteredSize);
+	ParallelForRange(
+		height,
+		16,
+		[&](size_t begin, size_t end)
+		{
+			std::vector<uint8_t> row(rowSize);
+			std::vector<uint8_t> prior(rowSize, 0);
+			std::vector<uint8_t> candidate;
+			
+			auto convert = [&](size_t y, std::vector<uint8_t> &target)
+			{
+				const uint8_t *pixels = &image.data[y * width * 4];
+				if (bpp == 4)
+				{
+					std::memcpy(target.data(), pixels, rowSize);
+					return;
+				}
+				
+				for (size_t x = 0; x < width; x++)
+				{
+					target[x * 3 + 0] = pixels[x * 4 + 0];
+					target[x * 3 + 1] = pixels[x * 4 + 1];
+					target[x * 3 + 2] = pixels[x * 4 + 2];
+				}
+			};
+			
+			if (begin > 0)
+			{
+				convert(begin - 1, prior);
+			}
+			
+			for (size_t y = begin; y < end; y++)
+			{
+				convert(y, row);
+				FilterPNGRow(
+					&filtered[y * (rowSize + 1)],
+					row.data(), prior.data(), rowSize, bpp, level == 0, candidate);
+				row.swap(prior);
+			}
+		},
+		numThreads);
+	
+	// Chunks, deflated to IDAT chunks of their own
+	
+	const size_t numChunks = (filteredSize + deflateChunkSize - 1) / deflateChunkSize;
+	std::vector<std::vector<uint8_t>> chunks(numChunks);
+	std::vector<uint32_t> adlers(numChunks);
+	
+	ParallelFor(
+		numChunks,
+		[&](size_t i)
+		{
+			size_t begin = i * deflateChunkSize;
+			size_t end = std::min(begin + deflateChunkSize, filteredSize);
+			size_t dictionary = std::min(begin, deflateWindowSize);
+			
+			std::vector<uint8_t> &chunk = chunks[i];
+			chunk.reserve((end - begin) / 2 + 1024);
+			size_t offset = BeginPNGChunk(chunk, "IDAT");
+			DeflatePNGChunk(
+				&filtered[begin - dictionary],
+				dictionary,
+				dictionary + end - begin,
+				deflateLevels[level],
+				i + 1 == numChunks,
+				chunk);
+			EndPNGChunk(chunk, offset);
+			
+			adlers[i] = GetAdler32(&filtered[begin], end - begin);
+		},
+		numThreads);
+	
+	// File
+	
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	png.assign(signature, signature + 8);
+	
+	size_t offset = BeginPNGChunk(png, "IHDR");
+	AppendPNGUInt32(png, width);
+	AppendPNGUInt32(png, height);
+	const uint8_t header[5] = { 8, uint8_t(opaque ? 2 : 6), 0, 0, 0 };
+	png.insert(png.end(), header, header + 5);
+	EndPNGChunk(png, offset);
+	
+	/// zlib header with a 32 KB window and the level, then the chunks
+	uint8_t compressionLevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+	uint32_t zlibHeader = (0x78 << 8) | (compressionLevel << 6);
+	zlibHeader += 31 - zlibHeader % 31;
+	
+	offset = BeginPNGChunk(png, "IDAT");
+	png.push_back(uint8_t(zlibHeader >> 8));
+	png.push_back(uint8_t(zlibHeader));
+	EndPNGChunk(png, offset);
+	
+	uint32_t adler = 1;
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		png.insert(png.end(), chunks[i].begin(), chunks[i].end());
+		
+		size_t end = std::min((i + 1) * deflateChunkSize, filteredSize);
+		adler = CombineAdler32(adler, adlers[i], end - i * deflateChunkSize);
+	}
+	
+	offset = BeginPNGChunk(png, "IDAT");
+	AppendPNGUInt32(png, adler);
+	EndPNGChunk(png, offset);
+	
+	offset = BeginPNGChunk(png, "IEND");
+	EndPNGChunk(png, offset);
+	
+	return true;
+}
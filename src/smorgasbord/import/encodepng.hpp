@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+
+Parallel PNG encoding
+---------------------
+
+EncodePNG() encodes an RGBA Image as an 8 bit RGB or RGBA PNG, RGB if every
+pixel is opaque. The work is split pigz-style:
+	- rows are filtered in parallel, each with the filter that gives the
+	  smallest sum of absolute differences
+	- the filtered data is cut into chunks which are deflated in parallel,
+	  each with the 32 KB before it as its dictionary, so that matches can
+	  reach back across chunk borders
+	- chunks end with an empty stored block, which byte aligns them, so
+	  they are concatenated as they are. Every chunk becomes an IDAT chunk
+	  of its own, and the Adler-32s of the chunks are combined
+level is the zlib compression level, 0 for stored blocks only up to 9 for
+the longest match searches. numThreads == 0 means one thread per hardware
+thread. The output doesn't depend on the number of threads.
+
+*/
+
+namespace Smorgasbord {
+
+class Image;
+
+bool EncodePNG(
+	const Image &image,
+	std::vector<uint8_t> &png,
+	int level = 6,
+	uint32_t numThreads = 0);
+
+}
@@ -0,0 +1,640 @@
+#include "loadglb.hpp"
+
+#include <smorgasbord/rendering/transform.hpp>
+#include <smorgasbord/util/json.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/mappedfile.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <cstring>
+
+using namespace Smorgasbord;
+
+const uint32_t glbMagic = 0x46546C67; // "glTF"
+const uint32_t glbVersion = 2;
+const uint32_t glbChunkJSON = 0x4E4F534A; // "JSON"
+const uint32_t glbChunkBIN = 0x004E4942; // "BIN\0"
+const size_t glbBufferAlignment = 4;
+
+struct GLBBufferView
+{
+	size_t byteOffset = 0; // in the binary chunk
+	size_t byteLength = 0;
+	size_t byteStride = 0; // 0 if tightly packed
+	bool valid = false; // in the binary chunk
+	// offsets in the GPU buffers, or SIZE_MAX if not used there
+	size_t vertexOffset = SIZE_MAX;
+	size_t indexOffset = SIZE_MAX;
+};
+
+struct GLBAccessor
+{
+	uint32_t bufferView = 0;
+	size_t byteOffset = 0; // in the buffer view
+	size_t count = 0;
+	uint32_t componentType = 0;
+	uint32_t numComponents = 0;
+	size_t stride = 0;
+	bool normalized = false;
+};
+
+inline size_t GetGLBComponentSize(uint32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: // BYTE
+	case 5121: // UNSIGNED_BYTE
+		return 1;
+	case 5122: // SHORT
+	case 5123: // UNSIGNED_SHORT
+		return 2;
+	case 5125: // UNSIGNED_INT
+	case 5126: // FLOAT
+		return 4;
+	}
+	
+	return 0;
+}
+
+inline AttributeDataType GetGLBAttributeDataType(uint32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: return AttributeDataType::Int8;
+	case 5121: return AttributeDataType::UInt8;
+	case 5122: return AttributeDataType::Int16;
+	case 5123: return AttributeDataType::UInt16;
+	case 5125: return AttributeDataType::UInt32;
+	}
+	
+	return AttributeDataType::Float;
+}
+
+/// Returns false if the accessor doesn't exist, or isn't a dense accessor
+/// within a buffer view of the binary chunk
+static bool GetGLBAccessor(
+	const JsonValue &json,
+	int64_t index,
+	const std::vector<GLBBufferView> &views,
+	GLBAccessor &accessor)
+{
+	const JsonValue &value = json["accessors"][size_t(index)];
+	if (index < 0 || value.IsNull() || value.Has("sparse"))
+	{
+		return false;
+	}
+	
+	int64_t viewIndex = value["bufferView"].GetInteger();
+	if (viewIndex < 0 || size_t(viewIndex) >= views.size() || !views[viewIndex].valid)
+	{
+		return false;
+	}
+	
+	const std::string &type = value["type"].GetString();
+	accessor.numComponents =
+		type == "SCALAR" ? 1
+		: type == "VEC2" ? 2
+		: type == "VEC3" ? 3
+		: type == "VEC4" ? 4
+		: 0;
+	
+	accessor.bufferView = uint32_t(viewIndex);
+	accessor.byteOffset = size_t(std::max<int64_t>(value["byteOffset"].GetInteger(0), 0));
+	accessor.count = size_t(std::max<int64_t>(value["count"].GetInteger(0), 0));
+	accessor.componentType = uint32_t(value["componentType"].GetInteger(0));
+	accessor.normalized = value["normalized"].GetBool();
+	
+	const size_t elementSize =
+		GetGLBComponentSize(accessor.componentType) * accessor.numComponents;
+	const GLBBufferView &view = views[viewIndex];
+	accessor.stride = view.byteStride > 0 ? view.byteStride : elementSize;
+	
+	/// The last element has to end within the view. count comes from the
+	/// file, so it's compared by division, which can't overflow
+	return elementSize > 0
+		&& accessor.count > 0
+		&& accessor.count <= UINT32_MAX
+		&& accessor.byteOffset <= view.byteLength
+		&& elementSize <= view.byteLength - accessor.byteOffset
+		&& accessor.count - 1
+			<= (view.byteLength - accessor.byteOffset - elementSize) / accessor.stride;
+}
+
+/// 0 to 15, or 16 if c isn't a hex digit
+static uint32_t GetGLBHexDigit(char c)
+{
+	return c >= '0' && c <= '9' ? c - '0'
+		: c >= 'a' && c <= 'f' ? c - 'a' + 10
+		: c >= 'A' && c <= 'F' ? c - 'A' + 10
+		: 16;
+}
+
+/// Percent escapes which aren't followed by two hex digits are kept as
+/// they are
+static std::string DecodeGLBURI(const std::string &uri)
+{
+	std::string path;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		const uint32_t high = i + 2 < uri.size() ? GetGLBHexDigit(uri[i + 1]) : 16;
+		const uint32_t low = i + 2 < uri.size() ? GetGLBHexDigit(uri[i + 2]) : 16;
+		if (uri[i] == '%' && high < 16 && low < 16)
+		{
+			path += char(high * 16 + low);
+			i += 2;
+		}
+		else
+		{
+			path += uri[i];
+		}
+	}
+	
+	return path;
+}
+
+static glm::mat4 GetGLBNodeTransform(const JsonValue &node)
+{
+	const JsonValue &matrix = node["matrix"];
+	if (matrix.Size() == 16)
+	{
+		glm::mat4 result;
+		for (size_t i = 0; i < 16; i++)
+		{
+			result[i / 4][i % 4] = float(matrix[i].GetNumber());
+		}
+		
+		return result;
+	}
+	
+	const JsonValue &t = node["translation"];
+	const JsonValue &r = node["rotation"];
+	const JsonValue &s = node["scale"];
+	
+	glm::vec3 translation(
+		t[0].GetNumber(0), t[1].GetNumber(0), t[2].GetNumber(0));
+	glm::vec3 scale(
+		s[0].GetNumber(1), s[1].GetNumber(1), s[2].GetNumber(1));
+	float x = float(r[0].GetNumber(0));
+	float y = float(r[1].GetNumber(0));
+	float z = float(r[2].GetNumber(0));
+	float w = float(r[3].GetNumber(1));
+	
+	/// Unit quaternion to rotation matrix
+	glm::mat4 rotation(1.0f);
+	rotation[0] = glm::vec4(
+		1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0);
+	rotation[1] = glm::vec4(
+		2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0);
+	rotation[2] = glm::vec4(
+		2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0);
+	
+	return Translate(translation) * rotation * Scale(scale);
+}
+
+std::unique_ptr<GLBScene> Smorgasbord::LoadGLB(
+	std::shared_ptr<Device> device, ResourceReference file)
+{
+	std::unique_ptr<MappedFile> mapped = file.OpenMapped();
+	if (mapped == nullptr || !mapped->IsOpen())
+	{
+		return nullptr;
+	}
+	
+	const uint8_t *data = mapped->GetData();
+	const size_t size = mapped->GetSize();
+	
+	// Header and chunks
+	
+	uint32_t header[3] = { };
+	if (size >= sizeof(header))
+	{
+		std::memcpy(header, data, sizeof(header));
+	}
+	
+	if (header[0] != glbMagic || header[1] != glbVersion || header[2] > size)
+	{
+		LogE("{0} is not a binary glTF 2.0 file.", file.GetPath());
+		return nullptr;
+	}
+	
+	const char *jsonText = nullptr;
+	size_t jsonSize = 0;
+	const uint8_t *bin = nullptr;
+	size_t binSize = 0;
+	
+	for (size_t offset = sizeof(header); offset + 8 <= header[2]; )
+	{
+		uint32_t chunk[2];
+		std::memcpy(chunk, &data[offset], sizeof(chunk));
+		offset += sizeof(chunk);
+		
+		if (chunk[0] > header[2] - offset)
+		{
+			LogE("{0} has a truncated chunk.", file.GetPath());
+			return nullptr;
+		}
+		
+		if (chunk[1] == glbChunkJSON && jsonText == nullptr)
+		{
+			jsonText = reinterpret_cast<const char*>(&data[offset]);
+			jsonSize = chunk[0];
+		}
+		else if (chunk[1] == glbChunkBIN && bin == nullptr)
+		{
+			bin = &data[offset];
+			binSize = chunk[0];
+		}
+		
+		offset += chunk[0];
+	}
+	
+	JsonValue json;
+	if (jsonText == nullptr || !ParseJson(jsonText, jsonSize, json))
+	{
+		LogE("{0} has no valid JSON chunk.", file.GetPath());
+		return nullptr;
+	}
+	
+	// Buffer views within the binary chunk
+	
+	const JsonValue &buffers = json["buffers"];
+	std::vector<GLBBufferView> views(json["bufferViews"].Size());
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		const JsonValue &value = json["bufferViews"][i];
+		GLBBufferView &view = views[i];
+		view.byteOffset = size_t(std::max<int64_t>(value["byteOffset"].GetInteger(0), 0));
+		view.byteLength = size_t(std::max<int64_t>(value["byteLength"].GetInteger(0), 0));
+		view.byteStride = size_t(std::max<int64_t>(value["byteStride"].GetInteger(0), 0));
+		
+		/// Only the first buffer may refer to the binary chunk
+		view.valid = bin != nullptr
+			&& value["buffer"].GetInteger() == 0
+			&& !buffers[0].Has("uri")
+			&& view.byteOffset <= binSize
+			&& view.byteLength <= binSize - view.byteOffset;
+	}
+	
+	std::unique_ptr<GLBScene> scene(new GLBScene());
+	
+	// Primitives and the views they use
+	
+	struct PrimitiveAccessors
+	{
+		uint32_t mesh;
+		uint32_t primitive;
+		GLBAccessor attributes[3];
+		bool hasAttribute[3];
+		GLBAccessor indices;
+		bool indexed;
+	};
+	
+	const char *attributeNames[3] = { "POSITION", "NORMAL", "TEXCOORD_0" };
+	const char *attributeShaderNames[3] = { "v_p", "v_n", "v_uv" };
+	
+	std::vector<PrimitiveAccessors> primitives;
+	const JsonValue &meshes = json["meshes"];
+	scene->meshes.resize(meshes.Size());
+	
+	for (size_t m = 0; m < meshes.Size(); m++)
+	{
+		scene->meshes[m].name = meshes[m]["name"].GetString();
+		
+		const JsonValue &meshPrimitives = meshes[m]["primitives"];
+		for (size_t p = 0; p < meshPrimitives.Size(); p++)
+		{
+			const JsonValue &primitive = meshPrimitives[p];
+			
+			PrimitiveAccessors accessors = { };
+			accessors.mesh = uint32_t(m);
+			accessors.primitive = uint32_t(p);
+			
+			bool valid = !primitive["extensions"].Has("KHR_draco_mesh_compression");
+			for (int a = 0; a < 3 && valid; a++)
+			{
+				const JsonValue &index = primitive["attributes"][attributeNames[a]];
+				accessors.hasAttribute[a] = !index.IsNull();
+				if (accessors.hasAttribute[a])
+				{
+					valid = GetGLBAccessor(
+						json, index.GetInteger(), views, accessors.attributes[a]);
+				}
+			}
+			
+			valid = valid && accessors.hasAttribute[0];
+			
+			accessors.indexed = primitive.Has("indices");
+			if (valid && accessors.indexed)
+			{
+				GLBAccessor &indices = accessors.indices;
+				valid = GetGLBAccessor(
+					json, primitive["indices"].GetInteger(), views, indices)
+					&& indices.numComponents == 1
+					&& (indices.componentType == 5121
+						|| indices.componentType == 5123
+						|| indices.componentType == 5125)
+					&& indices.stride == GetGLBComponentSize(indices.componentType);
+			}
+			
+			if (!valid)
+			{
+				LogW("Primitive {0} of mesh {1} in {2} is not supported, skipped.",
+					p, m, file.GetPath());
+				continue;
+			}
+			
+			primitives.push_back(accessors);
+		}
+	}
+	
+	// Pack the views into the vertex and index buffers
+	
+	size_t vertexBufferSize = 0;
+	size_t indexBufferSize = 0;
+	
+	auto align = [](size_t offset)
+	{
+		return (offset + glbBufferAlignment - 1) & ~(glbBufferAlignment - 1);
+	};
+	
+	for (const PrimitiveAccessors &accessors : primitives)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			GLBBufferView &view = views[accessors.attributes[a].bufferView];
+			if (accessors.hasAttribute[a] && view.vertexOffset == SIZE_MAX)
+			{
+				view.vertexOffset = vertexBufferSize;
+				vertexBufferSize = align(vertexBufferSize + view.byteLength);
+			}
+		}
+		
+		GLBBufferView &view = views[accessors.indices.bufferView];
+		if (accessors.indexed && view.indexOffset == SIZE_MAX)
+		{
+			view.indexOffset = indexBufferSize;
+			indexBufferSize = align(indexBufferSize + view.byteLength);
+		}
+	}
+	
+	if (vertexBufferSize > UINT32_MAX || indexBufferSize > UINT32_MAX)
+	{
+		LogE("{0} has too much vertex or index data.", file.GetPath());
+		return nullptr;
+	}
+	
+	/// Straight from the mapped file into the mapped buffers
+	auto upload = [&](std::shared_ptr<Buffer> buffer, bool indices)
+	{
+		Scope(buffer, MappedDataAccessType::Write);
+		uint8_t *target = buffer->GetMappedData();
+		for (const GLBBufferView &view : views)
+		{
+			size_t offset = indices ? view.indexOffset : view.vertexOffset;
+			if (offset != SIZE_MAX)
+			{
+				StreamingCopy(&target[offset], &bin[view.byteOffset], view.byteLength);
+			}
+		}
+	};
+	
+	if (vertexBufferSize > 0)
+	{
+		scene->vertexBuffer = device->CreateBuffer(
+			BufferType::Vertex,
+			BufferUsageType::Draw,
+			BufferUsageFrequency::Static,
+			uint32_t(vertexBufferSize));
+		upload(scene->vertexBuffer, false);
+	}
+	
+	if (indexBufferSize > 0)
+	{
+		scene->indexBuffer = device->CreateBuffer(
+			BufferType::Index,
+			BufferUsageType::Draw,
+			BufferUsageFrequency::Static,
+			uint32_t(indexBufferSize));
+		upload(scene->indexBuffer, true);
+	}
+	
+	// Sub-meshes
+	
+	for (const PrimitiveAccessors &accessors : primitives)
+	{
+		const JsonValue &primitive =
+			meshes[accessors.mesh]["primitives"][accessors.primitive];
+		GLBMesh &mesh = scene->meshes[accessors.mesh];
+		
+		GLBPrimitive result;
+		Geometry &geometry = result.subMesh.geometry;
+		geometry.vertexBuffer = scene->vertexBuffer;
+		
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			if (!accessors.hasAttribute[a])
+			{
+				continue;
+			}
+			
+			const GLBAccessor &accessor = accessors.attributes[a];
+			Attribute attribute;
+			attribute.location = a;
+			attribute.name = attributeShaderNames[a];
+			attribute.dataType = GetGLBAttributeDataType(accessor.componentType);
+			attribute.numComponents = accessor.numComponents;
+			attribute.accessType = AttributeAccessType::Float;
+			attribute.normalize = accessor.normalized;
+			attribute.stride = uint32_t(accessor.stride);
+			attribute.offset = uint32_t(
+				views[accessor.bufferView].vertexOffset + accessor.byteOffset);
+			result.geometryLayout.attributes.push_back(attribute);
+		}
+		
+		switch (primitive["mode"].GetInteger(4))
+		{
+		case 0: result.geometryLayout.primitiveType = PrimitiveTopology::PointList; break;
+		case 1: result.geometryLayout.primitiveType = PrimitiveTopology::LineList; break;
+		case 3: result.geometryLayout.primitiveType = PrimitiveTopology::LineStrip; break;
+		case 5: result.geometryLayout.primitiveType = PrimitiveTopology::TriangleStrip; break;
+		case 6: result.geometryLayout.primitiveType = PrimitiveTopology::TriangleFan; break;
+		default: result.geometryLayout.primitiveType = PrimitiveTopology::TriangleList; break;
+		}
+		
+		if (accessors.indexed)
+		{
+			const GLBAccessor &indices = accessors.indices;
+			const size_t indexSize = indices.stride;
+			const size_t offset = views[indices.bufferView].indexOffset + indices.byteOffset;
+			if (offset % indexSize != 0)
+			{
+				LogW("Misaligned indices of mesh {0} in {1}, skipped.",
+					accessors.mesh, file.GetPath());
+				continue;
+			}
+			
+			geometry.indexBuffer = IndexBufferRef(
+				scene->indexBuffer,
+				indexSize == 1 ? IndexDataType::UInt8
+				: indexSize == 2 ? IndexDataType::UInt16
+				: IndexDataType::UInt32);
+			geometry.startIndex = uint32_t(offset / indexSize);
+			geometry.numVertices = uint32_t(indices.count);
+		}
+		else
+		{
+			geometry.numVertices = uint32_t(accessors.attributes[0].count);
+		}
+		
+		MeshRange &range = result.subMesh.range;
+		range.materialIndex = int32_t(primitive["material"].GetInteger(-1));
+		range.object = mesh.name;
+		if (result.geometryLayout.primitiveType == PrimitiveTopology::TriangleList)
+		{
+			range.firstFace = geometry.startIndex / 3;
+			range.numFaces = geometry.numVertices / 3;
+		}
+		
+		/// POSITION is required to have min and max
+		const JsonValue &position = json["accessors"][size_t(
+			primitive["attributes"]["POSITION"].GetInteger())];
+		for (int i = 0; i < 3; i++)
+		{
+			result.boundingMin[i] = float(position["min"][i].GetNumber());
+			result.boundingMax[i] = float(position["max"][i].GetNumber());
+		}
+		
+		mesh.primitives.push_back(result);
+	}
+	
+	// Materials and images
+	
+	const JsonValue &images = json["images"];
+	scene->images.resize(images.Size());
+	for (size_t i = 0; i < images.Size(); i++)
+	{
+		int64_t viewIndex = images[i]["bufferView"].GetInteger();
+		if (viewIndex >= 0 && size_t(viewIndex) < views.size() && views[viewIndex].valid)
+		{
+			const uint8_t *image = &bin[views[viewIndex].byteOffset];
+			scene->images[i].assign(image, image + views[viewIndex].byteLength);
+		}
+	}
+	
+	/// Path of the image of a texture, if it is stored in a separate file
+	auto getImage = [&](const JsonValue &textureInfo, int32_t &imageIndex)
+	{
+		int64_t textureIndex = textureInfo["index"].GetInteger();
+		imageIndex = int32_t(json["textures"][size_t(textureIndex)]["source"].GetInteger());
+		
+		const std::string &uri = images[size_t(imageIndex)]["uri"].GetString();
+		if (textureIndex < 0 || uri.empty() || uri.compare(0, 5, "data:") == 0)
+		{
+			return std::string();
+		}
+		
+		return file.Get(DecodeGLBURI(uri)).GetFullPath();
+	};
+	
+	const JsonValue &materials = json["materials"];
+	scene->materials.resize(materials.Size());
+	scene->materialImages.resize(materials.Size(), -1);
+	for (size_t i = 0; i < materials.Size(); i++)
+	{
+		const JsonValue &value = materials[i];
+		const JsonValue &pbr = value["pbrMetallicRoughness"];
+		const JsonValue &color = pbr["baseColorFactor"];
+		
+		MaterialData &material = scene->materials[i];
+		material.name = value["name"].GetString();
+		material.diffuseColor = glm::vec3(
+			color[0].GetNumber(1), color[1].GetNumber(1), color[2].GetNumber(1));
+		material.opacity = float(color[3].GetNumber(1));
+		
+		int32_t imageIndex;
+		if (pbr.Has("baseColorTexture"))
+		{
+			material.diffuseMap = getImage(pbr["baseColorTexture"], imageIndex);
+			scene->materialImages[i] = imageIndex;
+		}
+		
+		if (value.Has("normalTexture"))
+		{
+			material.normalMap = getImage(value["normalTexture"], imageIndex);
+		}
+	}
+	
+	// Placed objects, from the default scene, or every root node
+	
+	const JsonValue &nodes = json["nodes"];
+	std::vector<bool> visited(nodes.Size(), false);
+	std::vector<std::pair<size_t, glm::mat4>> stack;
+	
+	const JsonValue &roots =
+		json["scenes"][size_t(std::max<int64_t>(json["scene"].GetInteger(0), 0))]["nodes"];
+	if (roots.Size() > 0)
+	{
+		for (size_t i = roots.Size(); i-- > 0; )
+		{
+			stack.emplace_back(size_t(roots[i].GetInteger()), glm::mat4(1));
+		}
+	}
+	else
+	{
+		std::vector<bool> isChild(nodes.Size(), false);
+		for (size_t i = 0; i < nodes.Size(); i++)
+		{
+			for (size_t c = 0; c < nodes[i]["children"].Size(); c++)
+			{
+				size_t child = size_t(nodes[i]["children"][c].GetInteger());
+				if (child < nodes.Size())
+				{
+					isChild[child] = true;
+				}
+			}
+		}
+		
+		for (size_t i = nodes.Size(); i-- > 0; )
+		{
+			if (!isChild[i])
+			{
+				stack.emplace_back(i, glm::mat4(1));
+			}
+		}
+	}
+	
+	while (!stack.empty())
+	{
+		size_t nodeIndex = stack.back().first;
+		glm::mat4 parent = stack.back().second;
+		stack.pop_back();
+		
+		/// Cycles and nodes reached twice are invalid glTF
+		if (nodeIndex >= nodes.Size() || visited[nodeIndex])
+		{
+			continue;
+		}
+		visited[nodeIndex] = true;
+		
+		const JsonValue &node = nodes[nodeIndex];
+		glm::mat4 world = parent * GetGLBNodeTransform(node);
+		
+		int64_t meshIndex = node["mesh"].GetInteger();
+		if (meshIndex >= 0 && size_t(meshIndex) < scene->meshes.size())
+		{
+			GLBObject object;
+			object.name = node["name"].GetString();
+			object.meshIndex = uint32_t(meshIndex);
+			object.world = world;
+			scene->objects.push_back(object);
+		}
+		
+		const JsonValue &children = node["children"];
+		for (size_t c = children.Size(); c-- > 0; )
+		{
+			stack.emplace_back(size_t(children[c].GetInteger()), world);
+		}
+	}
+	
+	return scene;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <smorgasbord/gpu/gpuapi.hpp>
+#include <smorgasbord/import/loadmtl.hpp>
+#include <smorgasbord/rendering/staticmesh.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+
+# Binary glTF import #
+
+LoadGLB() memory maps a .glb file and copies the buffer views holding
+vertex attributes into one vertex Buffer, and those holding indices into
+one index Buffer, without converting or de-indexing them. glTF accessors
+map onto Attribute and IndexDataType as they are:
+	
+	componentType 5120 .. 5126 -> AttributeDataType Int8 .. Float
+	type SCALAR, VEC2 .. VEC4 -> numComponents 1 .. 4
+	normalized -> normalize
+	bufferView byteStride -> stride, the element size if not set
+	bufferView and accessor byteOffset -> offset in the vertex Buffer
+
+POSITION, NORMAL and TEXCOORD_0 are bound to the locations StaticMesh uses,
+0 "v_p", 1 "v_n" and 2 "v_uv". Every primitive becomes a sub-mesh with its
+own GeometryLayout, since attribute offsets differ between primitives.
+Nodes of the default scene that hold a mesh become placed objects, with
+the transforms of their ancestors applied.
+
+Only the binary chunk of the .glb is read: buffers with a uri, sparse
+accessors and compression extensions are not supported, primitives using
+them are skipped.
+
+*/
+
+namespace Smorgasbord {
+
+struct GLBPrimitive
+{
+	/// range.materialIndex refers to GLBScene::materials, range.object is
+	/// the mesh name. range.numFaces is only set for triangle lists
+	SubMesh subMesh;
+	GeometryLayout geometryLayout;
+	// model space bounding box, from the POSITION accessor
+	glm::vec3 boundingMin = glm::vec3(0);
+	glm::vec3 boundingMax = glm::vec3(0);
+};
+
+struct GLBMesh
+{
+	std::string name;
+	std::vector<GLBPrimitive> primitives;
+};
+
+/// A node holding a mesh, in world space
+struct GLBObject
+{
+	std::string name;
+	uint32_t meshIndex = 0;
+	glm::mat4 world = glm::mat4(1);
+};
+
+struct GLBScene
+{
+	std::shared_ptr<Buffer> vertexBuffer;
+	std::shared_ptr<Buffer> indexBuffer; // nullptr if nothing is indexed
+	std::vector<GLBMesh> meshes;
+	std::vector<GLBObject> objects;
+	/// Base color factor as diffuseColor and opacity. diffuseMap is set for
+	/// base color images stored in separate files
+	std::vector<MaterialData> materials;
+	/// Image files stored in the .glb, e.g. PNG, indexed like the glTF
+	/// images. Empty for images stored in separate files
+	std::vector<std::vector<uint8_t>> images;
+	/// Base color image of every material, -1 if none
+	std::vector<int32_t> materialImages;
+};
+
+/// Returns nullptr if the file can't be opened or is invalid
+std::unique_ptr<GLBScene> LoadGLB(
+	std::shared_ptr<Device> device, ResourceReference file);
+
+}
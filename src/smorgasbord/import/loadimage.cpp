@@ -1,11 +1,160 @@
 #include "loadimage.hpp"
 
 #include <smorgasbord/image/image.hpp>
+#include <smorgasbord/import/decodepng.hpp>
+#include <smorgasbord/import/encodepng.hpp>
 #include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/mappedfile.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
 
 #include <lodepng/lodepng.h>
 
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
+#include <thread>
+
+/// lodepng's error for files which can't be opened
+const uint32_t loadImageOpenError = 78;
+
+/// Returns a lodepng error code, without logging, so that it can be called
+/// from worker threads
+static uint32_t DecodeLoadedImagePNG(
+	const uint8_t *data, size_t size, std::shared_ptr<Smorgasbord::Image> &image)
+{
+	image = std::make_shared<Smorgasbord::Image>();
+	
+	/// lodepng handles the variants DecodePNG() doesn't, and reports errors
+	if (Smorgasbord::DecodePNG(data, size, *image))
+	{
+		return 0;
+	}
+	
+	/// lodepng appends to data, so it starts from an empty image
+	image = std::make_shared<Smorgasbord::Image>();
+	uint32_t error = lodepng::decode(
+		image->data, image->imageSize.x, image->imageSize.y, data, size);
+	
+	if (error != 0)
+	{
+		image.reset();
+		return error;
+	}
+	
+	image->UpdateCached();
+	return 0;
+}
+
+static uint32_t DecodeLoadedImageFile(
+	std::unique_ptr<Smorgasbord::MappedFile> file,
+	std::shared_ptr<Smorgasbord::Image> &image)
+{
+	if (file == nullptr || !file->IsOpen())
+	{
+		return loadImageOpenError;
+	}
+	
+	return DecodeLoadedImagePNG(file->GetData(), file->GetSize(), image);
+}
+
+static void ReportLoadedImage(uint32_t error)
+{
+	if (error != 0)
+	{
+		LogE("lodepng DEcoder error {0}: {1}",
+			error, lodepng_error_text(error));
+	}
+}
+
+/// Runs decode(i, image) on worker threads and onLoaded(i, image) on the
+/// calling thread, as soon as each image is done
+static void LoadImageBatch(
+	size_t count,
+	const std::function<uint32_t(size_t, std::shared_ptr<Smorgasbord::Image>&)> &decode,
+	const std::function<void(size_t, std::shared_ptr<Smorgasbord::Image>)> &onLoaded,
+	uint32_t numThreads)
+{
+	auto report = [&](size_t i, uint32_t error, std::shared_ptr<Smorgasbord::Image> image)
+	{
+		ReportLoadedImage(error);
+		onLoaded(i, std::move(image));
+	};
+	
+	numThreads = uint32_t(std::min<size_t>(
+		Smorgasbord::ResolveThreadCount(numThreads), count));
+	
+	if (numThreads <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			std::shared_ptr<Smorgasbord::Image> image;
+			uint32_t error = decode(i, image);
+			report(i, error, std::move(image));
+		}
+		
+		return;
+	}
+	
+	struct Result
+	{
+		size_t index;
+		uint32_t error;
+		std::shared_ptr<Smorgasbord::Image> image;
+	};
+	
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::vector<Result> results; // not yet passed to onLoaded
+	std::atomic<size_t> nextIndex(0);
+	
+	auto worker = [&]()
+	{
+		size_t i;
+		while ((i = nextIndex.fetch_add(1)) < count)
+		{
+			Result result = { i, 0, nullptr };
+			result.error = decode(i, result.image);
+			
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				results.push_back(std::move(result));
+			}
+			finished.notify_one();
+		}
+	};
+	
+	/// The calling thread only waits and runs onLoaded, e.g. GPU uploads
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads);
+	for (uint32_t i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	
+	std::vector<Result> batch;
+	for (size_t numLoaded = 0; numLoaded < count; )
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [&]() { return !results.empty(); });
+			batch.swap(results);
+		}
+		
+		for (Result &result : batch)
+		{
+			report(result.index, result.error, std::move(result.image));
+		}
+		
+		numLoaded += batch.size();
+		batch.clear();
+	}
+	
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+}
 
 std::shared_ptr<Smorgasbord::Image> Smorgasbord::LoadImage(std::string filename)
 {
@@ -19,22 +168,53 @@ void Smorgasbord::SaveImage(Smorgasbord::Image &image, std::string filename)
 
 std::shared_ptr<Smorgasbord::Image> Smorgasbord::LoadImagePNG(std::string filename)
 {
-	Image* img = new Image();
+	std::shared_ptr<Image> image;
+	uint32_t error = DecodeLoadedImageFile(
+		std::unique_ptr<MappedFile>(new MappedFile(filename)), image);
+	ReportLoadedImage(error);
 	
-	uint32_t error = lodepng::decode(
-		img->data, img->imageSize.x, img->imageSize.y, filename);
+	return image;
+}
+
+std::shared_ptr<Smorgasbord::Image> Smorgasbord::LoadImagePNG(
+	const uint8_t *data, size_t size)
+{
+	std::shared_ptr<Image> image;
+	uint32_t error = DecodeLoadedImagePNG(data, size, image);
+	ReportLoadedImage(error);
 	
-	if (error == 0)
-	{
-		img->UpdateCached();
-		return std::shared_ptr<Image>(img);
-	}
-	else
-	{
-		LogE("lodepng DEcoder error {0}: {1}",
-			error, lodepng_error_text(error));
-		return std::shared_ptr<Image>();
-	}
+	return image;
+}
+
+void Smorgasbord::LoadImages(
+	std::vector<ResourceReference> files,
+	const std::function<void(size_t, std::shared_ptr<Image>)> &onLoaded,
+	uint32_t numThreads)
+{
+	LoadImageBatch(
+		files.size(),
+		[&](size_t i, std::shared_ptr<Image> &image)
+		{
+			return DecodeLoadedImageFile(files[i].OpenMapped(), image);
+		},
+		onLoaded,
+		numThreads);
+}
+
+void Smorgasbord::LoadImages(
+	std::vector<std::string> filenames,
+	const std::function<void(size_t, std::shared_ptr<Image>)> &onLoaded,
+	uint32_t numThreads)
+{
+	LoadImageBatch(
+		filenames.size(),
+		[&](size_t i, std::shared_ptr<Image> &image)
+		{
+			return DecodeLoadedImageFile(
+				std::unique_ptr<MappedFile>(new MappedFile(filenames[i])), image);
+		},
+		onLoaded,
+		numThreads);
 }
 
 void Smorgasbord::SaveImagePNG(Smorgasbord::Image &image, std::string filename)
@@ -54,3 +234,21 @@ void Smorgasbord::SaveImagePNG(Smorgasbord::Image &image, std::string filename)
 			error, lodepng_error_text(error));
 	}
 }
+
+void Smorgasbord::SaveImagePNG(
+	Smorgasbord::Image &image, std::string filename, int level, uint32_t numThreads)
+{
+	std::vector<uint8_t> png;
+	if (!EncodePNG(image, png, level, numThreads))
+	{
+		LogE("Invalid image, cannot save {0}", filename);
+		return;
+	}
+	
+	unsigned int error = lodepng::save_file(png, filename);
+	if (error != 0)
+	{
+		LogE("lodepng error {0} saving {1}: {2}",
+			error, filename, lodepng_error_text(error));
+	}
+}
@@ -1,13 +1,41 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
+/*
+
+Batch image loading
+-------------------
+
+LoadImages() decodes many files on worker threads and hands every image to
+onLoaded on the calling thread, in completion order, together with its index
+in files. Work that has to stay on one thread, like GPU uploads, can be done
+in onLoaded while the remaining files are still being decoded:
+	
+	LoadImages(files, [&](size_t i, std::shared_ptr<Image> image)
+	{
+		if (image)
+		{
+			textures[i] = device->CreateTexture(...);
+			textures[i]->Upload(*image);
+		}
+	});
+
+Failed loads are logged from the calling thread and passed as nullptr.
+numThreads == 0 means one worker per hardware thread.
+
+*/
+
 namespace Smorgasbord {
 
 class Image;
+class ResourceReference;
 
 std::shared_ptr<Image> LoadImage(std::string filename);
 void SaveImage(Image& image, std::string filename);
@@ -15,4 +43,22 @@ void SaveImage(Image& image, std::string filename);
 std::shared_ptr<Image> LoadImagePNG(std::string filename);
 void SaveImagePNG(Image& image, std::string filename);
 
+/// Encodes with EncodePNG(), in parallel, at zlib level 0 to 9
+void SaveImagePNG(
+	Image& image, std::string filename, int level, uint32_t numThreads = 0);
+
+/// Decodes a PNG file which is already in memory, e.g. embedded in a .glb
+std::shared_ptr<Image> LoadImagePNG(const uint8_t *data, size_t size);
+
+void LoadImages(
+	std::vector<ResourceReference> files,
+	const std::function<void(size_t, std::shared_ptr<Image>)> &onLoaded,
+	uint32_t numThreads = 0);
+
+/// Same for full paths, as taken by LoadImage()
+void LoadImages(
+	std::vector<std::string> filenames,
+	const std::function<void(size_t, std::shared_ptr<Image>)> &onLoaded,
+	uint32_t numThreads = 0);
+
 }
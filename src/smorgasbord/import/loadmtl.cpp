@@ -0,0 +1,221 @@
+#include "loadmtl.hpp"
+#include "loadtexture.hpp"
+
+#include <smorgasbord/gpu/gpuapi.hpp>
+#include <smorgasbord/util/log.hpp>
+
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace Smorgasbord;
+
+inline std::string TrimMTLString(const std::string &s)
+{
+	size_t start = s.find_first_not_of(" \t\r");
+	if (start == std::string::npos)
+	{
+		return { };
+	}
+	
+	size_t end = s.find_last_not_of(" \t\r");
+	return s.substr(start, end + 1 - start);
+}
+
+/// Texture statements may start with options, e.g. "-s 1 1 1 file.png",
+/// in that case the file name is the last token
+inline std::string GetMTLTexturePath(ResourceReference &file, std::string value)
+{
+	value = TrimMTLString(value);
+	if (value.empty())
+	{
+		return { };
+	}
+	
+	if (value[0] == '-')
+	{
+		value = value.substr(value.find_last_of(" \t") + 1);
+	}
+	
+	/// MTL files written on Windows tend to use backslashes
+	for (char &c : value)
+	{
+		if (c == '\\')
+		{
+			c = '/';
+		}
+	}
+	
+	return file.Get(value).GetFullPath();
+}
+
+std::vector<Smorgasbord::MaterialData> Smorgasbord::LoadMTL(
+	ResourceReference file)
+{
+	std::vector<MaterialData> materials;
+	
+	std::unique_ptr<std::istream> stream = file.OpenRead();
+	if (!static_cast<bool>(stream) || !stream->good())
+	{
+		LogE("Couldn't open MTL file {0}", file.GetPath());
+		return materials;
+	}
+	
+	std::string line;
+	std::stringstream lineStream; // helper stream
+	
+	while (std::getline(*stream, line))
+	{
+		lineStream.clear(); // reset EOF flag if set
+		lineStream.str(line);
+		
+		std::string type;
+		lineStream >> type;
+		
+		if (type.empty() || type[0] == '#')
+		{
+			continue;
+		}
+		
+		std::string rest;
+		std::getline(lineStream, rest);
+		
+		if (type == "newmtl")
+		{
+			materials.emplace_back();
+			materials.back().name = TrimMTLString(rest);
+			continue;
+		}
+		
+		if (materials.empty())
+		{
+			continue; // statements before the first material
+		}
+		
+		MaterialData &material = materials.back();
+		
+		lineStream.clear();
+		lineStream.str(rest);
+		
+		if (type == "Ka")
+		{
+			glm::vec3 &c = material.ambientColor;
+			lineStream >> c.x >> c.y >> c.z;
+		}
+		else if (type == "Kd")
+		{
+			glm::vec3 &c = material.diffuseColor;
+			lineStream >> c.x >> c.y >> c.z;
+		}
+		else if (type == "Ks")
+		{
+			glm::vec3 &c = material.specularColor;
+			lineStream >> c.x >> c.y >> c.z;
+		}
+		else if (type == "Ns")
+		{
+			lineStream >> material.specularExponent;
+		}
+		else if (type == "d")
+		{
+			lineStream >> material.opacity;
+		}
+		else if (type == "Tr")
+		{
+			float transparency = 0;
+			lineStream >> transparency;
+			material.opacity = 1.0f - transparency;
+		}
+		else if (type == "map_Kd")
+		{
+			material.diffuseMap = GetMTLTexturePath(file, rest);
+		}
+		else if (type == "map_Ks")
+		{
+			material.specularMap = GetMTLTexturePath(file, rest);
+		}
+		else if (type == "map_Bump" || type == "map_bump"
+			|| type == "bump" || type == "norm")
+		{
+			material.normalMap = GetMTLTexturePath(file, rest);
+		}
+		else if (type == "map_d")
+		{
+			material.alphaMap = GetMTLTexturePath(file, rest);
+		}
+	}
+	
+	return materials;
+}
+
+std::vector<Smorgasbord::MaterialData> Smorgasbord::LoadMeshMaterials(
+	ResourceReference meshFile, const MeshData &mesh)
+{
+	std::vector<MaterialData> materials(mesh.materialNames.size());
+	
+	std::map<std::string, size_t> materialIndices;
+	for (size_t i = 0; i < mesh.materialNames.size(); i++)
+	{
+		materials[i].name = mesh.materialNames[i];
+		materialIndices[mesh.materialNames[i]] = i;
+	}
+	
+	for (const std::string &library : mesh.materialLibraries)
+	{
+		for (MaterialData &material : LoadMTL(meshFile.Get(library)))
+		{
+			auto it = materialIndices.find(material.name);
+			if (it != materialIndices.end())
+			{
+				materials[it->second] = std::move(material);
+			}
+		}
+	}
+	
+	return materials;
+}
+
+void Smorgasbord::LoadMaterialTextures(
+	std::shared_ptr<Device> device,
+	std::vector<MaterialData> &materials,
+	uint32_t numThreads)
+{
+	/// Every file once. Failed loads stay nullptr, so they are only reported
+	/// once too
+	std::map<std::string, size_t> textureIndices;
+	std::vector<std::string> paths;
+	
+	auto add = [&](const std::string &path)
+	{
+		if (!path.empty() && textureIndices.emplace(path, paths.size()).second)
+		{
+			paths.push_back(path);
+		}
+	};
+	
+	for (const MaterialData &material : materials)
+	{
+		add(material.diffuseMap);
+		add(material.specularMap);
+		add(material.normalMap);
+		add(material.alphaMap);
+	}
+	
+	std::vector<std::shared_ptr<Texture>> textures =
+		LoadTextures(device, paths, numThreads);
+	
+	auto get = [&](const std::string &path)
+	{
+		return path.empty()
+			? std::shared_ptr<Texture>()
+			: textures[textureIndices[path]];
+	};
+	
+	for (MaterialData &material : materials)
+	{
+		material.diffuseTexture = get(material.diffuseMap);
+		material.specularTexture = get(material.specularMap);
+		material.normalTexture = get(material.normalMap);
+		material.alphaTexture = get(material.alphaMap);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Smorgasbord {
+
+class Texture;
+class Device;
+
+struct MaterialData
+{
+	std::string name;
+	
+	glm::vec3 ambientColor = glm::vec3(0); // Ka
+	glm::vec3 diffuseColor = glm::vec3(1); // Kd
+	glm::vec3 specularColor = glm::vec3(0); // Ks
+	float specularExponent = 0; // Ns
+	float opacity = 1; // d, or 1 - Tr
+	
+	// Texture file paths including the ResourceManager base path, empty if
+	// the material has no such texture
+	
+	std::string diffuseMap; // map_Kd
+	std::string specularMap; // map_Ks
+	std::string normalMap; // map_Bump, bump or norm
+	std::string alphaMap; // map_d
+	
+	// Filled by LoadMaterialTextures()
+	
+	std::shared_ptr<Texture> diffuseTexture;
+	std::shared_ptr<Texture> specularTexture;
+	std::shared_ptr<Texture> normalTexture;
+	std::shared_ptr<Texture> alphaTexture;
+};
+
+std::vector<MaterialData> LoadMTL(ResourceReference file);
+
+/// Loads the material libraries of the mesh, resolved relative to the mesh
+/// file. The result is indexed like MeshData::materialNames, materials
+/// missing from the libraries keep the default values
+std::vector<MaterialData> LoadMeshMaterials(
+	ResourceReference meshFile, const MeshData &mesh);
+
+/// Loads every texture referenced by the materials. A file referenced by
+/// several materials is decoded and uploaded once, and shared between them.
+/// Files are decoded on numThreads worker threads, see LoadTextures()
+void LoadMaterialTextures(
+	std::shared_ptr<Device> device,
+	std::vector<MaterialData> &materials,
+	uint32_t numThreads = 0);
+
+}
@@ -1,10 +1,15 @@
 #include "loadobj.hpp"
+#include "loadsmesh.hpp"
 
 #include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/mappedfile.hpp>
+#include <smorgasbord/util/parallel.hpp>
 
 #include <glm/glm.hpp>
 
 #include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <list>
@@ -16,6 +21,520 @@
 
 using namespace Smorgasbord;
 
+enum class OBJLineType
+{
+	Other = 0,
+	Position,
+	Normal,
+	TexCoord,
+	Face,
+	Object, // o
+	Group, // g
+	Material, // usemtl
+	MaterialLibrary // mtllib
+};
+
+/// Line counts gathered before parsing, used to reserve the MeshData arrays
+/// and to decide whether faces reference normals and texture coordinates
+struct OBJLineCounts
+{
+	size_t positions = 0;
+	size_t normals = 0;
+	size_t texCoords = 0;
+	size_t faces = 0;
+};
+
+/// A sub-mesh statement and the number of faces preceding it. Statements
+/// are rare, so they are collected during the count pass, and the ranges
+/// are built from them without involving the parse pass
+struct OBJStatement
+{
+	OBJLineType type = OBJLineType::Other;
+	size_t faceIndex = 0;
+	std::string name;
+};
+
+inline bool IsOBJSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char *SkipOBJSpaces(const char *s, const char *end)
+{
+	while (s < end && IsOBJSpace(*s))
+	{
+		s++;
+	}
+	
+	return s;
+}
+
+inline const char *SkipOBJToken(const char *s, const char *end)
+{
+	while (s < end && !IsOBJSpace(*s))
+	{
+		s++;
+	}
+	
+	return s;
+}
+
+/// memchr is vectorized in all major C runtimes, so line breaks are
+/// searched for 16-32 bytes at a time
+inline const char *FindOBJLineEnd(const char *s, const char *end)
+{
+	const void *lineEnd = std::memchr(s, '\n', size_t(end - s));
+	return lineEnd != nullptr ? static_cast<const char*>(lineEnd) : end;
+}
+
+inline bool IsOBJKeyword(const char *s, const char *lineEnd, const char *keyword)
+{
+	size_t length = std::strlen(keyword);
+	return size_t(lineEnd - s) > length
+		&& std::memcmp(s, keyword, length) == 0
+		&& IsOBJSpace(s[length]);
+}
+
+/// Expects s to point to the first non-whitespace character of a line.
+/// On a recognised line type, s is advanced past the keyword
+inline OBJLineType GetOBJLineType(const char *&s, const char *lineEnd)
+{
+	if (s >= lineEnd)
+	{
+		return OBJLineType::Other;
+	}
+	
+	const char c0 = s[0];
+	const char c1 = s + 1 < lineEnd ? s[1] : ' ';
+	
+	if (c0 == 'v')
+	{
+		if (IsOBJSpace(c1))
+		{
+			s += 1;
+			return OBJLineType::Position;
+		}
+		
+		const char c2 = s + 2 < lineEnd ? s[2] : ' ';
+		if (IsOBJSpace(c2))
+		{
+			if (c1 == 'n')
+			{
+				s += 2;
+				return OBJLineType::Normal;
+			}
+			
+			if (c1 == 't')
+			{
+				s += 2;
+				return OBJLineType::TexCoord;
+			}
+		}
+	}
+	else if (c0 == 'f' && IsOBJSpace(c1))
+	{
+		s += 1;
+		return OBJLineType::Face;
+	}
+	else if (c0 == 'o' && IsOBJSpace(c1))
+	{
+		s += 1;
+		return OBJLineType::Object;
+	}
+	else if (c0 == 'g' && IsOBJSpace(c1))
+	{
+		s += 1;
+		return OBJLineType::Group;
+	}
+	else if (IsOBJKeyword(s, lineEnd, "usemtl"))
+	{
+		s += 6;
+		return OBJLineType::Material;
+	}
+	else if (IsOBJKeyword(s, lineEnd, "mtllib"))
+	{
+		s += 6;
+		return OBJLineType::MaterialLibrary;
+	}
+	
+	return OBJLineType::Other;
+}
+
+/// Rest of the line without surrounding whitespace. Names may contain
+/// spaces, e.g. multiple group names or file names
+inline std::string GetOBJName(const char *s, const char *lineEnd)
+{
+	s = SkipOBJSpaces(s, lineEnd);
+	while (lineEnd > s && IsOBJSpace(lineEnd[-1]))
+	{
+		lineEnd--;
+	}
+	
+	return std::string(s, lineEnd);
+}
+
+/// statements is optional, if set, sub-mesh statements are appended to it
+/// with faceIndex relative to the start of the text
+inline OBJLineCounts CountOBJLines(
+	const char *s,
+	const char *end,
+	std::vector<OBJStatement> *statements = nullptr)
+{
+	OBJLineCounts counts;
+	
+	while (s < end)
+	{
+		const char *lineEnd = FindOBJLineEnd(s, end);
+		const char *lineStart = SkipOBJSpaces(s, lineEnd);
+		
+		OBJLineType lineType = GetOBJLineType(lineStart, lineEnd);
+		switch (lineType)
+		{
+		case OBJLineType::Position:
+			counts.positions++;
+			break;
+		case OBJLineType::Normal:
+			counts.normals++;
+			break;
+		case OBJLineType::TexCoord:
+			counts.texCoords++;
+			break;
+		case OBJLineType::Face:
+			counts.faces++;
+			break;
+		case OBJLineType::Object:
+		case OBJLineType::Group:
+		case OBJLineType::Material:
+		case OBJLineType::MaterialLibrary:
+			if (statements != nullptr)
+			{
+				OBJStatement statement;
+				statement.type = lineType;
+				statement.faceIndex = counts.faces;
+				statement.name = GetOBJName(lineStart, lineEnd);
+				statements->push_back(std::move(statement));
+			}
+			break;
+		case OBJLineType::Other:
+			break;
+		}
+		
+		s = lineEnd + 1;
+	}
+	
+	return counts;
+}
+
+/// Splits the faces into ranges at every statement changing the object,
+/// group or material. Statements that don't change the state, or that
+/// aren't followed by faces, don't produce a new range
+inline void BuildOBJRanges(
+	const std::vector<OBJStatement> &statements,
+	size_t numFaces,
+	MeshData &mesh)
+{
+	std::map<std::string, int32_t> materialIndices;
+	MeshRange current;
+	
+	auto closeRange = [&](size_t faceIndex)
+	{
+		if (faceIndex > current.firstFace)
+		{
+			current.numFaces = uint32_t(faceIndex - current.firstFace);
+			
+			if (!mesh.ranges.empty() && mesh.ranges.back().HasSameState(current))
+			{
+				mesh.ranges.back().numFaces += current.numFaces;
+			}
+			else
+			{
+				mesh.ranges.push_back(current);
+			}
+		}
+		
+		current.firstFace = uint32_t(faceIndex);
+		current.numFaces = 0;
+	};
+	
+	for (const OBJStatement &statement : statements)
+	{
+		switch (statement.type)
+		{
+		case OBJLineType::Object:
+			closeRange(statement.faceIndex);
+			current.object = statement.name;
+			current.group.clear(); // groups are local to an object
+			break;
+		
+		case OBJLineType::Group:
+			closeRange(statement.faceIndex);
+			current.group = statement.name;
+			break;
+		
+		case OBJLineType::Material:
+		{
+			closeRange(statement.faceIndex);
+			
+			auto it = materialIndices.find(statement.name);
+			if (it == materialIndices.end())
+			{
+				it = materialIndices.emplace(
+					statement.name, int32_t(mesh.materialNames.size())).first;
+				mesh.materialNames.push_back(statement.name);
+			}
+			
+			current.materialIndex = it->second;
+			break;
+		}
+		
+		case OBJLineType::MaterialLibrary:
+			mesh.materialLibraries.push_back(statement.name);
+			break;
+		
+		default:
+			break;
+		}
+	}
+	
+	closeRange(numFaces);
+}
+
+inline const char *ParseOBJFloat(const char *s, const char *end, float &value)
+{
+	s = SkipOBJSpaces(s, end);
+	
+	/// from_chars() doesn't accept an explicit plus sign
+	if (s < end && *s == '+')
+	{
+		s++;
+	}
+	
+	std::from_chars_result result = std::from_chars(s, end, value);
+	if (result.ec != std::errc())
+	{
+		value = 0.0f;
+		return result.ptr != s ? result.ptr : SkipOBJToken(s, end);
+	}
+	
+	return result.ptr;
+}
+
+/// Resolved index of a face corner referring to no element
+const uint32_t invalidOBJIndex = ~0u;
+
+/// Leaves index unchanged if there is no valid index at s
+inline const char *ParseOBJIndex(const char *s, const char *end, int64_t &index)
+{
+	if (s < end && *s == '+')
+	{
+		s++;
+	}
+	
+	int64_t value = 0;
+	std::from_chars_result result = std::from_chars(s, end, value);
+	if (result.ec == std::errc())
+	{
+		index = value;
+	}
+	
+	return result.ptr;
+}
+
+/// OBJ indexes from 1, negative indices are relative to the end of the list
+/// read so far. 0 and indices before the first element resolve to
+/// invalidOBJIndex. Indices past the last element can't be told apart from
+/// references to later lines here, all of them are checked by
+/// AreOBJIndicesValid() once the element counts are known
+inline uint32_t ResolveOBJIndex(int64_t index, size_t count)
+{
+	if (index > 0 && index <= int64_t(invalidOBJIndex))
+	{
+		return uint32_t(index - 1);
+	}
+	
+	if (index < 0 && -index <= int64_t(count))
+	{
+		return uint32_t(int64_t(count) + index);
+	}
+	
+	return invalidOBJIndex;
+}
+
+inline bool AreOBJIndicesValid(
+	const std::vector<uint32_t> &indices, size_t count)
+{
+	return std::all_of(
+		indices.begin(),
+		indices.end(),
+		[count](uint32_t index) { return index < count; });
+}
+
+/// counts are the element counts of the whole file
+inline bool AreOBJIndicesValid(const MeshData &mesh, const OBJLineCounts &counts)
+{
+	return AreOBJIndicesValid(mesh.fp, counts.positions)
+		&& AreOBJIndicesValid(mesh.fn, counts.normals)
+		&& AreOBJIndicesValid(mesh.ft, counts.texCoords);
+}
+
+/// base holds the number of elements preceding the parsed text, so relative
+/// indices resolve to the same global index in every chunk
+inline void ParseOBJFace(
+	const char *s,
+	const char *lineEnd,
+	MeshData &mesh,
+	const OBJLineCounts &base,
+	bool hasNormal,
+	bool hasTexCoord)
+{
+	int32_t n = 0;
+	
+	s = SkipOBJSpaces(s, lineEnd);
+	while (s < lineEnd)
+	{
+		/// OBJ stores indices in the following order:
+		/// position index / texture coordinate index / normal index
+		/// The latter two are optional, e.g. "1", "1/2", "1//3", "1/2/3".
+		/// A missing position index is invalid, missing texture coordinate
+		/// and normal indices fall back to the first element
+		
+		int64_t pi = 0; // vertex index
+		int64_t ti = 1; // texture coordinate index
+		int64_t ni = 1; // normal index
+		
+		s = ParseOBJIndex(s, lineEnd, pi);
+		if (s < lineEnd && *s == '/')
+		{
+			s = ParseOBJIndex(s + 1, lineEnd, ti);
+			if (s < lineEnd && *s == '/')
+			{
+				s = ParseOBJIndex(s + 1, lineEnd, ni);
+			}
+		}
+		
+		mesh.fp.push_back(ResolveOBJIndex(
+			pi, base.positions + mesh.p.size()));
+		
+		if (hasTexCoord)
+		{
+			mesh.ft.push_back(ResolveOBJIndex(
+				ti, base.texCoords + mesh.t.size()));
+		}
+		
+		if (hasNormal)
+		{
+			mesh.fn.push_back(ResolveOBJIndex(
+				ni, base.normals + mesh.n.size()));
+		}
+		
+		n++;
+		
+		s = SkipOBJSpaces(SkipOBJToken(s, lineEnd), lineEnd);
+	}
+	
+	mesh.c.push_back(n);
+}
+
+inline OBJLineType ParseOBJLine(
+	const char *s,
+	const char *lineEnd,
+	MeshData &mesh,
+	const OBJLineCounts &base,
+	bool hasNormal,
+	bool hasTexCoord)
+{
+	s = SkipOBJSpaces(s, lineEnd);
+	
+	glm::vec3 value;
+	OBJLineType lineType = GetOBJLineType(s, lineEnd);
+	switch (lineType)
+	{
+	case OBJLineType::Position:
+		s = ParseOBJFloat(s, lineEnd, value.x);
+		s = ParseOBJFloat(s, lineEnd, value.y);
+		s = ParseOBJFloat(s, lineEnd, value.z);
+		mesh.p.push_back(value);
+		break;
+	
+	case OBJLineType::Normal:
+		s = ParseOBJFloat(s, lineEnd, value.x);
+		s = ParseOBJFloat(s, lineEnd, value.y);
+		s = ParseOBJFloat(s, lineEnd, value.z);
+		mesh.n.push_back(value);
+		break;
+	
+	case OBJLineType::TexCoord:
+		s = ParseOBJFloat(s, lineEnd, value.x);
+		s = ParseOBJFloat(s, lineEnd, value.y);
+		value.y = 1.0f - value.y; // flip y (obj -> opengl)
+		mesh.t.push_back(glm::vec2(value.x, value.y));
+		break;
+	
+	case OBJLineType::Face:
+		ParseOBJFace(s, lineEnd, mesh, base, hasNormal, hasTexCoord);
+		break;
+	
+	case OBJLineType::Object: // collected by CountOBJLines()
+	case OBJLineType::Group:
+	case OBJLineType::Material:
+	case OBJLineType::MaterialLibrary:
+	case OBJLineType::Other: // comments and unsupported statements
+		break;
+	}
+	
+	return lineType;
+}
+
+/// Appends the contents of the text to mesh. counts are the line counts of
+/// the text, used to reserve memory, base is as in ParseOBJFace()
+inline void ParseOBJText(
+	const char *s,
+	const char *end,
+	MeshData &mesh,
+	const OBJLineCounts &counts,
+	const OBJLineCounts &base,
+	bool hasNormal,
+	bool hasTexCoord)
+{
+	/// Triangles are the common case, the index arrays may still grow
+	/// for larger faces
+	mesh.p.reserve(mesh.p.size() + counts.positions);
+	mesh.n.reserve(mesh.n.size() + counts.normals);
+	mesh.t.reserve(mesh.t.size() + counts.texCoords);
+	mesh.c.reserve(mesh.c.size() + counts.faces);
+	mesh.fp.reserve(mesh.fp.size() + counts.faces * 3);
+	mesh.fn.reserve(mesh.fn.size() + (hasNormal ? counts.faces * 3 : 0));
+	mesh.ft.reserve(mesh.ft.size() + (hasTexCoord ? counts.faces * 3 : 0));
+	
+	while (s < end)
+	{
+		const char *lineEnd = FindOBJLineEnd(s, end);
+		ParseOBJLine(s, lineEnd, mesh, base, hasNormal, hasTexCoord);
+		s = lineEnd + 1;
+	}
+}
+
+/// Moves the start of the range forward to the start of the next line,
+/// unless it's already at a line start
+inline const char *AlignOBJChunkStart(
+	const char *text, const char *s, const char *end)
+{
+	if (s <= text || s >= end || s[-1] == '\n')
+	{
+		return s;
+	}
+	
+	const char *lineEnd = FindOBJLineEnd(s, end);
+	return lineEnd < end ? lineEnd + 1 : end;
+}
+
+template<typename T>
+inline void CopyOBJFragment(
+	const std::vector<T> &source, std::vector<T> &target, size_t offset)
+{
+	std::copy(source.begin(), source.end(), target.begin() + offset);
+}
+
 std::unique_ptr<Smorgasbord::MeshData> Smorgasbord::LoadOBJ(
 	std::unique_ptr<std::istream> _file)
 {
@@ -139,6 +658,300 @@ std::unique_ptr<Smorgasbord::MeshData> Smorgasbord::LoadOBJ(
 	
 	_file.reset(); //file.close();
 	
+	OBJLineCounts counts;
+	counts.positions = mesh.p.size();
+	counts.normals = mesh.n.size();
+	counts.texCoords = mesh.t.size();
+	if (!AreOBJIndicesValid(mesh, counts))
+	{
+		LogE("OBJ face index out of range, returning empty mesh");
+		return std::unique_ptr<MeshData>(new MeshData());
+	}
+	
+	meshData->UpdateStatistics();
+	return meshData;
+}
+
+
+std::unique_ptr<Smorgasbord::MeshData> Smorgasbord::LoadOBJ(
+	ResourceReference file, uint32_t numThreads)
+{
+	std::unique_ptr<MappedFile> mappedFile = file.OpenMapped();
+	
+	if (!static_cast<bool>(mappedFile))
+	{
+		LogE("Couldn't open OBJ file, returning empty mesh");
+		return std::unique_ptr<MeshData>(new MeshData());
+	}
+	
+	return LoadOBJ(mappedFile->GetText(), mappedFile->GetSize(), numThreads);
+}
+
+std::unique_ptr<Smorgasbord::MeshData> Smorgasbord::LoadOBJCached(
+	ResourceReference file, uint32_t numThreads)
+{
+	MeshCacheKey key = GetMeshCacheKey(file);
+	
+	/// Get() resolves paths relative to the directory of the reference
+	const std::string &path = file.GetPath();
+	std::string fileName = path.substr(path.find_last_of("\\/:") + 1);
+	ResourceReference cacheFile = file.Get(fileName + ".smesh");
+	
+	std::unique_ptr<MeshData> meshData = LoadSMesh(cacheFile, key);
+	if (static_cast<bool>(meshData))
+	{
+		return meshData;
+	}
+	
+	meshData = LoadOBJ(file, numThreads);
+	if (!meshData->IsEmpty())
+	{
+		SaveSMesh(*meshData, cacheFile, key);
+	}
+	
+	return meshData;
+}
+
+std::unique_ptr<Smorgasbord::MeshData> Smorgasbord::LoadOBJ(
+	const char *text, size_t size, uint32_t numThreads)
+{
+	/// Below this, thread startup costs more than what parsing in
+	/// parallel could save
+	const size_t minChunkSize = 1 << 20;
+	
+	std::unique_ptr<MeshData> meshData(new MeshData());
+	MeshData &mesh = *meshData;
+	
+	const char *end = text + size;
+	
+	// Split text into chunks at line boundaries
+	
+	const size_t numChunks = std::max<size_t>(1, std::min<size_t>(
+		ResolveThreadCount(numThreads), size / minChunkSize));
+	
+	std::vector<const char*> chunkStarts(numChunks + 1);
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		chunkStarts[i] = AlignOBJChunkStart(
+			text, text + size * i / numChunks, end);
+	}
+	chunkStarts[numChunks] = end;
+	
+	// Count pass
+	
+	std::vector<OBJLineCounts> chunkCounts(numChunks);
+	std::vector<std::vector<OBJStatement>> chunkStatements(numChunks);
+	ParallelFor(
+		numChunks,
+		[&](size_t i)
+		{
+			chunkCounts[i] = CountOBJLines(
+				chunkStarts[i], chunkStarts[i + 1], &chunkStatements[i]);
+		},
+		numThreads);
+	
+	/// Exclusive prefix sum of the element counts, needed to resolve
+	/// relative indices and to place the chunks in the merged arrays
+	std::vector<OBJLineCounts> chunkBases(numChunks);
+	OBJLineCounts total;
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		chunkBases[i] = total;
+		total.positions += chunkCounts[i].positions;
+		total.normals += chunkCounts[i].normals;
+		total.texCoords += chunkCounts[i].texCoords;
+		total.faces += chunkCounts[i].faces;
+	}
+	
+	bool hasNormal = total.normals > 0;
+	bool hasTexCoord = total.texCoords > 0;
+	
+	// Sub-mesh ranges
+	
+	std::vector<OBJStatement> statements;
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		for (OBJStatement &statement : chunkStatements[i])
+		{
+			statement.faceIndex += chunkBases[i].faces;
+			statements.push_back(std::move(statement));
+		}
+	}
+	
+	BuildOBJRanges(statements, total.faces, mesh);
+	
+	// Parse pass
+	
+	if (numChunks == 1)
+	{
+		ParseOBJText(
+			text, end, mesh, total, { }, hasNormal, hasTexCoord);
+		
+		if (!AreOBJIndicesValid(mesh, total))
+		{
+			LogE("OBJ face index out of range, returning empty mesh");
+			return std::unique_ptr<MeshData>(new MeshData());
+		}
+		
+		meshData->UpdateStatistics();
+		return meshData;
+	}
+	
+	std::vector<MeshData> fragments(numChunks);
+	ParallelFor(
+		numChunks,
+		[&](size_t i)
+		{
+			ParseOBJText(
+				chunkStarts[i], chunkStarts[i + 1],
+				fragments[i],
+				chunkCounts[i], chunkBases[i],
+				hasNormal, hasTexCoord);
+		},
+		numThreads);
+	
+	/// Indices are global, so every fragment is checked against the totals
+	std::vector<uint8_t> fragmentValid(numChunks);
+	ParallelFor(
+		numChunks,
+		[&](size_t i)
+		{
+			fragmentValid[i] = AreOBJIndicesValid(fragments[i], total);
+		},
+		numThreads);
+	
+	if (std::find(fragmentValid.begin(), fragmentValid.end(), 0)
+		!= fragmentValid.end())
+	{
+		LogE("OBJ face index out of range, returning empty mesh");
+		return std::unique_ptr<MeshData>(new MeshData());
+	}
+	
+	// Merge pass
+	
+	/// Face indices are already global, the faces only need to be
+	/// concatenated. The number of face corners per chunk is only known
+	/// after parsing
+	std::vector<size_t> cornerBases(numChunks);
+	size_t totalCorners = 0;
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		cornerBases[i] = totalCorners;
+		totalCorners += fragments[i].fp.size();
+	}
+	
+	mesh.p.resize(total.positions);
+	mesh.n.resize(total.normals);
+	mesh.t.resize(total.texCoords);
+	mesh.c.resize(total.faces);
+	mesh.fp.resize(totalCorners);
+	mesh.fn.resize(hasNormal ? totalCorners : 0);
+	mesh.ft.resize(hasTexCoord ? totalCorners : 0);
+	
+	ParallelFor(
+		numChunks,
+		[&](size_t i)
+		{
+			MeshData &fragment = fragments[i];
+			CopyOBJFragment(fragment.p, mesh.p, chunkBases[i].positions);
+			CopyOBJFragment(fragment.n, mesh.n, chunkBases[i].normals);
+			CopyOBJFragment(fragment.t, mesh.t, chunkBases[i].texCoords);
+			CopyOBJFragment(fragment.c, mesh.c, chunkBases[i].faces);
+			CopyOBJFragment(fragment.fp, mesh.fp, cornerBases[i]);
+			CopyOBJFragment(fragment.fn, mesh.fn, cornerBases[i]);
+			CopyOBJFragment(fragment.ft, mesh.ft, cornerBases[i]);
+			
+			/// Release memory as early as possible
+			fragment = MeshData();
+		},
+		numThreads);
+	
 	meshData->UpdateStatistics();
 	return meshData;
 }
+
+bool Smorgasbord::LoadOBJStreaming(
+	ResourceReference file,
+	size_t facesPerBatch,
+	const OBJStreamStartCallback &onStart,
+	const OBJStreamBatchCallback &onBatch)
+{
+	std::unique_ptr<MappedFile> mappedFile = file.OpenMapped();
+	
+	if (!static_cast<bool>(mappedFile))
+	{
+		LogE("Couldn't open OBJ file");
+		return false;
+	}
+	
+	const char *s = mappedFile->GetText();
+	const char *end = s + mappedFile->GetSize();
+	
+	// Count pass
+	
+	OBJLineCounts counts = CountOBJLines(s, end);
+	
+	OBJStreamInfo info;
+	info.numPositions = counts.positions;
+	info.numNormals = counts.normals;
+	info.numTexCoords = counts.texCoords;
+	info.numFaces = counts.faces;
+	info.hasNormal = counts.normals > 0;
+	info.hasTexCoord = counts.texCoords > 0;
+	
+	if (onStart)
+	{
+		onStart(info);
+	}
+	
+	// Parse pass
+	
+	facesPerBatch = std::max<size_t>(facesPerBatch, 1);
+	
+	MeshData batch;
+	batch.p.reserve(counts.positions);
+	batch.n.reserve(counts.normals);
+	batch.t.reserve(counts.texCoords);
+	batch.c.reserve(facesPerBatch);
+	
+	while (s < end)
+	{
+		const char *lineEnd = FindOBJLineEnd(s, end);
+		
+		OBJLineType lineType = ParseOBJLine(
+			s, lineEnd, batch, { }, info.hasNormal, info.hasTexCoord);
+		
+		if (lineType == OBJLineType::Face && batch.c.size() >= facesPerBatch)
+		{
+			if (!AreOBJIndicesValid(batch, counts))
+			{
+				LogE("OBJ face index out of range");
+				return false;
+			}
+			
+			onBatch(batch);
+			
+			/// Keep the attributes, faces of later batches may refer
+			/// to any of them, see the limitation in loadobj.hpp
+			batch.c.clear();
+			batch.fp.clear();
+			batch.fn.clear();
+			batch.ft.clear();
+		}
+		
+		s = lineEnd + 1;
+	}
+	
+	if (batch.c.size() > 0)
+	{
+		if (!AreOBJIndicesValid(batch, counts))
+		{
+			LogE("OBJ face index out of range");
+			return false;
+		}
+		
+		onBatch(batch);
+	}
+	
+	return true;
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <smorgasbord/rendering/staticmesh.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -9,4 +11,57 @@ namespace Smorgasbord {
 
 std::unique_ptr<MeshData> LoadOBJ(std::unique_ptr<std::istream> file);
 
+/// Memory maps the file and parses it in place, without per line or per
+/// token string copies.
+/// numThreads > 1 splits the file into chunks at line boundaries and parses
+/// them in parallel. 0 uses all hardware threads. The result is identical
+/// to the single threaded one.
+/// Returns an empty mesh if a face refers to an element the file doesn't
+/// have
+std::unique_ptr<MeshData> LoadOBJ(
+	ResourceReference file, uint32_t numThreads = 1);
+
+/// Loads "<file>.smesh" from next to the OBJ file if it was built from the
+/// current version of the file, otherwise loads the OBJ file and writes the
+/// cache for subsequent loads. See loadsmesh.hpp
+std::unique_ptr<MeshData> LoadOBJCached(
+	ResourceReference file, uint32_t numThreads = 1);
+
+/// Totals of the file, known before the first batch of LoadOBJStreaming()
+struct OBJStreamInfo
+{
+	size_t numPositions = 0;
+	size_t numNormals = 0;
+	size_t numTexCoords = 0;
+	size_t numFaces = 0;
+	bool hasNormal = false;
+	bool hasTexCoord = false;
+};
+
+using OBJStreamStartCallback = std::function<void(const OBJStreamInfo&)>;
+using OBJStreamBatchCallback = std::function<void(const MeshData&)>;
+
+/// Streaming variant of LoadOBJ(). Calls onStart once with the totals, then
+/// onBatch for every facesPerBatch faces, and for the remaining faces at
+/// the end.
+/// In a batch, p, n and t hold every attribute read so far, while c, fp,
+/// fn and ft only hold the faces of the batch, so face memory is bounded
+/// by the batch size. Attribute memory is not: faces may refer to any
+/// attribute before them, so p, n and t grow to the totals of the file and
+/// are kept until the end, and peak memory is all attributes plus one batch
+/// of faces. Statistics are not calculated for batches.
+/// Batches can be uploaded with StaticMesh::Append() into a StaticMesh
+/// created with room for OBJStreamInfo::numFaces. Returns false without
+/// calling onBatch for a batch with a face index out of range
+bool LoadOBJStreaming(
+	ResourceReference file,
+	size_t facesPerBatch,
+	const OBJStreamStartCallback &onStart,
+	const OBJStreamBatchCallback &onBatch);
+
+/// Parses OBJ text already in memory. The text doesn't need to be null
+/// terminated
+std::unique_ptr<MeshData> LoadOBJ(
+	const char *text, size_t size, uint32_t numThreads = 1);
+
 }
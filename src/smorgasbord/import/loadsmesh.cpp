@@ -0,0 +1,441 @@
+#include "loadsmesh.hpp"
+
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/mappedfile.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+using namespace Smorgasbord;
+
+static_assert(sizeof(glm::vec3) == 12, "glm::vec3 must be tightly packed");
+static_assert(sizeof(glm::vec2) == 8, "glm::vec2 must be tightly packed");
+
+const uint32_t smeshVersion = 3;
+const size_t smeshAlignment = 16;
+
+enum SMeshArray
+{
+	SMeshArrayP = 0,
+	SMeshArrayN,
+	SMeshArrayT,
+	SMeshArrayC,
+	SMeshArrayFP,
+	SMeshArrayFN,
+	SMeshArrayFT,
+	SMeshArraySourceFaces,
+	SMeshArrayNum
+};
+
+struct SMeshHeader
+{
+	char magic[4] = { 'S', 'M', 'S', 'H' };
+	uint32_t version = smeshVersion;
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	uint64_t arraySizes[SMeshArrayNum] = { }; // in elements
+	uint64_t polyCount = 0;
+	uint64_t vertCount = 0;
+	int32_t minVerticesPerFace = 0;
+	int32_t maxVerticesPerFace = 0;
+	float boundingMin[3] = { };
+	float boundingMax[3] = { };
+	float boundingCenter[3] = { };
+	float boundingScale = 0;
+};
+
+inline size_t AlignSMeshOffset(size_t offset)
+{
+	return (offset + smeshAlignment - 1) & ~(smeshAlignment - 1);
+}
+
+inline size_t GetSMeshElementSize(SMeshArray array)
+{
+	switch (array)
+	{
+	case SMeshArrayP:
+	case SMeshArrayN:
+		return sizeof(glm::vec3);
+	case SMeshArrayT:
+		return sizeof(glm::vec2);
+	case SMeshArrayC:
+		return sizeof(int32_t);
+	case SMeshArrayFP:
+	case SMeshArrayFN:
+	case SMeshArrayFT:
+	case SMeshArraySourceFaces:
+		return sizeof(uint32_t);
+	case SMeshArrayNum:
+		break;
+	}
+	
+	return 0;
+}
+
+/// Bulk copy straight from the mapped file, no per element conversion
+template<typename T>
+inline void ReadSMeshArray(
+	const uint8_t *data, size_t offset, uint64_t size, std::vector<T> &target)
+{
+	target.resize(size_t(size));
+	if (size > 0)
+	{
+		std::memcpy(target.data(), &data[offset], size_t(size) * sizeof(T));
+	}
+}
+
+template<typename T>
+inline void WriteSMeshArray(
+	std::ostream &file, size_t &offset, const std::vector<T> &source)
+{
+	static const char padding[smeshAlignment] = { };
+	size_t alignedOffset = AlignSMeshOffset(offset);
+	file.write(padding, std::streamsize(alignedOffset - offset));
+	
+	size_t size = source.size() * sizeof(T);
+	file.write(reinterpret_cast<const char*>(source.data()), std::streamsize(size));
+	offset = alignedOffset + size;
+}
+
+/// Sequential reader for the variable sized sub-mesh section, fails
+/// instead of reading past the end of the file
+struct SMeshReader
+{
+	const uint8_t *data = nullptr;
+	size_t offset = 0;
+	size_t size = 0;
+	bool failed = false;
+	
+	template<typename T>
+	T Read()
+	{
+		T value = T();
+		if (failed || offset > size || size - offset < sizeof(T))
+		{
+			failed = true;
+			return value;
+		}
+		
+		std::memcpy(&value, &data[offset], sizeof(T));
+		offset += sizeof(T);
+		return value;
+	}
+	
+	std::string ReadString()
+	{
+		uint32_t length = Read<uint32_t>();
+		if (failed || offset > size || size - offset < length)
+		{
+			failed = true;
+			return { };
+		}
+		
+		std::string value(reinterpret_cast<const char*>(&data[offset]), length);
+		offset += length;
+		return value;
+	}
+	
+	std::vector<std::string> ReadStrings()
+	{
+		uint64_t count = Read<uint64_t>();
+		std::vector<std::string> values;
+		for (uint64_t i = 0; i < count && !failed; i++)
+		{
+			values.push_back(ReadString());
+		}
+		
+		return values;
+	}
+};
+
+inline bool IsValidSMeshIndices(
+	const std::vector<uint32_t> &indices, size_t numElements)
+{
+	for (uint32_t index : indices)
+	{
+		if (index >= numElements)
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+/// Checked once after loading, so nothing downstream indexes past the
+/// arrays of a corrupted file
+inline bool IsValidSMeshData(const MeshData &mesh)
+{
+	uint64_t numCorners = 0;
+	for (int32_t count : mesh.c)
+	{
+		if (count < 0)
+		{
+			return false;
+		}
+		
+		numCorners += uint64_t(count);
+	}
+	
+	for (const MeshRange &range : mesh.ranges)
+	{
+		if (range.firstFace > mesh.c.size()
+			|| range.numFaces > mesh.c.size() - range.firstFace
+			|| range.materialIndex < -1
+			|| (range.materialIndex >= 0
+				&& size_t(range.materialIndex) >= mesh.materialNames.size()))
+		{
+			return false;
+		}
+	}
+	
+	/// Normal and texture coordinate indices are optional, as are the
+	/// source faces of a triangulated mesh
+	return numCorners == mesh.fp.size()
+		&& (mesh.sourceFaces.empty() || mesh.sourceFaces.size() == mesh.c.size())
+		&& (mesh.fn.empty() || mesh.fn.size() == mesh.fp.size())
+		&& (mesh.ft.empty() || mesh.ft.size() == mesh.fp.size())
+		&& IsValidSMeshIndices(mesh.fp, mesh.p.size())
+		&& IsValidSMeshIndices(mesh.fn, mesh.n.size())
+		&& IsValidSMeshIndices(mesh.ft, mesh.t.size());
+}
+
+template<typename T>
+inline void WriteSMeshValue(std::ostream &file, const T &value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void WriteSMeshString(std::ostream &file, const std::string &value)
+{
+	WriteSMeshValue(file, uint32_t(value.size()));
+	file.write(value.data(), std::streamsize(value.size()));
+}
+
+inline void WriteSMeshStrings(
+	std::ostream &file, const std::vector<std::string> &values)
+{
+	WriteSMeshValue(file, uint64_t(values.size()));
+	for (const std::string &value : values)
+	{
+		WriteSMeshString(file, value);
+	}
+}
+
+Smorgasbord::MeshCacheKey Smorgasbord::GetMeshCacheKey(ResourceReference source)
+{
+	MeshCacheKey key;
+	std::string path = source.GetFullPath();
+	std::error_code error;
+	
+	key.sourceSize = uint64_t(std::filesystem::file_size(path, error));
+	if (error)
+	{
+		return { };
+	}
+	
+	key.sourceTime = int64_t(std::filesystem::last_write_time(path, error)
+		.time_since_epoch().count());
+	if (error)
+	{
+		return { };
+	}
+	
+	return key;
+}
+
+std::unique_ptr<Smorgasbord::MeshData> Smorgasbord::LoadSMesh(
+	ResourceReference file, const MeshCacheKey &key)
+{
+	/// A missing cache is not an error, avoid the error log of OpenMapped()
+	std::error_code error;
+	if (!std::filesystem::exists(file.GetFullPath(), error))
+	{
+		return { };
+	}
+	
+	std::unique_ptr<MappedFile> mappedFile = file.OpenMapped();
+	if (!static_cast<bool>(mappedFile)
+		|| mappedFile->GetSize() < sizeof(SMeshHeader))
+	{
+		return { };
+	}
+	
+	const uint8_t *data = mappedFile->GetData();
+	SMeshHeader header;
+	std::memcpy(&header, data, sizeof(SMeshHeader));
+	
+	if (std::memcmp(header.magic, SMeshHeader().magic, 4) != 0
+		|| header.version != smeshVersion)
+	{
+		LogW("Not a compatible smesh file: {0}", file.GetPath());
+		return { };
+	}
+	
+	if (header.sourceSize != key.sourceSize
+		|| header.sourceTime != key.sourceTime)
+	{
+		return { };
+	}
+	
+	// Validate array sizes against the file size
+	
+	size_t offsets[SMeshArrayNum];
+	const size_t fileSize = mappedFile->GetSize();
+	size_t offset = sizeof(SMeshHeader);
+	for (uint32_t i = 0; i < SMeshArrayNum; i++)
+	{
+		/// Sizes come from the file, compare by division so they can't wrap
+		const size_t elementSize = GetSMeshElementSize(SMeshArray(i));
+		offsets[i] = AlignSMeshOffset(offset);
+		if (offsets[i] > fileSize
+			|| header.arraySizes[i] > (fileSize - offsets[i]) / elementSize)
+		{
+			LogW("Truncated smesh file: {0}", file.GetPath());
+			return { };
+		}
+		
+		offset = offsets[i] + size_t(header.arraySizes[i]) * elementSize;
+	}
+	
+	// Read arrays
+	
+	std::unique_ptr<MeshData> meshData(new MeshData());
+	MeshData &mesh = *meshData;
+	
+	ReadSMeshArray(data, offsets[SMeshArrayP], header.arraySizes[SMeshArrayP], mesh.p);
+	ReadSMeshArray(data, offsets[SMeshArrayN], header.arraySizes[SMeshArrayN], mesh.n);
+	ReadSMeshArray(data, offsets[SMeshArrayT], header.arraySizes[SMeshArrayT], mesh.t);
+	ReadSMeshArray(data, offsets[SMeshArrayC], header.arraySizes[SMeshArrayC], mesh.c);
+	ReadSMeshArray(data, offsets[SMeshArrayFP], header.arraySizes[SMeshArrayFP], mesh.fp);
+	ReadSMeshArray(data, offsets[SMeshArrayFN], header.arraySizes[SMeshArrayFN], mesh.fn);
+	ReadSMeshArray(data, offsets[SMeshArrayFT], header.arraySizes[SMeshArrayFT], mesh.ft);
+	ReadSMeshArray(
+		data,
+		offsets[SMeshArraySourceFaces],
+		header.arraySizes[SMeshArraySourceFaces],
+		mesh.sourceFaces);
+	
+	// Read sub-meshes
+	
+	SMeshReader reader;
+	reader.data = data;
+	reader.offset = AlignSMeshOffset(offset);
+	reader.size = fileSize;
+	
+	uint64_t numRanges = reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < numRanges && !reader.failed; i++)
+	{
+		MeshRange range;
+		range.firstFace = reader.Read<uint32_t>();
+		range.numFaces = reader.Read<uint32_t>();
+		range.materialIndex = reader.Read<int32_t>();
+		range.object = reader.ReadString();
+		range.group = reader.ReadString();
+		mesh.ranges.push_back(std::move(range));
+	}
+	
+	mesh.materialNames = reader.ReadStrings();
+	mesh.materialLibraries = reader.ReadStrings();
+	
+	if (reader.failed)
+	{
+		LogW("Truncated smesh file: {0}", file.GetPath());
+		return { };
+	}
+	
+	if (!IsValidSMeshData(mesh))
+	{
+		LogW("Invalid smesh file: {0}", file.GetPath());
+		return { };
+	}
+	
+	/// Statistics are stored, so no need for UpdateStatistics()
+	mesh.polyCount = size_t(header.polyCount);
+	mesh.vertCount = size_t(header.vertCount);
+	mesh.minVerticesPerFace = header.minVerticesPerFace;
+	mesh.maxVerticesPerFace = header.maxVerticesPerFace;
+	mesh.boundingMin = glm::vec3(
+		header.boundingMin[0], header.boundingMin[1], header.boundingMin[2]);
+	mesh.boundingMax = glm::vec3(
+		header.boundingMax[0], header.boundingMax[1], header.boundingMax[2]);
+	mesh.boundingCenter = glm::vec3(
+		header.boundingCenter[0],
+		header.boundingCenter[1],
+		header.boundingCenter[2]);
+	mesh.boundingScale = header.boundingScale;
+	
+	return meshData;
+}
+
+bool Smorgasbord::SaveSMesh(
+	const MeshData &mesh, ResourceReference file, const MeshCacheKey &key)
+{
+	std::unique_ptr<std::ostream> stream = file.OpenWrite();
+	if (!static_cast<bool>(stream))
+	{
+		return false;
+	}
+	
+	SMeshHeader header;
+	header.sourceSize = key.sourceSize;
+	header.sourceTime = key.sourceTime;
+	header.arraySizes[SMeshArrayP] = mesh.p.size();
+	header.arraySizes[SMeshArrayN] = mesh.n.size();
+	header.arraySizes[SMeshArrayT] = mesh.t.size();
+	header.arraySizes[SMeshArrayC] = mesh.c.size();
+	header.arraySizes[SMeshArrayFP] = mesh.fp.size();
+	header.arraySizes[SMeshArrayFN] = mesh.fn.size();
+	header.arraySizes[SMeshArrayFT] = mesh.ft.size();
+	header.arraySizes[SMeshArraySourceFaces] = mesh.sourceFaces.size();
+	header.polyCount = mesh.polyCount;
+	header.vertCount = mesh.vertCount;
+	header.minVerticesPerFace = mesh.minVerticesPerFace;
+	header.maxVerticesPerFace = mesh.maxVerticesPerFace;
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundingMin[i] = mesh.boundingMin[i];
+		header.boundingMax[i] = mesh.boundingMax[i];
+		header.boundingCenter[i] = mesh.boundingCenter[i];
+	}
+	header.boundingScale = mesh.boundingScale;
+	
+	std::ostream &s = *stream;
+	s.write(reinterpret_cast<const char*>(&header), sizeof(SMeshHeader));
+	
+	size_t offset = sizeof(SMeshHeader);
+	WriteSMeshArray(s, offset, mesh.p);
+	WriteSMeshArray(s, offset, mesh.n);
+	WriteSMeshArray(s, offset, mesh.t);
+	WriteSMeshArray(s, offset, mesh.c);
+	WriteSMeshArray(s, offset, mesh.fp);
+	WriteSMeshArray(s, offset, mesh.fn);
+	WriteSMeshArray(s, offset, mesh.ft);
+	WriteSMeshArray(s, offset, mesh.sourceFaces);
+	WriteSMeshArray(s, offset, std::vector<uint8_t>()); // align
+	
+	WriteSMeshValue(s, uint64_t(mesh.ranges.size()));
+	for (const MeshRange &range : mesh.ranges)
+	{
+		WriteSMeshValue(s, range.firstFace);
+		WriteSMeshValue(s, range.numFaces);
+		WriteSMeshValue(s, range.materialIndex);
+		WriteSMeshString(s, range.object);
+		WriteSMeshString(s, range.group);
+	}
+	
+	WriteSMeshStrings(s, mesh.materialNames);
+	WriteSMeshStrings(s, mesh.materialLibraries);
+	
+	if (!s.good())
+	{
+		LogE("Failed writing smesh file: {0}", file.GetPath());
+		return false;
+	}
+	
+	return true;
+}
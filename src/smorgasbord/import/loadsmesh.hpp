@@ -0,0 +1,64 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
+
+#include <memory>
+#include <string>
+
+/*
+
+# SMesh binary mesh format #
+
+A MeshData snapshot meant to be memory mapped and loaded without parsing.
+All values are little endian.
+	
+	SMeshHeader
+	p, n, t, c, fp, fn, ft, sourceFaces arrays, in this order, each
+		starting at a 16 byte aligned offset from the beginning of the file
+	sub-mesh section, 16 byte aligned:
+		uint64 range count, then per range:
+			uint32 firstFace, uint32 numFaces, int32 materialIndex,
+			string object, string group
+		uint64 material name count, strings
+		uint64 material library count, strings
+	where a string is a uint32 byte length followed by the bytes
+
+The header stores the statistics calculated by MeshData::UpdateStatistics(),
+and a key identifying the version of the source file the cache was built
+from. A cache with a mismatching key or version is considered stale.
+Array sizes are checked against the file size, and indices, face vertex
+counts, ranges and their materials against the arrays they refer to,
+before a cache is used, so a corrupted cache is rejected instead of read.
+
+*/
+
+namespace Smorgasbord {
+
+/// Identifies a version of a source file by its size and last write time
+struct MeshCacheKey
+{
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	
+	bool operator==(const MeshCacheKey &b) const
+	{
+		return sourceSize == b.sourceSize && sourceTime == b.sourceTime;
+	}
+	
+	bool operator!=(const MeshCacheKey &b) const
+	{
+		return !(*this == b);
+	}
+};
+
+MeshCacheKey GetMeshCacheKey(ResourceReference source);
+
+/// Returns nullptr if the file doesn't exist, is invalid, or was built from
+/// a source not matching the key
+std::unique_ptr<MeshData> LoadSMesh(
+	ResourceReference file, const MeshCacheKey &key);
+bool SaveSMesh(
+	const MeshData &mesh, ResourceReference file, const MeshCacheKey &key);
+
+}
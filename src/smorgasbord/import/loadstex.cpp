@@ -0,0 +1,271 @@
+#include "loadstex.hpp"
+
+#include <smorgasbord/image/blockcompress.hpp>
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/mappedfile.hpp>
+
+#include <cstring>
+#include <iostream>
+
+using namespace Smorgasbord;
+
+const uint32_t stexVersion = 1;
+const size_t stexAlignment = 16;
+
+struct STexHeader
+{
+	char magic[4] = { 'S', 'T', 'E', 'X' };
+	uint32_t version = stexVersion;
+	uint32_t format = 0; // TextureFormat
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t numLevels = 0;
+};
+
+struct STexLevel
+{
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+inline size_t AlignSTexOffset(size_t offset)
+{
+	return (offset + stexAlignment - 1) & ~(stexAlignment - 1);
+}
+
+/// Validates the whole file before creating the texture, the levels are
+/// uploaded from the mapping
+static std::shared_ptr<Texture> CreateSTexTexture(
+	std::shared_ptr<Device> device,
+	const MappedFile &mappedFile,
+	const std::string &name)
+{
+	const uint8_t *data = mappedFile.GetData();
+	const size_t fileSize = mappedFile.GetSize();
+	
+	STexHeader header;
+	if (fileSize < sizeof(STexHeader))
+	{
+		LogE("Not an stex file: {0}", name);
+		return { };
+	}
+	
+	std::memcpy(&header, data, sizeof(STexHeader));
+	if (std::memcmp(header.magic, STexHeader().magic, 4) != 0
+		|| header.version != stexVersion)
+	{
+		LogE("Not a compatible stex file: {0}", name);
+		return { };
+	}
+	
+	const TextureFormat format = TextureFormat(header.format);
+	const glm::uvec2 size(header.width, header.height);
+	if (!IsValidTextureFormat(header.format)
+		|| size.x == 0 || size.y == 0
+		|| header.numLevels == 0 || header.numLevels > GetMaxTextureLevels(size))
+	{
+		LogE("Invalid stex header: {0}", name);
+		return { };
+	}
+	
+	if (fileSize - sizeof(STexHeader) < header.numLevels * sizeof(STexLevel))
+	{
+		LogE("Truncated stex file: {0}", name);
+		return { };
+	}
+	
+	std::vector<STexLevel> levels(header.numLevels);
+	std::memcpy(
+		levels.data(), &data[sizeof(STexHeader)], levels.size() * sizeof(STexLevel));
+	
+	for (uint32_t i = 0; i < header.numLevels; i++)
+	{
+		if (levels[i].size != GetTextureLevelSize(format, size, i)
+			|| levels[i].offset > fileSize
+			|| levels[i].size > fileSize - levels[i].offset)
+		{
+			LogE("Invalid level {0} in stex file: {1}", i, name);
+			return { };
+		}
+	}
+	
+	std::shared_ptr<Texture> texture =
+		device->CreateTexture(size, format, header.numLevels);
+	for (uint32_t i = 0; i < header.numLevels; i++)
+	{
+		texture->UploadLevel(
+			i, &data[size_t(levels[i].offset)], size_t(levels[i].size));
+	}
+	
+	return texture;
+}
+
+static bool WriteSTex(
+	ResourceReference &file,
+	TextureFormat format,
+	glm::uvec2 size,
+	const std::vector<const uint8_t*> &levelData)
+{
+	const uint32_t numLevels = uint32_t(levelData.size());
+	if (size.x == 0 || size.y == 0
+		|| numLevels == 0 || numLevels > GetMaxTextureLevels(size))
+	{
+		LogE("Invalid texture, cannot save {0}", file.GetPath());
+		return false;
+	}
+	
+	std::unique_ptr<std::ostream> stream = file.OpenWrite();
+	if (!static_cast<bool>(stream))
+	{
+		return false;
+	}
+	
+	STexHeader header;
+	header.format = uint32_t(format);
+	header.width = size.x;
+	header.height = size.y;
+	header.numLevels = numLevels;
+	
+	std::vector<STexLevel> levels(numLevels);
+	size_t offset = sizeof(STexHeader) + numLevels * sizeof(STexLevel);
+	for (uint32_t i = 0; i < numLevels; i++)
+	{
+		levels[i].offset = AlignSTexOffset(offset);
+		levels[i].size = GetTextureLevelSize(format, size, i);
+		offset = size_t(levels[i].offset + levels[i].size);
+	}
+	
+	std::ostream &s = *stream;
+	s.write(reinterpret_cast<const char*>(&header), sizeof(STexHeader));
+	s.write(
+		reinterpret_cast<const char*>(levels.data()),
+		std::streamsize(levels.size() * sizeof(STexLevel)));
+	
+	static const char padding[stexAlignment] = { };
+	offset = sizeof(STexHeader) + numLevels * sizeof(STexLevel);
+	for (uint32_t i = 0; i < numLevels; i++)
+	{
+		s.write(padding, std::streamsize(levels[i].offset - offset));
+		s.write(
+			reinterpret_cast<const char*>(levelData[i]),
+			std::streamsize(levels[i].size));
+		offset = size_t(levels[i].offset + levels[i].size);
+	}
+	
+	if (!s.good())
+	{
+		LogE("Failed writing stex file: {0}", file.GetPath());
+		return false;
+	}
+	
+	return true;
+}
+
+std::shared_ptr<Smorgasbord::Texture> Smorgasbord::LoadSTex(
+	std::shared_ptr<Device> device, ResourceReference file)
+{
+	std::unique_ptr<MappedFile> mappedFile = file.OpenMapped();
+	if (!static_cast<bool>(mappedFile))
+	{
+		return { };
+	}
+	
+	return CreateSTexTexture(device, *mappedFile, file.GetPath());
+}
+
+std::shared_ptr<Smorgasbord::Texture> Smorgasbord::LoadSTex(
+	std::shared_ptr<Device> device, std::string filename)
+{
+	MappedFile mappedFile(filename);
+	if (!mappedFile.IsOpen())
+	{
+		return { };
+	}
+	
+	return CreateSTexTexture(device, mappedFile, filename);
+}
+
+bool Smorgasbord::SaveSTex(
+	ResourceReference file,
+	TextureFormat format,
+	glm::uvec2 size,
+	const std::vector<std::vector<uint8_t>> &levels)
+{
+	std::vector<const uint8_t*> levelData;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		if (levels[i].size() != GetTextureLevelSize(format, size, uint32_t(i)))
+		{
+			LogE("Level {0} has the wrong size, cannot save {1}", i, file.GetPath());
+			return false;
+		}
+		
+		levelData.push_back(levels[i].data());
+	}
+	
+	return WriteSTex(file, format, size, levelData);
+}
+
+bool Smorgasbord::SaveSTex(
+	ResourceReference file,
+	const std::vector<std::shared_ptr<Image>> &levels,
+	TextureFormat format,
+	uint32_t numThreads)
+{
+	if (levels.empty() || !levels[0])
+	{
+		LogE("No image, cannot save {0}", file.GetPath());
+		return false;
+	}
+	
+	if (format != TextureFormat::RGBA_8_8_8_8_UNorm
+		&& !IsCompressedTextureFormat(format))
+	{
+		LogE("Images can only be saved as RGBA or compressed, cannot save {0}",
+			file.GetPath());
+		return false;
+	}
+	
+	const glm::uvec2 size = levels[0]->imageSize;
+	const TextureFormat imageFormat = TextureFormat::RGBA_8_8_8_8_UNorm;
+	
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		if (!levels[i] || levels[i]->pixelSize != 4
+			|| levels[i]->imageSize != GetTextureLevelDimensions(size, uint32_t(i))
+			|| levels[i]->data.size() != GetTextureLevelSize(imageFormat, size, uint32_t(i)))
+		{
+			LogE("Level {0} has the wrong size, cannot save {1}", i, file.GetPath());
+			return false;
+		}
+	}
+	
+	std::vector<std::vector<uint8_t>> blocks(
+		IsCompressedTextureFormat(format) ? levels.size() : 0);
+	std::vector<const uint8_t*> levelData;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		if (blocks.empty())
+		{
+			levelData.push_back(levels[i]->data.data());
+			continue;
+		}
+		
+		if (!CompressImage(*levels[i], format, blocks[i], numThreads))
+		{
+			return false;
+		}
+		
+		levelData.push_back(blocks[i].data());
+	}
+	
+	return WriteSTex(file, format, size, levelData);
+}
+
+bool Smorgasbord::IsSTexPath(const std::string &path)
+{
+	const std::string extension = ".stex";
+	return path.size() >= extension.size()
+		&& path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <smorgasbord/gpu/gpuapi.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+
+# STex texture container #
+
+A texture with its whole mip chain, stored in the format the GPU takes, in
+the spirit of KTX2 and DDS. Loading maps the file and uploads every level
+straight from the mapping, nothing is decoded. All values are little
+endian.
+	
+	STexHeader: magic, version, TextureFormat, width, height, level count
+	per level: uint64 offset from the beginning of the file, uint64 size
+	level data, level 0 (full size) first, each starting at a 16 byte
+		aligned offset
+
+Level i is GetTextureLevelDimensions(size, i) and tightly packed, so its
+size is GetTextureLevelSize(). Block compressed levels are stored as the
+blocks CompressImage() writes. A file doesn't need to go down to 1x1.
+
+*/
+
+namespace Smorgasbord {
+
+class Device;
+class Image;
+class Texture;
+
+/// Returns nullptr if the file can't be opened or is invalid
+std::shared_ptr<Texture> LoadSTex(
+	std::shared_ptr<Device> device, ResourceReference file);
+std::shared_ptr<Texture> LoadSTex(
+	std::shared_ptr<Device> device, std::string filename);
+
+/// levels[0] is the full size level
+bool SaveSTex(
+	ResourceReference file,
+	TextureFormat format,
+	glm::uvec2 size,
+	const std::vector<std::vector<uint8_t>> &levels);
+
+/// RGBA images, each half the size of the one before. Compressed formats
+/// compress every level with CompressImage()
+bool SaveSTex(
+	ResourceReference file,
+	const std::vector<std::shared_ptr<Image>> &levels,
+	TextureFormat format = TextureFormat::RGBA_8_8_8_8_UNorm,
+	uint32_t numThreads = 0);
+
+/// Whether LoadTexture() and LoadTextures() should load the file as STex
+bool IsSTexPath(const std::string &path);
+
+}
@@ -3,24 +3,73 @@
 #include <smorgasbord/gpu/gpuapi.hpp>
 #include <smorgasbord/image/image.hpp>
 #include <smorgasbord/import/loadimage.hpp>
+#include <smorgasbord/import/loadstex.hpp>
 #include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/resourcemanager.hpp>
+
+inline const std::string &GetTextureFilePath(const Smorgasbord::ResourceReference &file)
+{
+	return file.GetPath();
+}
+
+inline const std::string &GetTextureFilePath(const std::string &filename)
+{
+	return filename;
+}
+
+/// STex files need no decoding, they are uploaded right away and only the
+/// images go to the workers of LoadImages()
+template<typename File>
+static std::vector<std::shared_ptr<Smorgasbord::Texture>> LoadTextureBatch(
+	std::shared_ptr<Smorgasbord::Device> device,
+	std::vector<File> files,
+	uint32_t numThreads)
+{
+	std::vector<std::shared_ptr<Smorgasbord::Texture>> textures(files.size());
+	std::vector<File> images;
+	std::vector<size_t> imageIndices;
+	
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (Smorgasbord::IsSTexPath(GetTextureFilePath(files[i])))
+		{
+			textures[i] = Smorgasbord::LoadSTex(device, files[i]);
+		}
+		else
+		{
+			images.push_back(std::move(files[i]));
+			imageIndices.push_back(i);
+		}
+	}
+	
+	Smorgasbord::LoadImages(
+		std::move(images),
+		[&](size_t i, std::shared_ptr<Smorgasbord::Image> image)
+		{
+			if (image)
+			{
+				textures[imageIndices[i]] =
+					Smorgasbord::CreateImageTexture(device, *image);
+			}
+		},
+		numThreads);
+	
+	return textures;
+}
 
 std::shared_ptr<Smorgasbord::Texture> Smorgasbord::LoadTexture(
 	std::shared_ptr<Device> device, std::string filename)
 {
+	if (IsSTexPath(filename))
+	{
+		return LoadSTex(device, filename);
+	}
+	
 	std::shared_ptr<Image> img = LoadImage(filename);
 	
 	if (img)
 	{
-		std::shared_ptr<Texture> tex =
-			device->CreateTexture(
-				img->imageSize,
-				TextureFormat::RGBA_8_8_8_8_UNorm);
-		
-		tex->Upload(*img);
-		//tex->Verify(*img);
-		
-		return tex;
+		return CreateImageTexture(device, *img);
 	}
 	else
 	{
@@ -28,3 +77,64 @@ std::shared_ptr<Smorgasbord::Texture> Smorgasbord::LoadTexture(
 		return std::shared_ptr<Texture>();
 	}
 }
+
+std::shared_ptr<Smorgasbord::Texture> Smorgasbord::CreateImageTexture(
+	std::shared_ptr<Device> device, Image &image)
+{
+	std::shared_ptr<Texture> tex =
+		device->CreateTexture(
+			image.imageSize,
+			TextureFormat::RGBA_8_8_8_8_UNorm);
+	
+	tex->Upload(image);
+	//tex->Verify(image);
+	
+	return tex;
+}
+
+std::shared_ptr<Smorgasbord::Texture> Smorgasbord::CreateImageTexture(
+	std::shared_ptr<Device> device,
+	const std::vector<std::shared_ptr<Image>> &levels,
+	TextureFormat format)
+{
+	if (levels.empty())
+	{
+		LogE("Can't create a texture without levels.");
+		return nullptr;
+	}
+	
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		if (!levels[level])
+		{
+			LogE("Can't create a texture, level {0} has no image.", level);
+			return nullptr;
+		}
+	}
+	
+	std::shared_ptr<Texture> tex =
+		device->CreateTexture(
+			levels[0]->imageSize,
+			format,
+			uint32_t(levels.size()));
+	
+	tex->UploadLevels(levels);
+	
+	return tex;
+}
+
+std::vector<std::shared_ptr<Smorgasbord::Texture>> Smorgasbord::LoadTextures(
+	std::shared_ptr<Device> device,
+	std::vector<ResourceReference> files,
+	uint32_t numThreads)
+{
+	return LoadTextureBatch(device, std::move(files), numThreads);
+}
+
+std::vector<std::shared_ptr<Smorgasbord::Texture>> Smorgasbord::LoadTextures(
+	std::shared_ptr<Device> device,
+	std::vector<std::string> filenames,
+	uint32_t numThreads)
+{
+	return LoadTextureBatch(device, std::move(filenames), numThreads);
+}
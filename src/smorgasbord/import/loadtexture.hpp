@@ -1,5 +1,8 @@
 #pragma once
 
+#include <smorgasbord/gpu/gpuapi.hpp>
+
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -9,7 +12,34 @@ namespace Smorgasbord {
 
 class Texture;
 class Device;
+class Image;
+class ResourceReference;
 
+/// .stex files are loaded with LoadSTex(), anything else as an image
 std::shared_ptr<Texture> LoadTexture(std::shared_ptr<Device> device, std::string filename);
 
+/// Creates an RGBA texture from a decoded image
+std::shared_ptr<Texture> CreateImageTexture(std::shared_ptr<Device> device, Image &image);
+
+/// Creates a texture with a level per image, e.g. from GenerateMipChain().
+/// Block compressed formats compress the images on the way. Returns nullptr
+/// if there are no levels or one of them is null
+std::shared_ptr<Texture> CreateImageTexture(
+	std::shared_ptr<Device> device,
+	const std::vector<std::shared_ptr<Image>> &levels,
+	TextureFormat format = TextureFormat::RGBA_8_8_8_8_UNorm);
+
+/// Decodes the files on worker threads, see LoadImages(), and uploads each
+/// image on the calling thread as soon as it is decoded. Failed loads are
+/// nullptr in the result, at the index of their file
+std::vector<std::shared_ptr<Texture>> LoadTextures(
+	std::shared_ptr<Device> device,
+	std::vector<ResourceReference> files,
+	uint32_t numThreads = 0);
+
+std::vector<std::shared_ptr<Texture>> LoadTextures(
+	std::shared_ptr<Device> device,
+	std::vector<std::string> filenames,
+	uint32_t numThreads = 0);
+
 }
@@ -0,0 +1,797 @@
+#include "meshbvh.hpp"
+#include "camera.hpp"
+#include "staticmesh.hpp"
+
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace Smorgasbord;
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode should fill half a cache line");
+
+const uint32_t bvhNumBins = 16;
+const uint32_t bvhMaxLeafSize = 4;
+/// Leaves may get larger if splitting them doesn't pay off
+const uint32_t bvhMaxSahLeafSize = 16;
+/// Deeper nodes become leaves, so traversal stacks have a fixed size
+const uint32_t bvhMaxDepth = 60;
+/// Nodes with more triangles are binned in parallel, the others build
+/// their subtree on a single thread
+const size_t bvhParallelNodeSize = 1 << 15;
+
+/// Box grown while building, 4 lanes wide when SSE is available
+struct BVHBounds
+{
+#ifdef SMORGASBORD_SSE2
+	__m128 boundsMin = _mm_set1_ps(std::numeric_limits<float>::max());
+	__m128 boundsMax = _mm_set1_ps(-std::numeric_limits<float>::max());
+	
+	void Grow(const glm::vec3 &p)
+	{
+		__m128 p4 = _mm_setr_ps(p.x, p.y, p.z, 0.0f);
+		boundsMin = _mm_min_ps(boundsMin, p4);
+		boundsMax = _mm_max_ps(boundsMax, p4);
+	}
+	
+	void Grow(const BVHBounds &b)
+	{
+		boundsMin = _mm_min_ps(boundsMin, b.boundsMin);
+		boundsMax = _mm_max_ps(boundsMax, b.boundsMax);
+	}
+	
+	glm::vec3 GetMin() const
+	{
+		alignas(16) float v[4];
+		_mm_store_ps(v, boundsMin);
+		return glm::vec3(v[0], v[1], v[2]);
+	}
+	
+	glm::vec3 GetMax() const
+	{
+		alignas(16) float v[4];
+		_mm_store_ps(v, boundsMax);
+		return glm::vec3(v[0], v[1], v[2]);
+	}
+	
+	float HalfArea() const
+	{
+		alignas(16) float d[4];
+		_mm_store_ps(d, _mm_max_ps(_mm_sub_ps(boundsMax, boundsMin), _mm_setzero_ps()));
+		return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+	}
+#else
+	glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	
+	void Grow(const glm::vec3 &p)
+	{
+		boundsMin = glm::min(boundsMin, p);
+		boundsMax = glm::max(boundsMax, p);
+	}
+	
+	void Grow(const BVHBounds &b)
+	{
+		boundsMin = glm::min(boundsMin, b.boundsMin);
+		boundsMax = glm::max(boundsMax, b.boundsMax);
+	}
+	
+	glm::vec3 GetMin() const
+	{
+		return boundsMin;
+	}
+	
+	glm::vec3 GetMax() const
+	{
+		return boundsMax;
+	}
+	
+	float HalfArea() const
+	{
+		glm::vec3 d = glm::max(boundsMax - boundsMin, glm::vec3(0));
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+#endif
+};
+
+struct BVHBin
+{
+	BVHBounds bounds;
+	uint32_t count = 0;
+};
+
+/// Bounds of the triangles and of their centroids, plus their bins
+struct BVHNodeStatistics
+{
+	BVHBounds bounds;
+	BVHBounds centroidBounds;
+	BVHBin bins[3][bvhNumBins];
+};
+
+/// Triangle reference moved around while partitioning, kept small and
+/// self-contained so the builder reads memory sequentially
+struct BVHPrimitive
+{
+	BVHBounds bounds;
+	glm::vec3 centroid;
+	uint32_t triangle;
+};
+
+struct BVHBuildTask
+{
+	uint32_t node;
+	uint32_t first;
+	uint32_t count;
+	uint32_t depth;
+};
+
+struct BVHBuilder
+{
+	std::vector<BVHPrimitive> &primitives;
+	
+	BVHBuilder(std::vector<BVHPrimitive> &primitives)
+		: primitives(primitives)
+	{ }
+	
+	void AccumulateBounds(BVHNodeStatistics &s, size_t begin, size_t end) const
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			s.bounds.Grow(primitives[i].bounds);
+			s.centroidBounds.Grow(primitives[i].centroid);
+		}
+	}
+	
+	void AccumulateBins(
+		BVHBin (&bins)[3][bvhNumBins],
+		const BVHBounds &centroidBounds,
+		size_t begin,
+		size_t end) const
+	{
+		const glm::vec3 centroidMin = centroidBounds.GetMin();
+		const glm::vec3 scale = GetBinScale(centroidBounds);
+		for (size_t i = begin; i < end; i++)
+		{
+			const BVHPrimitive &primitive = primitives[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (scale[axis] <= 0)
+				{
+					continue;
+				}
+				
+				BVHBin &bin = bins[axis][GetBin(primitive.centroid, centroidMin, scale, axis)];
+				bin.bounds.Grow(primitive.bounds);
+				bin.count++;
+			}
+		}
+	}
+	
+	/// Bins per unit along each axis, 0 for flat axes
+	static glm::vec3 GetBinScale(const BVHBounds &centroidBounds)
+	{
+		glm::vec3 extent = centroidBounds.GetMax() - centroidBounds.GetMin();
+		glm::vec3 scale;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scale[axis] = extent[axis] > 0 ? float(bvhNumBins) / extent[axis] : 0.0f;
+		}
+		
+		return scale;
+	}
+	
+	static uint32_t GetBin(
+		const glm::vec3 &c, const glm::vec3 &centroidMin, const glm::vec3 &scale, int axis)
+	{
+		float bin = (c[axis] - centroidMin[axis]) * scale[axis];
+		return std::min(uint32_t(std::max(bin, 0.0f)), bvhNumBins - 1);
+	}
+	
+	/// Splits the work over numThreads threads for large nodes
+	void Analyze(BVHNodeStatistics &s, size_t first, size_t count, uint32_t numThreads) const
+	{
+		if (numThreads <= 1 || count < bvhParallelNodeSize)
+		{
+			AccumulateBounds(s, first, first + count);
+			AccumulateBins(s.bins, s.centroidBounds, first, first + count);
+			return;
+		}
+		
+		const size_t numChunks = std::min<size_t>(size_t(numThreads) * 4, count / 4096 + 1);
+		std::vector<BVHNodeStatistics> chunks(numChunks);
+		auto chunkBegin = [&](size_t c)
+		{
+			return first + count * c / numChunks;
+		};
+		
+		ParallelFor(
+			numChunks,
+			[&](size_t c)
+			{
+				AccumulateBounds(chunks[c], chunkBegin(c), chunkBegin(c + 1));
+			},
+			numThreads);
+		
+		for (const BVHNodeStatistics &chunk : chunks)
+		{
+			s.bounds.Grow(chunk.bounds);
+			s.centroidBounds.Grow(chunk.centroidBounds);
+		}
+		
+		ParallelFor(
+			numChunks,
+			[&](size_t c)
+			{
+				AccumulateBins(
+					chunks[c].bins, s.centroidBounds, chunkBegin(c), chunkBegin(c + 1));
+			},
+			numThreads);
+		
+		for (const BVHNodeStatistics &chunk : chunks)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (uint32_t b = 0; b < bvhNumBins; b++)
+				{
+					s.bins[axis][b].bounds.Grow(chunk.bins[axis][b].bounds);
+					s.bins[axis][b].count += chunk.bins[axis][b].count;
+				}
+			}
+		}
+	}
+	
+	/// Sets the bounds of the task's node, and either makes it a leaf or
+	/// appends its two children to nodes and returns true
+	bool Split(
+		std::vector<BVHNode> &nodes,
+		const BVHBuildTask &task,
+		BVHBuildTask &left,
+		BVHBuildTask &right,
+		uint32_t numThreads)
+	{
+		BVHNodeStatistics s;
+		Analyze(s, task.first, task.count, numThreads);
+		
+		nodes[task.node].boundsMin = s.bounds.GetMin();
+		nodes[task.node].boundsMax = s.bounds.GetMax();
+		
+		auto makeLeaf = [&]()
+		{
+			nodes[task.node].first = task.first;
+			nodes[task.node].count = task.count;
+			return false;
+		};
+		
+		if (task.count <= bvhMaxLeafSize || task.depth >= bvhMaxDepth)
+		{
+			return makeLeaf();
+		}
+		
+		// Cheapest split between bins, with traversal and intersection
+		// costs of 1
+		
+		int bestAxis = -1;
+		uint32_t bestBin = 0;
+		float bestCost = std::numeric_limits<float>::max();
+		
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const BVHBin *bins = s.bins[axis];
+			
+			float rightCosts[bvhNumBins];
+			BVHBounds rightBounds;
+			uint32_t rightCount = 0;
+			for (uint32_t b = bvhNumBins - 1; b > 0; b--)
+			{
+				rightBounds.Grow(bins[b].bounds);
+				rightCount += bins[b].count;
+				rightCosts[b] = float(rightCount) * rightBounds.HalfArea();
+			}
+			
+			BVHBounds leftBounds;
+			uint32_t leftCount = 0;
+			for (uint32_t b = 0; b + 1 < bvhNumBins; b++)
+			{
+				leftBounds.Grow(bins[b].bounds);
+				leftCount += bins[b].count;
+				if (leftCount == 0 || leftCount == task.count)
+				{
+					continue;
+				}
+				
+				float cost = float(leftCount) * leftBounds.HalfArea() + rightCosts[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+		
+		uint32_t numLeft = 0;
+		if (bestAxis >= 0)
+		{
+			const float area = s.bounds.HalfArea();
+			const float splitCost = area > 0 ? 1.0f + bestCost / area : 1.0f;
+			if (splitCost >= float(task.count) && task.count <= bvhMaxSahLeafSize)
+			{
+				return makeLeaf();
+			}
+			
+			const glm::vec3 centroidMin = s.centroidBounds.GetMin();
+			const glm::vec3 scale = GetBinScale(s.centroidBounds);
+			BVHPrimitive *begin = &primitives[task.first];
+			BVHPrimitive *middle = std::partition(
+				begin,
+				begin + task.count,
+				[&](const BVHPrimitive &p)
+				{
+					return GetBin(p.centroid, centroidMin, scale, bestAxis) <= bestBin;
+				});
+			numLeft = uint32_t(middle - begin);
+		}
+		else if (task.count <= bvhMaxSahLeafSize)
+		{
+			return makeLeaf();
+		}
+		
+		/// Coincident centroids can't be binned, halve them instead
+		if (numLeft == 0 || numLeft == task.count)
+		{
+			numLeft = task.count / 2;
+		}
+		
+		const uint32_t leftIndex = uint32_t(nodes.size());
+		nodes.resize(nodes.size() + 2);
+		nodes[task.node].first = leftIndex;
+		nodes[task.node].count = 0;
+		
+		left = { leftIndex, task.first, numLeft, task.depth + 1 };
+		right = { leftIndex + 1, task.first + numLeft, task.count - numLeft, task.depth + 1 };
+		return true;
+	}
+	
+	/// Single threaded, nodes[task.node] must exist
+	void BuildSubtree(std::vector<BVHNode> &nodes, const BVHBuildTask &root)
+	{
+		std::vector<BVHBuildTask> stack(1, root);
+		while (!stack.empty())
+		{
+			BVHBuildTask task = stack.back();
+			stack.pop_back();
+			
+			BVHBuildTask left, right;
+			if (Split(nodes, task, left, right, 1))
+			{
+				stack.push_back(right);
+				stack.push_back(left);
+			}
+		}
+	}
+};
+
+Smorgasbord::MeshBVH::MeshBVH()
+{ }
+
+Smorgasbord::MeshBVH::MeshBVH(const MeshData &mesh, uint32_t numThreads)
+{
+	Build(mesh, numThreads);
+}
+
+bool Smorgasbord::MeshBVH::Build(const MeshData &mesh, uint32_t numThreads)
+{
+	nodes.clear();
+	triangles.clear();
+	numThreads = ResolveThreadCount(numThreads);
+	
+	// Triangle fans of the faces
+	
+	const size_t numFaces = mesh.c.size();
+	std::vector<size_t> cornerStarts(numFaces + 1, 0);
+	std::vector<size_t> triangleStarts(numFaces + 1, 0);
+	for (size_t f = 0; f < numFaces; f++)
+	{
+		cornerStarts[f + 1] = cornerStarts[f] + size_t(std::max(mesh.c[f], 0));
+		triangleStarts[f + 1] = triangleStarts[f] + size_t(std::max(mesh.c[f] - 2, 0));
+	}
+	
+	if (cornerStarts[numFaces] > mesh.fp.size())
+	{
+		LogE("MeshBVH: face indices don't match face vertex counts.");
+		return false;
+	}
+	
+	const size_t numTriangles = triangleStarts[numFaces];
+	if (numTriangles == 0)
+	{
+		return true;
+	}
+	
+	if (numTriangles >= size_t(std::numeric_limits<uint32_t>::max()))
+	{
+		LogE("MeshBVH: too many triangles.");
+		return false;
+	}
+	
+	std::vector<Triangle> unordered(numTriangles);
+	std::vector<BVHPrimitive> primitives(numTriangles);
+	
+	ParallelForRange(
+		numFaces,
+		4096,
+		[&](size_t begin, size_t end)
+		{
+			for (size_t f = begin; f < end; f++)
+			{
+				const uint32_t *corners = &mesh.fp[cornerStarts[f]];
+				size_t t = triangleStarts[f];
+				for (int32_t k = 1; k + 1 < mesh.c[f]; k++, t++)
+				{
+					const glm::vec3 &p0 = mesh.p[corners[0]];
+					const glm::vec3 &p1 = mesh.p[corners[k]];
+					const glm::vec3 &p2 = mesh.p[corners[k + 1]];
+					
+					unordered[t] = { p0, p1 - p0, p2 - p0, uint32_t(f) };
+					
+					BVHPrimitive &primitive = primitives[t];
+					primitive.bounds.Grow(p0);
+					primitive.bounds.Grow(p1);
+					primitive.bounds.Grow(p2);
+					primitive.centroid = (p0 + p1 + p2) / 3.0f;
+					primitive.triangle = uint32_t(t);
+				}
+			}
+		},
+		numThreads);
+	
+	// Top levels, binned in parallel
+	
+	BVHBuilder builder(primitives);
+	
+	nodes.reserve(numTriangles / bvhMaxLeafSize * 2 + 1);
+	nodes.resize(1);
+	
+	std::vector<BVHBuildTask> subtrees;
+	std::vector<BVHBuildTask> stack(1, BVHBuildTask{ 0, 0, uint32_t(numTriangles), 0 });
+	while (!stack.empty())
+	{
+		BVHBuildTask task = stack.back();
+		stack.pop_back();
+		
+		if (task.count < bvhParallelNodeSize || numThreads <= 1)
+		{
+			subtrees.push_back(task);
+			continue;
+		}
+		
+		BVHBuildTask left, right;
+		if (builder.Split(nodes, task, left, right, numThreads))
+		{
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+	}
+	
+	// Subtrees, one thread each, spliced into the node array afterwards
+	
+	std::vector<std::vector<BVHNode>> subtreeNodes(subtrees.size());
+	ParallelFor(
+		subtrees.size(),
+		[&](size_t i)
+		{
+			BVHBuildTask root = subtrees[i];
+			root.node = 0;
+			subtreeNodes[i].resize(1);
+			builder.BuildSubtree(subtreeNodes[i], root);
+		},
+		numThreads);
+	
+	for (size_t i = 0; i < subtrees.size(); i++)
+	{
+		/// Local node n > 0 lands at base + n - 1, the root replaces the
+		/// placeholder node of the task
+		std::vector<BVHNode> &local = subtreeNodes[i];
+		const uint32_t base = uint32_t(nodes.size());
+		for (BVHNode &node : local)
+		{
+			if (node.count == 0)
+			{
+				node.first = base + node.first - 1;
+			}
+		}
+		
+		nodes[subtrees[i].node] = local[0];
+		nodes.insert(nodes.end(), local.begin() + 1, local.end());
+	}
+	
+	// Triangles in leaf order
+	
+	triangles.resize(numTriangles);
+	ParallelForRange(
+		numTriangles,
+		16384,
+		[&](size_t begin, size_t end)
+		{
+			for (size_t t = begin; t < end; t++)
+			{
+				triangles[t] = unordered[primitives[t].triangle];
+			}
+		},
+		numThreads);
+	
+	return true;
+}
+
+/// Ray with precomputed reciprocal direction for slab tests
+struct BVHRay
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 invDirection;
+	float tMin;
+#ifdef SMORGASBORD_SSE2
+	__m128 origin4;
+	__m128 invDirection4;
+	__m128 xyzMask; // selects the 3 bounds lanes, the 4th holds node indices
+	__m128 tMin4;
+#endif
+	
+	BVHRay(const Ray &ray)
+		: origin(ray.origin)
+		, direction(ray.direction)
+		, invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z)
+		, tMin(ray.tMin)
+	{
+#ifdef SMORGASBORD_SSE2
+		origin4 = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+		invDirection4 = _mm_setr_ps(invDirection.x, invDirection.y, invDirection.z, 0.0f);
+		xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+		tMin4 = _mm_set1_ps(tMin);
+#endif
+	}
+};
+
+/// Slab test, tNear is where the ray enters the box
+inline bool IntersectBVHBox(const BVHNode &node, const BVHRay &ray, float tMax, float &tNear)
+{
+#ifdef SMORGASBORD_SSE2
+	/// Loads bounds and the index next to them, the index lane is masked
+	/// out before the horizontal min and max
+	__m128 t0 = _mm_mul_ps(
+		_mm_sub_ps(_mm_loadu_ps(&node.boundsMin.x), ray.origin4), ray.invDirection4);
+	__m128 t1 = _mm_mul_ps(
+		_mm_sub_ps(_mm_loadu_ps(&node.boundsMax.x), ray.origin4), ray.invDirection4);
+	
+	__m128 tMax4 = _mm_set1_ps(tMax);
+	__m128 near4 = _mm_or_ps(
+		_mm_and_ps(ray.xyzMask, _mm_min_ps(t0, t1)),
+		_mm_andnot_ps(ray.xyzMask, ray.tMin4));
+	__m128 far4 = _mm_or_ps(
+		_mm_and_ps(ray.xyzMask, _mm_max_ps(t0, t1)),
+		_mm_andnot_ps(ray.xyzMask, tMax4));
+	
+	near4 = _mm_max_ps(near4, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(1, 0, 3, 2)));
+	near4 = _mm_max_ps(near4, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(2, 3, 0, 1)));
+	far4 = _mm_min_ps(far4, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(1, 0, 3, 2)));
+	far4 = _mm_min_ps(far4, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(2, 3, 0, 1)));
+	
+	tNear = _mm_cvtss_f32(near4);
+	return tNear <= _mm_cvtss_f32(far4);
+#else
+	glm::vec3 t0 = (node.boundsMin - ray.origin) * ray.invDirection;
+	glm::vec3 t1 = (node.boundsMax - ray.origin) * ray.invDirection;
+	glm::vec3 near3 = glm::min(t0, t1);
+	glm::vec3 far3 = glm::max(t0, t1);
+	
+	tNear = std::max(std::max(near3.x, near3.y), std::max(near3.z, ray.tMin));
+	float tFar = std::min(std::min(far3.x, far3.y), std::min(far3.z, tMax));
+	return tNear <= tFar;
+#endif
+}
+
+/// Möller-Trumbore, double sided
+template <typename TriangleT>
+inline bool IntersectBVHTriangle(
+	const TriangleT &triangle, const BVHRay &ray, float tMax, float &t, float &u, float &v)
+{
+	glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+	float determinant = glm::dot(triangle.e1, p);
+	if (determinant == 0)
+	{
+		return false;
+	}
+	
+	float invDeterminant = 1.0f / determinant;
+	glm::vec3 s = ray.origin - triangle.v0;
+	u = glm::dot(s, p) * invDeterminant;
+	if (u < 0 || u > 1)
+	{
+		return false;
+	}
+	
+	glm::vec3 q = glm::cross(s, triangle.e1);
+	v = glm::dot(ray.direction, q) * invDeterminant;
+	if (v < 0 || u + v > 1)
+	{
+		return false;
+	}
+	
+	t = glm::dot(triangle.e2, q) * invDeterminant;
+	return t >= ray.tMin && t <= tMax;
+}
+
+struct BVHStackEntry
+{
+	uint32_t node;
+	float tNear;
+};
+
+bool Smorgasbord::MeshBVH::Intersect(const Ray &ray, RayHit &hit) const
+{
+	hit = RayHit();
+	
+	const BVHRay bvhRay(ray);
+	float tMax = ray.tMax;
+	float tNear;
+	if (nodes.empty() || !IntersectBVHBox(nodes[0], bvhRay, tMax, tNear))
+	{
+		return false;
+	}
+	
+	BVHStackEntry stack[bvhMaxDepth + 4];
+	uint32_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+	
+	while (true)
+	{
+		const BVHNode &node = nodes[nodeIndex];
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				float t, u, v;
+				if (IntersectBVHTriangle(triangles[i], bvhRay, tMax, t, u, v))
+				{
+					tMax = t;
+					hit.face = triangles[i].face;
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+				}
+			}
+		}
+		else
+		{
+			/// Nearer child first, the other one waits on the stack
+			uint32_t left = node.first;
+			uint32_t right = node.first + 1;
+			float tLeft, tRight;
+			bool isLeftHit = IntersectBVHBox(nodes[left], bvhRay, tMax, tLeft);
+			bool isRightHit = IntersectBVHBox(nodes[right], bvhRay, tMax, tRight);
+			
+			if (isLeftHit && isRightHit)
+			{
+				if (tRight < tLeft)
+				{
+					std::swap(left, right);
+					std::swap(tLeft, tRight);
+				}
+				
+				stack[stackSize++] = { right, tRight };
+				nodeIndex = left;
+				continue;
+			}
+			
+			if (isLeftHit || isRightHit)
+			{
+				nodeIndex = isLeftHit ? left : right;
+				continue;
+			}
+		}
+		
+		/// Skips nodes behind the closest hit found since they were pushed
+		while (stackSize > 0 && stack[stackSize - 1].tNear > tMax)
+		{
+			stackSize--;
+		}
+		
+		if (stackSize == 0)
+		{
+			break;
+		}
+		
+		nodeIndex = stack[--stackSize].node;
+	}
+	
+	return hit.IsHit();
+}
+
+bool Smorgasbord::MeshBVH::IntersectAny(const Ray &ray) const
+{
+	const BVHRay bvhRay(ray);
+	float tNear;
+	if (nodes.empty() || !IntersectBVHBox(nodes[0], bvhRay, ray.tMax, tNear))
+	{
+		return false;
+	}
+	
+	uint32_t stack[bvhMaxDepth + 4];
+	uint32_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+	
+	while (true)
+	{
+		const BVHNode &node = nodes[nodeIndex];
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				float t, u, v;
+				if (IntersectBVHTriangle(triangles[i], bvhRay, ray.tMax, t, u, v))
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			float tLeft, tRight;
+			bool isLeftHit = IntersectBVHBox(nodes[node.first], bvhRay, ray.tMax, tLeft);
+			bool isRightHit = IntersectBVHBox(nodes[node.first + 1], bvhRay, ray.tMax, tRight);
+			
+			if (isLeftHit && isRightHit)
+			{
+				stack[stackSize++] = node.first + 1;
+			}
+			
+			if (isLeftHit || isRightHit)
+			{
+				nodeIndex = isLeftHit ? node.first : node.first + 1;
+				continue;
+			}
+		}
+		
+		if (stackSize == 0)
+		{
+			break;
+		}
+		
+		nodeIndex = stack[--stackSize];
+	}
+	
+	return false;
+}
+
+Smorgasbord::Ray Smorgasbord::GetCameraRay(Camera &camera, glm::vec2 ndc)
+{
+	glm::mat4 inverseViewProjection = glm::inverse(
+		camera.GetProjectionMatrix() * camera.GetViewMatrix());
+	
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+	
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 toFar = glm::vec3(farPoint) / farPoint.w - ray.origin;
+	float length = glm::length(toFar);
+	ray.direction = toFar / length;
+	ray.tMin = 0;
+	ray.tMax = length;
+	
+	return ray;
+}
+
+Smorgasbord::Ray Smorgasbord::TransformRay(const Ray &ray, const glm::mat4 &transform)
+{
+	Ray transformed = ray;
+	transformed.origin = glm::vec3(transform * glm::vec4(ray.origin, 1.0f));
+	transformed.direction = glm::vec3(transform * glm::vec4(ray.direction, 0.0f));
+	return transformed;
+}
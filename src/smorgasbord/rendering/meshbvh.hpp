@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+
+class MeshBVH
+-------------
+
+Bounding volume hierarchy over the triangles of a MeshData, for picking
+and other ray queries on the CPU. Polygons are split in triangle fans.
+
+Built top-down with binned SAH (Wald 2007). Nodes with many triangles
+are binned in parallel, then the subtrees below them are built on
+separate threads. Nodes are stored in a flat array, 32 bytes each, with
+the two children of a node next to each other. Triangles are stored in
+leaf order with precomputed edges.
+
+Queries work in the space of the mesh positions. For a mesh placed with
+a world matrix, transform the ray with its inverse first, see
+TransformRay().
+
+*/
+
+namespace Smorgasbord {
+
+struct MeshData;
+class Camera;
+
+struct Ray
+{
+	glm::vec3 origin = glm::vec3(0);
+	glm::vec3 direction = glm::vec3(0, 0, -1); // need not be normalized
+	float tMin = 0;
+	float tMax = std::numeric_limits<float>::infinity();
+};
+
+struct RayHit
+{
+	uint32_t face = ~0u; // index of the MeshData face, ~0u if none was hit
+	float t = 0; // hit point is origin + t * direction
+	float u = 0; // barycentric coordinates within the hit triangle
+	float v = 0;
+	
+	bool IsHit() const
+	{
+		return face != ~0u;
+	}
+};
+
+struct BVHNode
+{
+	glm::vec3 boundsMin = glm::vec3(0);
+	uint32_t first = 0; // left child of inner nodes, first triangle of leaves
+	glm::vec3 boundsMax = glm::vec3(0);
+	uint32_t count = 0; // triangles of a leaf, 0 for inner nodes
+};
+
+class MeshBVH
+{
+private:
+	struct Triangle
+	{
+		glm::vec3 v0;
+		glm::vec3 e1; // v1 - v0
+		glm::vec3 e2; // v2 - v0
+		uint32_t face;
+	};
+	
+	std::vector<BVHNode> nodes; // root first
+	std::vector<Triangle> triangles;
+
+public:
+	MeshBVH();
+	/// numThreads == 0 uses all hardware threads
+	MeshBVH(const MeshData &mesh, uint32_t numThreads = 0);
+	
+	bool Build(const MeshData &mesh, uint32_t numThreads = 0);
+	
+	/// Closest hit within [ray.tMin, ray.tMax]
+	bool Intersect(const Ray &ray, RayHit &hit) const;
+	/// Whether anything is hit within [ray.tMin, ray.tMax], stopping at the
+	/// first hit found, e.g. for shadow rays
+	bool IntersectAny(const Ray &ray) const;
+	
+	bool IsEmpty() const
+	{
+		return nodes.empty();
+	}
+	
+	const std::vector<BVHNode> &GetNodes() const
+	{
+		return nodes;
+	}
+	
+	size_t GetTriangleCount() const
+	{
+		return triangles.size();
+	}
+};
+
+/// Ray through a point of the viewport in normalized device coordinates,
+/// from (-1, -1) at the bottom left to (1, 1) at the top right. The ray
+/// starts on the near plane and ends on the far plane, in world space
+Ray GetCameraRay(Camera &camera, glm::vec2 ndc);
+
+/// E.g. with the inverse world matrix of a mesh, to query its MeshBVH. t
+/// values stay comparable, as the direction is not renormalized
+Ray TransformRay(const Ray &ray, const glm::mat4 &transform);
+
+}
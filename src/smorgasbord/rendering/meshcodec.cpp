@@ -0,0 +1,670 @@
+#include "meshcodec.hpp"
+
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/simd.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+const uint32_t meshCodecVersion = 1;
+const size_t meshCodecBlockSize = 256; // vertices
+const size_t meshCodecGroupSize = 16; // bytes of a plane
+const size_t meshCodecMaxStride = 256;
+const size_t meshCodecIndexBlockSize = 4096; // indices
+
+struct MeshCodecVertexHeader
+{
+	char magic[4] = { 'S', 'M', 'V', 'B' };
+	uint32_t version = meshCodecVersion;
+	uint64_t count = 0;
+	uint32_t stride = 0;
+	uint32_t reserved = 0;
+};
+
+struct MeshCodecIndexHeader
+{
+	char magic[4] = { 'S', 'M', 'I', 'B' };
+	uint32_t version = meshCodecVersion;
+	uint64_t count = 0;
+	uint64_t codesSize = 0;
+};
+
+inline uint32_t ZigzagMeshCodec(uint32_t v)
+{
+	return (v << 1) ^ uint32_t(int32_t(v) >> 31);
+}
+
+inline uint32_t UnzigzagMeshCodec(uint32_t v)
+{
+	return (v >> 1) ^ (0u - (v & 1));
+}
+
+// Vertex planes
+
+static void EncodeMeshCodecPlane(
+	std::vector<uint8_t> &out, const uint8_t *plane, size_t numGroups)
+{
+	const size_t headerOffset = out.size();
+	out.resize(out.size() + (numGroups + 3) / 4, 0);
+	
+	for (size_t g = 0; g < numGroups; g++)
+	{
+		const uint8_t *group = &plane[g * meshCodecGroupSize];
+		const uint8_t maxValue = *std::max_element(group, group + meshCodecGroupSize);
+		
+		uint32_t selector =
+			maxValue == 0 ? 0
+			: maxValue < 4 ? 1
+			: maxValue < 16 ? 2
+			: 3;
+		out[headerOffset + g / 4] |= uint8_t(selector << ((g % 4) * 2));
+		
+		if (selector == 3)
+		{
+			out.insert(out.end(), group, group + meshCodecGroupSize);
+		}
+		else if (selector > 0)
+		{
+			/// Values are packed from the low bits up
+			const uint32_t bits = selector * 2;
+			const uint32_t valuesPerByte = 8 / bits;
+			for (size_t i = 0; i < meshCodecGroupSize; i += valuesPerByte)
+			{
+				uint8_t byte = 0;
+				for (uint32_t k = 0; k < valuesPerByte; k++)
+				{
+					byte |= uint8_t(group[i + k] << (k * bits));
+				}
+				
+				out.push_back(byte);
+			}
+		}
+	}
+}
+
+/// Returns the end of the plane in data, nullptr if it is truncated
+static const uint8_t *DecodeMeshCodecPlane(
+	uint8_t *plane, size_t numGroups, const uint8_t *data, const uint8_t *end)
+{
+	const uint8_t *header = data;
+	data += (numGroups + 3) / 4;
+	if (data > end)
+	{
+		return nullptr;
+	}
+	
+	for (size_t g = 0; g < numGroups; g++)
+	{
+		uint8_t *group = &plane[g * meshCodecGroupSize];
+		const uint32_t selector = (header[g / 4] >> ((g % 4) * 2)) & 3;
+		
+		/// 0, 4, 8 or 16 bytes
+		const size_t size = selector == 0 ? 0 : size_t(2) << selector;
+		if (size_t(end - data) < size)
+		{
+			return nullptr;
+		}
+		
+		switch (selector)
+		{
+		case 0:
+			std::memset(group, 0, meshCodecGroupSize);
+			break;
+		
+		case 1:
+		{
+#ifdef SMORGASBORD_SSE2
+			int32_t packed;
+			std::memcpy(&packed, data, sizeof(packed));
+			const __m128i mask = _mm_set1_epi8(3);
+			__m128i x = _mm_cvtsi32_si128(packed);
+			__m128i v0 = _mm_and_si128(x, mask);
+			__m128i v1 = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+			__m128i v2 = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+			__m128i v3 = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+			__m128i result = _mm_unpacklo_epi16(
+				_mm_unpacklo_epi8(v0, v1), _mm_unpacklo_epi8(v2, v3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(group), result);
+#else
+			for (size_t i = 0; i < 4; i++)
+			{
+				group[i * 4 + 0] = data[i] & 3;
+				group[i * 4 + 1] = (data[i] >> 2) & 3;
+				group[i * 4 + 2] = (data[i] >> 4) & 3;
+				group[i * 4 + 3] = data[i] >> 6;
+			}
+#endif
+			break;
+		}
+		
+		case 2:
+		{
+#ifdef SMORGASBORD_SSE2
+			const __m128i mask = _mm_set1_epi8(15);
+			__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+			__m128i low = _mm_and_si128(x, mask);
+			__m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+			_mm_storeu_si128(
+				reinterpret_cast<__m128i*>(group), _mm_unpacklo_epi8(low, high));
+#else
+			for (size_t i = 0; i < 8; i++)
+			{
+				group[i * 2 + 0] = data[i] & 15;
+				group[i * 2 + 1] = data[i] >> 4;
+			}
+#endif
+			break;
+		}
+		
+		case 3:
+			std::memcpy(group, data, meshCodecGroupSize);
+			break;
+		}
+		
+		data += size;
+	}
+	
+	return data;
+}
+
+// Vertex buffers
+
+std::vector<uint8_t> Smorgasbord::EncodeVertexBuffer(
+	const void *vertices, size_t count, size_t stride)
+{
+	if (stride == 0 || stride % 4 != 0 || stride > meshCodecMaxStride)
+	{
+		LogE("Vertex stride {0} cannot be encoded.", stride);
+		return { };
+	}
+	
+	MeshCodecVertexHeader header;
+	header.count = count;
+	header.stride = uint32_t(stride);
+	
+	std::vector<uint8_t> out(sizeof(header));
+	std::memcpy(out.data(), &header, sizeof(header));
+	out.reserve(sizeof(header) + count * stride / 2);
+	
+	const uint8_t *source = static_cast<const uint8_t*>(vertices);
+	const size_t numWords = stride / 4;
+	std::vector<uint32_t> previous(numWords, 0);
+	std::vector<uint8_t> planes(stride * meshCodecBlockSize);
+	
+	for (size_t first = 0; first < count; first += meshCodecBlockSize)
+	{
+		const size_t n = std::min(meshCodecBlockSize, count - first);
+		const size_t numGroups = (n + meshCodecGroupSize - 1) / meshCodecGroupSize;
+		std::fill(planes.begin(), planes.end(), 0);
+		
+		for (size_t i = 0; i < n; i++)
+		{
+			const uint8_t *vertex = &source[(first + i) * stride];
+			for (size_t w = 0; w < numWords; w++)
+			{
+				uint32_t word;
+				std::memcpy(&word, &vertex[w * 4], sizeof(word));
+				uint32_t delta = ZigzagMeshCodec(word - previous[w]);
+				previous[w] = word;
+				
+				for (size_t b = 0; b < 4; b++)
+				{
+					planes[(w * 4 + b) * meshCodecBlockSize + i] = uint8_t(delta >> (b * 8));
+				}
+			}
+		}
+		
+		for (size_t k = 0; k < stride; k++)
+		{
+			EncodeMeshCodecPlane(out, &planes[k * meshCodecBlockSize], numGroups);
+		}
+	}
+	
+	return out;
+}
+
+bool Smorgasbord::DecodeVertexBuffer(
+	void *target, size_t count, size_t stride, const uint8_t *data, size_t size)
+{
+	MeshCodecVertexHeader header;
+	if (size < sizeof(header)
+		|| std::memcmp(data, header.magic, sizeof(header.magic)) != 0)
+	{
+		LogE("Not an encoded vertex buffer.");
+		return false;
+	}
+	
+	std::memcpy(&header, data, sizeof(header));
+	if (header.version != meshCodecVersion
+		|| header.count != count
+		|| header.stride != stride
+		|| stride == 0 || stride % 4 != 0 || stride > meshCodecMaxStride)
+	{
+		LogE("Encoded vertex buffer doesn't match the expected layout.");
+		return false;
+	}
+	
+	const uint8_t *end = data + size;
+	data += sizeof(header);
+	
+	uint8_t *out = static_cast<uint8_t*>(target);
+	const size_t numWords = stride / 4;
+	std::vector<uint32_t> previous(numWords, 0);
+	std::vector<uint8_t> planes(stride * meshCodecBlockSize);
+	std::vector<uint32_t> block(numWords * meshCodecBlockSize);
+	
+	for (size_t first = 0; first < count; first += meshCodecBlockSize)
+	{
+		const size_t n = std::min(meshCodecBlockSize, count - first);
+		const size_t numGroups = (n + meshCodecGroupSize - 1) / meshCodecGroupSize;
+		
+		for (size_t k = 0; k < stride && data != nullptr; k++)
+		{
+			data = DecodeMeshCodecPlane(
+				&planes[k * meshCodecBlockSize], numGroups, data, end);
+		}
+		
+		if (data == nullptr)
+		{
+			LogE("Encoded vertex buffer is truncated.");
+			return false;
+		}
+		
+		/// Words are summed up in the cached block, which is then streamed
+		/// to the target whole
+		for (size_t w = 0; w < numWords; w++)
+		{
+			const uint8_t *p0 = &planes[(w * 4 + 0) * meshCodecBlockSize];
+			const uint8_t *p1 = &planes[(w * 4 + 1) * meshCodecBlockSize];
+			const uint8_t *p2 = &planes[(w * 4 + 2) * meshCodecBlockSize];
+			const uint8_t *p3 = &planes[(w * 4 + 3) * meshCodecBlockSize];
+			
+			uint32_t word = previous[w];
+			size_t i = 0;
+
+#ifdef SMORGASBORD_SSE2
+			/// 4 differences at a time, summed up with a prefix sum
+			const __m128i one = _mm_set1_epi32(1);
+			__m128i sum = _mm_set1_epi32(int32_t(word));
+			for (; i + 4 <= n; i += 4)
+			{
+				int32_t b0, b1, b2, b3;
+				std::memcpy(&b0, &p0[i], 4);
+				std::memcpy(&b1, &p1[i], 4);
+				std::memcpy(&b2, &p2[i], 4);
+				std::memcpy(&b3, &p3[i], 4);
+				
+				__m128i delta = _mm_unpacklo_epi16(
+					_mm_unpacklo_epi8(_mm_cvtsi32_si128(b0), _mm_cvtsi32_si128(b1)),
+					_mm_unpacklo_epi8(_mm_cvtsi32_si128(b2), _mm_cvtsi32_si128(b3)));
+				delta = _mm_xor_si128(
+					_mm_srli_epi32(delta, 1),
+					_mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(delta, one)));
+				
+				delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+				delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+				sum = _mm_add_epi32(sum, delta);
+				
+				uint32_t *words = &block[i * numWords + w];
+				if (numWords == 1)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(words), sum);
+				}
+				else
+				{
+					words[0] = uint32_t(_mm_cvtsi128_si32(sum));
+					words[numWords] = uint32_t(_mm_cvtsi128_si32(_mm_shuffle_epi32(sum, 0x55)));
+					words[numWords * 2] = uint32_t(_mm_cvtsi128_si32(_mm_shuffle_epi32(sum, 0xAA)));
+				}
+				
+				sum = _mm_shuffle_epi32(sum, 0xFF);
+				words[numWords * 3] = uint32_t(_mm_cvtsi128_si32(sum));
+			}
+			
+			word = uint32_t(_mm_cvtsi128_si32(sum));
+#endif
+			
+			for (; i < n; i++)
+			{
+				uint32_t delta =
+					uint32_t(p0[i])
+					| (uint32_t(p1[i]) << 8)
+					| (uint32_t(p2[i]) << 16)
+					| (uint32_t(p3[i]) << 24);
+				word += UnzigzagMeshCodec(delta);
+				block[i * numWords + w] = word;
+			}
+			
+			previous[w] = word;
+		}
+		
+		StreamingCopy(&out[first * stride], block.data(), n * stride);
+	}
+	
+	/// Corruption in the group selectors changes the size of the planes
+	if (data != end)
+	{
+		LogE("Encoded vertex buffer has data past its last block.");
+		return false;
+	}
+	
+	return true;
+}
+
+// Index buffers
+
+/// Recent edges and vertices, updated alike by encoder and decoder
+struct MeshCodecIndexFifo
+{
+	uint32_t edges[8][2] = { };
+	uint32_t vertices[8] = { };
+	uint32_t edgeOffset = 0;
+	uint32_t vertexOffset = 0;
+	uint32_t next = 0; // lowest vertex not referenced as next yet
+	uint32_t last = 0; // last explicit vertex
+	
+	void PushEdge(uint32_t a, uint32_t b)
+	{
+		edges[edgeOffset & 7][0] = a;
+		edges[edgeOffset & 7][1] = b;
+		edgeOffset++;
+	}
+	
+	void PushVertex(uint32_t v)
+	{
+		vertices[vertexOffset & 7] = v;
+		vertexOffset++;
+	}
+	
+	/// 0 is the most recent
+	const uint32_t *GetEdge(uint32_t i) const
+	{
+		return edges[(edgeOffset - 1 - i) & 7];
+	}
+	
+	uint32_t GetVertex(uint32_t i) const
+	{
+		return vertices[(vertexOffset - 1 - i) & 7];
+	}
+};
+
+const uint32_t meshCodecEdgeMiss = 3;
+const uint32_t meshCodecNextVertex = 0;
+const uint32_t meshCodecExplicitVertex = 7;
+
+/// Returns the 3 bit vertex encoding, explicit vertices are written to extra
+static uint32_t EncodeMeshCodecVertex(
+	MeshCodecIndexFifo &fifo, uint32_t v, std::vector<uint8_t> &extra)
+{
+	if (v == fifo.next)
+	{
+		fifo.next++;
+		fifo.PushVertex(v);
+		return meshCodecNextVertex;
+	}
+	
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		if (fifo.GetVertex(i) == v)
+		{
+			return i + 1;
+		}
+	}
+	
+	/// LEB128
+	uint32_t value = ZigzagMeshCodec(v - fifo.last);
+	while (value >= 0x80)
+	{
+		extra.push_back(uint8_t(value | 0x80));
+		value >>= 7;
+	}
+	extra.push_back(uint8_t(value));
+	
+	fifo.last = v;
+	fifo.PushVertex(v);
+	return meshCodecExplicitVertex;
+}
+
+static bool DecodeMeshCodecVertex(
+	MeshCodecIndexFifo &fifo,
+	uint32_t encoding,
+	const uint8_t *&data,
+	const uint8_t *end,
+	uint32_t &v)
+{
+	if (encoding == meshCodecNextVertex)
+	{
+		v = fifo.next++;
+		fifo.PushVertex(v);
+		return true;
+	}
+	
+	if (encoding != meshCodecExplicitVertex)
+	{
+		v = fifo.GetVertex(encoding - 1);
+		return true;
+	}
+	
+	uint32_t value = 0;
+	for (uint32_t shift = 0; ; shift += 7)
+	{
+		if (data == end || shift > 28)
+		{
+			return false;
+		}
+		
+		uint8_t byte = *data++;
+		value |= uint32_t(byte & 0x7F) << shift;
+		if (byte < 0x80)
+		{
+			break;
+		}
+	}
+	
+	v = fifo.last + UnzigzagMeshCodec(value);
+	fifo.last = v;
+	fifo.PushVertex(v);
+	return true;
+}
+
+std::vector<uint8_t> Smorgasbord::EncodeIndexBuffer(
+	const uint32_t *indices, size_t count)
+{
+	if (count % 3 != 0)
+	{
+		LogE("Index count {0} is not a multiple of 3.", count);
+		return { };
+	}
+	
+	const size_t numTriangles = count / 3;
+	std::vector<uint8_t> codes(numTriangles);
+	std::vector<uint8_t> extra;
+	MeshCodecIndexFifo fifo;
+	
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		const uint32_t *triangle = &indices[t * 3];
+		
+		/// Most recent edge shared with the triangle, in any rotation
+		uint32_t edge = 0;
+		uint32_t rotation = meshCodecEdgeMiss;
+		for (uint32_t i = 0; i < 8 && rotation == meshCodecEdgeMiss; i++)
+		{
+			const uint32_t *e = fifo.GetEdge(i);
+			for (uint32_t r = 0; r < 3; r++)
+			{
+				if (e[0] == triangle[r] && e[1] == triangle[(r + 1) % 3])
+				{
+					edge = i;
+					rotation = r;
+					break;
+				}
+			}
+		}
+		
+		if (rotation != meshCodecEdgeMiss)
+		{
+			const uint32_t a = triangle[rotation];
+			const uint32_t b = triangle[(rotation + 1) % 3];
+			const uint32_t c = triangle[(rotation + 2) % 3];
+			
+			uint32_t encodingC = EncodeMeshCodecVertex(fifo, c, extra);
+			codes[t] = uint8_t((edge << 5) | (rotation << 3) | encodingC);
+			
+			fifo.PushEdge(c, b);
+			fifo.PushEdge(a, c);
+		}
+		else
+		{
+			const uint32_t a = triangle[0];
+			const uint32_t b = triangle[1];
+			const uint32_t c = triangle[2];
+			
+			uint32_t encodingA = EncodeMeshCodecVertex(fifo, a, extra);
+			uint32_t encodingB = EncodeMeshCodecVertex(fifo, b, extra);
+			
+			/// Encoding of c precedes its explicit value
+			size_t encodingOffset = extra.size();
+			extra.push_back(0);
+			extra[encodingOffset] = uint8_t(EncodeMeshCodecVertex(fifo, c, extra));
+			
+			codes[t] = uint8_t((encodingA << 5) | (meshCodecEdgeMiss << 3) | encodingB);
+			
+			fifo.PushEdge(b, a);
+			fifo.PushEdge(c, b);
+			fifo.PushEdge(a, c);
+		}
+	}
+	
+	MeshCodecIndexHeader header;
+	header.count = count;
+	header.codesSize = codes.size();
+	
+	std::vector<uint8_t> out(sizeof(header) + codes.size() + extra.size());
+	std::memcpy(out.data(), &header, sizeof(header));
+	std::memcpy(&out[sizeof(header)], codes.data(), codes.size());
+	std::memcpy(&out[sizeof(header) + codes.size()], extra.data(), extra.size());
+	return out;
+}
+
+bool Smorgasbord::DecodeIndexBuffer(
+	void *target, size_t count, size_t indexSize, const uint8_t *data, size_t size)
+{
+	MeshCodecIndexHeader header;
+	if (size < sizeof(header)
+		|| std::memcmp(data, header.magic, sizeof(header.magic)) != 0)
+	{
+		LogE("Not an encoded index buffer.");
+		return false;
+	}
+	
+	std::memcpy(&header, data, sizeof(header));
+	if (header.version != meshCodecVersion
+		|| header.count != count
+		|| count % 3 != 0
+		|| header.codesSize != count / 3
+		|| header.codesSize > size - sizeof(header)
+		|| (indexSize != 2 && indexSize != 4))
+	{
+		LogE("Encoded index buffer doesn't match the expected layout.");
+		return false;
+	}
+	
+	const uint8_t *codes = data + sizeof(header);
+	const uint8_t *extra = codes + header.codesSize;
+	const uint8_t *end = data + size;
+	const uint32_t maxIndex = indexSize == 2 ? 0xFFFF : 0xFFFFFFFF;
+	
+	uint8_t *out = static_cast<uint8_t*>(target);
+	MeshCodecIndexFifo fifo;
+	
+	/// Triangles are decoded into a cached block, which is then streamed to
+	/// the target whole
+	uint32_t block[meshCodecIndexBlockSize];
+	size_t blockFirst = 0;
+	size_t blockSize = 0;
+	
+	auto flush = [&]()
+	{
+		if (indexSize == 2)
+		{
+			uint16_t narrow[meshCodecIndexBlockSize];
+			for (size_t i = 0; i < blockSize; i++)
+			{
+				narrow[i] = uint16_t(block[i]);
+			}
+			StreamingCopy(&out[blockFirst * 2], narrow, blockSize * 2);
+		}
+		else
+		{
+			StreamingCopy(&out[blockFirst * 4], block, blockSize * 4);
+		}
+		
+		blockFirst += blockSize;
+		blockSize = 0;
+	};
+	
+	for (size_t t = 0; t < header.codesSize; t++)
+	{
+		const uint32_t code = codes[t];
+		const uint32_t rotation = (code >> 3) & 3;
+		uint32_t a = 0, b = 0, c = 0;
+		bool valid;
+		
+		if (rotation != meshCodecEdgeMiss)
+		{
+			const uint32_t *edge = fifo.GetEdge(code >> 5);
+			a = edge[0];
+			b = edge[1];
+			valid = DecodeMeshCodecVertex(fifo, code & 7, extra, end, c);
+			
+			fifo.PushEdge(c, b);
+			fifo.PushEdge(a, c);
+		}
+		else
+		{
+			valid = DecodeMeshCodecVertex(fifo, code >> 5, extra, end, a)
+				&& DecodeMeshCodecVertex(fifo, code & 7, extra, end, b)
+				&& extra != end
+				&& *extra <= meshCodecExplicitVertex;
+			if (valid)
+			{
+				uint32_t encodingC = *extra++;
+				valid = DecodeMeshCodecVertex(fifo, encodingC, extra, end, c);
+			}
+			
+			fifo.PushEdge(b, a);
+			fifo.PushEdge(c, b);
+			fifo.PushEdge(a, c);
+		}
+		
+		if (!valid || a > maxIndex || b > maxIndex || c > maxIndex)
+		{
+			LogE("Encoded index buffer is invalid.");
+			return false;
+		}
+		
+		/// Undo the rotation of the shared edge, a miss has none
+		static const uint32_t corners[4][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 1, 2 } };
+		uint32_t *triangle = &block[blockSize];
+		triangle[corners[rotation][0]] = a;
+		triangle[corners[rotation][1]] = b;
+		triangle[corners[rotation][2]] = c;
+		
+		blockSize += 3;
+		if (blockSize + 3 > meshCodecIndexBlockSize)
+		{
+			flush();
+		}
+	}
+	
+	flush();
+	
+	if (extra != end)
+	{
+		LogE("Encoded index buffer has data past its last triangle.");
+		return false;
+	}
+	
+	return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+
+Mesh buffer codec
+-----------------
+
+Lossless compression of vertex and index buffers, for mesh assets stored
+on disk. Decoding is meant to run straight into mapped GPU memory, see
+Buffer::GetMappedData(), so it writes the target once, in order, with
+streaming stores, and never reads it back. All values are little endian.
+
+Vertex buffers
+
+	header: char[4] "SMVB", uint32 version, uint64 count, uint32 stride,
+		uint32 reserved
+	blocks of up to 256 vertices, each holding stride byte planes
+
+Vertices are read as 32 bit words, so stride must be a multiple of 4, and
+every word is replaced by the zigzag encoded difference to the same word
+of the previous vertex. Similar neighbors, e.g. after OptimizeVertexFetch(),
+leave mostly small differences. Byte k of the differences of a block is
+stored as plane k, so the mostly zero high bytes line up. A plane is split
+into groups of 16 bytes, with 2 bits per group in front of the plane,
+selecting 0, 2, 4 or 8 bits per byte for the group.
+
+Index buffers
+
+	header: char[4] "SMIB", uint32 version, uint64 count, uint64 codes size
+	one code byte per triangle, then the extra data of the codes
+
+Triangles are encoded in order, against a FIFO of the 8 most recent edges
+and one of the 6 most recent vertices, both updated the same way by the
+encoder and the decoder. Most triangles share an edge with a recent one,
+and reference either the next unused vertex or a recent one with the third,
+so they take a single byte:
+
+	bits 5-7: edge FIFO index
+	bits 3-4: rotation of the triangle relative to the edge, 3 if no recent
+		edge is shared
+	bits 0-2: third vertex, 0 for the next vertex, 1-6 for the vertex FIFO,
+		7 for an explicit vertex, a zigzag LEB128 difference to the last
+		explicit vertex in the extra data
+
+If no edge is shared, bits 5-7 and 0-2 encode the first and second vertex,
+and the third follows in the extra data as a byte of the same encoding.
+Triangles keep their rotation, so the decoded buffer is identical.
+
+There is no checksum. Truncated input, mismatching headers and input
+whose codes or selectors don't add up to its size are rejected, other
+corruption decodes to wrong values, but never reads or writes outside of
+the input and the target.
+
+*/
+
+namespace Smorgasbord {
+
+/// stride must be a multiple of 4, at most 256
+std::vector<uint8_t> EncodeVertexBuffer(
+	const void *vertices, size_t count, size_t stride);
+
+/// Returns false if data is invalid, or doesn't hold count vertices of
+/// stride bytes. target receives count * stride bytes
+bool DecodeVertexBuffer(
+	void *target, size_t count, size_t stride, const uint8_t *data, size_t size);
+
+/// count must be a multiple of 3
+std::vector<uint8_t> EncodeIndexBuffer(const uint32_t *indices, size_t count);
+
+/// indexSize is 2 or 4 bytes, indices must fit it. Returns false if data is
+/// invalid, or doesn't hold count indices
+bool DecodeIndexBuffer(
+	void *target, size_t count, size_t indexSize, const uint8_t *data, size_t size);
+
+}
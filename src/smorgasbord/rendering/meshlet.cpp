@@ -0,0 +1,449 @@
+#include "meshlet.hpp"
+#include "camera.hpp"
+#include "meshoptimize.hpp"
+#include "staticmesh.hpp"
+
+#include <smorgasbord/util/log.hpp>
+
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+struct MeshletPositionHash
+{
+	size_t operator()(const glm::vec3 &p) const
+	{
+		uint32_t words[3];
+		std::memcpy(words, &p, sizeof(words));
+		return size_t(words[0] * 73856093u ^ words[1] * 19349663u ^ words[2] * 83492791u);
+	}
+};
+
+struct MeshletPositionEqual
+{
+	bool operator()(const glm::vec3 &a, const glm::vec3 &b) const
+	{
+		return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+	}
+};
+
+std::vector<Smorgasbord::Meshlet> Smorgasbord::BuildMeshlets(
+	IndexedMeshData &mesh,
+	const std::vector<MeshRange> &ranges,
+	const MeshletSettings &settings)
+{
+	std::vector<Meshlet> meshlets;
+	if (mesh.vertsPerFace != 3 || mesh.indices.empty())
+	{
+		return meshlets;
+	}
+	
+	const uint32_t maxVertices = std::max<uint32_t>(settings.maxVertices, 3);
+	const uint32_t maxTriangles = std::max<uint32_t>(settings.maxTriangles, 1);
+	const size_t numVertices = mesh.p.size();
+	const size_t numTriangles = mesh.indices.size() / 3;
+	const std::vector<uint32_t> &indices = mesh.indices;
+	
+	/// Vertices split by attribute seams are still connected, so
+	/// adjacency goes through positions
+	std::vector<uint32_t> positionIds(numVertices);
+	size_t numPositions = 0;
+	{
+		std::unordered_map<glm::vec3, uint32_t, MeshletPositionHash, MeshletPositionEqual> ids;
+		ids.reserve(numVertices);
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			positionIds[v] = ids.emplace(mesh.p[v], uint32_t(ids.size())).first->second;
+		}
+		numPositions = ids.size();
+	}
+	
+	// Position to triangle adjacency
+	
+	std::vector<uint32_t> adjacencyStarts(numPositions + 1, 0);
+	for (uint32_t v : indices)
+	{
+		adjacencyStarts[positionIds[v] + 1]++;
+	}
+	for (size_t p = 0; p < numPositions; p++)
+	{
+		adjacencyStarts[p + 1] += adjacencyStarts[p];
+	}
+	
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursors(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[cursors[positionIds[indices[i]]]++] = uint32_t(i / 3);
+		}
+	}
+	
+	/// Unused triangles around each position
+	std::vector<uint32_t> liveCounts(numPositions);
+	for (size_t p = 0; p < numPositions; p++)
+	{
+		liveCounts[p] = adjacencyStarts[p + 1] - adjacencyStarts[p];
+	}
+	
+	std::vector<glm::vec3> centroids(numTriangles);
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		centroids[t] = (
+			mesh.p[indices[t * 3]]
+			+ mesh.p[indices[t * 3 + 1]]
+			+ mesh.p[indices[t * 3 + 2]]) / 3.0f;
+	}
+	
+	// Greedy clustering
+	
+	std::vector<uint32_t> reordered;
+	reordered.reserve(indices.size());
+	std::vector<uint8_t> emitted(numTriangles, 0);
+	/// Marks the vertices of the current meshlet, by meshlet number + 1
+	std::vector<uint32_t> vertexMarks(numVertices, 0);
+	std::vector<uint32_t> meshletVertices;
+	
+	auto buildRange = [&](uint32_t rangeIndex, size_t firstTriangle, size_t endTriangle)
+	{
+		auto isCandidate = [&](uint32_t t)
+		{
+			return t >= firstTriangle && t < endTriangle && !emitted[t];
+		};
+		
+		size_t seedCursor = firstTriangle;
+		uint32_t seed = std::numeric_limits<uint32_t>::max();
+		
+		while (true)
+		{
+			/// Continue next to the previous meshlet if possible, else with
+			/// the next unused triangle in cache order
+			if (seed == std::numeric_limits<uint32_t>::max())
+			{
+				while (seedCursor < endTriangle && emitted[seedCursor])
+				{
+					seedCursor++;
+				}
+				
+				if (seedCursor == endTriangle)
+				{
+					break;
+				}
+				
+				seed = uint32_t(seedCursor);
+			}
+			
+			Meshlet meshlet;
+			meshlet.firstIndex = uint32_t(reordered.size());
+			meshlet.rangeIndex = rangeIndex;
+			const uint32_t mark = uint32_t(meshlets.size() + 1);
+			meshletVertices.clear();
+			glm::vec3 positionSum = glm::vec3(0);
+			uint32_t numMeshletTriangles = 0;
+			
+			auto addTriangle = [&](uint32_t t)
+			{
+				emitted[t] = 1;
+				numMeshletTriangles++;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t v = indices[size_t(t) * 3 + k];
+					liveCounts[positionIds[v]]--;
+					reordered.push_back(v);
+					if (vertexMarks[v] != mark)
+					{
+						vertexMarks[v] = mark;
+						meshletVertices.push_back(v);
+						positionSum += mesh.p[v];
+					}
+				}
+			};
+			
+			addTriangle(seed);
+			
+			/// Grow by the adjacent triangle adding the fewest vertices, then
+			/// the one with the fewest unused neighbors, which fills holes
+			/// before they become islands, then the closest to the center
+			while (numMeshletTriangles < maxTriangles)
+			{
+				const glm::vec3 center = positionSum / float(meshletVertices.size());
+				uint32_t best = std::numeric_limits<uint32_t>::max();
+				uint32_t bestNew = 4;
+				uint32_t bestLive = std::numeric_limits<uint32_t>::max();
+				float bestDistance = std::numeric_limits<float>::max();
+				
+				for (uint32_t v : meshletVertices)
+				{
+					const uint32_t p = positionIds[v];
+					for (uint32_t a = adjacencyStarts[p]; a < adjacencyStarts[p + 1]; a++)
+					{
+						uint32_t t = adjacency[a];
+						if (!isCandidate(t))
+						{
+							continue;
+						}
+						
+						uint32_t numNew = 0;
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							numNew += vertexMarks[indices[size_t(t) * 3 + k]] != mark;
+						}
+						
+						if (meshletVertices.size() + numNew > maxVertices
+							|| numNew > bestNew)
+						{
+							continue;
+						}
+						
+						uint32_t live = 0;
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							live += liveCounts[positionIds[indices[size_t(t) * 3 + k]]];
+						}
+						
+						glm::vec3 offset = centroids[t] - center;
+						float distance = glm::dot(offset, offset);
+						if (numNew < bestNew
+							|| live < bestLive
+							|| (live == bestLive && distance < bestDistance))
+						{
+							best = t;
+							bestNew = numNew;
+							bestLive = live;
+							bestDistance = distance;
+						}
+					}
+				}
+				
+				if (best == std::numeric_limits<uint32_t>::max())
+				{
+					break;
+				}
+				
+				addTriangle(best);
+			}
+			
+			meshlet.numIndices = numMeshletTriangles * 3;
+			meshlet.numVertices = uint32_t(meshletVertices.size());
+			meshlets.push_back(meshlet);
+			
+			/// Next seed: the unused neighbor with the fewest unused
+			/// neighbors itself, so no small islands are left behind
+			const glm::vec3 center = positionSum / float(meshletVertices.size());
+			uint32_t seedLive = std::numeric_limits<uint32_t>::max();
+			float seedDistance = std::numeric_limits<float>::max();
+			seed = std::numeric_limits<uint32_t>::max();
+			for (uint32_t v : meshletVertices)
+			{
+				const uint32_t p = positionIds[v];
+				for (uint32_t a = adjacencyStarts[p]; a < adjacencyStarts[p + 1]; a++)
+				{
+					uint32_t t = adjacency[a];
+					if (!isCandidate(t))
+					{
+						continue;
+					}
+					
+					uint32_t live = 0;
+					for (uint32_t k = 0; k < 3; k++)
+					{
+						live += liveCounts[positionIds[indices[size_t(t) * 3 + k]]];
+					}
+					
+					glm::vec3 offset = centroids[t] - center;
+					float distance = glm::dot(offset, offset);
+					if (live < seedLive || (live == seedLive && distance < seedDistance))
+					{
+						seed = t;
+						seedLive = live;
+						seedDistance = distance;
+					}
+				}
+			}
+		}
+	};
+	
+	if (ranges.empty())
+	{
+		buildRange(0, 0, numTriangles);
+	}
+	else
+	{
+		for (size_t r = 0; r < ranges.size(); r++)
+		{
+			buildRange(
+				uint32_t(r),
+				ranges[r].firstFace,
+				size_t(ranges[r].firstFace) + ranges[r].numFaces);
+		}
+	}
+	
+	/// Faces outside of every range keep their place
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		if (!emitted[t])
+		{
+			LogW("BuildMeshlets(): ranges don't cover the whole mesh.");
+			return { };
+		}
+	}
+	
+	mesh.indices.swap(reordered);
+	
+	for (Meshlet &meshlet : meshlets)
+	{
+		OptimizeVertexCache(&mesh.indices[meshlet.firstIndex], meshlet.numIndices, 3);
+		ComputeMeshletBounds(meshlet, mesh.indices.data(), mesh.p.data());
+	}
+	
+	return meshlets;
+}
+
+void Smorgasbord::ComputeMeshletBounds(
+	Meshlet &meshlet,
+	const uint32_t *indices,
+	const glm::vec3 *positions)
+{
+	const uint32_t *first = indices + meshlet.firstIndex;
+	const uint32_t *end = first + meshlet.numIndices;
+	
+	if (first == end)
+	{
+		return;
+	}
+	
+	// Bounding sphere around the bounding box center
+	
+	glm::vec3 boundingMin = positions[*first];
+	glm::vec3 boundingMax = boundingMin;
+	for (const uint32_t *i = first; i != end; i++)
+	{
+		boundingMin = glm::min(boundingMin, positions[*i]);
+		boundingMax = glm::max(boundingMax, positions[*i]);
+	}
+	
+	meshlet.center = (boundingMin + boundingMax) * 0.5f;
+	float radius2 = 0;
+	for (const uint32_t *i = first; i != end; i++)
+	{
+		glm::vec3 offset = positions[*i] - meshlet.center;
+		radius2 = std::max(radius2, glm::dot(offset, offset));
+	}
+	meshlet.radius = std::sqrt(radius2);
+	
+	// Normal cone around the mean normal
+	
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.numIndices / 3);
+	glm::vec3 normalSum = glm::vec3(0);
+	for (const uint32_t *i = first; i + 2 < end; i += 3)
+	{
+		const glm::vec3 &p0 = positions[i[0]];
+		glm::vec3 normal = glm::cross(positions[i[1]] - p0, positions[i[2]] - p0);
+		float length = glm::length(normal);
+		if (length > 0)
+		{
+			normals.push_back(normal / length);
+			normalSum += normals.back();
+		}
+	}
+	
+	meshlet.coneAxis = glm::vec3(0, 0, 1);
+	meshlet.coneCutoff = 1;
+	
+	float sumLength = glm::length(normalSum);
+	if (normals.empty() || sumLength <= 0)
+	{
+		return;
+	}
+	
+	meshlet.coneAxis = normalSum / sumLength;
+	float minDot = 1;
+	for (const glm::vec3 &normal : normals)
+	{
+		minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+	}
+	
+	/// Cones of 90 degrees or wider always have a front-facing triangle
+	if (minDot > 0)
+	{
+		meshlet.coneCutoff = std::sqrt(std::max(1.0f - minDot * minDot, 0.0f));
+	}
+}
+
+size_t Smorgasbord::CullMeshlets(
+	const std::vector<Meshlet> &meshlets,
+	Camera &camera,
+	const glm::mat4 &world,
+	std::vector<uint32_t> &visible)
+{
+	const glm::mat4 modelView = camera.GetViewMatrix() * world;
+	const glm::mat4 clip = camera.GetProjectionMatrix() * modelView;
+	
+	/// Frustum planes in model space (Gribb & Hartmann), normalized so
+	/// sphere distances are in model units
+	glm::vec4 planes[6];
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec4 row = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+		glm::vec4 w = glm::vec4(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+		planes[i * 2] = w + row;
+		planes[i * 2 + 1] = w - row;
+	}
+	for (glm::vec4 &plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	
+	/// The back-face test is done in model space too, where the sign of
+	/// the facing is the same as in world space
+	const glm::mat4 viewToModel = glm::inverse(modelView);
+	const bool isPerspective = camera.GetIsPerspective();
+	const glm::vec3 cameraPosition = glm::vec3(viewToModel * glm::vec4(0, 0, 0, 1));
+	const glm::vec3 viewDirection = glm::normalize(
+		glm::vec3(viewToModel * glm::vec4(0, 0, -1, 0)));
+	
+	size_t numVisible = 0;
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		const Meshlet &meshlet = meshlets[m];
+		
+		bool isInside = true;
+		for (const glm::vec4 &plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+			{
+				isInside = false;
+				break;
+			}
+		}
+		
+		if (!isInside)
+		{
+			continue;
+		}
+		
+		if (isPerspective)
+		{
+			glm::vec3 offset = meshlet.center - cameraPosition;
+			if (glm::dot(offset, meshlet.coneAxis)
+				>= meshlet.coneCutoff * glm::length(offset) + meshlet.radius)
+			{
+				continue;
+			}
+		}
+		else if (glm::dot(viewDirection, meshlet.coneAxis) >= meshlet.coneCutoff)
+		{
+			continue;
+		}
+		
+		visible.push_back(uint32_t(m));
+		numVisible++;
+	}
+	
+	return numVisible;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+
+Meshlets
+--------
+
+Small clusters of spatially close triangles, each stored as a contiguous
+range of the index buffer, so large meshes can be culled piece by piece.
+
+Every meshlet carries a bounding sphere for frustum culling, and a normal
+cone bounding the normals of its triangles. When the camera lies in the
+region where every normal of the cone faces away, the whole meshlet is
+back-facing:
+
+	dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius
+
+coneCutoff is the sine of the cone half angle, 1 when the cone is too
+wide to ever cull.
+
+*/
+
+namespace Smorgasbord {
+
+struct IndexedMeshData;
+struct MeshRange;
+class Camera;
+
+struct MeshletSettings
+{
+	bool enabled = false;
+	uint32_t maxVertices = 64;
+	uint32_t maxTriangles = 124;
+};
+
+struct Meshlet
+{
+	uint32_t firstIndex = 0; // into the index buffer
+	uint32_t numIndices = 0;
+	uint32_t numVertices = 0; // unique vertices referenced
+	uint32_t rangeIndex = 0; // sub-mesh the triangles belong to
+	// bounding sphere
+	glm::vec3 center = glm::vec3(0);
+	float radius = 0;
+	// normal cone
+	glm::vec3 coneAxis = glm::vec3(0, 0, 1);
+	float coneCutoff = 1;
+};
+
+/// Reorders the triangles of each range into meshlets. Meshlets never span
+/// ranges, an empty ranges vector means a single range covering the whole
+/// mesh. Triangles only
+std::vector<Meshlet> BuildMeshlets(
+	IndexedMeshData &mesh,
+	const std::vector<MeshRange> &ranges,
+	const MeshletSettings &settings);
+
+/// Sets the bounding sphere and normal cone of meshlet from its triangles,
+/// indices being the whole index buffer
+void ComputeMeshletBounds(
+	Meshlet &meshlet,
+	const uint32_t *indices,
+	const glm::vec3 *positions);
+
+/// Appends the indices of the meshlets inside the camera frustum and not
+/// entirely back-facing to visible, returns their count. world is the
+/// model to world transform of the mesh
+size_t CullMeshlets(
+	const std::vector<Meshlet> &meshlets,
+	Camera &camera,
+	const glm::mat4 &world,
+	std::vector<uint32_t> &visible);
+
+}
@@ -0,0 +1,478 @@
+#include "meshoptimize.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+using namespace Smorgasbord;
+
+/// Renumbers the vertices referenced by a part of an index buffer densely
+/// from 0, so scratch arrays scale with the part instead of the whole mesh.
+/// Returns the number of vertices referenced.
+/// The lookup table spans the index range of the part, which is narrow for
+/// welded meshes, as WeldMeshData() numbers vertices in first use order
+inline size_t CompactMeshIndices(
+	const uint32_t *indices, size_t numIndices, std::vector<uint32_t> &local)
+{
+	local.resize(numIndices);
+	if (numIndices == 0)
+	{
+		return 0;
+	}
+	
+	auto minmax = std::minmax_element(indices, indices + numIndices);
+	const uint32_t first = *minmax.first;
+	
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(size_t(*minmax.second - first) + 1, unused);
+	
+	uint32_t numVertices = 0;
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		uint32_t &v = remap[indices[i] - first];
+		if (v == unused)
+		{
+			v = numVertices++;
+		}
+		
+		local[i] = v;
+	}
+	
+	return numVertices;
+}
+
+/// FIFO cache simulation. A vertex is cached if fewer than cacheSize
+/// misses happened since it was last transformed
+struct MeshCacheSimulator
+{
+	std::vector<uint32_t> timestamps;
+	uint32_t time;
+	uint32_t cacheSize;
+	
+	MeshCacheSimulator(size_t numVertices, uint32_t cacheSize)
+		: timestamps(numVertices, 0), time(cacheSize + 1), cacheSize(cacheSize)
+	{ }
+	
+	/// Returns the number of misses
+	uint32_t AddFace(const uint32_t *face, uint32_t vertsPerFace)
+	{
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < vertsPerFace; k++)
+		{
+			uint32_t &timestamp = timestamps[face[k]];
+			if (time - timestamp > cacheSize)
+			{
+				timestamp = time++;
+				misses++;
+			}
+		}
+		
+		return misses;
+	}
+	
+	void Reset()
+	{
+		time += cacheSize + 1;
+	}
+};
+
+/// Writes the faces of indices in the order given by faceOrder
+inline void ReorderMeshFaces(
+	uint32_t *indices,
+	const std::vector<uint32_t> &faceOrder,
+	uint32_t vertsPerFace)
+{
+	std::vector<uint32_t> source(indices, indices + faceOrder.size() * vertsPerFace);
+	for (size_t i = 0; i < faceOrder.size(); i++)
+	{
+		std::copy_n(
+			&source[size_t(faceOrder[i]) * vertsPerFace],
+			vertsPerFace,
+			&indices[i * vertsPerFace]);
+	}
+}
+
+Smorgasbord::VertexCacheStatistics Smorgasbord::AnalyzeVertexCache(
+	const uint32_t *indices,
+	size_t numIndices,
+	uint32_t vertsPerFace,
+	uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics;
+	if (vertsPerFace == 0 || numIndices < vertsPerFace)
+	{
+		return statistics;
+	}
+	
+	std::vector<uint32_t> local;
+	size_t numVertices = CompactMeshIndices(indices, numIndices, local);
+	size_t numFaces = numIndices / vertsPerFace;
+	
+	MeshCacheSimulator cache(numVertices, cacheSize);
+	for (size_t i = 0; i < numFaces; i++)
+	{
+		statistics.numTransformed += cache.AddFace(&local[i * vertsPerFace], vertsPerFace);
+	}
+	
+	statistics.acmr = float(statistics.numTransformed) / float(numFaces);
+	statistics.atvr = float(statistics.numTransformed) / float(numVertices);
+	return statistics;
+}
+
+void Smorgasbord::OptimizeVertexCache(
+	uint32_t *indices,
+	size_t numIndices,
+	uint32_t vertsPerFace,
+	uint32_t cacheSize)
+{
+	if (vertsPerFace == 0 || numIndices < vertsPerFace)
+	{
+		return;
+	}
+	
+	std::vector<uint32_t> local;
+	const size_t numVertices = CompactMeshIndices(indices, numIndices, local);
+	const size_t numFaces = numIndices / vertsPerFace;
+	
+	// Vertex-face adjacency
+	
+	std::vector<uint32_t> liveFaces(numVertices, 0); // faces not emitted yet
+	for (size_t i = 0; i < numFaces * vertsPerFace; i++)
+	{
+		liveFaces[local[i]]++;
+	}
+	
+	std::vector<uint32_t> adjacencyStarts(numVertices + 1, 0);
+	std::partial_sum(liveFaces.begin(), liveFaces.end(), adjacencyStarts.begin() + 1);
+	
+	std::vector<uint32_t> adjacency(numFaces * vertsPerFace);
+	{
+		std::vector<uint32_t> cursors(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+		for (size_t i = 0; i < numFaces * vertsPerFace; i++)
+		{
+			adjacency[cursors[local[i]]++] = uint32_t(i / vertsPerFace);
+		}
+	}
+	
+	// Tipsify
+	
+	std::vector<uint32_t> cacheTime(numVertices, 0);
+	std::vector<bool> emitted(numFaces, false);
+	std::vector<uint32_t> deadEnds; // recently used vertices
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> faceOrder;
+	faceOrder.reserve(numFaces);
+	
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	int64_t fanning = 0;
+	
+	while (fanning >= 0)
+	{
+		/// Emit all remaining faces around the fanning vertex
+		candidates.clear();
+		for (uint32_t a = adjacencyStarts[fanning]; a < adjacencyStarts[fanning + 1]; a++)
+		{
+			uint32_t face = adjacency[a];
+			if (emitted[face])
+			{
+				continue;
+			}
+			
+			for (uint32_t k = 0; k < vertsPerFace; k++)
+			{
+				uint32_t v = local[size_t(face) * vertsPerFace + k];
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveFaces[v]--;
+				
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+			
+			emitted[face] = true;
+			faceOrder.push_back(face);
+		}
+		
+		/// Next fanning vertex: the oldest candidate which stays in the
+		/// cache while its remaining faces are emitted
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (liveFaces[v] == 0)
+			{
+				continue;
+			}
+			
+			int64_t priority = 0;
+			if (time - cacheTime[v] + (vertsPerFace - 1) * liveFaces[v] <= cacheSize)
+			{
+				priority = time - cacheTime[v];
+			}
+			
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+		
+		/// Dead end, continue with a recently used vertex, or with the
+		/// next unfinished vertex in index order
+		while (next < 0 && !deadEnds.empty())
+		{
+			uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveFaces[v] > 0)
+			{
+				next = v;
+			}
+		}
+		
+		while (next < 0 && cursor < numVertices)
+		{
+			if (liveFaces[cursor] > 0)
+			{
+				next = int64_t(cursor);
+			}
+			else
+			{
+				cursor++;
+			}
+		}
+		
+		fanning = next;
+	}
+	
+	ReorderMeshFaces(indices, faceOrder, vertsPerFace);
+}
+
+void Smorgasbord::OptimizeOverdraw(
+	uint32_t *indices,
+	size_t numIndices,
+	const glm::vec3 *positions,
+	uint32_t vertsPerFace,
+	float threshold,
+	uint32_t cacheSize)
+{
+	if (vertsPerFace < 3 || numIndices < vertsPerFace)
+	{
+		return;
+	}
+	
+	std::vector<uint32_t> local;
+	const size_t numVertices = CompactMeshIndices(indices, numIndices, local);
+	const size_t numFaces = numIndices / vertsPerFace;
+	
+	// Hard boundaries, where every vertex of a face missed the cache
+	
+	/// The first cluster starts at face 0 even if its face is degenerate
+	std::vector<size_t> hardClusters = { 0 }; // first faces
+	{
+		MeshCacheSimulator cache(numVertices, cacheSize);
+		for (size_t i = 0; i < numFaces; i++)
+		{
+			if (cache.AddFace(&local[i * vertsPerFace], vertsPerFace) == vertsPerFace
+				&& i > 0)
+			{
+				hardClusters.push_back(i);
+			}
+		}
+	}
+	hardClusters.push_back(numFaces);
+	
+	// Soft boundaries, where a cluster reaches the ACMR of its hard cluster
+	
+	std::vector<size_t> clusters;
+	{
+		MeshCacheSimulator cache(numVertices, cacheSize);
+		for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+		{
+			const size_t start = hardClusters[c];
+			const size_t end = hardClusters[c + 1];
+			
+			cache.Reset();
+			size_t misses = 0;
+			for (size_t i = start; i < end; i++)
+			{
+				misses += cache.AddFace(&local[i * vertsPerFace], vertsPerFace);
+			}
+			
+			const float clusterThreshold =
+				threshold * float(misses) / float(end - start);
+			
+			cache.Reset();
+			size_t clusterStart = start;
+			misses = 0;
+			clusters.push_back(start);
+			for (size_t i = start; i < end; i++)
+			{
+				misses += cache.AddFace(&local[i * vertsPerFace], vertsPerFace);
+				
+				if (i + 1 < end
+					&& float(misses) / float(i + 1 - clusterStart) <= clusterThreshold)
+				{
+					clusterStart = i + 1;
+					clusters.push_back(clusterStart);
+					misses = 0;
+					cache.Reset();
+				}
+			}
+		}
+	}
+	clusters.push_back(numFaces);
+	
+	const size_t numClusters = clusters.size() - 1;
+	
+	// Sort clusters, outward facing ones first
+	
+	glm::vec3 meshCenter = glm::vec3(0);
+	float meshArea = 0;
+	
+	std::vector<glm::vec3> clusterCenters(numClusters, glm::vec3(0));
+	std::vector<glm::vec3> clusterNormals(numClusters, glm::vec3(0));
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		float clusterArea = 0;
+		for (size_t i = clusters[c]; i < clusters[c + 1]; i++)
+		{
+			/// Normal of the first triangle stands for the whole face
+			const uint32_t *face = &indices[i * vertsPerFace];
+			glm::vec3 p0 = positions[face[0]];
+			glm::vec3 normal = glm::cross(
+				positions[face[1]] - p0, positions[face[2]] - p0);
+			float area = glm::length(normal);
+			
+			glm::vec3 faceCenter = glm::vec3(0);
+			for (uint32_t k = 0; k < vertsPerFace; k++)
+			{
+				faceCenter += positions[face[k]];
+			}
+			faceCenter /= float(vertsPerFace);
+			
+			clusterCenters[c] += faceCenter * area;
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		
+		meshCenter += clusterCenters[c];
+		meshArea += clusterArea;
+		
+		if (clusterArea > 0)
+		{
+			clusterCenters[c] /= clusterArea;
+		}
+	}
+	
+	if (meshArea > 0)
+	{
+		meshCenter /= meshArea;
+	}
+	
+	std::vector<float> sortKeys(numClusters);
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		float normalLength = glm::length(clusterNormals[c]);
+		sortKeys[c] = normalLength > 0
+			? glm::dot(clusterCenters[c] - meshCenter, clusterNormals[c] / normalLength)
+			: 0.0f;
+	}
+	
+	std::vector<uint32_t> clusterOrder(numClusters);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(
+		clusterOrder.begin(),
+		clusterOrder.end(),
+		[&](uint32_t a, uint32_t b)
+		{
+			return sortKeys[a] > sortKeys[b];
+		});
+	
+	std::vector<uint32_t> faceOrder;
+	faceOrder.reserve(numFaces);
+	for (uint32_t c : clusterOrder)
+	{
+		for (size_t i = clusters[c]; i < clusters[c + 1]; i++)
+		{
+			faceOrder.push_back(uint32_t(i));
+		}
+	}
+	
+	ReorderMeshFaces(indices, faceOrder, vertsPerFace);
+}
+
+void Smorgasbord::OptimizeVertexFetch(IndexedMeshData &mesh)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.p.size(), unused);
+	
+	uint32_t numVertices = 0;
+	for (uint32_t &index : mesh.indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = numVertices++;
+		}
+		
+		index = remap[index];
+	}
+	
+	auto reorder = [&](auto &attributes)
+	{
+		if (attributes.empty())
+		{
+			return;
+		}
+		
+		typename std::remove_reference<decltype(attributes)>::type
+			reordered(numVertices);
+		for (size_t i = 0; i < remap.size(); i++)
+		{
+			if (remap[i] != unused)
+			{
+				reordered[remap[i]] = attributes[i];
+			}
+		}
+		
+		attributes.swap(reordered);
+	};
+	
+	reorder(mesh.p);
+	reorder(mesh.n);
+	reorder(mesh.t);
+}
+
+void Smorgasbord::OptimizeIndexedMesh(
+	IndexedMeshData &mesh,
+	const std::vector<MeshRange> &ranges,
+	uint32_t cacheSize)
+{
+	const uint32_t vertsPerFace = mesh.vertsPerFace;
+	
+	auto optimizeRange = [&](size_t firstIndex, size_t numIndices)
+	{
+		uint32_t *indices = &mesh.indices[firstIndex];
+		OptimizeVertexCache(indices, numIndices, vertsPerFace, cacheSize);
+		OptimizeOverdraw(
+			indices, numIndices, mesh.p.data(), vertsPerFace, 1.05f, cacheSize);
+	};
+	
+	if (ranges.empty())
+	{
+		optimizeRange(0, mesh.indices.size());
+	}
+	else
+	{
+		for (const MeshRange &range : ranges)
+		{
+			optimizeRange(
+				size_t(range.firstFace) * vertsPerFace,
+				size_t(range.numFaces) * vertsPerFace);
+		}
+	}
+	
+	OptimizeVertexFetch(mesh);
+}
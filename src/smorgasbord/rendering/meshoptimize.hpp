@@ -0,0 +1,74 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+
+Mesh optimization
+-----------------
+
+Reorders indexed meshes for the GPU, without changing what's drawn:
+
+1. OptimizeVertexCache() orders the faces for the post-transform vertex
+	cache (Tipsify, Sander et al. 2007)
+2. OptimizeOverdraw() splits the result into clusters at cache breaks and
+	draws outward facing clusters first, so they occlude the rest
+3. OptimizeVertexFetch() renumbers the vertices in first use order, so
+	vertex fetches read the vertex buffer mostly sequentially
+
+The face order functions work on any part of an index buffer, so faces
+never move between sub-mesh ranges. Faces are vertsPerFace consecutive
+indices, e.g. triangles or patches.
+
+*/
+
+namespace Smorgasbord {
+
+struct VertexCacheStatistics
+{
+	size_t numTransformed = 0; // vertex shader invocations
+	float acmr = 0; // average cache miss ratio, transformed vertices per face
+	float atvr = 0; // average transformed vertex ratio, per unique vertex
+};
+
+/// Simulates a FIFO post-transform cache with cacheSize entries. The ideal
+/// ATVR is 1, the ACMR of triangle meshes is usually between 0.5 and 3
+VertexCacheStatistics AnalyzeVertexCache(
+	const uint32_t *indices,
+	size_t numIndices,
+	uint32_t vertsPerFace,
+	uint32_t cacheSize = 16);
+
+void OptimizeVertexCache(
+	uint32_t *indices,
+	size_t numIndices,
+	uint32_t vertsPerFace,
+	uint32_t cacheSize = 16);
+
+/// Expects faces ordered by OptimizeVertexCache(). threshold is the ACMR
+/// loss allowed for finer clusters, relative to the input order
+void OptimizeOverdraw(
+	uint32_t *indices,
+	size_t numIndices,
+	const glm::vec3 *positions,
+	uint32_t vertsPerFace,
+	float threshold = 1.05f,
+	uint32_t cacheSize = 16);
+
+/// Also removes vertices not referenced by any index
+void OptimizeVertexFetch(IndexedMeshData &mesh);
+
+/// Runs all the above. Faces are reordered within each range only, an
+/// empty ranges vector means a single range covering the whole mesh
+void OptimizeIndexedMesh(
+	IndexedMeshData &mesh,
+	const std::vector<MeshRange> &ranges,
+	uint32_t cacheSize = 16);
+
+}
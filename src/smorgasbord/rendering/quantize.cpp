@@ -0,0 +1,172 @@
+#include "quantize.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+inline uint16_t QuantizeUNorm16(float v)
+{
+	return uint16_t(std::lround(glm::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+inline int16_t QuantizeSNorm16(float v)
+{
+	return int16_t(std::lround(glm::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+/// GL 4.2 conversion of normalized signed integers
+inline float DequantizeSNorm16(int16_t v)
+{
+	return std::max(float(v) / 32767.0f, -1.0f);
+}
+
+inline float SafeReciprocal(float v)
+{
+	return v > 0 ? 1.0f / v : 0.0f;
+}
+
+glm::vec2 Smorgasbord::EncodeOctahedral(glm::vec3 n)
+{
+	float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (sum <= 0)
+	{
+		return glm::vec2(0);
+	}
+	
+	n /= sum;
+	
+	if (n.z < 0)
+	{
+		return glm::vec2(
+			(1.0f - std::abs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f),
+			(1.0f - std::abs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f));
+	}
+	
+	return glm::vec2(n.x, n.y);
+}
+
+glm::vec3 Smorgasbord::DecodeOctahedral(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0)
+	{
+		n.x = (1.0f - std::abs(e.y)) * (e.x >= 0 ? 1.0f : -1.0f);
+		n.y = (1.0f - std::abs(e.x)) * (e.y >= 0 ? 1.0f : -1.0f);
+	}
+	
+	return glm::normalize(n);
+}
+
+bool Smorgasbord::QuantizePositions(
+	const std::vector<glm::vec3> &positions,
+	glm::vec3 boundingMin,
+	glm::vec3 boundingMax,
+	float maxError,
+	std::vector<QuantizedPosition> &quantized,
+	glm::vec3 &offset,
+	glm::vec3 &scale,
+	float &error)
+{
+	glm::vec3 extent = boundingMax - boundingMin;
+	glm::vec3 invExtent(
+		SafeReciprocal(extent.x),
+		SafeReciprocal(extent.y),
+		SafeReciprocal(extent.z));
+	
+	offset = boundingMin;
+	scale = extent;
+	error = 0;
+	
+	quantized.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		glm::vec3 v = (positions[i] - boundingMin) * invExtent;
+		QuantizedPosition &q = quantized[i];
+		q.x = QuantizeUNorm16(v.x);
+		q.y = QuantizeUNorm16(v.y);
+		q.z = QuantizeUNorm16(v.z);
+		q.w = 0;
+		
+		glm::vec3 decoded = offset
+			+ scale * glm::vec3(q.x, q.y, q.z) / 65535.0f;
+		glm::vec3 difference = glm::abs(decoded - positions[i]);
+		error = std::max(error, std::max(
+			std::max(difference.x, difference.y), difference.z));
+	}
+	
+	return error <= maxError;
+}
+
+bool Smorgasbord::QuantizeNormals(
+	const std::vector<glm::vec3> &normals,
+	float maxError,
+	std::vector<QuantizedNormal> &quantized,
+	float &error)
+{
+	error = 0;
+	
+	quantized.resize(normals.size());
+	for (size_t i = 0; i < normals.size(); i++)
+	{
+		glm::vec2 e = EncodeOctahedral(normals[i]);
+		QuantizedNormal &q = quantized[i];
+		q.x = QuantizeSNorm16(e.x);
+		q.y = QuantizeSNorm16(e.y);
+		
+		float length = glm::length(normals[i]);
+		if (length <= 0)
+		{
+			continue; // degenerate normals have no direction to lose
+		}
+		
+		glm::vec3 decoded = DecodeOctahedral(
+			glm::vec2(DequantizeSNorm16(q.x), DequantizeSNorm16(q.y)));
+		float cosAngle = glm::dot(decoded, normals[i] / length);
+		error = std::max(error, std::acos(glm::clamp(cosAngle, -1.0f, 1.0f)));
+	}
+	
+	return error <= maxError;
+}
+
+bool Smorgasbord::QuantizeTexCoords(
+	const std::vector<glm::vec2> &texCoords,
+	float maxError,
+	std::vector<QuantizedTexCoord> &quantized,
+	glm::vec2 &offset,
+	glm::vec2 &scale,
+	float &error)
+{
+	glm::vec2 boundingMin(0);
+	glm::vec2 boundingMax(0);
+	if (!texCoords.empty())
+	{
+		boundingMin = texCoords[0];
+		boundingMax = texCoords[0];
+		for (const glm::vec2 &t : texCoords)
+		{
+			boundingMin = glm::min(boundingMin, t);
+			boundingMax = glm::max(boundingMax, t);
+		}
+	}
+	
+	glm::vec2 extent = boundingMax - boundingMin;
+	glm::vec2 invExtent(SafeReciprocal(extent.x), SafeReciprocal(extent.y));
+	
+	offset = boundingMin;
+	scale = extent;
+	error = 0;
+	
+	quantized.resize(texCoords.size());
+	for (size_t i = 0; i < texCoords.size(); i++)
+	{
+		glm::vec2 v = (texCoords[i] - boundingMin) * invExtent;
+		QuantizedTexCoord &q = quantized[i];
+		q.x = QuantizeUNorm16(v.x);
+		q.y = QuantizeUNorm16(v.y);
+		
+		glm::vec2 decoded = offset + scale * glm::vec2(q.x, q.y) / 65535.0f;
+		glm::vec2 difference = glm::abs(decoded - texCoords[i]);
+		error = std::max(error, std::max(difference.x, difference.y));
+	}
+	
+	return error <= maxError;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/*
+
+Vertex attribute quantization
+-----------------------------
+
+Positions: UNorm16 offsets within the bounding box, 4 components with w
+	unused to keep attributes 4 byte aligned. Decode with
+	p = offset + scale * v
+Normals: octahedral encoding in two SNorm16 components. Decode with
+
+	vec3 n = vec3(v.xy, 1.0 - abs(v.x) - abs(v.y));
+	if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+	n = normalize(n);
+
+Texture coordinates: UNorm16 offsets within the texture coordinate bounds,
+	decode with t = offset + scale * v
+
+Every Quantize function measures the largest error it introduced, and
+fails if that's above the bound, so the caller can keep the attribute as
+float.
+
+*/
+
+namespace Smorgasbord {
+
+struct VertexQuantization
+{
+	bool enabled = false;
+	float maxPositionError = 1e-4f; // relative to the largest bounding box side
+	float maxNormalError = 1e-3f; // in radians
+	float maxTexCoordError = 1.0f / 8192; // in texture coordinate units
+};
+
+struct QuantizedPosition
+{
+	uint16_t x, y, z, w;
+};
+
+struct QuantizedNormal
+{
+	int16_t x, y;
+};
+
+struct QuantizedTexCoord
+{
+	uint16_t x, y;
+};
+
+glm::vec2 EncodeOctahedral(glm::vec3 n);
+glm::vec3 DecodeOctahedral(glm::vec2 e);
+
+/// offset and scale are set to the decode transform. error is set to the
+/// largest error, in model units
+bool QuantizePositions(
+	const std::vector<glm::vec3> &positions,
+	glm::vec3 boundingMin,
+	glm::vec3 boundingMax,
+	float maxError,
+	std::vector<QuantizedPosition> &quantized,
+	glm::vec3 &offset,
+	glm::vec3 &scale,
+	float &error);
+
+bool QuantizeNormals(
+	const std::vector<glm::vec3> &normals,
+	float maxError,
+	std::vector<QuantizedNormal> &quantized,
+	float &error);
+
+bool QuantizeTexCoords(
+	const std::vector<glm::vec2> &texCoords,
+	float maxError,
+	std::vector<QuantizedTexCoord> &quantized,
+	glm::vec2 &offset,
+	glm::vec2 &scale,
+	float &error);
+
+}
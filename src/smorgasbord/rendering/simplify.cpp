@@ -0,0 +1,454 @@
+#include "simplify.hpp"
+#include "meshoptimize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace Smorgasbord;
+
+/// Sum of squared distances to planes, weighted by triangle area
+struct SimplifyQuadric
+{
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+	double weight = 0;
+	
+	void AddPlane(glm::vec3 n, float d, float w)
+	{
+		a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+		b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+		c2 += w * n.z * n.z; cd += w * n.z * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+	
+	void Add(const SimplifyQuadric &q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+	
+	/// Mean squared distance of p to the planes
+	double Evaluate(glm::vec3 p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		double e =
+			a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z
+			+ d2;
+		
+		return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+struct SimplifyPositionHash
+{
+	size_t operator()(const glm::vec3 &p) const
+	{
+		uint32_t words[3];
+		std::memcpy(words, &p, sizeof(words));
+		return size_t(words[0] * 73856093u ^ words[1] * 19349663u ^ words[2] * 83492791u);
+	}
+};
+
+struct SimplifyPositionEqual
+{
+	bool operator()(const glm::vec3 &a, const glm::vec3 &b) const
+	{
+		return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+	}
+};
+
+struct SimplifyCollapse
+{
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+std::vector<uint32_t> Smorgasbord::SimplifyMesh(
+	const uint32_t *indices,
+	size_t numIndices,
+	const std::vector<glm::vec3> &positions,
+	size_t targetIndexCount,
+	float maxError,
+	float &error)
+{
+	error = 0;
+	numIndices -= numIndices % 3;
+	
+	// Local vertices, so memory scales with the part being simplified
+	
+	std::unordered_map<uint32_t, uint32_t> localIds;
+	std::vector<uint32_t> vertices; // local to global
+	std::vector<uint32_t> triangles(numIndices);
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		auto result = localIds.emplace(indices[i], uint32_t(vertices.size()));
+		if (result.second)
+		{
+			vertices.push_back(indices[i]);
+		}
+		
+		triangles[i] = result.first->second;
+	}
+	
+	const size_t numVertices = vertices.size();
+	
+	/// Vertices split by attribute seams share a position group
+	std::vector<uint32_t> groups(numVertices);
+	std::vector<uint32_t> groupSizes;
+	{
+		std::unordered_map<glm::vec3, uint32_t, SimplifyPositionHash, SimplifyPositionEqual> groupIds;
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			auto result = groupIds.emplace(
+				positions[vertices[v]], uint32_t(groupSizes.size()));
+			if (result.second)
+			{
+				groupSizes.push_back(0);
+			}
+			
+			groups[v] = result.first->second;
+			groupSizes[groups[v]]++;
+		}
+	}
+	
+	const size_t numGroups = groupSizes.size();
+	auto position = [&](uint32_t v) -> const glm::vec3&
+	{
+		return positions[vertices[v]];
+	};
+	
+	// Lock seams, borders and non-manifold edges
+	
+	std::vector<uint8_t> locked(numGroups, 0);
+	for (size_t g = 0; g < numGroups; g++)
+	{
+		locked[g] = groupSizes[g] > 1;
+	}
+	
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeCounts;
+		edgeCounts.reserve(numIndices);
+		for (size_t t = 0; t < numIndices; t += 3)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint64_t a = groups[triangles[t + k]];
+				uint64_t b = groups[triangles[t + (k + 1) % 3]];
+				if (a != b)
+				{
+					edgeCounts[std::min(a, b) << 32 | std::max(a, b)]++;
+				}
+			}
+		}
+		
+		for (const auto &edge : edgeCounts)
+		{
+			if (edge.second != 2)
+			{
+				locked[edge.first >> 32] = 1;
+				locked[edge.first & 0xFFFFFFFFu] = 1;
+			}
+		}
+	}
+	
+	// Quadrics
+	
+	std::vector<SimplifyQuadric> quadrics(numGroups);
+	for (size_t t = 0; t < numIndices; t += 3)
+	{
+		const glm::vec3 &p0 = position(triangles[t]);
+		glm::vec3 normal = glm::cross(
+			position(triangles[t + 1]) - p0, position(triangles[t + 2]) - p0);
+		float length = glm::length(normal);
+		if (length <= 0)
+		{
+			continue;
+		}
+		
+		normal /= length;
+		float d = -glm::dot(normal, p0);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			quadrics[groups[triangles[t + k]]].AddPlane(normal, d, length * 0.5f);
+		}
+	}
+	
+	// Collapse passes
+	
+	const double maxCost = double(maxError) * double(maxError);
+	double maxAppliedCost = 0;
+	
+	std::vector<uint32_t> remap(numVertices);
+	std::vector<uint8_t> touched(numGroups);
+	std::vector<uint32_t> adjacencyStarts(numVertices + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<SimplifyCollapse> collapses;
+	
+	while (triangles.size() > targetIndexCount)
+	{
+		/// Vertex to triangle adjacency of the current triangles
+		std::fill(adjacencyStarts.begin(), adjacencyStarts.end(), 0);
+		for (uint32_t v : triangles)
+		{
+			adjacencyStarts[v + 1]++;
+		}
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			adjacencyStarts[v + 1] += adjacencyStarts[v];
+		}
+		
+		adjacency.resize(triangles.size());
+		{
+			std::vector<uint32_t> cursors(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+			for (size_t i = 0; i < triangles.size(); i++)
+			{
+				adjacency[cursors[triangles[i]]++] = uint32_t(i / 3);
+			}
+		}
+		
+		/// Both directions of every edge, the cost being the error of
+		/// moving the source vertex onto the target
+		collapses.clear();
+		for (size_t t = 0; t < triangles.size(); t += 3)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t a = triangles[t + k];
+				uint32_t b = triangles[t + (k + 1) % 3];
+				
+				for (uint32_t direction = 0; direction < 2; direction++)
+				{
+					uint32_t from = direction == 0 ? a : b;
+					uint32_t to = direction == 0 ? b : a;
+					if (locked[groups[from]] || groups[from] == groups[to])
+					{
+						continue;
+					}
+					
+					double cost = quadrics[groups[from]].Evaluate(position(to));
+					if (cost <= maxCost)
+					{
+						collapses.push_back({ from, to, cost });
+					}
+				}
+			}
+		}
+		
+		if (collapses.empty())
+		{
+			break;
+		}
+		
+		std::sort(
+			collapses.begin(),
+			collapses.end(),
+			[](const SimplifyCollapse &a, const SimplifyCollapse &b)
+			{
+				return a.cost < b.cost;
+			});
+		
+		/// Collapses of a pass must not share triangles, so the flip
+		/// checks stay valid, and are applied together afterwards
+		std::fill(touched.begin(), touched.end(), 0);
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			remap[v] = uint32_t(v);
+		}
+		
+		size_t remainingIndices = triangles.size();
+		size_t numCollapsed = 0;
+		
+		for (const SimplifyCollapse &collapse : collapses)
+		{
+			if (remainingIndices <= targetIndexCount)
+			{
+				break;
+			}
+			
+			const uint32_t groupFrom = groups[collapse.from];
+			const uint32_t groupTo = groups[collapse.to];
+			if (touched[groupFrom] || touched[groupTo])
+			{
+				continue;
+			}
+			
+			bool isValid = true;
+			size_t numRemoved = 0;
+			for (uint32_t a = adjacencyStarts[collapse.from];
+				a < adjacencyStarts[collapse.from + 1] && isValid;
+				a++)
+			{
+				const uint32_t *triangle = &triangles[size_t(adjacency[a]) * 3];
+				
+				glm::vec3 p[3];
+				bool isRemoved = false;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					isRemoved = isRemoved || groups[triangle[k]] == groupTo;
+					p[k] = position(triangle[k]);
+				}
+				
+				if (isRemoved)
+				{
+					numRemoved++;
+					continue;
+				}
+				
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					if (triangle[k] == collapse.from)
+					{
+						p[k] = position(collapse.to);
+					}
+				}
+				glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				
+				isValid = glm::dot(before, after) > 0;
+			}
+			
+			if (!isValid)
+			{
+				continue;
+			}
+			
+			remap[collapse.from] = collapse.to;
+			quadrics[groupTo].Add(quadrics[groupFrom]);
+			maxAppliedCost = std::max(maxAppliedCost, collapse.cost);
+			remainingIndices -= numRemoved * 3;
+			numCollapsed++;
+			
+			touched[groupFrom] = 1;
+			touched[groupTo] = 1;
+			for (uint32_t a = adjacencyStarts[collapse.from]; a < adjacencyStarts[collapse.from + 1]; a++)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					touched[groups[triangles[size_t(adjacency[a]) * 3 + k]]] = 1;
+				}
+			}
+		}
+		
+		if (numCollapsed == 0)
+		{
+			break;
+		}
+		
+		/// Apply collapses and drop triangles which became degenerate
+		size_t target = 0;
+		for (size_t t = 0; t < triangles.size(); t += 3)
+		{
+			uint32_t a = remap[triangles[t]];
+			uint32_t b = remap[triangles[t + 1]];
+			uint32_t c = remap[triangles[t + 2]];
+			if (groups[a] == groups[b] || groups[b] == groups[c] || groups[c] == groups[a])
+			{
+				continue;
+			}
+			
+			triangles[target++] = a;
+			triangles[target++] = b;
+			triangles[target++] = c;
+		}
+		triangles.resize(target);
+	}
+	
+	error = float(std::sqrt(maxAppliedCost));
+	
+	for (uint32_t &v : triangles)
+	{
+		v = vertices[v];
+	}
+	
+	return triangles;
+}
+
+std::vector<Smorgasbord::MeshLODLevel> Smorgasbord::GenerateMeshLODs(
+	IndexedMeshData &mesh,
+	const std::vector<MeshRange> &ranges,
+	const MeshLODSettings &settings,
+	float boundingScale)
+{
+	std::vector<MeshLODLevel> levels(1);
+	levels[0].numIndices = uint32_t(mesh.indices.size());
+	levels[0].ranges = ranges;
+	if (ranges.empty())
+	{
+		MeshRange range;
+		range.numFaces = uint32_t(mesh.indices.size() / 3);
+		levels[0].ranges.push_back(range);
+	}
+	
+	if (mesh.vertsPerFace != 3)
+	{
+		return levels; // triangles only
+	}
+	
+	const float maxError = settings.maxError * boundingScale;
+	
+	while (levels.size() < settings.maxLevels)
+	{
+		const MeshLODLevel &previous = levels.back();
+		if (previous.numIndices / 3 <= settings.minTriangles
+			|| previous.error >= maxError)
+		{
+			break;
+		}
+		
+		MeshLODLevel level;
+		level.firstIndex = uint32_t(mesh.indices.size());
+		level.error = previous.error;
+		
+		for (const MeshRange &range : previous.ranges)
+		{
+			const size_t first = size_t(range.firstFace) * 3;
+			const size_t count = size_t(range.numFaces) * 3;
+			const size_t target = size_t(float(count) * settings.reduction) / 3 * 3;
+			
+			float error = 0;
+			std::vector<uint32_t> simplified = SimplifyMesh(
+				&mesh.indices[first],
+				count,
+				mesh.p,
+				target,
+				maxError - previous.error,
+				error);
+			OptimizeVertexCache(simplified.data(), simplified.size(), 3);
+			
+			MeshRange levelRange = range;
+			levelRange.firstFace = uint32_t(mesh.indices.size() / 3);
+			levelRange.numFaces = uint32_t(simplified.size() / 3);
+			if (levelRange.numFaces > 0)
+			{
+				level.ranges.push_back(levelRange);
+			}
+			
+			mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+			level.error = std::max(level.error, previous.error + error);
+		}
+		
+		level.numIndices = uint32_t(mesh.indices.size() - level.firstIndex);
+		
+		/// Levels barely smaller than the previous one are not worth it
+		if (float(level.numIndices) > 0.9f * float(previous.numIndices))
+		{
+			mesh.indices.resize(level.firstIndex);
+			break;
+		}
+		
+		levels.push_back(std::move(level));
+	}
+	
+	return levels;
+}
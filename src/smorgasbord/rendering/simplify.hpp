@@ -0,0 +1,59 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+
+Mesh simplification
+-------------------
+
+Quadric error metric edge collapses (Garland & Heckbert 1997). Vertices
+are collapsed into one of their neighbors instead of a new optimal
+position, so every level of detail indexes the vertex buffer of the full
+mesh, and all levels share a single vertex buffer.
+
+Vertices on borders, attribute seams and non-manifold edges never move,
+so simplified sub-meshes stay watertight with their neighbors. Works on
+triangles only, see TriangulateMeshData().
+
+*/
+
+namespace Smorgasbord {
+
+/// A level of detail stored as index range of the shared index buffer
+struct MeshLODLevel
+{
+	uint32_t firstIndex = 0;
+	uint32_t numIndices = 0;
+	float error = 0; // geometric deviation from the full mesh, in model units
+	std::vector<MeshRange> ranges; // firstFace counts from the buffer start
+};
+
+/// Returns the simplified triangles of indices, with at most
+/// targetIndexCount indices unless no further collapse stays within
+/// maxError. error is set to the largest deviation introduced, in model
+/// units
+std::vector<uint32_t> SimplifyMesh(
+	const uint32_t *indices,
+	size_t numIndices,
+	const std::vector<glm::vec3> &positions,
+	size_t targetIndexCount,
+	float maxError,
+	float &error);
+
+/// Appends the simplified levels to mesh.indices, each simplified from the
+/// previous one, range by range. levels[0] is the full mesh. An empty
+/// ranges vector means a single range covering the whole mesh
+std::vector<MeshLODLevel> GenerateMeshLODs(
+	IndexedMeshData &mesh,
+	const std::vector<MeshRange> &ranges,
+	const MeshLODSettings &settings,
+	float boundingScale);
+
+}
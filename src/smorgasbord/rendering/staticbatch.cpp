@@ -0,0 +1,517 @@
+#include "staticbatch.hpp"
+#include "transform.hpp"
+
+#include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+
+/// A distinct MeshData, shared by all instances placing it
+struct StaticBatchSource
+{
+	glm::vec3 boundingMin = glm::vec3(0);
+	glm::vec3 boundingMax = glm::vec3(0);
+	uint32_t numVertices = 0; // welded
+	/// The whole mesh if it has no ranges
+	std::vector<Smorgasbord::MeshRange> ranges;
+	std::vector<size_t> rangeCorners; // first corner of every range
+	std::vector<size_t> rangeCornerCounts;
+	bool hasNormal = false;
+	bool hasTexCoord = false;
+};
+
+struct StaticBatchItem
+{
+	uint32_t instance = 0;
+	uint32_t source = 0;
+	glm::vec3 center = glm::vec3(0); // of the world space bounding box
+	glm::vec3 boundingMin = glm::vec3(0);
+	glm::vec3 boundingMax = glm::vec3(0);
+	uint32_t morton = 0;
+};
+
+/// A range of an item, placed in the merged mesh
+struct StaticBatchRange
+{
+	uint32_t item = 0; // within the batch
+	uint32_t range = 0; // into StaticBatchSource::ranges
+	int32_t materialIndex = -1; // merged
+	uint32_t firstFace = 0; // merged
+	size_t firstCorner = 0; // merged
+};
+
+/// Spreads the low 10 bits of v to every third bit
+inline uint32_t SpreadStaticBatchBits(uint32_t v)
+{
+	v &= 0x3FF;
+	v = (v | (v << 16)) & 0x030000FF;
+	v = (v | (v << 8)) & 0x0300F00F;
+	v = (v | (v << 4)) & 0x030C30C3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+static StaticBatchSource CreateStaticBatchSource(const Smorgasbord::MeshData &mesh)
+{
+	StaticBatchSource source;
+	source.hasNormal = !mesh.n.empty() && mesh.fn.size() == mesh.fp.size();
+	source.hasTexCoord = !mesh.t.empty() && mesh.ft.size() == mesh.fp.size();
+	
+	if (!mesh.p.empty())
+	{
+		source.boundingMin = mesh.p[0];
+		source.boundingMax = mesh.p[0];
+		for (const glm::vec3 &p : mesh.p)
+		{
+			source.boundingMin = glm::min(source.boundingMin, p);
+			source.boundingMax = glm::max(source.boundingMax, p);
+		}
+	}
+	
+	/// Corners referenced by distinct attribute index combinations, an
+	/// upper bound of the vertices left after welding
+	std::unordered_map<uint64_t, uint32_t> vertices;
+	vertices.reserve(mesh.fp.size());
+	for (size_t i = 0; i < mesh.fp.size(); i++)
+	{
+		uint64_t key = mesh.fp[i];
+		key = key * 0x9E3779B97F4A7C15ull + (source.hasNormal ? mesh.fn[i] : 0);
+		key = key * 0x9E3779B97F4A7C15ull + (source.hasTexCoord ? mesh.ft[i] : 0);
+		vertices.emplace(key, 0);
+	}
+	source.numVertices = uint32_t(vertices.size());
+	
+	// Ranges and their first corners
+	
+	source.ranges = mesh.ranges;
+	if (source.ranges.empty())
+	{
+		Smorgasbord::MeshRange range;
+		range.numFaces = uint32_t(mesh.c.size());
+		source.ranges.push_back(range);
+	}
+	
+	size_t corner = 0;
+	uint32_t face = 0;
+	for (const Smorgasbord::MeshRange &range : source.ranges)
+	{
+		for (; face < range.firstFace; face++)
+		{
+			corner += size_t(mesh.c[face]);
+		}
+		
+		size_t first = corner;
+		for (; face < range.firstFace + range.numFaces; face++)
+		{
+			corner += size_t(mesh.c[face]);
+		}
+		
+		source.rangeCorners.push_back(first);
+		source.rangeCornerCounts.push_back(corner - first);
+	}
+	
+	return source;
+}
+
+/// Builds the merged world space mesh of the items
+static std::unique_ptr<Smorgasbord::MeshData> MergeStaticBatchItems(
+	const std::vector<Smorgasbord::StaticBatchInstance> &instances,
+	const std::vector<StaticBatchSource> &sources,
+	const std::vector<StaticBatchItem> &items,
+	std::vector<StaticBatchRange> &ranges,
+	uint32_t numThreads)
+{
+	using namespace Smorgasbord;
+	
+	std::unique_ptr<MeshData> merged(new MeshData());
+	
+	// Materials
+	
+	std::unordered_map<std::string, int32_t> materialIndices;
+	std::unordered_map<std::string, bool> materialLibraries;
+	
+	ranges.clear();
+	for (uint32_t i = 0; i < items.size(); i++)
+	{
+		const MeshData &mesh = *instances[items[i].instance].mesh;
+		const StaticBatchSource &source = sources[items[i].source];
+		
+		for (const std::string &library : mesh.materialLibraries)
+		{
+			if (materialLibraries.emplace(library, true).second)
+			{
+				merged->materialLibraries.push_back(library);
+			}
+		}
+		
+		for (uint32_t r = 0; r < source.ranges.size(); r++)
+		{
+			const MeshRange &range = source.ranges[r];
+			if (range.numFaces == 0)
+			{
+				continue; // would be dropped by TriangulateMeshData()
+			}
+			
+			StaticBatchRange batchRange;
+			batchRange.item = i;
+			batchRange.range = r;
+			
+			if (range.materialIndex >= 0
+				&& size_t(range.materialIndex) < mesh.materialNames.size())
+			{
+				const std::string &name = mesh.materialNames[range.materialIndex];
+				auto result = materialIndices.emplace(
+					name, int32_t(merged->materialNames.size()));
+				if (result.second)
+				{
+					merged->materialNames.push_back(name);
+				}
+				
+				batchRange.materialIndex = result.first->second;
+			}
+			
+			ranges.push_back(batchRange);
+		}
+	}
+	
+	/// Faces sharing a material become contiguous, instances keep their
+	/// order within each material
+	std::stable_sort(
+		ranges.begin(),
+		ranges.end(),
+		[](const StaticBatchRange &a, const StaticBatchRange &b)
+		{
+			return a.materialIndex < b.materialIndex;
+		});
+	
+	// Layout of the merged arrays
+	
+	std::vector<size_t> pBases(items.size() + 1, 0);
+	std::vector<size_t> nBases(items.size() + 1, 0);
+	std::vector<size_t> tBases(items.size() + 1, 0);
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const MeshData &mesh = *instances[items[i].instance].mesh;
+		const StaticBatchSource &source = sources[items[i].source];
+		pBases[i + 1] = pBases[i] + mesh.p.size();
+		nBases[i + 1] = nBases[i] + (source.hasNormal ? mesh.n.size() : 0);
+		tBases[i + 1] = tBases[i] + (source.hasTexCoord ? mesh.t.size() : 0);
+	}
+	
+	uint32_t numFaces = 0;
+	size_t numCorners = 0;
+	for (StaticBatchRange &batchRange : ranges)
+	{
+		const StaticBatchSource &source = sources[items[batchRange.item].source];
+		const MeshRange &range = source.ranges[batchRange.range];
+		
+		batchRange.firstFace = numFaces;
+		batchRange.firstCorner = numCorners;
+		numFaces += range.numFaces;
+		numCorners += source.rangeCornerCounts[batchRange.range];
+		
+		MeshRange mergedRange = range;
+		mergedRange.firstFace = batchRange.firstFace;
+		mergedRange.materialIndex = batchRange.materialIndex;
+		merged->ranges.push_back(mergedRange);
+	}
+	
+	const bool hasNormal = sources[items[0].source].hasNormal;
+	const bool hasTexCoord = sources[items[0].source].hasTexCoord;
+	
+	merged->p.resize(pBases.back());
+	merged->n.resize(nBases.back());
+	merged->t.resize(tBases.back());
+	merged->c.resize(numFaces);
+	merged->fp.resize(numCorners);
+	merged->fn.resize(hasNormal ? numCorners : 0);
+	merged->ft.resize(hasTexCoord ? numCorners : 0);
+	
+	// Transform attributes
+	
+	ParallelFor(
+		items.size(),
+		[&](size_t i)
+		{
+			const MeshData &mesh = *instances[items[i].instance].mesh;
+			glm::mat4 world = instances[items[i].instance].world;
+			
+			for (size_t v = 0; v < mesh.p.size(); v++)
+			{
+				merged->p[pBases[i] + v] = glm::vec3(world * glm::vec4(mesh.p[v], 1.0f));
+			}
+			
+			if (hasNormal)
+			{
+				glm::mat3 normalTransform = glm::mat3(NormalTransform(world));
+				for (size_t v = 0; v < mesh.n.size(); v++)
+				{
+					glm::vec3 n = normalTransform * mesh.n[v];
+					float length = glm::length(n);
+					merged->n[nBases[i] + v] = length > 0 ? n / length : n;
+				}
+			}
+			
+			if (hasTexCoord)
+			{
+				std::copy(mesh.t.begin(), mesh.t.end(), merged->t.begin() + tBases[i]);
+			}
+		},
+		numThreads);
+	
+	// Copy faces
+	
+	ParallelFor(
+		ranges.size(),
+		[&](size_t r)
+		{
+			const StaticBatchRange &batchRange = ranges[r];
+			const StaticBatchItem &item = items[batchRange.item];
+			const StaticBatchSource &source = sources[item.source];
+			const MeshData &mesh = *instances[item.instance].mesh;
+			const MeshRange &range = source.ranges[batchRange.range];
+			
+			/// Mirroring transforms flip the winding
+			const glm::mat3 world = glm::mat3(instances[item.instance].world);
+			const bool mirrored =
+				glm::dot(glm::cross(world[0], world[1]), world[2]) < 0;
+			
+			const uint32_t pBase = uint32_t(pBases[batchRange.item]);
+			const uint32_t nBase = uint32_t(nBases[batchRange.item]);
+			const uint32_t tBase = uint32_t(tBases[batchRange.item]);
+			
+			size_t corner = source.rangeCorners[batchRange.range];
+			size_t mergedCorner = batchRange.firstCorner;
+			for (uint32_t f = 0; f < range.numFaces; f++)
+			{
+				const int32_t faceSize = mesh.c[range.firstFace + f];
+				merged->c[batchRange.firstFace + f] = faceSize;
+				
+				for (int32_t k = 0; k < faceSize; k++)
+				{
+					/// Reversed faces keep their first corner
+					size_t from = corner + (mirrored ? (faceSize - k) % faceSize : k);
+					merged->fp[mergedCorner + k] = pBase + mesh.fp[from];
+					if (hasNormal)
+					{
+						merged->fn[mergedCorner + k] = nBase + mesh.fn[from];
+					}
+					if (hasTexCoord)
+					{
+						merged->ft[mergedCorner + k] = tBase + mesh.ft[from];
+					}
+				}
+				
+				corner += faceSize;
+				mergedCorner += faceSize;
+			}
+		},
+		numThreads);
+	
+	merged->UpdateStatistics(numThreads);
+	return merged;
+}
+
+std::vector<Smorgasbord::StaticBatch> Smorgasbord::BuildStaticBatches(
+	std::shared_ptr<Device> device,
+	const std::vector<StaticBatchInstance> &instances,
+	const StaticBatchSettings &settings,
+	uint32_t numThreads)
+{
+	// Distinct meshes
+	
+	std::unordered_map<const MeshData*, uint32_t> sourceIndices;
+	std::vector<const MeshData*> sourceMeshes;
+	std::vector<StaticBatchItem> items;
+	
+	for (uint32_t i = 0; i < instances.size(); i++)
+	{
+		const MeshData *mesh = instances[i].mesh;
+		if (mesh == nullptr || mesh->c.empty())
+		{
+			LogW("Static batch instance {0} has no faces, skipped.", i);
+			continue;
+		}
+		
+		auto result = sourceIndices.emplace(mesh, uint32_t(sourceMeshes.size()));
+		if (result.second)
+		{
+			sourceMeshes.push_back(mesh);
+		}
+		
+		StaticBatchItem item;
+		item.instance = i;
+		item.source = result.first->second;
+		items.push_back(item);
+	}
+	
+	std::vector<StaticBatchSource> sources(sourceMeshes.size());
+	ParallelFor(
+		sourceMeshes.size(),
+		[&](size_t i)
+		{
+			sources[i] = CreateStaticBatchSource(*sourceMeshes[i]);
+		},
+		numThreads);
+	
+	// World space bounds, from the corners of the model space ones
+	
+	ParallelForRange(
+		items.size(),
+		1024,
+		[&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				StaticBatchItem &item = items[i];
+				const StaticBatchSource &source = sources[item.source];
+				const glm::mat4 &world = instances[item.instance].world;
+				
+				for (uint32_t k = 0; k < 8; k++)
+				{
+					glm::vec3 corner(
+						(k & 1) ? source.boundingMax.x : source.boundingMin.x,
+						(k & 2) ? source.boundingMax.y : source.boundingMin.y,
+						(k & 4) ? source.boundingMax.z : source.boundingMin.z);
+					glm::vec3 p = glm::vec3(world * glm::vec4(corner, 1.0f));
+					item.boundingMin = k == 0 ? p : glm::min(item.boundingMin, p);
+					item.boundingMax = k == 0 ? p : glm::max(item.boundingMax, p);
+				}
+				
+				item.center = (item.boundingMin + item.boundingMax) * 0.5f;
+			}
+		},
+		numThreads);
+	
+	// Group by cell and attributes
+	
+	std::map<std::array<int64_t, 4>, std::vector<StaticBatchItem>> groups;
+	for (const StaticBatchItem &item : items)
+	{
+		std::array<int64_t, 4> key = { };
+		if (settings.cellSize > 0)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				key[axis] = int64_t(std::floor(item.center[axis] / settings.cellSize));
+			}
+		}
+		
+		const StaticBatchSource &source = sources[item.source];
+		key[3] = (source.hasNormal ? 1 : 0) | (source.hasTexCoord ? 2 : 0);
+		groups[key].push_back(item);
+	}
+	
+	// Split groups into batches
+	
+	std::vector<std::vector<StaticBatchItem>> batchItems;
+	for (auto &group : groups)
+	{
+		std::vector<StaticBatchItem> &groupItems = group.second;
+		
+		glm::vec3 centerMin = groupItems[0].center;
+		glm::vec3 centerMax = groupItems[0].center;
+		for (const StaticBatchItem &item : groupItems)
+		{
+			centerMin = glm::min(centerMin, item.center);
+			centerMax = glm::max(centerMax, item.center);
+		}
+		
+		const glm::vec3 extent = centerMax - centerMin;
+		const float scale = std::max(std::max(extent.x, extent.y), extent.z);
+		for (StaticBatchItem &item : groupItems)
+		{
+			glm::vec3 cell = scale > 0
+				? (item.center - centerMin) / scale * 1023.0f
+				: glm::vec3(0);
+			item.morton =
+				SpreadStaticBatchBits(uint32_t(cell.x))
+				| (SpreadStaticBatchBits(uint32_t(cell.y)) << 1)
+				| (SpreadStaticBatchBits(uint32_t(cell.z)) << 2);
+		}
+		
+		std::stable_sort(
+			groupItems.begin(),
+			groupItems.end(),
+			[](const StaticBatchItem &a, const StaticBatchItem &b)
+			{
+				return a.morton < b.morton;
+			});
+		
+		batchItems.emplace_back();
+		uint64_t batchVertices = 0;
+		for (const StaticBatchItem &item : groupItems)
+		{
+			const uint32_t numVertices = sources[item.source].numVertices;
+			if (!batchItems.back().empty()
+				&& batchVertices + numVertices > settings.maxVertices)
+			{
+				batchItems.emplace_back();
+				batchVertices = 0;
+			}
+			
+			batchItems.back().push_back(item);
+			batchVertices += numVertices;
+		}
+	}
+	
+	// Build batches
+	
+	std::vector<StaticBatch> batches;
+	batches.reserve(batchItems.size());
+	
+	for (const std::vector<StaticBatchItem> &itemsOfBatch : batchItems)
+	{
+		std::vector<StaticBatchRange> ranges;
+		std::unique_ptr<MeshData> merged = MergeStaticBatchItems(
+			instances, sources, itemsOfBatch, ranges, numThreads);
+		
+		StaticBatch batch;
+		batch.materialNames = merged->materialNames;
+		batch.materialLibraries = merged->materialLibraries;
+		batch.boundingMin = merged->boundingMin;
+		batch.boundingMax = merged->boundingMax;
+		
+		batch.mesh = std::make_shared<StaticMesh>(
+			device,
+			std::move(merged),
+			settings.vertexLayout,
+			settings.quantization);
+		
+		/// Sub-meshes follow the merged ranges one to one
+		const std::vector<SubMesh> &subMeshes = batch.mesh->GetSubMeshes();
+		if (subMeshes.size() != ranges.size())
+		{
+			LogE("Static batch could not be built.");
+			continue;
+		}
+		
+		for (size_t i = 0; i < subMeshes.size(); i++)
+		{
+			batch.subMeshInstances.push_back(itemsOfBatch[ranges[i].item].instance);
+			
+			const SubMesh &subMesh = subMeshes[i];
+			if (!batch.draws.empty()
+				&& batch.draws.back().range.materialIndex == subMesh.range.materialIndex)
+			{
+				SubMesh &draw = batch.draws.back();
+				draw.range.numFaces += subMesh.range.numFaces;
+				draw.geometry.numVertices += subMesh.geometry.numVertices;
+				continue;
+			}
+			
+			SubMesh draw = subMesh;
+			draw.range.object.clear();
+			draw.range.group.clear();
+			batch.draws.push_back(draw);
+		}
+		
+		batches.push_back(std::move(batch));
+	}
+	
+	return batches;
+}
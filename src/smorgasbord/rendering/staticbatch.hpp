@@ -0,0 +1,78 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+
+Static batching
+---------------
+
+Merges many small, never moving meshes into a few StaticMeshes, so a scene
+of props is drawn with a handful of draws instead of one per prop.
+
+Every instance is transformed to world space on the CPU: positions by its
+world matrix, e.g. Translate() * RotateXYZ() * Scale(), and normals by
+NormalTransform() of it. Mirroring transforms reverse the face winding, so
+front faces stay front faces.
+
+Instances are grouped by the grid cell of their bounding box center, if
+cellSize is set, and by their attributes. The instances of a group are
+sorted along a Morton curve and split into batches of at most maxVertices
+welded vertices, so batches stay spatially compact for culling. An
+instance exceeding the budget on its own gets a batch of its own.
+
+Within a batch, faces are ordered by material, so StaticBatch::draws holds
+one draw per material. The sub-meshes of the StaticMesh still keep the
+ranges of every instance apart, see StaticBatch::subMeshInstances.
+
+*/
+
+namespace Smorgasbord {
+
+struct StaticBatchSettings
+{
+	uint32_t maxVertices = 0x10000; // welded, per batch, 16 bit indices
+	float cellSize = 0; // in world units, 0 doesn't split by position
+	VertexLayout vertexLayout = VertexLayout::Planar;
+	VertexQuantization quantization;
+};
+
+/// A placement of a mesh in the world. The same MeshData may be placed by
+/// several instances
+struct StaticBatchInstance
+{
+	const MeshData *mesh = nullptr;
+	glm::mat4 world = glm::mat4(1);
+};
+
+struct StaticBatch
+{
+	std::shared_ptr<StaticMesh> mesh;
+	/// Instance every sub-mesh of mesh belongs to, an index into the
+	/// instances given to BuildStaticBatches()
+	std::vector<uint32_t> subMeshInstances;
+	/// Consecutive sub-meshes sharing a material, merged into one draw
+	std::vector<SubMesh> draws;
+	/// Indexed by MeshRange::materialIndex of the sub-meshes and draws
+	std::vector<std::string> materialNames;
+	std::vector<std::string> materialLibraries;
+	// world space bounding box
+	glm::vec3 boundingMin = glm::vec3(0);
+	glm::vec3 boundingMax = glm::vec3(0);
+};
+
+/// numThreads == 0 uses all hardware threads. Instances without a mesh or
+/// faces are skipped
+std::vector<StaticBatch> BuildStaticBatches(
+	std::shared_ptr<Device> device,
+	const std::vector<StaticBatchInstance> &instances,
+	const StaticBatchSettings &settings = StaticBatchSettings(),
+	uint32_t numThreads = 0);
+
+}
@@ -1,34 +1,356 @@
 #include "staticmesh.hpp"
+#include "camera.hpp"
+#include "meshoptimize.hpp"
+#include "simplify.hpp"
+#include "transform.hpp"
+#include "triangulate.hpp"
 
 #include <smorgasbord/util/log.hpp>
+#include <smorgasbord/util/parallel.hpp>
+#include <smorgasbord/util/simd.hpp>
 
-void Smorgasbord::MeshData::UpdateStatistics()
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+/// Attribute values of a face corner, compared bitwise
+struct WeldKey
+{
+	glm::vec3 p = glm::vec3(0);
+	glm::vec3 n = glm::vec3(0);
+	glm::vec2 t = glm::vec2(0);
+	
+	bool operator==(const WeldKey &b) const
+	{
+		return std::memcmp(this, &b, sizeof(WeldKey)) == 0;
+	}
+};
+
+static_assert(sizeof(WeldKey) == 8 * sizeof(float), "WeldKey must be packed");
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey &key) const
+	{
+		/// FNV-1a over 32 bit words
+		uint32_t words[8];
+		std::memcpy(words, &key, sizeof(WeldKey));
+		
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : words)
+		{
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		
+		return size_t(hash ^ (hash >> 32));
+	}
+};
+
+/// Element size is a compile time constant, so the loops compile to plain
+/// moves, or a single memcpy for planar layouts
+template<typename T>
+inline void WriteStaticMeshAttribute(
+	uint8_t *target, uint32_t stride, const T *source, uint32_t count)
+{
+	if (stride == sizeof(T))
+	{
+		std::memcpy(target, source, sizeof(T) * count);
+		return;
+	}
+	
+	for (uint32_t i = 0; i < count; i++)
+	{
+		std::memcpy(&target[size_t(i) * stride], &source[i], sizeof(T));
+	}
+}
+
+template<typename T>
+inline void GatherStaticMeshAttribute(
+	uint8_t *target,
+	uint32_t stride,
+	const std::vector<T> &source,
+	const uint32_t *indices,
+	uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		std::memcpy(&target[size_t(i) * stride], &source[indices[i]], sizeof(T));
+	}
+}
+
+/// An attribute written into a mapped buffer by WriteStaticMeshStreams().
+/// write(target, stride, first, count) writes the elements [first,
+/// first + count) to target, which points at the attribute of element first
+struct StaticMeshStreamAttribute
+{
+	uint32_t offset;
+	uint32_t stride;
+	std::function<void(uint8_t*, uint32_t, size_t, size_t)> write;
+};
+
+template<typename T>
+inline StaticMeshStreamAttribute MakeStaticMeshAttribute(
+	size_t offset, uint32_t stride, const T *source)
+{
+	return { uint32_t(offset), stride,
+		[source](uint8_t *target, uint32_t stride, size_t first, size_t count)
+		{
+			WriteStaticMeshAttribute(target, stride, &source[first], uint32_t(count));
+		} };
+}
+
+template<typename T>
+inline StaticMeshStreamAttribute MakeGatheredStaticMeshAttribute(
+	size_t offset, uint32_t stride, const std::vector<T> &source, const uint32_t *indices)
+{
+	return { uint32_t(offset), stride,
+		[&source, indices](uint8_t *target, uint32_t stride, size_t first, size_t count)
+		{
+			GatherStaticMeshAttribute(target, stride, source, &indices[first], uint32_t(count));
+		} };
+}
+
+/// Writes elements [firstElement, firstElement + count) of the attributes
+/// into a mapped buffer. Attributes sharing a stride and overlapping
+/// elements form a stream, which is assembled in a cached staging block
+/// and copied with streaming stores, so every line of the mapped buffer
+/// is written once, in order, without being read. Ranges of elements are
+/// written in parallel
+inline void WriteStaticMeshStreams(
+	uint8_t *base,
+	size_t firstElement,
+	size_t count,
+	std::vector<StaticMeshStreamAttribute> attributes,
+	uint32_t numThreads = 0)
+{
+	struct Stream
+	{
+		uint32_t offset;
+		uint32_t stride;
+		std::vector<const StaticMeshStreamAttribute*> attributes;
+	};
+	
+	std::sort(
+		attributes.begin(),
+		attributes.end(),
+		[](const StaticMeshStreamAttribute &a, const StaticMeshStreamAttribute &b)
+		{
+			return a.offset < b.offset;
+		});
+	
+	std::vector<Stream> streams;
+	for (const StaticMeshStreamAttribute &attribute : attributes)
+	{
+		if (streams.empty()
+			|| streams.back().stride != attribute.stride
+			|| attribute.offset >= streams.back().offset + attribute.stride)
+		{
+			streams.push_back({ attribute.offset, attribute.stride, { } });
+		}
+		
+		streams.back().attributes.push_back(&attribute);
+	}
+	
+	const size_t blockSize = 16384;
+	for (const Stream &stream : streams)
+	{
+		const size_t blockElements = std::max<size_t>(blockSize / stream.stride, 1);
+		uint8_t *target = &base[stream.offset + firstElement * stream.stride];
+		
+		Smorgasbord::ParallelForRange(
+			count,
+			blockElements * 4,
+			[&](size_t begin, size_t end)
+			{
+				alignas(64) uint8_t block[blockSize];
+				std::vector<uint8_t> largeBlock;
+				uint8_t *staging = block;
+				if (stream.stride > blockSize)
+				{
+					largeBlock.resize(stream.stride);
+					staging = largeBlock.data();
+				}
+				
+				for (size_t first = begin; first < end; first += blockElements)
+				{
+					size_t n = std::min(blockElements, end - first);
+					size_t size = n * stream.stride;
+					
+					/// Padding between attributes is written as zeros
+					std::memset(staging, 0, size);
+					for (const StaticMeshStreamAttribute *attribute : stream.attributes)
+					{
+						attribute->write(
+							&staging[attribute->offset - stream.offset],
+							stream.stride, first, n);
+					}
+					
+					Smorgasbord::StreamingCopy(&target[first * stream.stride], staging, size);
+				}
+			},
+			numThreads);
+	}
+}
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be packed");
+
+/// Grows the bounds by count positions. With SSE, 4 positions are read
+/// with 3 loads, so the lanes of the 3 accumulators hold the components
+/// x y z x, y z x y and z x y z
+inline void AccumulateMeshBounds(
+	const glm::vec3 *p, size_t count, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_SSE2
+	if (count >= 4)
+	{
+		const float *f = &p[0].x;
+		__m128 min0 = _mm_loadu_ps(f), max0 = min0;
+		__m128 min1 = _mm_loadu_ps(f + 4), max1 = min1;
+		__m128 min2 = _mm_loadu_ps(f + 8), max2 = min2;
+		
+		for (i = 4; i + 4 <= count; i += 4)
+		{
+			f = &p[i].x;
+			__m128 a = _mm_loadu_ps(f);
+			__m128 b = _mm_loadu_ps(f + 4);
+			__m128 c = _mm_loadu_ps(f + 8);
+			min0 = _mm_min_ps(min0, a);
+			max0 = _mm_max_ps(max0, a);
+			min1 = _mm_min_ps(min1, b);
+			max1 = _mm_max_ps(max1, b);
+			min2 = _mm_min_ps(min2, c);
+			max2 = _mm_max_ps(max2, c);
+		}
+		
+		alignas(16) float lows[12];
+		alignas(16) float highs[12];
+		_mm_store_ps(lows, min0);
+		_mm_store_ps(lows + 4, min1);
+		_mm_store_ps(lows + 8, min2);
+		_mm_store_ps(highs, max0);
+		_mm_store_ps(highs + 4, max1);
+		_mm_store_ps(highs + 8, max2);
+		
+		for (int k = 0; k < 4; k++)
+		{
+			boundsMin = glm::min(boundsMin, glm::vec3(lows[k * 3], lows[k * 3 + 1], lows[k * 3 + 2]));
+			boundsMax = glm::max(boundsMax, glm::vec3(highs[k * 3], highs[k * 3 + 1], highs[k * 3 + 2]));
+		}
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		boundsMin = glm::min(boundsMin, p[i]);
+		boundsMax = glm::max(boundsMax, p[i]);
+	}
+}
+
+inline void AccumulateFaceSizes(
+	const int32_t *c, size_t count, int32_t &minSize, int32_t &maxSize)
+{
+	size_t i = 0;
+
+#ifdef SMORGASBORD_SSE41
+	if (count >= 4)
+	{
+		__m128i min4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+		__m128i max4 = min4;
+		for (i = 4; i + 4 <= count; i += 4)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+			min4 = _mm_min_epi32(min4, v);
+			max4 = _mm_max_epi32(max4, v);
+		}
+		
+		alignas(16) int32_t lows[4];
+		alignas(16) int32_t highs[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lows), min4);
+		_mm_store_si128(reinterpret_cast<__m128i*>(highs), max4);
+		for (int k = 0; k < 4; k++)
+		{
+			minSize = std::min(minSize, lows[k]);
+			maxSize = std::max(maxSize, highs[k]);
+		}
+	}
+#endif
+	
+	for (; i < count; i++)
+	{
+		minSize = std::min(minSize, c[i]);
+		maxSize = std::max(maxSize, c[i]);
+	}
+}
+
+void Smorgasbord::MeshData::UpdateStatistics(uint32_t numThreads)
 {
+	/// Partial results per range, combined afterwards
+	struct RangeStatistics
+	{
+		int32_t minVerticesPerFace = std::numeric_limits<int32_t>::max();
+		int32_t maxVerticesPerFace = std::numeric_limits<int32_t>::min();
+		glm::vec3 boundingMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 boundingMax = glm::vec3(-std::numeric_limits<float>::max());
+	};
+	
+	const size_t minRangeSize = 1 << 16;
+	std::vector<RangeStatistics> faceRanges(
+		std::max<size_t>(GetParallelRangeCount(c.size(), minRangeSize, numThreads), 1));
+	std::vector<RangeStatistics> vertexRanges(
+		std::max<size_t>(GetParallelRangeCount(p.size(), minRangeSize, numThreads), 1));
+	
+	ParallelForRangeIndexed(
+		c.size(),
+		minRangeSize,
+		[&](size_t range, size_t begin, size_t end)
+		{
+			AccumulateFaceSizes(
+				&c[begin],
+				end - begin,
+				faceRanges[range].minVerticesPerFace,
+				faceRanges[range].maxVerticesPerFace);
+		},
+		numThreads);
+	
+	ParallelForRangeIndexed(
+		p.size(),
+		minRangeSize,
+		[&](size_t range, size_t begin, size_t end)
+		{
+			AccumulateMeshBounds(
+				&p[begin],
+				end - begin,
+				vertexRanges[range].boundingMin,
+				vertexRanges[range].boundingMax);
+		},
+		numThreads);
+	
 	polyCount = c.size();
 	
 	if (polyCount > 0)
 	{
-		minVerticesPerFace = c[0];
-		maxVerticesPerFace = c[0];
-		for (size_t i = 1; i < polyCount; i++)
+		minVerticesPerFace = faceRanges[0].minVerticesPerFace;
+		maxVerticesPerFace = faceRanges[0].maxVerticesPerFace;
+		for (const RangeStatistics &range : faceRanges)
 		{
-			if (c[i] < minVerticesPerFace)
-				minVerticesPerFace = c[i];
-				
-			if (c[i] > maxVerticesPerFace)
-				maxVerticesPerFace = c[i];
+			minVerticesPerFace = std::min(minVerticesPerFace, range.minVerticesPerFace);
+			maxVerticesPerFace = std::max(maxVerticesPerFace, range.maxVerticesPerFace);
 		}
 	}
 	
 	vertCount = p.size();
 	if (vertCount > 0)
 	{
-		boundingMin = p[0];
-		boundingMax = p[0];
-		for (size_t i = 1; i < vertCount; i++)
+		boundingMin = vertexRanges[0].boundingMin;
+		boundingMax = vertexRanges[0].boundingMax;
+		for (const RangeStatistics &range : vertexRanges)
 		{
-			boundingMin = min(boundingMin, p[i]);
-			boundingMax = max(boundingMax, p[i]);
+			boundingMin = min(boundingMin, range.boundingMin);
+			boundingMax = max(boundingMax, range.boundingMax);
 		}
 		
 		boundingCenter = (boundingMin + boundingMax) / 2.0f;
@@ -39,12 +361,163 @@ void Smorgasbord::MeshData::UpdateStatistics()
 	}
 }
 
+Smorgasbord::IndexedMeshData Smorgasbord::WeldMeshData(
+	const MeshData &mesh, uint32_t numThreads)
+{
+	IndexedMeshData indexed;
+	indexed.vertsPerFace = mesh.c.empty() ? 0 : uint32_t(mesh.c[0]);
+	
+	const size_t numCorners = mesh.fp.size();
+	const bool hasNormal = mesh.fn.size() == numCorners && !mesh.n.empty();
+	const bool hasTexCoord = mesh.ft.size() == numCorners && !mesh.t.empty();
+	
+	auto getKey = [&](size_t i)
+	{
+		WeldKey key;
+		key.p = mesh.p[mesh.fp[i]];
+		if (hasNormal)
+		{
+			key.n = mesh.n[mesh.fn[i]];
+		}
+		if (hasTexCoord)
+		{
+			key.t = mesh.t[mesh.ft[i]];
+		}
+		return key;
+	};
+	
+	/// Corners are split into buckets by hash, so equal corners land in
+	/// the same bucket, and every bucket is welded by a single thread
+	const size_t minBucketSize = 1 << 16;
+	const uint32_t numBuckets = uint32_t(std::max<size_t>(
+		std::min<size_t>(ResolveThreadCount(numThreads), numCorners / minBucketSize), 1));
+	
+	std::vector<uint32_t> buckets;
+	if (numBuckets > 1)
+	{
+		buckets.resize(numCorners);
+		ParallelForRange(
+			numCorners,
+			minBucketSize,
+			[&](size_t begin, size_t end)
+			{
+				WeldKeyHash hash;
+				for (size_t i = begin; i < end; i++)
+				{
+					buckets[i] = uint32_t((hash(getKey(i)) >> 16) % numBuckets);
+				}
+			},
+			numThreads);
+	}
+	
+	/// Unique vertices as their first corner, and each corner's vertex
+	/// within its bucket
+	std::vector<std::vector<uint32_t>> bucketCorners(numBuckets);
+	indexed.indices.resize(numCorners);
+	
+	ParallelFor(
+		numBuckets,
+		[&](size_t bucket)
+		{
+			std::unordered_map<WeldKey, uint32_t, WeldKeyHash> vertexIndices;
+			vertexIndices.reserve(numCorners / numBuckets);
+			std::vector<uint32_t> &corners = bucketCorners[bucket];
+			
+			for (size_t i = 0; i < numCorners; i++)
+			{
+				if (numBuckets > 1 && buckets[i] != bucket)
+				{
+					continue;
+				}
+				
+				auto result = vertexIndices.emplace(getKey(i), uint32_t(corners.size()));
+				if (result.second)
+				{
+					corners.push_back(uint32_t(i));
+				}
+				
+				indexed.indices[i] = result.first->second;
+			}
+		},
+		numThreads);
+	
+	/// Numbers vertices in first use order, as a serial weld would
+	std::vector<uint32_t> bucketBases(numBuckets + 1, 0);
+	for (uint32_t b = 0; b < numBuckets; b++)
+	{
+		bucketBases[b + 1] = bucketBases[b] + uint32_t(bucketCorners[b].size());
+	}
+	
+	const uint32_t numVertices = bucketBases[numBuckets];
+	std::vector<uint32_t> firstCorners(numVertices);
+	if (numBuckets == 1)
+	{
+		firstCorners.swap(bucketCorners[0]);
+	}
+	else
+	{
+		const uint32_t unused = ~0u;
+		std::vector<uint32_t> remap(numVertices, unused);
+		uint32_t numRemapped = 0;
+		for (size_t i = 0; i < numCorners; i++)
+		{
+			uint32_t &vertex = indexed.indices[i];
+			vertex += bucketBases[buckets[i]];
+			if (remap[vertex] == unused)
+			{
+				remap[vertex] = numRemapped;
+				firstCorners[numRemapped] = uint32_t(i);
+				numRemapped++;
+			}
+			
+			vertex = remap[vertex];
+		}
+	}
+	
+	indexed.p.resize(numVertices);
+	if (hasNormal)
+	{
+		indexed.n.resize(numVertices);
+	}
+	if (hasTexCoord)
+	{
+		indexed.t.resize(numVertices);
+	}
+	
+	ParallelForRange(
+		numVertices,
+		minBucketSize,
+		[&](size_t begin, size_t end)
+		{
+			for (size_t v = begin; v < end; v++)
+			{
+				const uint32_t corner = firstCorners[v];
+				indexed.p[v] = mesh.p[mesh.fp[corner]];
+				if (hasNormal)
+				{
+					indexed.n[v] = mesh.n[mesh.fn[corner]];
+				}
+				if (hasTexCoord)
+				{
+					indexed.t[v] = mesh.t[mesh.ft[corner]];
+				}
+			}
+		},
+		numThreads);
+	
+	return indexed;
+}
+
 Smorgasbord::StaticMesh::StaticMesh()
 { }
 
 Smorgasbord::StaticMesh::StaticMesh(
 	std::shared_ptr<Smorgasbord::Device> device,
-	std::unique_ptr<Smorgasbord::MeshData> meshData)
+	std::unique_ptr<Smorgasbord::MeshData> meshData,
+	VertexLayout vertexLayout,
+	const VertexQuantization &quantization,
+	const MeshLODSettings &lodSettings,
+	const MeshletSettings &meshletSettings)
 {
 	MeshData &mesh = *meshData;
 	
@@ -54,83 +527,238 @@ Smorgasbord::StaticMesh::StaticMesh(
 		return;
 	}
 	
-	if (mesh.minVerticesPerFace != mesh.maxVerticesPerFace)
+	/// Polygons are split on the CPU, so every mesh is drawn as a
+	/// TriangleList, without a tessellation stage
+	if (mesh.maxVerticesPerFace > 3)
 	{
-		LogE("Meshes with mixed vertex count per face are not supported.");
-		return;
+		TriangulateMeshData(mesh);
 	}
 	
-	bool hasNormal = mesh.n.size() > 0;
-	bool hasTexCoord = mesh.t.size() > 0;
+	IndexedMeshData indexed = WeldMeshData(mesh);
+	OptimizeIndexedMesh(indexed, mesh.ranges);
 	
-	// Upload buffers
-	
-	uint32_t polyCount = uint32_t(mesh.polyCount);
-	uint32_t vertsPerFace = mesh.minVerticesPerFace;
-	
-	uint32_t bufferSize = sizeof(glm::vec3) * polyCount * vertsPerFace;
-	uint32_t nStartByte = 0;
-	uint32_t tcStartByte = 0;
-	
-	if (hasNormal)
+	if (meshletSettings.enabled)
 	{
-		nStartByte = bufferSize;
-		bufferSize += sizeof(glm::vec3) * polyCount * vertsPerFace;
+		meshlets = BuildMeshlets(indexed, mesh.ranges, meshletSettings);
+		OptimizeVertexFetch(indexed); // for the new face order
 	}
 	
-	if (hasTexCoord)
-	{
-		tcStartByte = bufferSize;
-		bufferSize += sizeof(glm::vec2) * polyCount * vertsPerFace;
-	}
+	/// All levels share the index buffer, the full mesh comes first
+	std::vector<MeshLODLevel> levels = GenerateMeshLODs(
+		indexed, mesh.ranges, lodSettings, mesh.boundingScale);
 	
-	std::shared_ptr<Buffer> buffer = device->CreateBuffer(
-		BufferType::Vertex,
-		BufferUsageType::Draw,
-		BufferUsageFrequency::Static,
-		bufferSize);
+	const uint32_t numVertices = uint32_t(indexed.p.size());
+	const uint32_t numIndices = uint32_t(indexed.indices.size());
+	
+	// Quantize attributes
 	
-	{ Scope(buffer, MappedDataAccessType::Write);
-		uint8_t* pBase = buffer->GetMappedData();
+	std::vector<QuantizedPosition> qp;
+	std::vector<QuantizedNormal> qn;
+	std::vector<QuantizedTexCoord> qt;
+	
+	if (quantization.enabled)
+	{
+		glm::vec3 offset, scale;
+		float error;
 		
+		quantizedPosition = QuantizePositions(
+			indexed.p,
+			mesh.boundingMin,
+			mesh.boundingMax,
+			quantization.maxPositionError * mesh.boundingScale,
+			qp, offset, scale, error);
+		
+		if (quantizedPosition)
 		{
-			glm::vec3* p = (glm::vec3*)pBase;
-			for (uint32_t i = 0; i < polyCount; i++)
-			{
-				for (uint32_t j = 0; j < vertsPerFace; j++)
-				{
-					const uint32_t index = i * vertsPerFace + j;
-					p[index] = mesh.p[mesh.fp[index]];
-				}
-			}
+			positionTransform = Translate(offset) * Scale(scale);
 		}
 		
-		if (hasNormal)
+		quantizedNormal = !indexed.n.empty() && QuantizeNormals(
+			indexed.n, quantization.maxNormalError, qn, error);
+		
+		glm::vec2 tcOffset, tcScale;
+		quantizedTexCoord = !indexed.t.empty() && QuantizeTexCoords(
+			indexed.t, quantization.maxTexCoordError, qt, tcOffset, tcScale, error);
+		
+		if (quantizedTexCoord)
 		{
-			glm::vec3* n = reinterpret_cast<glm::vec3*>(&pBase[nStartByte]);
-			for (uint32_t i = 0; i < polyCount; i++)
+			texCoordTransform = glm::vec4(tcOffset.x, tcOffset.y, tcScale.x, tcScale.y);
+		}
+	}
+	
+	Allocate(
+		device,
+		numVertices,
+		indexed.vertsPerFace,
+		indexed.n.size() > 0,
+		indexed.t.size() > 0,
+		vertexLayout);
+	
+	UploadVertices(indexed, qp, qn, qt);
+	
+	// Upload indices
+	
+	/// Primitive restart is not used, so every 16 bit value is available
+	IndexDataType indexDataType =
+		numVertices <= 0x10000
+		? IndexDataType::UInt16
+		: IndexDataType::UInt32;
+	
+	std::shared_ptr<Buffer> indexBuffer = device->CreateBuffer(
+		BufferType::Index,
+		BufferUsageType::Draw,
+		BufferUsageFrequency::Static,
+		numIndices * GetIndexDataTypeSize(indexDataType));
+	
+	StaticMeshStreamAttribute indexAttribute;
+	if (indexDataType == IndexDataType::UInt16)
+	{
+		indexAttribute = { 0, sizeof(uint16_t),
+			[&](uint8_t *target, uint32_t, size_t first, size_t count)
 			{
-				for (uint32_t j = 0; j < vertsPerFace; j++)
+				uint16_t *indices = reinterpret_cast<uint16_t*>(target);
+				for (size_t i = 0; i < count; i++)
 				{
-					const uint32_t index = i * vertsPerFace + j;
-					n[index] = mesh.n[mesh.fn[index]];
+					indices[i] = uint16_t(indexed.indices[first + i]);
 				}
-			}
-		}
+			} };
+	}
+	else
+	{
+		indexAttribute = MakeStaticMeshAttribute(
+			0, sizeof(uint32_t), indexed.indices.data());
+	}
+	
+	{ Scope(indexBuffer, MappedDataAccessType::Write);
+		WriteStaticMeshStreams(
+			indexBuffer->GetMappedData(), 0, numIndices, { indexAttribute });
+	}
+	
+	geometry.indexBuffer = IndexBufferRef(indexBuffer, indexDataType);
+	geometry.numVertices = levels[0].numIndices;
+	numUniqueVertices = numVertices;
+	
+	InitSubMeshes(mesh);
+	
+	// Levels of detail
+	
+	boundingCenter = mesh.boundingCenter;
+	boundingScale = mesh.boundingScale;
+	
+	lods.resize(levels.size());
+	lods[0].geometry = geometry;
+	lods[0].subMeshes = subMeshes;
+	for (size_t i = 1; i < levels.size(); i++)
+	{
+		MeshLOD &lod = lods[i];
+		lod.geometry = geometry;
+		lod.geometry.startIndex = levels[i].firstIndex;
+		lod.geometry.numVertices = levels[i].numIndices;
+		lod.error = levels[i].error;
 		
-		if (hasTexCoord)
+		for (const MeshRange &range : levels[i].ranges)
 		{
-			glm::vec2* tc = reinterpret_cast<glm::vec2*>(&pBase[tcStartByte]);
-			for (uint32_t i = 0; i < polyCount; i++)
-			{
-				for (uint32_t j = 0; j < vertsPerFace; j++)
-				{
-					const uint32_t index = i * vertsPerFace + j;
-					tc[index] = mesh.t[mesh.ft[index]];
-				}
-			}
+			SubMesh subMesh;
+			subMesh.geometry = geometry;
+			subMesh.geometry.startIndex = range.firstFace * 3;
+			subMesh.geometry.numVertices = range.numFaces * 3;
+			subMesh.range = range;
+			lod.subMeshes.push_back(subMesh);
 		}
 	}
+}
+
+Smorgasbord::StaticMesh::StaticMesh(
+	std::shared_ptr<Device> device,
+	uint32_t maxFaces,
+	uint32_t vertsPerFace,
+	bool hasNormal,
+	bool hasTexCoord,
+	VertexLayout vertexLayout)
+{
+	if (vertsPerFace < 3)
+	{
+		LogE("Meshes with points or lines are not supported.");
+		return;
+	}
+	
+	Allocate(
+		device,
+		maxFaces * vertsPerFace,
+		vertsPerFace,
+		hasNormal,
+		hasTexCoord,
+		vertexLayout);
+}
+
+Smorgasbord::StaticMesh::~StaticMesh()
+{ }
+
+void Smorgasbord::StaticMesh::Allocate(
+	std::shared_ptr<Device> device,
+	uint32_t vertexCapacity,
+	uint32_t vertsPerFace,
+	bool hasNormal,
+	bool hasTexCoord,
+	VertexLayout vertexLayout)
+{
+	this->vertexLayout = vertexLayout;
+	this->vertsPerFace = vertsPerFace;
+	this->vertexCapacity = vertexCapacity;
+	this->hasNormal = hasNormal;
+	this->hasTexCoord = hasTexCoord;
+	
+	// Calculate layout
+	
+	const uint32_t pSize = quantizedPosition
+		? sizeof(QuantizedPosition)
+		: sizeof(glm::vec3);
+	const uint32_t nSize = !hasNormal ? 0 : quantizedNormal
+		? sizeof(QuantizedNormal)
+		: sizeof(glm::vec3);
+	const uint32_t tcSize = !hasTexCoord ? 0 : quantizedTexCoord
+		? sizeof(QuantizedTexCoord)
+		: sizeof(glm::vec2);
+	
+	switch (vertexLayout)
+	{
+	case VertexLayout::Planar:
+		pOffset = 0;
+		nOffset = pSize * vertexCapacity;
+		tcOffset = nOffset + nSize * vertexCapacity;
+		pStride = pSize;
+		nStride = nSize;
+		tcStride = tcSize;
+		break;
+	
+	case VertexLayout::Interleaved:
+		pOffset = 0;
+		nOffset = pSize;
+		tcOffset = pSize + nSize;
+		pStride = pSize + nSize + tcSize;
+		nStride = pStride;
+		tcStride = pStride;
+		break;
+	
+	case VertexLayout::SeparatePosition:
+		pOffset = 0;
+		nOffset = pSize * vertexCapacity;
+		tcOffset = nOffset + nSize;
+		pStride = pSize;
+		nStride = nSize + tcSize;
+		tcStride = nStride;
+		break;
+	}
+	
+	// Allocate buffer
+	
+	uint32_t bufferSize = (pSize + nSize + tcSize) * vertexCapacity;
+	
+	std::shared_ptr<Buffer> buffer = device->CreateBuffer(
+		BufferType::Vertex,
+		BufferUsageType::Draw,
+		BufferUsageFrequency::Static,
+		bufferSize);
 	
 	// Set up geometry layout
 	
@@ -145,12 +773,14 @@ Smorgasbord::StaticMesh::StaticMesh(
 		Attribute attribute;
 		attribute.location = 0;
 		attribute.name = "v_p";
-		attribute.dataType = AttributeDataType::Float;
-		attribute.numComponents = 3;
+		attribute.dataType = quantizedPosition
+			? AttributeDataType::UInt16
+			: AttributeDataType::Float;
+		attribute.numComponents = 3; // w of quantized positions is padding
 		attribute.accessType = AttributeAccessType::Float;
-		attribute.normalize = false;
-		attribute.stride = 0;
-		attribute.offset = 0;
+		attribute.normalize = quantizedPosition;
+		attribute.stride = pStride;
+		attribute.offset = pOffset;
 		geometryLayout.attributes.push_back(attribute);
 	}
 	
@@ -159,12 +789,14 @@ Smorgasbord::StaticMesh::StaticMesh(
 		Attribute attribute;
 		attribute.location = 1;
 		attribute.name = "v_n";
-		attribute.dataType = AttributeDataType::Float;
-		attribute.numComponents = 3;
+		attribute.dataType = quantizedNormal
+			? AttributeDataType::Int16
+			: AttributeDataType::Float;
+		attribute.numComponents = quantizedNormal ? 2 : 3;
 		attribute.accessType = AttributeAccessType::Float;
-		attribute.normalize = false;
-		attribute.stride = 0;
-		attribute.offset = nStartByte;
+		attribute.normalize = quantizedNormal;
+		attribute.stride = nStride;
+		attribute.offset = nOffset;
 		geometryLayout.attributes.push_back(attribute);
 	}
 	
@@ -173,22 +805,215 @@ Smorgasbord::StaticMesh::StaticMesh(
 		Attribute attribute;
 		attribute.location = 2;
 		attribute.name = "v_uv";
-		attribute.dataType = AttributeDataType::Float;
+		attribute.dataType = quantizedTexCoord
+			? AttributeDataType::UInt16
+			: AttributeDataType::Float;
 		attribute.numComponents = 2;
 		attribute.accessType = AttributeAccessType::Float;
-		attribute.normalize = false;
-		attribute.stride = 0;
-		attribute.offset = tcStartByte;
+		attribute.normalize = quantizedTexCoord;
+		attribute.stride = tcStride;
+		attribute.offset = tcOffset;
 		geometryLayout.attributes.push_back(attribute);
 	}
 	
-	// Init staticmesh
+	// Init staticmesh, empty until faces are appended
 	
-	Init(buffer, { }, polyCount * vertsPerFace, geometryLayout);
+	Init(buffer, { }, 0, geometryLayout);
 }
 
-Smorgasbord::StaticMesh::~StaticMesh()
-{ }
+void Smorgasbord::StaticMesh::UploadVertices(
+	const IndexedMeshData &mesh,
+	const std::vector<QuantizedPosition> &qp,
+	const std::vector<QuantizedNormal> &qn,
+	const std::vector<QuantizedTexCoord> &qt)
+{
+	const uint32_t numVertices = uint32_t(mesh.p.size());
+	
+	std::vector<StaticMeshStreamAttribute> attributes;
+	
+	if (quantizedPosition)
+	{
+		attributes.push_back(MakeStaticMeshAttribute(pOffset, pStride, qp.data()));
+	}
+	else
+	{
+		attributes.push_back(MakeStaticMeshAttribute(pOffset, pStride, mesh.p.data()));
+	}
+	
+	if (quantizedNormal)
+	{
+		attributes.push_back(MakeStaticMeshAttribute(nOffset, nStride, qn.data()));
+	}
+	else if (hasNormal)
+	{
+		attributes.push_back(MakeStaticMeshAttribute(nOffset, nStride, mesh.n.data()));
+	}
+	
+	if (quantizedTexCoord)
+	{
+		attributes.push_back(MakeStaticMeshAttribute(tcOffset, tcStride, qt.data()));
+	}
+	else if (hasTexCoord)
+	{
+		attributes.push_back(MakeStaticMeshAttribute(tcOffset, tcStride, mesh.t.data()));
+	}
+	
+	{ Scope(geometry.vertexBuffer, MappedDataAccessType::Write);
+		WriteStaticMeshStreams(
+			geometry.vertexBuffer->GetMappedData(),
+			0,
+			numVertices,
+			std::move(attributes));
+	}
+}
+
+void Smorgasbord::StaticMesh::InitSubMeshes(const MeshData &mesh)
+{
+	subMeshes.clear();
+	
+	if (mesh.ranges.empty())
+	{
+		SubMesh subMesh;
+		subMesh.geometry = geometry;
+		subMesh.range.numFaces = uint32_t(mesh.c.size());
+		subMeshes.push_back(subMesh);
+		return;
+	}
+	
+	/// Faces are stored in order, so a range of faces is a range of
+	/// vertices in the shared buffer
+	subMeshes.reserve(mesh.ranges.size());
+	for (const MeshRange &range : mesh.ranges)
+	{
+		SubMesh subMesh;
+		subMesh.geometry = geometry;
+		subMesh.geometry.startIndex = range.firstFace * vertsPerFace;
+		subMesh.geometry.numVertices = range.numFaces * vertsPerFace;
+		subMesh.range = range;
+		subMeshes.push_back(subMesh);
+	}
+}
+
+uint32_t Smorgasbord::StaticMesh::SelectLOD(
+	Camera &camera,
+	const glm::mat4 &world,
+	float viewportHeight,
+	float maxPixelError) const
+{
+	if (lods.size() <= 1)
+	{
+		return 0;
+	}
+	
+	/// Errors grow with the largest scale of the world transform
+	const float worldScale = glm::max(
+		glm::max(glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1]))),
+		glm::length(glm::vec3(world[2])));
+	
+	/// Sphere around the bounding box, whose largest side is boundingScale
+	const float radius = boundingScale * 0.8660254f * worldScale;
+	
+	/// projection[1][1] maps a unit at unit distance to NDC, which spans
+	/// two units over the viewport height
+	glm::mat4 projection = camera.GetProjectionMatrix();
+	float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+	
+	if (camera.GetIsPerspective())
+	{
+		glm::vec4 viewCenter =
+			camera.GetViewMatrix() * world * glm::vec4(boundingCenter, 1.0f);
+		float distance = glm::length(glm::vec3(viewCenter)) - radius;
+		if (distance <= 0)
+		{
+			return 0; // camera inside the bounding sphere
+		}
+		
+		pixelsPerUnit /= distance;
+	}
+	
+	/// Errors grow with every level, so the last one within the threshold
+	/// is the coarsest acceptable
+	uint32_t selected = 0;
+	for (uint32_t i = 1; i < lods.size(); i++)
+	{
+		if (lods[i].error * worldScale * pixelsPerUnit <= maxPixelError)
+		{
+			selected = i;
+		}
+	}
+	
+	return selected;
+}
+
+bool Smorgasbord::StaticMesh::Append(const MeshData &mesh)
+{
+	if (geometry.vertexBuffer == nullptr)
+	{
+		LogE("StaticMesh has no vertex buffer allocated.");
+		return false;
+	}
+	
+	if (geometry.indexBuffer.IsValid())
+	{
+		LogE("Faces cannot be appended to an indexed StaticMesh.");
+		return false;
+	}
+	
+	for (int32_t faceVertexCount : mesh.c)
+	{
+		if (uint32_t(faceVertexCount) != vertsPerFace)
+		{
+			LogE("Meshes with mixed vertex count per face are not supported.");
+			return false;
+		}
+	}
+	
+	const uint32_t numNewVertices = uint32_t(mesh.fp.size());
+	const uint32_t firstVertex = geometry.numVertices;
+	
+	if (firstVertex + numNewVertices > vertexCapacity)
+	{
+		LogE("Appended faces exceed the allocated capacity of the StaticMesh.");
+		return false;
+	}
+	
+	if ((hasNormal && mesh.fn.size() != numNewVertices)
+		|| (hasTexCoord && mesh.ft.size() != numNewVertices))
+	{
+		LogE("Appended faces don't have the attributes of the StaticMesh.");
+		return false;
+	}
+	
+	// Upload buffers
+	
+	std::vector<StaticMeshStreamAttribute> attributes;
+	attributes.push_back(MakeGatheredStaticMeshAttribute(
+		pOffset, pStride, mesh.p, mesh.fp.data()));
+	
+	if (hasNormal)
+	{
+		attributes.push_back(MakeGatheredStaticMeshAttribute(
+			nOffset, nStride, mesh.n, mesh.fn.data()));
+	}
+	
+	if (hasTexCoord)
+	{
+		attributes.push_back(MakeGatheredStaticMeshAttribute(
+			tcOffset, tcStride, mesh.t, mesh.ft.data()));
+	}
+	
+	{ Scope(geometry.vertexBuffer, MappedDataAccessType::Write);
+		WriteStaticMeshStreams(
+			geometry.vertexBuffer->GetMappedData(),
+			firstVertex,
+			numNewVertices,
+			std::move(attributes));
+	}
+	
+	geometry.numVertices += numNewVertices;
+	numUniqueVertices = geometry.numVertices;
+	return true;
+}
 
 void Smorgasbord::StaticMesh::Init(
 	std::shared_ptr<Buffer> vertexBuffer,
@@ -1,13 +1,35 @@
 #pragma once
 
 #include <smorgasbord/gpu/gpuapi.hpp>
+#include <smorgasbord/rendering/meshlet.hpp>
+#include <smorgasbord/rendering/quantize.hpp>
 
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace Smorgasbord {
 
+/// A run of consecutive faces sharing object, group and material, e.g. the
+/// faces between two "usemtl" statements of an OBJ file
+struct MeshRange
+{
+	uint32_t firstFace = 0;
+	uint32_t numFaces = 0;
+	int32_t materialIndex = -1; // into MeshData::materialNames, -1 if none
+	std::string object;
+	std::string group;
+	
+	bool HasSameState(const MeshRange &b) const
+	{
+		return materialIndex == b.materialIndex
+			&& object == b.object
+			&& group == b.group;
+	}
+};
+
 struct MeshData
 {
 	// Data
@@ -20,6 +42,15 @@ struct MeshData
 	std::vector<uint32_t> fn; // face normal indices
 	std::vector<uint32_t> ft; // face texture coordinate indices
 	
+	/// Original face index of every face, set by TriangulateMeshData()
+	std::vector<uint32_t> sourceFaces;
+	
+	// Sub-meshes
+	
+	std::vector<MeshRange> ranges; // in face order, may be empty
+	std::vector<std::string> materialNames; // indexed by material index
+	std::vector<std::string> materialLibraries; // e.g. MTL files
+	
 	// Statistics
 	
 	size_t polyCount = 0;
@@ -32,7 +63,8 @@ struct MeshData
 	glm::vec3 boundingCenter = glm::vec3(0);
 	float boundingScale = 0;
 	
-	void UpdateStatistics();
+	/// numThreads == 0 uses all hardware threads
+	void UpdateStatistics(uint32_t numThreads = 0);
 	
 	bool IsEmpty()
 	{
@@ -40,23 +72,166 @@ struct MeshData
 	}
 };
 
+/// Vertices with unique attribute combinations, and one index per face
+/// corner referring to them
+struct IndexedMeshData
+{
+	std::vector<glm::vec3> p;
+	std::vector<glm::vec3> n; // empty if the mesh has no normals
+	std::vector<glm::vec2> t; // empty if the mesh has no texture coordinates
+	std::vector<uint32_t> indices;
+	uint32_t vertsPerFace = 0;
+};
+
+/// Merges the face corners of mesh sharing position, normal and texture
+/// coordinate values. Attributes are compared bitwise, so welding is
+/// lossless. Expects every face of mesh to have the same vertex count
+IndexedMeshData WeldMeshData(const MeshData &mesh, uint32_t numThreads = 0);
+
+/// Arrangement of the attributes in the vertex buffer of a StaticMesh
+enum class VertexLayout
+{
+	Planar = 0, // ppp... nnn... ttt...
+	Interleaved, // pnt pnt pnt...
+	SeparatePosition // ppp... nt nt nt..., for position only passes
+};
+
+/// Levels of detail generated for a StaticMesh, see simplify.hpp
+struct MeshLODSettings
+{
+	uint32_t maxLevels = 1; // including the full mesh, 1 disables LODs
+	float reduction = 0.5f; // target index count relative to the previous level
+	float maxError = 0.05f; // relative to MeshData::boundingScale
+	uint32_t minTriangles = 32; // no level is made below this
+};
+
+/// A part of a StaticMesh, drawn from the vertex buffer of the whole mesh
+struct SubMesh
+{
+	Geometry geometry;
+	MeshRange range;
+};
+
+/// A level of detail of a StaticMesh, drawn from the shared vertex and
+/// index buffers
+struct MeshLOD
+{
+	Geometry geometry;
+	float error = 0; // deviation from the full mesh, in model units
+	std::vector<SubMesh> subMeshes;
+};
+
+class Camera;
+
 class StaticMesh
 {
 private:
 	Geometry geometry;
 	GeometryLayout geometryLayout;
+	std::vector<SubMesh> subMeshes;
+	std::vector<MeshLOD> lods;
+	std::vector<Meshlet> meshlets;
+	glm::vec3 boundingCenter = glm::vec3(0);
+	float boundingScale = 0;
+	
+	// Vertex buffer layout, used by Append()
+	VertexLayout vertexLayout = VertexLayout::Planar;
+	uint32_t vertsPerFace = 0;
+	uint32_t vertexCapacity = 0;
+	uint32_t numUniqueVertices = 0;
+	uint32_t pOffset = 0;
+	uint32_t nOffset = 0;
+	uint32_t tcOffset = 0;
+	uint32_t pStride = 0; // in bytes
+	uint32_t nStride = 0;
+	uint32_t tcStride = 0;
+	bool hasNormal = false;
+	bool hasTexCoord = false;
 	
+	// Quantization, see quantize.hpp
+	bool quantizedPosition = false;
+	bool quantizedNormal = false;
+	bool quantizedTexCoord = false;
+	glm::mat4 positionTransform = glm::mat4(1);
+	glm::vec4 texCoordTransform = glm::vec4(0, 0, 1, 1);
+
 public:
 	StaticMesh();
-	StaticMesh(std::shared_ptr<Device> device, std::unique_ptr<MeshData> meshData);
+	/// Triangulates polygons, see TriangulateMeshData(), welds the vertices
+	/// of the mesh, see WeldMeshData(), and draws them with an index
+	/// buffer. Indices are 16 bit if the vertex count allows.
+	/// With quantization enabled, each attribute within its error bound is
+	/// stored quantized, the others stay float.
+	/// Simplified levels of detail are appended to the index buffer, see
+	/// GenerateMeshLODs(). With meshlets enabled, the triangles of the full
+	/// mesh are grouped into meshlets, see BuildMeshlets()
+	StaticMesh(
+		std::shared_ptr<Device> device,
+		std::unique_ptr<MeshData> meshData,
+		VertexLayout vertexLayout = VertexLayout::Planar,
+		const VertexQuantization &quantization = VertexQuantization(),
+		const MeshLODSettings &lodSettings = MeshLODSettings(),
+		const MeshletSettings &meshletSettings = MeshletSettings());
+	/// Creates an empty mesh with room for maxFaces faces, to be filled
+	/// progressively with Append(). Only the faces appended so far are drawn
+	StaticMesh(
+		std::shared_ptr<Device> device,
+		uint32_t maxFaces,
+		uint32_t vertsPerFace,
+		bool hasNormal,
+		bool hasTexCoord,
+		VertexLayout vertexLayout = VertexLayout::Planar);
 	~StaticMesh();
 	
+	/// Uploads the faces of mesh after the already uploaded ones, without
+	/// welding. Face indices refer to the p, n, t arrays of mesh, see
+	/// LoadOBJStreaming()
+	bool Append(const MeshData &mesh);
+	
 	void Init(
 		std::shared_ptr<Buffer> vertexBuffer,
 		IndexBufferRef indexBuffer,
 		uint32_t numVertices,
 		GeometryLayout &geometryLayout);
 	
+	VertexLayout GetVertexLayout() const
+	{
+		return vertexLayout;
+	}
+	
+	/// Quantized positions are UNorm16 offsets within the bounding box,
+	/// this transforms them back to model space. Identity for float
+	/// positions
+	const glm::mat4 &GetPositionTransform() const
+	{
+		return positionTransform;
+	}
+	
+	/// xy is the offset and zw the scale of quantized texture coordinates,
+	/// (0, 0, 1, 1) for float ones
+	const glm::vec4 &GetTexCoordTransform() const
+	{
+		return texCoordTransform;
+	}
+	
+	/// Quantized normals are octahedral encoded, with 2 components
+	bool HasQuantizedNormals() const
+	{
+		return quantizedNormal;
+	}
+	
+	uint32_t GetVertexCapacity() const
+	{
+		return vertexCapacity;
+	}
+	
+	/// Number of vertices stored in the vertex buffer. For indexed meshes
+	/// GetGeometry().numVertices is the number of indices
+	uint32_t GetUniqueVertexCount() const
+	{
+		return numUniqueVertices;
+	}
+	
 	const Geometry &GetGeometry() const
 	{
 		return geometry;
@@ -66,6 +241,58 @@ public:
 	{
 		return geometryLayout;
 	}
+	
+	/// One entry per MeshData range, or a single entry covering the whole
+	/// mesh if it had no ranges. Empty for meshes filled with Append()
+	const std::vector<SubMesh> &GetSubMeshes() const
+	{
+		return subMeshes;
+	}
+	
+	/// lods[0] is the full mesh, same as GetGeometry() and GetSubMeshes().
+	/// Empty for meshes filled with Append()
+	const std::vector<MeshLOD> &GetLODs() const
+	{
+		return lods;
+	}
+	
+	/// Meshlets of the full mesh, in index buffer order, see CullMeshlets().
+	/// Meshlet::rangeIndex refers to GetSubMeshes()
+	const std::vector<Meshlet> &GetMeshlets() const
+	{
+		return meshlets;
+	}
+	
+	Geometry GetMeshletGeometry(uint32_t meshletIndex) const
+	{
+		Geometry meshletGeometry = geometry;
+		meshletGeometry.startIndex = meshlets[meshletIndex].firstIndex;
+		meshletGeometry.numVertices = meshlets[meshletIndex].numIndices;
+		return meshletGeometry;
+	}
+	
+	/// Coarsest level whose error, projected at the point of the bounding
+	/// sphere nearest to the camera, stays within maxPixelError pixels
+	uint32_t SelectLOD(
+		Camera &camera,
+		const glm::mat4 &world,
+		float viewportHeight,
+		float maxPixelError = 1.0f) const;
+
+private:
+	void Allocate(
+		std::shared_ptr<Device> device,
+		uint32_t vertexCapacity,
+		uint32_t vertsPerFace,
+		bool hasNormal,
+		bool hasTexCoord,
+		VertexLayout vertexLayout);
+	void UploadVertices(
+		const IndexedMeshData &mesh,
+		const std::vector<QuantizedPosition> &qp,
+		const std::vector<QuantizedNormal> &qn,
+		const std::vector<QuantizedTexCoord> &qt);
+	void InitSubMeshes(const MeshData &mesh);
 };
 
 }
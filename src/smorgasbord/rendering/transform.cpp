@@ -87,12 +87,8 @@ glm::mat4 Smorgasbord::Center(glm::vec3 boundingMin, glm::vec3 boundingMax)
 
 glm::mat4 Smorgasbord::NormalTransform(glm::mat4 &world)
 {
-	// normal = world.transpose().invert()
-	glm::mat4 normal = world;
-	float det = determinant(normal);
-	normal[3] = glm::vec4(0, 0, 0, det);
-	normal = transpose(normal) / det;
-	return normal;
+	// normal = world.invert().transpose(), without the translation
+	return glm::mat4(glm::transpose(glm::inverse(glm::mat3(world))));
 }
 
 glm::mat4 Smorgasbord::GetPerspectiveProjection(
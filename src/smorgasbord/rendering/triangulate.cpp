@@ -0,0 +1,314 @@
+#include "triangulate.hpp"
+
+#include <smorgasbord/util/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace Smorgasbord;
+
+/// Relative to the longest edge of the face
+const float triangulationPlanarityTolerance = 1e-3f;
+
+inline float CrossTriangulation2D(glm::vec2 a, glm::vec2 b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+inline bool IsInTriangle2D(
+	glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c, float orientation)
+{
+	return CrossTriangulation2D(b - a, p - a) * orientation >= 0
+		&& CrossTriangulation2D(c - b, p - b) * orientation >= 0
+		&& CrossTriangulation2D(a - c, p - c) * orientation >= 0;
+}
+
+/// Scratch memory of a thread, reused between faces
+struct FaceTriangulator
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> projected;
+	std::vector<uint32_t> remaining;
+	std::vector<uint32_t> triangles; // 3 face local corner indices each
+	
+	void Triangulate()
+	{
+		const uint32_t n = uint32_t(positions.size());
+		triangles.clear();
+		
+		if (n < 3)
+		{
+			return;
+		}
+		
+		if (n == 3)
+		{
+			triangles.insert(triangles.end(), { 0, 1, 2 });
+			return;
+		}
+		
+		// Newell normal, also valid for concave and non-planar faces
+		
+		glm::vec3 normal(0);
+		glm::vec3 center(0);
+		float longestEdge = 0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			const glm::vec3 &a = positions[i];
+			const glm::vec3 &b = positions[(i + 1) % n];
+			normal.x += (a.y - b.y) * (a.z + b.z);
+			normal.y += (a.z - b.z) * (a.x + b.x);
+			normal.z += (a.x - b.x) * (a.y + b.y);
+			center += a;
+			longestEdge = std::max(longestEdge, glm::length(b - a));
+		}
+		center /= float(n);
+		
+		float normalLength = glm::length(normal);
+		if (normalLength <= 0)
+		{
+			Fan(0);
+			return; // degenerate, any split is as good as another
+		}
+		normal /= normalLength;
+		
+		bool isPlanar = true;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			float distance = std::abs(glm::dot(positions[i] - center, normal));
+			if (distance > triangulationPlanarityTolerance * longestEdge)
+			{
+				isPlanar = false;
+				break;
+			}
+		}
+		
+		if (!isPlanar && n == 4)
+		{
+			/// The shorter diagonal gives the smaller fold
+			float d02 = glm::length(positions[2] - positions[0]);
+			float d13 = glm::length(positions[3] - positions[1]);
+			Fan(d02 <= d13 ? 0 : 1);
+			return;
+		}
+		
+		// Project to the plane, dropping the dominant normal axis
+		
+		glm::vec3 absNormal = glm::abs(normal);
+		uint32_t axisU = 1;
+		uint32_t axisV = 2;
+		if (absNormal.y >= absNormal.x && absNormal.y >= absNormal.z)
+		{
+			axisU = 2;
+			axisV = 0;
+		}
+		else if (absNormal.z >= absNormal.x && absNormal.z >= absNormal.y)
+		{
+			axisU = 0;
+			axisV = 1;
+		}
+		
+		projected.resize(n);
+		for (uint32_t i = 0; i < n; i++)
+		{
+			projected[i] = glm::vec2(positions[i][axisU], positions[i][axisV]);
+		}
+		
+		float area = 0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			area += CrossTriangulation2D(projected[i], projected[(i + 1) % n]);
+		}
+		const float orientation = area >= 0 ? 1.0f : -1.0f;
+		
+		bool isConvex = true;
+		for (uint32_t i = 0; i < n && isConvex; i++)
+		{
+			glm::vec2 e0 = projected[(i + 1) % n] - projected[i];
+			glm::vec2 e1 = projected[(i + 2) % n] - projected[(i + 1) % n];
+			isConvex = CrossTriangulation2D(e0, e1) * orientation >= 0;
+		}
+		
+		if (isConvex)
+		{
+			Fan(0);
+		}
+		else
+		{
+			ClipEars(orientation);
+		}
+	}
+	
+	void Fan(uint32_t first)
+	{
+		const uint32_t n = uint32_t(positions.size());
+		for (uint32_t i = 1; i + 1 < n; i++)
+		{
+			triangles.insert(triangles.end(), {
+				first, (first + i) % n, (first + i + 1) % n });
+		}
+	}
+	
+	void ClipEars(float orientation)
+	{
+		remaining.resize(projected.size());
+		for (uint32_t i = 0; i < remaining.size(); i++)
+		{
+			remaining[i] = i;
+		}
+		
+		while (remaining.size() > 3)
+		{
+			const size_t m = remaining.size();
+			size_t ear = m; // none
+			
+			for (size_t i = 0; i < m && ear == m; i++)
+			{
+				uint32_t a = remaining[(i + m - 1) % m];
+				uint32_t b = remaining[i];
+				uint32_t c = remaining[(i + 1) % m];
+				glm::vec2 pa = projected[a];
+				glm::vec2 pb = projected[b];
+				glm::vec2 pc = projected[c];
+				
+				if (CrossTriangulation2D(pb - pa, pc - pb) * orientation <= 0)
+				{
+					continue; // reflex or collinear corner
+				}
+				
+				bool isEar = true;
+				for (size_t j = 0; j < m && isEar; j++)
+				{
+					uint32_t v = remaining[j];
+					if (v != a && v != b && v != c)
+					{
+						isEar = !IsInTriangle2D(projected[v], pa, pb, pc, orientation);
+					}
+				}
+				
+				if (isEar)
+				{
+					ear = i;
+				}
+			}
+			
+			/// Self intersecting or numerically degenerate faces may have no
+			/// ear, clip any corner to make progress
+			if (ear == m)
+			{
+				ear = 0;
+			}
+			
+			triangles.insert(triangles.end(), {
+				remaining[(ear + m - 1) % m],
+				remaining[ear],
+				remaining[(ear + 1) % m] });
+			remaining.erase(remaining.begin() + ear);
+		}
+		
+		triangles.insert(triangles.end(), {
+			remaining[0], remaining[1], remaining[2] });
+	}
+};
+
+void Smorgasbord::TriangulateMeshData(MeshData &mesh, uint32_t numThreads)
+{
+	const size_t numFaces = mesh.c.size();
+	const bool hasNormal = !mesh.fn.empty();
+	const bool hasTexCoord = !mesh.ft.empty();
+	
+	// Offsets of the faces in the input and output arrays
+	
+	std::vector<size_t> cornerStarts(numFaces + 1, 0);
+	std::vector<size_t> triangleStarts(numFaces + 1, 0);
+	for (size_t i = 0; i < numFaces; i++)
+	{
+		cornerStarts[i + 1] = cornerStarts[i] + size_t(mesh.c[i]);
+		triangleStarts[i + 1] = triangleStarts[i] + size_t(std::max(mesh.c[i] - 2, 0));
+	}
+	
+	const size_t numTriangles = triangleStarts[numFaces];
+	
+	std::vector<int32_t> c(numTriangles, 3);
+	std::vector<uint32_t> fp(numTriangles * 3);
+	std::vector<uint32_t> fn(hasNormal ? numTriangles * 3 : 0);
+	std::vector<uint32_t> ft(hasTexCoord ? numTriangles * 3 : 0);
+	std::vector<uint32_t> sourceFaces(numTriangles);
+	
+	// Triangulate
+	
+	/// Every face has a known number of triangles, so ranges write straight
+	/// into the output arrays
+	ParallelForRange(
+		numFaces,
+		4096,
+		[&](size_t begin, size_t end)
+		{
+			FaceTriangulator triangulator;
+			
+			for (size_t face = begin; face < end; face++)
+			{
+				const size_t cornerStart = cornerStarts[face];
+				const size_t n = cornerStarts[face + 1] - cornerStart;
+				
+				triangulator.positions.resize(n);
+				for (size_t k = 0; k < n; k++)
+				{
+					triangulator.positions[k] = mesh.p[mesh.fp[cornerStart + k]];
+				}
+				
+				triangulator.Triangulate();
+				
+				size_t target = triangleStarts[face] * 3;
+				for (uint32_t corner : triangulator.triangles)
+				{
+					fp[target] = mesh.fp[cornerStart + corner];
+					if (hasNormal)
+					{
+						fn[target] = mesh.fn[cornerStart + corner];
+					}
+					if (hasTexCoord)
+					{
+						ft[target] = mesh.ft[cornerStart + corner];
+					}
+					target++;
+				}
+				
+				/// Faces triangulated before keep their original source
+				const uint32_t sourceFace = mesh.sourceFaces.empty()
+					? uint32_t(face)
+					: mesh.sourceFaces[face];
+				for (size_t t = triangleStarts[face]; t < triangleStarts[face + 1]; t++)
+				{
+					sourceFaces[t] = sourceFace;
+				}
+			}
+		},
+		numThreads);
+	
+	// Update ranges
+	
+	for (MeshRange &range : mesh.ranges)
+	{
+		size_t first = triangleStarts[range.firstFace];
+		size_t end = triangleStarts[size_t(range.firstFace) + range.numFaces];
+		range.firstFace = uint32_t(first);
+		range.numFaces = uint32_t(end - first);
+	}
+	
+	mesh.ranges.erase(
+		std::remove_if(
+			mesh.ranges.begin(),
+			mesh.ranges.end(),
+			[](const MeshRange &range) { return range.numFaces == 0; }),
+		mesh.ranges.end());
+	
+	mesh.c.swap(c);
+	mesh.fp.swap(fp);
+	mesh.fn.swap(fn);
+	mesh.ft.swap(ft);
+	mesh.sourceFaces.swap(sourceFaces);
+	
+	mesh.UpdateStatistics();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <cstdint>
+
+namespace Smorgasbord {
+
+/// Splits every face of mesh into triangles, so it can be drawn as a
+/// TriangleList. Convex faces are fanned, concave ones are ear clipped in
+/// the plane of the face. Non-planar quads are split along their shorter
+/// diagonal. Faces with less than 3 vertices are removed.
+/// MeshData::sourceFaces records the original face of every triangle, a
+/// face of n vertices becomes n - 2 consecutive triangles. Ranges are
+/// updated to the new face indices.
+/// numThreads == 0 uses all hardware threads
+void TriangulateMeshData(MeshData &mesh, uint32_t numThreads = 0);
+
+}
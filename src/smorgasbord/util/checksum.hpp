@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/*
+
+Checksums
+---------
+
+GetAdler32() is the checksum of zlib streams. Pass the result of a previous
+call as adler to continue it over more data. CombineAdler32() gives the
+checksum of two concatenated parts from the checksums of the parts, so
+that they can be computed in parallel.
+
+*/
+
+namespace Smorgasbord {
+
+inline uint32_t GetAdler32(const uint8_t *data, size_t size, uint32_t adler = 1)
+{
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	
+	/// 5552 bytes can't overflow b before the modulo
+	while (size > 0)
+	{
+		size_t blockSize = std::min<size_t>(size, 5552);
+		size -= blockSize;
+		
+		for (; blockSize >= 4; blockSize -= 4, data += 4)
+		{
+			a += data[0]; b += a;
+			a += data[1]; b += a;
+			a += data[2]; b += a;
+			a += data[3]; b += a;
+		}
+		
+		for (; blockSize > 0; blockSize--)
+		{
+			a += *data++;
+			b += a;
+		}
+		
+		a %= 65521;
+		b %= 65521;
+	}
+	
+	return (b << 16) | a;
+}
+
+/// adler2 is the checksum of the second part, which is size2 bytes long
+inline uint32_t CombineAdler32(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+	const uint32_t base = 65521;
+	uint32_t remainder = uint32_t(size2 % base);
+	
+	/// The sums of the second part start from a1 instead of 1
+	uint32_t a = (adler1 & 0xFFFF) + (adler2 & 0xFFFF) + base - 1;
+	uint32_t b = uint32_t((uint64_t(remainder) * (adler1 & 0xFFFF)) % base)
+		+ (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+	
+	return ((b % base) << 16) | (a % base);
+}
+
+}
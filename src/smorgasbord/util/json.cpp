@@ -0,0 +1,331 @@
+#include "json.hpp"
+
+#include <smorgasbord/util/log.hpp>
+
+#include <charconv>
+#include <cmath>
+
+const uint32_t jsonMaxDepth = 256;
+
+struct JsonParser
+{
+	const char *begin;
+	const char *s;
+	const char *end;
+	
+	void SkipSpaces()
+	{
+		while (s < end && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r'))
+		{
+			s++;
+		}
+	}
+	
+	bool Expect(const char *literal)
+	{
+		for (; *literal != 0; literal++, s++)
+		{
+			if (s == end || *s != *literal)
+			{
+				return false;
+			}
+		}
+		
+		return true;
+	}
+	
+	bool ParseHex(uint32_t &code)
+	{
+		code = 0;
+		for (int i = 0; i < 4; i++, s++)
+		{
+			if (s == end)
+			{
+				return false;
+			}
+			
+			char c = *s;
+			uint32_t digit =
+				c >= '0' && c <= '9' ? c - '0'
+				: c >= 'a' && c <= 'f' ? c - 'a' + 10
+				: c >= 'A' && c <= 'F' ? c - 'A' + 10
+				: 16;
+			if (digit == 16)
+			{
+				return false;
+			}
+			
+			code = code * 16 + digit;
+		}
+		
+		return true;
+	}
+	
+	bool ParseString(std::string &string)
+	{
+		s++; // opening quote
+		
+		while (s < end && *s != '"')
+		{
+			/// Runs without escapes are appended whole
+			const char *run = s;
+			while (s < end && *s != '"' && *s != '\\')
+			{
+				s++;
+			}
+			string.append(run, s);
+			
+			if (s == end || *s == '"')
+			{
+				break;
+			}
+			
+			s++; // backslash
+			if (s == end)
+			{
+				return false;
+			}
+			
+			char c = *s++;
+			switch (c)
+			{
+			case '"': string += '"'; break;
+			case '\\': string += '\\'; break;
+			case '/': string += '/'; break;
+			case 'b': string += '\b'; break;
+			case 'f': string += '\f'; break;
+			case 'n': string += '\n'; break;
+			case 'r': string += '\r'; break;
+			case 't': string += '\t'; break;
+			case 'u':
+			{
+				uint32_t code;
+				if (!ParseHex(code))
+				{
+					return false;
+				}
+				
+				/// Surrogate pairs encode code points above 0xFFFF
+				if (code >= 0xD800 && code < 0xDC00)
+				{
+					uint32_t low;
+					if (!Expect("\\u") || !ParseHex(low) || low < 0xDC00 || low >= 0xE000)
+					{
+						return false;
+					}
+					
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				
+				// UTF-8
+				if (code < 0x80)
+				{
+					string += char(code);
+				}
+				else if (code < 0x800)
+				{
+					string += char(0xC0 | (code >> 6));
+					string += char(0x80 | (code & 0x3F));
+				}
+				else if (code < 0x10000)
+				{
+					string += char(0xE0 | (code >> 12));
+					string += char(0x80 | ((code >> 6) & 0x3F));
+					string += char(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					string += char(0xF0 | (code >> 18));
+					string += char(0x80 | ((code >> 12) & 0x3F));
+					string += char(0x80 | ((code >> 6) & 0x3F));
+					string += char(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		
+		if (s == end)
+		{
+			return false;
+		}
+		
+		s++; // closing quote
+		return true;
+	}
+	
+	bool ParseValue(Smorgasbord::JsonValue &value, uint32_t depth)
+	{
+		using Type = Smorgasbord::JsonValue::Type;
+		
+		SkipSpaces();
+		if (s == end || depth > jsonMaxDepth)
+		{
+			return false;
+		}
+		
+		switch (*s)
+		{
+		case 'n':
+			value.type = Type::Null;
+			return Expect("null");
+		
+		case 't':
+			value.type = Type::Bool;
+			value.boolean = true;
+			return Expect("true");
+		
+		case 'f':
+			value.type = Type::Bool;
+			value.boolean = false;
+			return Expect("false");
+		
+		case '"':
+			value.type = Type::String;
+			return ParseString(value.string);
+		
+		case '[':
+			value.type = Type::Array;
+			s++;
+			SkipSpaces();
+			if (s < end && *s == ']')
+			{
+				s++;
+				return true;
+			}
+			
+			for (;;)
+			{
+				value.array.emplace_back();
+				if (!ParseValue(value.array.back(), depth + 1))
+				{
+					return false;
+				}
+				
+				SkipSpaces();
+				if (s < end && *s == ',')
+				{
+					s++;
+					continue;
+				}
+				
+				return Expect("]");
+			}
+		
+		case '{':
+			value.type = Type::Object;
+			s++;
+			SkipSpaces();
+			if (s < end && *s == '}')
+			{
+				s++;
+				return true;
+			}
+			
+			for (;;)
+			{
+				SkipSpaces();
+				value.object.emplace_back();
+				auto &member = value.object.back();
+				if (s == end || *s != '"' || !ParseString(member.first))
+				{
+					return false;
+				}
+				
+				SkipSpaces();
+				if (!Expect(":") || !ParseValue(member.second, depth + 1))
+				{
+					return false;
+				}
+				
+				SkipSpaces();
+				if (s < end && *s == ',')
+				{
+					s++;
+					continue;
+				}
+				
+				return Expect("}");
+			}
+		
+		default:
+		{
+			value.type = Type::Number;
+			
+			/// from_chars() would also take "inf" and "nan"
+			const char *digit = *s == '-' ? s + 1 : s;
+			if (digit == end || *digit < '0' || *digit > '9')
+			{
+				return false;
+			}
+			
+			std::from_chars_result result = std::from_chars(s, end, value.number);
+			if (result.ec != std::errc() && result.ec != std::errc::result_out_of_range)
+			{
+				return false;
+			}
+			
+			s = result.ptr;
+			return true;
+		}
+		}
+	}
+};
+
+const Smorgasbord::JsonValue &Smorgasbord::JsonValue::operator[](size_t index) const
+{
+	static const JsonValue null;
+	return type == Type::Array && index < array.size() ? array[index] : null;
+}
+
+const Smorgasbord::JsonValue &Smorgasbord::JsonValue::operator[](
+	const std::string &key) const
+{
+	static const JsonValue null;
+	if (type != Type::Object)
+	{
+		return null;
+	}
+	
+	for (const auto &member : object)
+	{
+		if (member.first == key)
+		{
+			return member.second;
+		}
+	}
+	
+	return null;
+}
+
+int64_t Smorgasbord::JsonValue::GetInteger(int64_t defaultValue) const
+{
+	if (type != Type::Number
+		|| number != std::floor(number)
+		|| std::abs(number) > 9007199254740992.0) // 2^53
+	{
+		return defaultValue;
+	}
+	
+	return int64_t(number);
+}
+
+bool Smorgasbord::ParseJson(const char *text, size_t size, JsonValue &value)
+{
+	value = JsonValue();
+	
+	JsonParser parser = { text, text, text + size };
+	bool valid = parser.ParseValue(value, 0);
+	
+	parser.SkipSpaces();
+	if (!valid || parser.s != parser.end)
+	{
+		LogE("Invalid JSON at offset {0}.", size_t(parser.s - parser.begin));
+		value = JsonValue();
+		return false;
+	}
+	
+	return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+
+class JsonValue
+---------------
+
+Minimal JSON document, e.g. for the JSON chunk of glTF files. Lookups of
+missing members or out of range elements return a null value, so nested
+optional values can be read without checks:
+	
+	float scale = json["materials"][i]["pbrMetallicRoughness"]
+		["metallicFactor"].GetNumber(1.0f);
+
+Object members keep their order. Lookup is linear, which is fine for the
+small objects of asset formats.
+
+*/
+
+namespace Smorgasbord {
+
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null = 0,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+	
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+	
+	bool IsNull() const
+	{
+		return type == Type::Null;
+	}
+	
+	bool Has(const std::string &key) const
+	{
+		return !(*this)[key].IsNull();
+	}
+	
+	/// Element count of arrays, member count of objects, 0 otherwise
+	size_t Size() const
+	{
+		return type == Type::Array ? array.size()
+			: type == Type::Object ? object.size()
+			: 0;
+	}
+	
+	const JsonValue &operator[](size_t index) const;
+	const JsonValue &operator[](const std::string &key) const;
+	
+	double GetNumber(double defaultValue = 0) const
+	{
+		return type == Type::Number ? number : defaultValue;
+	}
+	
+	bool GetBool(bool defaultValue = false) const
+	{
+		return type == Type::Bool ? boolean : defaultValue;
+	}
+	
+	const std::string &GetString() const
+	{
+		return string; // empty unless a string
+	}
+	
+	/// Number as an integer, defaultValue if it isn't one
+	int64_t GetInteger(int64_t defaultValue = -1) const;
+};
+
+/// Parses UTF-8 JSON text, which doesn't need to be null terminated.
+/// Returns false and logs the offset of the error if text is invalid
+bool ParseJson(const char *text, size_t size, JsonValue &value);
+
+}
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <exception>
 #include <cassert>
+#include <mutex>
 
 #define SMORGASBORD_PRINT_CALLER_IN_RELEASE 1
 
@@ -37,6 +38,9 @@ public:
 private:
 	std::ostream* stream;
 	LogAssertLevel assertLevel;
+	/// Keeps messages of worker threads, e.g. of LoadImages(), whole.
+	/// Recursive because LogAssert() logs too
+	std::recursive_mutex mutex;
 	
 public:
 	Log(
@@ -55,12 +59,14 @@ public:
 	// Oneline info
 	void O(const std::string& message)
 	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
 		*this->stream << "INFO " << message << std::endl;
 	}
 	
 	// Info
 	void I(const std::string& caller, const std::string& message)
 	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
 		*this->stream << "INFO ";
 		PrintMessage(caller, message);
 	}
@@ -68,6 +74,7 @@ public:
 	// Warning
 	void W(const std::string& caller, const std::string& message)
 	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
 		*this->stream << "WARNING ";
 		PrintMessage(caller, message);
 		LogAssert((int)assertLevel < (int)LogAssertLevel::Warning);
@@ -76,6 +83,7 @@ public:
 	// Error
 	inline void E(const std::string& caller, const std::string& message)
 	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
 		*this->stream << "ERROR ";
 		PrintMessage(caller, message);
 		LogAssert((int)assertLevel < (int)LogAssertLevel::Error);
@@ -84,6 +92,7 @@ public:
 	// Fatal error (causes program termination)
 	inline void F(const std::string& caller, const std::string& message)
 	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
 		*this->stream << "FATAL ERROR ";
 		PrintMessage(caller, message);
 		LogAssert(false);
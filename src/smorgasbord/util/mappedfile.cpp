@@ -0,0 +1,177 @@
+#include "mappedfile.hpp"
+
+#include "log.hpp"
+
+#ifdef WIN32 // Windows
+	#include <windows.h>
+#else // Unix
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+Smorgasbord::MappedFile::MappedFile()
+{ }
+
+Smorgasbord::MappedFile::MappedFile(const std::string &path)
+{
+	Open(path);
+}
+
+Smorgasbord::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef WIN32 // Windows ////////////////////////////////////////////////
+
+bool Smorgasbord::MappedFile::Open(const std::string &path)
+{
+	Close();
+	
+	HANDLE file = CreateFileA(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LogE("Cannot open file {0}", path);
+		return false;
+	}
+	
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		LogE("Cannot query size of file {0}", path);
+		CloseHandle(file);
+		return false;
+	}
+	
+	fileHandle = file;
+	size = static_cast<size_t>(fileSize.QuadPart);
+	isOpen = true;
+	
+	/// Zero sized files cannot be mapped, but they are valid files
+	if (size == 0)
+	{
+		return true;
+	}
+	
+	HANDLE mapping = CreateFileMappingA(
+		file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	
+	if (mapping == nullptr)
+	{
+		LogE("Cannot map file {0}", path);
+		Close();
+		return false;
+	}
+	
+	mappingHandle = mapping;
+	data = static_cast<const uint8_t*>(
+		MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	
+	if (data == nullptr)
+	{
+		LogE("Cannot map view of file {0}", path);
+		Close();
+		return false;
+	}
+	
+	return true;
+}
+
+void Smorgasbord::MappedFile::Close()
+{
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+	}
+	
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = nullptr;
+	}
+	
+	size = 0;
+	isOpen = false;
+}
+
+#else // Unix //////////////////////////////////////////////////////////
+
+bool Smorgasbord::MappedFile::Open(const std::string &path)
+{
+	Close();
+	
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		LogE("Cannot open file {0}", path);
+		return false;
+	}
+	
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+	{
+		LogE("Cannot query size of file {0}", path);
+		close(fd);
+		return false;
+	}
+	
+	fileDescriptor = fd;
+	size = static_cast<size_t>(fileStat.st_size);
+	isOpen = true;
+	
+	/// Zero sized files cannot be mapped, but they are valid files
+	if (size == 0)
+	{
+		return true;
+	}
+	
+	void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		LogE("Cannot map file {0}", path);
+		Close();
+		return false;
+	}
+	
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = static_cast<const uint8_t*>(mapping);
+	
+	return true;
+}
+
+void Smorgasbord::MappedFile::Close()
+{
+	if (data != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(data), size);
+		data = nullptr;
+	}
+	
+	if (fileDescriptor >= 0)
+	{
+		close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+	
+	size = 0;
+	isOpen = false;
+}
+
+#endif
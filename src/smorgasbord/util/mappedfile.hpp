@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+
+class MappedFile
+----------------
+
+Read-only memory mapping of a whole file. The mapping stays valid until
+Close() is called or the object is destroyed. An empty file opens
+successfully, but GetData() returns nullptr for it.
+
+*/
+
+namespace Smorgasbord {
+
+class MappedFile
+{
+private:
+#ifdef WIN32
+	void *fileHandle = nullptr; // HANDLE
+	void *mappingHandle = nullptr; // HANDLE
+#else
+	int fileDescriptor = -1;
+#endif
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	bool isOpen = false;
+
+public:
+	MappedFile();
+	MappedFile(const std::string &path);
+	~MappedFile();
+	
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	
+	bool Open(const std::string &path);
+	void Close();
+	
+	bool IsOpen() const
+	{
+		return isOpen;
+	}
+	
+	const uint8_t *GetData() const
+	{
+		return data;
+	}
+	
+	size_t GetSize() const
+	{
+		return size;
+	}
+	
+	const char *GetText() const
+	{
+		return reinterpret_cast<const char*>(data);
+	}
+};
+
+}
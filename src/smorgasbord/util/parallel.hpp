@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/*
+
+ParallelFor()
+-------------
+
+Runs task(i) for every i in [0, numTasks) on up to numThreads threads. The
+calling thread takes part in the work, and the call returns only after every
+task finished. numThreads == 0 means one thread per hardware thread.
+
+ParallelForRange() splits [0, count) into contiguous ranges of at least
+minRangeSize elements and runs task(begin, end) for each of them.
+ParallelForRangeIndexed() passes the range index too, for reductions into
+GetParallelRangeCount() partial results.
+
+Threads are spawned per call, so these are meant for coarse work items
+(mesh or image sized loops), not for fine grained tasks.
+
+*/
+
+namespace Smorgasbord {
+
+inline uint32_t GetHardwareThreadCount()
+{
+	uint32_t numThreads = std::thread::hardware_concurrency();
+	return numThreads > 0 ? numThreads : 1;
+}
+
+inline uint32_t ResolveThreadCount(uint32_t numThreads)
+{
+	return numThreads > 0 ? numThreads : GetHardwareThreadCount();
+}
+
+inline void ParallelFor(
+	size_t numTasks,
+	const std::function<void(size_t)> &task,
+	uint32_t numThreads = 0)
+{
+	numThreads = uint32_t(std::min<size_t>(
+		ResolveThreadCount(numThreads), numTasks));
+	
+	if (numThreads <= 1)
+	{
+		for (size_t i = 0; i < numTasks; i++)
+		{
+			task(i);
+		}
+		
+		return;
+	}
+	
+	std::atomic<size_t> nextTask(0);
+	auto worker = [&]()
+	{
+		size_t i;
+		while ((i = nextTask.fetch_add(1)) < numTasks)
+		{
+			task(i);
+		}
+	};
+	
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (uint32_t i = 1; i < numThreads; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	
+	worker();
+	
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+/// Number of ranges ParallelForRange() splits count elements into
+inline size_t GetParallelRangeCount(
+	size_t count, size_t minRangeSize, uint32_t numThreads = 0)
+{
+	numThreads = ResolveThreadCount(numThreads);
+	minRangeSize = std::max<size_t>(minRangeSize, 1);
+	
+	/// A few ranges per thread even out uneven work between ranges
+	return std::min<size_t>(
+		size_t(numThreads) * 4, (count + minRangeSize - 1) / minRangeSize);
+}
+
+/// Also passes the index of the range to task, below
+/// GetParallelRangeCount(), e.g. to store partial results per range
+inline void ParallelForRangeIndexed(
+	size_t count,
+	size_t minRangeSize,
+	const std::function<void(size_t, size_t, size_t)> &task,
+	uint32_t numThreads = 0)
+{
+	size_t numRanges = GetParallelRangeCount(count, minRangeSize, numThreads);
+	
+	if (numRanges <= 1)
+	{
+		if (count > 0)
+		{
+			task(0, 0, count);
+		}
+		
+		return;
+	}
+	
+	ParallelFor(
+		numRanges,
+		[&](size_t rangeIndex)
+		{
+			size_t begin = count * rangeIndex / numRanges;
+			size_t end = count * (rangeIndex + 1) / numRanges;
+			task(rangeIndex, begin, end);
+		},
+		numThreads);
+}
+
+inline void ParallelForRange(
+	size_t count,
+	size_t minRangeSize,
+	const std::function<void(size_t, size_t)> &task,
+	uint32_t numThreads = 0)
+{
+	ParallelForRangeIndexed(
+		count,
+		minRangeSize,
+		[&](size_t, size_t begin, size_t end)
+		{
+			task(begin, end);
+		},
+		numThreads);
+}
+
+}
@@ -1,6 +1,7 @@
 #include "resourcemanager.hpp"
 
 #include "log.hpp"
+#include "mappedfile.hpp"
 
 #include <fstream>
 #include <sstream>
@@ -50,6 +51,45 @@ std::unique_ptr<std::istream> Smorgasbord::ResourceReference::OpenRead()
 	return { };
 }
 
+std::unique_ptr<Smorgasbord::MappedFile> Smorgasbord::ResourceReference::OpenMapped()
+{
+	std::shared_ptr<ResourceManager> rm = this->rmRef.lock();
+	
+	if (static_cast<bool>(rm))
+	{
+		return rm->OpenMapped(this->path);
+	}
+	
+	LogE("Couldn't open resource: ResourceManager no longer available");
+	return { };
+}
+
+std::unique_ptr<std::ostream> Smorgasbord::ResourceReference::OpenWrite()
+{
+	std::shared_ptr<ResourceManager> rm = this->rmRef.lock();
+	
+	if (static_cast<bool>(rm))
+	{
+		return rm->OpenWrite(this->path);
+	}
+	
+	LogE("Couldn't open resource: ResourceManager no longer available");
+	return { };
+}
+
+std::string Smorgasbord::ResourceReference::GetFullPath()
+{
+	std::shared_ptr<ResourceManager> rm = this->rmRef.lock();
+	
+	if (static_cast<bool>(rm))
+	{
+		return rm->GetPath(this->path);
+	}
+	
+	LogE("Couldn't resolve resource path: ResourceManager no longer available");
+	return this->path;
+}
+
 void Smorgasbord::ResourceReference::ReadInto(std::stringstream &stream)
 {
 	std::unique_ptr<std::istream> file = OpenRead();
@@ -119,3 +159,32 @@ std::unique_ptr<std::istream> Smorgasbord::ResourceManager::OpenRead(std::string
 	
 	return file;
 }
+
+std::unique_ptr<Smorgasbord::MappedFile> Smorgasbord::ResourceManager::OpenMapped(std::string path)
+{
+	std::unique_ptr<MappedFile> file =
+		std::make_unique<MappedFile>(GetPath(path));
+	
+	if (!file->IsOpen())
+	{
+		return { };
+	}
+	
+	return file;
+}
+
+std::unique_ptr<std::ostream> Smorgasbord::ResourceManager::OpenWrite(std::string path)
+{
+	std::string relativePath = GetPath(path);
+	
+	std::unique_ptr<std::ofstream> file = std::make_unique<std::ofstream>(
+		relativePath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+	
+	if (!file->is_open())
+	{
+		LogE("Cannot open file {0} for writing", relativePath);
+		return { };
+	}
+	
+	return file;
+}
@@ -13,6 +13,7 @@ namespace Smorgasbord {
 
 class ResourceManager;
 class Device;
+class MappedFile;
 
 class ResourceReference
 {
@@ -28,10 +29,20 @@ public:
 	/// Get resource relative to the stored path
 	ResourceReference Get(std::string relativePath);
 	std::unique_ptr<std::istream> OpenRead();
+	std::unique_ptr<MappedFile> OpenMapped();
+	std::unique_ptr<std::ostream> OpenWrite();
 	void ReadInto(std::stringstream &stream);
 	std::string GetTextContents();
 	std::vector<uint8_t> GetBinaryContents();
 	
+	const std::string &GetPath() const
+	{
+		return path;
+	}
+	
+	/// Path including the ResourceManager base path
+	std::string GetFullPath();
+	
 	operator std::unique_ptr<std::istream>()
 	{
 		return OpenRead();
@@ -48,6 +59,8 @@ public:
 	
 	std::string GetPath(std::string path);
 	std::unique_ptr<std::istream> OpenRead(std::string path);
+	std::unique_ptr<MappedFile> OpenMapped(std::string path);
+	std::unique_ptr<std::ostream> OpenWrite(std::string path);
 	
 	std::string GetTextContents(std::string path)
 	{
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+
+SIMD instruction sets
+---------------------
+
+Defines SMORGASBORD_SSE2, SMORGASBORD_SSE41 and SMORGASBORD_AVX2 for the
+instruction sets the compiler is allowed to use, e.g. with -mavx2 or
+/arch:AVX2, and includes their intrinsics. Code using them keeps a scalar
+path for the other targets. SMORGASBORD_F16C is defined next to AVX2 if
+the half float conversions may be used too, with -mf16c or /arch:AVX2.
+
+Default builds target the baseline of the architecture, SSE2 on x64, so
+the AVX2, F16C and SSE4.1 paths are left out. Configure with
+-DSMORGASBORD_AVX2=ON to build the library, its tests and its users with
+them. There is no runtime dispatch, such a build doesn't run on CPUs
+without AVX2.
+
+StreamingCopy() copies with non-temporal stores where available.
+
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SMORGASBORD_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+#if defined(SMORGASBORD_SSE2) && (defined(__SSE4_1__) || defined(__AVX__))
+	#define SMORGASBORD_SSE41 1
+	#include <smmintrin.h>
+#endif
+
+#if defined(SMORGASBORD_SSE41) && defined(__AVX2__)
+	#define SMORGASBORD_AVX2 1
+	#include <immintrin.h>
+#endif
+
+#if defined(SMORGASBORD_AVX2) && (defined(__F16C__) || defined(_MSC_VER))
+	#define SMORGASBORD_F16C 1
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Smorgasbord {
+
+/// memcpy with non-temporal stores, for large writes which are not read
+/// back by the CPU, e.g. into mapped GPU buffers. They bypass the caches
+/// and don't read the target lines first. Unaligned ends use regular
+/// stores. Stores are fenced before returning
+inline void StreamingCopy(void *target, const void *source, size_t size)
+{
+	uint8_t *t = static_cast<uint8_t*>(target);
+	const uint8_t *s = static_cast<const uint8_t*>(source);
+	
+#ifdef SMORGASBORD_SSE2
+	size_t head = (16 - (reinterpret_cast<uintptr_t>(t) & 15)) & 15;
+	if (size < head + 64)
+	{
+		std::memcpy(t, s, size);
+		return;
+	}
+	
+	std::memcpy(t, s, head);
+	t += head;
+	s += head;
+	size -= head;
+	
+	for (; size >= 64; t += 64, s += 64, size -= 64)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(t), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(t + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(t + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(t + 48), d);
+	}
+	
+	_mm_sfence();
+#endif
+	
+	std::memcpy(t, s, size);
+}
+
+}
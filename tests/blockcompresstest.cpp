@@ -0,0 +1,222 @@
+#include "test.hpp"
+
+#include <smorgasbord/image/blockcompress.hpp>
+#include <smorgasbord/image/image.hpp>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+struct TestFormat
+{
+	TextureFormat format;
+	uint32_t numChannels; // stored channels, starting at red
+	double minPSNR; // on MakeSmoothImage()
+};
+
+/// Floors a few dB below what the encoder reaches, so that a regression in
+/// quality fails, but not a small change in endpoint search
+const TestFormat testFormats[] =
+{
+	{ TextureFormat::BC1_RGBA_UNorm, 3, 36 },
+	{ TextureFormat::BC1_RGBA_sRGB, 3, 36 },
+	{ TextureFormat::BC3_RGBA_UNorm, 4, 37 },
+	{ TextureFormat::BC3_RGBA_sRGB, 4, 37 },
+	{ TextureFormat::BC4_R_UNorm, 1, 48 },
+	{ TextureFormat::BC5_RG_UNorm, 2, 50 },
+	{ TextureFormat::BC7_RGBA_UNorm, 4, 42 },
+	{ TextureFormat::BC7_RGBA_sRGB, 4, 42 },
+};
+
+/// Partial blocks in both directions, and sizes below one block
+const glm::uvec2 testSizes[] = { { 1, 1 }, { 3, 5 }, { 17, 9 }, { 64, 64 }, { 100, 37 } };
+
+static bool IsPunchThrough(TextureFormat format)
+{
+	return format == TextureFormat::BC1_RGBA_UNorm
+		|| format == TextureFormat::BC1_RGBA_sRGB;
+}
+
+/// Gradients and an alpha ramp, opaque enough for BC1, with the same slope
+/// per pixel at every size, up to 128x128
+static Image MakeSmoothImage(glm::uvec2 size)
+{
+	Image image(size);
+	for (uint32_t y = 0; y < size.y; y++)
+	{
+		for (uint32_t x = 0; x < size.x; x++)
+		{
+			uint8_t *pixel = &image.data[(size_t(y) * size.x + x) * 4];
+			pixel[0] = uint8_t(128 + 100 * std::sin(float(x) * 0.05f));
+			pixel[1] = uint8_t(20 + y * 2);
+			pixel[2] = uint8_t(128 + 100 * std::cos(float(x + y) * 0.04f));
+			pixel[3] = uint8_t(128 + x);
+		}
+	}
+	
+	return image;
+}
+
+static Image MakeRandomImage(glm::uvec2 size, std::mt19937 &random)
+{
+	Image image(size);
+	for (uint8_t &value : image.data)
+	{
+		value = uint8_t(random());
+	}
+	
+	return image;
+}
+
+/// PSNR over the stored channels, infinity if they are exact
+static double GetPSNR(const Image &image, const Image &decoded, uint32_t numChannels)
+{
+	double squaredError = 0;
+	size_t count = 0;
+	for (size_t i = 0; i < image.data.size(); i += 4)
+	{
+		for (uint32_t c = 0; c < numChannels; c++)
+		{
+			double error = double(image.data[i + c]) - double(decoded.data[i + c]);
+			squaredError += error * error;
+			count++;
+		}
+	}
+	
+	if (squaredError == 0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	
+	return 10 * std::log10(255.0 * 255.0 * double(count) / squaredError);
+}
+
+static void TestRoundTrip(const TestFormat &format, glm::uvec2 size)
+{
+	Image image = MakeSmoothImage(size);
+	std::vector<uint8_t> blocks;
+	TestCheck(CompressImage(image, format.format, blocks, 1));
+	TestCheck(blocks.size() == GetTextureLevelSize(format.format, size, 0));
+	
+	std::shared_ptr<Image> decoded =
+		DecompressImage(blocks.data(), blocks.size(), size, format.format);
+	TestCheck(decoded && decoded->imageSize == size);
+	if (!decoded || decoded->imageSize != size)
+	{
+		return;
+	}
+	
+	const double psnr = GetPSNR(image, *decoded, format.numChannels);
+	if (psnr < format.minPSNR)
+	{
+		fmt::print(
+			"format {0}, {1}x{2}: PSNR {3:.2f} dB below {4} dB\n",
+			uint32_t(format.format), size.x, size.y, psnr, format.minPSNR);
+	}
+	TestCheck(psnr >= format.minPSNR);
+	
+	/// Channels the format doesn't store decode to (r, 0, 0, 255) and
+	/// (r, g, 0, 255), BC1 alpha is 255 for pixels at 128 and above
+	bool constantChannels = true;
+	for (size_t i = 0; i < decoded->data.size(); i += 4)
+	{
+		const uint8_t *pixel = &decoded->data[i];
+		if (format.numChannels == 1)
+		{
+			constantChannels = constantChannels && pixel[1] == 0;
+		}
+		
+		if (format.numChannels <= 2)
+		{
+			constantChannels = constantChannels && pixel[2] == 0 && pixel[3] == 255;
+		}
+		
+		if (IsPunchThrough(format.format))
+		{
+			constantChannels = constantChannels && pixel[3] == 255;
+		}
+	}
+	TestCheck(constantChannels);
+}
+
+/// Pixels with alpha below 128 become transparent black in BC1, the others
+/// stay opaque
+static void TestPunchThrough(TextureFormat format)
+{
+	const glm::uvec2 size(17, 9);
+	Image image = MakeSmoothImage(size);
+	for (size_t i = 0; i < image.data.size(); i += 4)
+	{
+		image.data[i + 3] = (i / 4) % 3 == 0 ? 0 : 255;
+	}
+	
+	std::vector<uint8_t> blocks;
+	TestCheck(CompressImage(image, format, blocks, 1));
+	std::shared_ptr<Image> decoded =
+		DecompressImage(blocks.data(), blocks.size(), size, format);
+	TestCheck(decoded != nullptr);
+	if (!decoded)
+	{
+		return;
+	}
+	
+	bool matches = true;
+	for (size_t i = 0; i < image.data.size(); i += 4)
+	{
+		const bool transparent = image.data[i + 3] < 128;
+		matches = matches && (decoded->data[i + 3] == 0) == transparent;
+	}
+	TestCheck(matches);
+}
+
+/// Rows of blocks are split between threads, the result must not depend
+/// on how
+static void TestThreads(TextureFormat format, std::mt19937 &random)
+{
+	const glm::uvec2 size(100, 37);
+	Image image = MakeRandomImage(size, random);
+	
+	std::vector<uint8_t> blocks;
+	TestCheck(CompressImage(image, format, blocks, 1));
+	for (uint32_t numThreads : { 2u, 4u, 0u })
+	{
+		std::vector<uint8_t> threadBlocks;
+		TestCheck(CompressImage(image, format, threadBlocks, numThreads));
+		TestCheck(threadBlocks == blocks);
+	}
+	
+	std::shared_ptr<Image> decoded =
+		DecompressImage(blocks.data(), blocks.size(), size, format, 1);
+	std::shared_ptr<Image> threadDecoded =
+		DecompressImage(blocks.data(), blocks.size(), size, format, 4);
+	TestCheck(decoded && threadDecoded && decoded->data == threadDecoded->data);
+	
+	TestQuietLog quiet;
+	TestCheck(!DecompressImage(blocks.data(), blocks.size() - 1, size, format));
+	TestCheck(!DecompressImage(blocks.data(), blocks.size(), size + 4u, format));
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	
+	for (const TestFormat &format : testFormats)
+	{
+		for (glm::uvec2 size : testSizes)
+		{
+			TestRoundTrip(format, size);
+		}
+		
+		TestThreads(format.format, random);
+	}
+	
+	TestPunchThrough(TextureFormat::BC1_RGBA_UNorm);
+	TestPunchThrough(TextureFormat::BC1_RGBA_sRGB);
+	
+	return TestResult();
+}
@@ -0,0 +1,130 @@
+#include "test.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/import/decodepng.hpp>
+#include <smorgasbord/import/loadimage.hpp>
+
+#include <lodepng/lodepng.h>
+
+#include <cstring>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+static void AppendPNGUInt32(std::vector<uint8_t> &png, uint32_t value)
+{
+	png.insert(png.end(), {
+		uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) });
+}
+
+static void AppendPNGChunk(
+	std::vector<uint8_t> &png, const char *type, const std::vector<uint8_t> &data)
+{
+	AppendPNGUInt32(png, uint32_t(data.size()));
+	const size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	AppendPNGUInt32(png, lodepng_crc32(&png[start], png.size() - start));
+}
+
+/// 8 bit palette PNG written by hand, so that it can hold what no encoder
+/// writes. rows holds a filter byte and width indices per row
+static std::vector<uint8_t> MakePalettePNG(
+	uint32_t width,
+	uint32_t height,
+	const std::vector<uint8_t> &palette,
+	const std::vector<uint8_t> &rows)
+{
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	
+	std::vector<uint8_t> header;
+	AppendPNGUInt32(header, width);
+	AppendPNGUInt32(header, height);
+	header.insert(header.end(), { 8, 3, 0, 0, 0 });
+	AppendPNGChunk(png, "IHDR", header);
+	AppendPNGChunk(png, "PLTE", palette);
+	
+	std::vector<uint8_t> zlib;
+	lodepng::compress(zlib, rows);
+	AppendPNGChunk(png, "IDAT", zlib);
+	AppendPNGChunk(png, "IEND", {});
+	return png;
+}
+
+static std::vector<uint8_t> MakeCheckerRows(uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> rows;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		rows.push_back(0);
+		for (uint32_t x = 0; x < width; x++)
+		{
+			rows.push_back(uint8_t((x + y) % 2));
+		}
+	}
+	
+	return rows;
+}
+
+/// LoadImagePNG() gives what lodepng decodes, or nullptr where it fails
+static void TestLoadImagePNG(const std::vector<uint8_t> &png, bool valid)
+{
+	std::vector<uint8_t> expected;
+	unsigned width = 0;
+	unsigned height = 0;
+	TestCheck((lodepng::decode(expected, width, height, png) == 0) == valid);
+	
+	TestQuietLog quiet;
+	std::shared_ptr<Image> image = LoadImagePNG(png.data(), png.size());
+	if (!valid)
+	{
+		TestCheck(image == nullptr);
+		return;
+	}
+	
+	TestCheck(image != nullptr);
+	if (image)
+	{
+		TestCheck(image->imageSize == glm::uvec2(width, height));
+		TestCheck(image->data == expected);
+	}
+}
+
+int main()
+{
+	const uint32_t width = 8;
+	const uint32_t height = 8;
+	const std::vector<uint8_t> palette = { 255, 0, 0, 0, 0, 255 };
+	const std::vector<uint8_t> rows = MakeCheckerRows(width, height);
+	
+	/// Decoded by DecodePNG()
+	const std::vector<uint8_t> png = MakePalettePNG(width, height, palette, rows);
+	Image decoded;
+	TestCheck(DecodePNG(png.data(), png.size(), decoded));
+	TestLoadImagePNG(png, true);
+	
+	/// A palette index past PLTE in the last row fails DecodePNG() after
+	/// the rows before it are done. It must leave the image as it was, and
+	/// lodepng, which decodes the index to black, must start from scratch
+	std::vector<uint8_t> badIndexRows = rows;
+	badIndexRows.back() = 5;
+	const std::vector<uint8_t> badIndexPNG =
+		MakePalettePNG(width, height, palette, badIndexRows);
+	Image untouched;
+	TestCheck(!DecodePNG(badIndexPNG.data(), badIndexPNG.size(), untouched));
+	TestCheck(untouched.data.empty() && untouched.imageSize == glm::uvec2(0, 0));
+	TestLoadImagePNG(badIndexPNG, true);
+	
+	/// Filter types go up to 4, both decoders reject the last row
+	std::vector<uint8_t> badFilterRows = rows;
+	badFilterRows[(rows.size() / height) * (height - 1)] = 7;
+	const std::vector<uint8_t> badFilterPNG =
+		MakePalettePNG(width, height, palette, badFilterRows);
+	TestCheck(!DecodePNG(badFilterPNG.data(), badFilterPNG.size(), untouched));
+	TestCheck(untouched.data.empty());
+	TestLoadImagePNG(badFilterPNG, false);
+	
+	return TestResult();
+}
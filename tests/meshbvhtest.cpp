@@ -0,0 +1,268 @@
+#include "test.hpp"
+
+#include <smorgasbord/rendering/meshbvh.hpp>
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+/// t of MeshBVH and of the reference may differ in the last bits where
+/// either is compiled with FMA
+const float tTolerance = 1e-5f;
+
+static bool IsSameT(float a, float b)
+{
+	return std::abs(a - b) <= tTolerance * std::max(1.0f, std::abs(b));
+}
+
+/// Closest hit of the brute force search, with every face hit at that t
+struct ReferenceHit
+{
+	float t = std::numeric_limits<float>::infinity();
+	std::vector<uint32_t> faces;
+};
+
+/// Same triangle test and fan split as MeshBVH, over every triangle
+static ReferenceHit IntersectReference(const MeshData &mesh, const Ray &ray)
+{
+	std::vector<std::pair<float, uint32_t>> hits;
+	size_t corner = 0;
+	for (uint32_t face = 0; face < mesh.c.size(); face++)
+	{
+		const uint32_t *corners = &mesh.fp[corner];
+		for (int32_t k = 1; k + 1 < mesh.c[face]; k++)
+		{
+			const glm::vec3 v0 = mesh.p[corners[0]];
+			const glm::vec3 e1 = mesh.p[corners[k]] - v0;
+			const glm::vec3 e2 = mesh.p[corners[k + 1]] - v0;
+			
+			const glm::vec3 p = glm::cross(ray.direction, e2);
+			const float determinant = glm::dot(e1, p);
+			if (determinant == 0)
+			{
+				continue;
+			}
+			
+			const float invDeterminant = 1.0f / determinant;
+			const glm::vec3 s = ray.origin - v0;
+			const float u = glm::dot(s, p) * invDeterminant;
+			const glm::vec3 q = glm::cross(s, e1);
+			const float v = glm::dot(ray.direction, q) * invDeterminant;
+			const float t = glm::dot(e2, q) * invDeterminant;
+			if (u < 0 || u > 1 || v < 0 || u + v > 1 || t < ray.tMin || t > ray.tMax)
+			{
+				continue;
+			}
+			
+			hits.emplace_back(t, face);
+		}
+		corner += size_t(mesh.c[face]);
+	}
+	
+	ReferenceHit hit;
+	for (const std::pair<float, uint32_t> &faceHit : hits)
+	{
+		hit.t = std::min(hit.t, faceHit.first);
+	}
+	
+	for (const std::pair<float, uint32_t> &faceHit : hits)
+	{
+		if (IsSameT(faceHit.first, hit.t))
+		{
+			hit.faces.push_back(faceHit.second);
+		}
+	}
+	
+	return hit;
+}
+
+static void AddTriangle(MeshData &mesh, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+	const uint32_t first = uint32_t(mesh.p.size());
+	mesh.p.insert(mesh.p.end(), { a, b, c });
+	mesh.c.push_back(3);
+	mesh.fp.insert(mesh.fp.end(), { first, first + 1, first + 2 });
+}
+
+/// Triangles, quads and pentagons of random size and orientation in a
+/// unit cube
+static MeshData MakeSoup(size_t numFaces, std::mt19937 &random)
+{
+	std::uniform_real_distribution<float> position(-1, 1);
+	std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+	MeshData mesh;
+	for (size_t f = 0; f < numFaces; f++)
+	{
+		const glm::vec3 center(position(random), position(random), position(random));
+		const int32_t count = int32_t(3 + f % 3);
+		for (int32_t k = 0; k < count; k++)
+		{
+			mesh.fp.push_back(uint32_t(mesh.p.size()));
+			mesh.p.push_back(center + glm::vec3(offset(random), offset(random), offset(random)));
+		}
+		mesh.c.push_back(count);
+	}
+	
+	return mesh;
+}
+
+/// Terrain-like grid of width by height quads, two triangles each, so
+/// that the root is large enough to be built in parallel
+static MeshData MakeGrid(uint32_t width, uint32_t height, std::mt19937 &random)
+{
+	std::uniform_real_distribution<float> bump(-0.2f, 0.2f);
+	MeshData mesh;
+	for (uint32_t y = 0; y <= height; y++)
+	{
+		for (uint32_t x = 0; x <= width; x++)
+		{
+			mesh.p.push_back(glm::vec3(
+				float(x) / float(width) * 2 - 1,
+				bump(random),
+				float(y) / float(height) * 2 - 1));
+		}
+	}
+	
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint32_t v = y * (width + 1) + x;
+			mesh.c.insert(mesh.c.end(), { 3, 3 });
+			mesh.fp.insert(mesh.fp.end(), { v, v + 1, v + width + 1 });
+			mesh.fp.insert(mesh.fp.end(), { v + 1, v + width + 2, v + width + 1 });
+		}
+	}
+	
+	return mesh;
+}
+
+/// Duplicates and concentric triangles, all with the same centroid, which
+/// SAH can't split
+static MeshData MakeCoincident(size_t numFaces)
+{
+	MeshData mesh;
+	for (size_t f = 0; f < numFaces; f++)
+	{
+		const float scale = 0.1f + float(f % 7) * 0.1f;
+		AddTriangle(
+			mesh,
+			glm::vec3(-scale, -scale, 0),
+			glm::vec3(scale, -scale, 0),
+			glm::vec3(0, scale * 2, 0));
+	}
+	
+	return mesh;
+}
+
+/// Rays from around the mesh towards points in it, some along the axes,
+/// so that direction components of 0 are covered, and some with a shorter
+/// [tMin, tMax]
+static std::vector<Ray> MakeRays(size_t numRays, std::mt19937 &random)
+{
+	std::uniform_real_distribution<float> unit(-1, 1);
+	std::vector<Ray> rays(numRays);
+	for (size_t i = 0; i < numRays; i++)
+	{
+		Ray &ray = rays[i];
+		ray.origin = glm::vec3(unit(random), unit(random), unit(random)) * 2.0f;
+		const glm::vec3 target(unit(random), unit(random), unit(random));
+		ray.direction = target - ray.origin;
+		if (i % 5 == 0)
+		{
+			ray.direction = glm::vec3(0);
+			ray.direction[i % 3] = ray.origin[i % 3] > 0 ? -1.0f : 1.0f;
+		}
+		
+		if (i % 4 == 0)
+		{
+			ray.tMin = 0.3f;
+			ray.tMax = 0.8f;
+		}
+	}
+	
+	return rays;
+}
+
+static void TestQueries(const MeshData &mesh, const MeshBVH &bvh, const std::vector<Ray> &rays)
+{
+	size_t hitMismatches = 0;
+	size_t anyMismatches = 0;
+	size_t numHits = 0;
+	for (const Ray &ray : rays)
+	{
+		const ReferenceHit reference = IntersectReference(mesh, ray);
+		const bool referenceHit = !reference.faces.empty();
+		
+		RayHit hit;
+		const bool isHit = bvh.Intersect(ray, hit);
+		numHits += isHit;
+		hitMismatches += isHit != referenceHit || isHit != hit.IsHit();
+		if (isHit && referenceHit)
+		{
+			hitMismatches += !IsSameT(hit.t, reference.t)
+				|| std::find(reference.faces.begin(), reference.faces.end(), hit.face)
+					== reference.faces.end();
+		}
+		
+		anyMismatches += bvh.IntersectAny(ray) != referenceHit;
+	}
+	
+	TestCheck(hitMismatches == 0);
+	TestCheck(anyMismatches == 0);
+	
+	/// Otherwise the rays test nothing
+	TestCheck(numHits > rays.size() / 10);
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	const std::vector<Ray> rays = MakeRays(500, random);
+	
+	/// Brute force on large meshes is slow, fewer rays there
+	const std::vector<Ray> largeRays(rays.begin(), rays.begin() + 60);
+	
+	{
+		MeshData mesh = MakeSoup(2000, random);
+		MeshBVH bvh(mesh, 1);
+		TestCheck(!bvh.IsEmpty());
+		TestQueries(mesh, bvh, rays);
+	}
+	
+	/// 80000 triangles, above the size of nodes built in parallel
+	{
+		MeshData mesh = MakeGrid(200, 200, random);
+		for (uint32_t numThreads : { 1u, 4u })
+		{
+			MeshBVH bvh(mesh, numThreads);
+			TestCheck(bvh.GetTriangleCount() == mesh.c.size());
+			TestQueries(mesh, bvh, largeRays);
+		}
+	}
+	
+	{
+		MeshData mesh = MakeCoincident(40000);
+		MeshBVH bvh(mesh, 4);
+		TestCheck(bvh.GetTriangleCount() == mesh.c.size());
+		TestQueries(mesh, bvh, largeRays);
+	}
+	
+	{
+		MeshBVH bvh(MeshData(), 1);
+		RayHit hit;
+		TestCheck(bvh.IsEmpty());
+		TestCheck(!bvh.Intersect(rays[0], hit) && !hit.IsHit());
+		TestCheck(!bvh.IntersectAny(rays[0]));
+	}
+	
+	return TestResult();
+}
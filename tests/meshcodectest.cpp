@@ -0,0 +1,244 @@
+#include "test.hpp"
+
+#include <smorgasbord/rendering/meshcodec.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+/// Bytes after the target of a decode, which must stay untouched
+const size_t guardSize = 64;
+const uint8_t guardByte = 0xA5;
+
+static bool IsGuardIntact(const std::vector<uint8_t> &target, size_t size)
+{
+	for (size_t i = size; i < target.size(); i++)
+	{
+		if (target[i] != guardByte)
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+/// Vertices of floats on a smooth surface, the case the codec is made for
+static std::vector<uint8_t> MakeSmoothVertices(size_t count, size_t stride)
+{
+	std::vector<uint8_t> vertices(count * stride);
+	for (size_t i = 0; i < count; i++)
+	{
+		for (size_t w = 0; w < stride / 4; w++)
+		{
+			float value = float(i % 37) * 0.25f + float(w) * 3.0f - float(i / 37);
+			std::memcpy(&vertices[i * stride + w * 4], &value, 4);
+		}
+	}
+	
+	return vertices;
+}
+
+static std::vector<uint8_t> MakeRandomVertices(
+	size_t count, size_t stride, std::mt19937 &random)
+{
+	std::vector<uint8_t> vertices(count * stride);
+	for (uint8_t &byte : vertices)
+	{
+		byte = uint8_t(random());
+	}
+	
+	return vertices;
+}
+
+/// Two triangles per quad of a width by height vertex grid
+static std::vector<uint32_t> MakeGridIndices(uint32_t width, uint32_t height)
+{
+	std::vector<uint32_t> indices;
+	for (uint32_t y = 0; y + 1 < height; y++)
+	{
+		for (uint32_t x = 0; x + 1 < width; x++)
+		{
+			uint32_t v = y * width + x;
+			indices.insert(indices.end(), { v, v + 1, v + width });
+			indices.insert(indices.end(), { v + 1, v + width + 1, v + width });
+		}
+	}
+	
+	return indices;
+}
+
+static std::vector<uint32_t> MakeRandomIndices(
+	size_t numTriangles, uint32_t numVertices, std::mt19937 &random)
+{
+	std::vector<uint32_t> indices(numTriangles * 3);
+	for (uint32_t &index : indices)
+	{
+		index = uint32_t(random() % numVertices);
+	}
+	
+	return indices;
+}
+
+static void TestVertexRoundTrip(
+	const std::vector<uint8_t> &vertices, size_t count, size_t stride)
+{
+	std::vector<uint8_t> data = EncodeVertexBuffer(vertices.data(), count, stride);
+	
+	std::vector<uint8_t> target(vertices.size() + guardSize, guardByte);
+	TestCheck(DecodeVertexBuffer(target.data(), count, stride, data.data(), data.size()));
+	TestCheck(std::memcmp(target.data(), vertices.data(), vertices.size()) == 0);
+	TestCheck(IsGuardIntact(target, vertices.size()));
+}
+
+static void TestIndexRoundTrip(const std::vector<uint32_t> &indices)
+{
+	std::vector<uint8_t> data = EncodeIndexBuffer(indices.data(), indices.size());
+	
+	std::vector<uint8_t> target(indices.size() * 4 + guardSize, guardByte);
+	TestCheck(DecodeIndexBuffer(
+		target.data(), indices.size(), 4, data.data(), data.size()));
+	TestCheck(std::memcmp(target.data(), indices.data(), indices.size() * 4) == 0);
+	TestCheck(IsGuardIntact(target, indices.size() * 4));
+	
+	uint32_t maxIndex = 0;
+	for (uint32_t index : indices)
+	{
+		maxIndex = std::max(maxIndex, index);
+	}
+	
+	std::fill(target.begin(), target.end(), guardByte);
+	if (maxIndex > 0xFFFF)
+	{
+		/// Doesn't fit 16 bits
+		TestQuietLog quiet;
+		TestCheck(!DecodeIndexBuffer(
+			target.data(), indices.size(), 2, data.data(), data.size()));
+		return;
+	}
+	
+	TestCheck(DecodeIndexBuffer(
+		target.data(), indices.size(), 2, data.data(), data.size()));
+	bool equal = true;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		uint16_t index;
+		std::memcpy(&index, &target[i * 2], 2);
+		equal = equal && index == indices[i];
+	}
+	TestCheck(equal);
+	TestCheck(IsGuardIntact(target, indices.size() * 2));
+}
+
+/// Every prefix, a trailing byte, header fields and random byte flips.
+/// decode(target, data, size) decodes into a target of targetSize bytes
+template<typename Decode>
+static void TestInvalidInput(
+	const std::vector<uint8_t> &data,
+	size_t targetSize,
+	std::mt19937 &random,
+	Decode decode)
+{
+	TestQuietLog quiet;
+	std::vector<uint8_t> target(targetSize + guardSize, guardByte);
+	
+	bool rejectsTruncated = true;
+	for (size_t size = 0; size < data.size(); size++)
+	{
+		std::vector<uint8_t> truncated(data.begin(), data.begin() + ptrdiff_t(size));
+		rejectsTruncated = rejectsTruncated
+			&& !decode(target.data(), truncated.data(), truncated.size());
+	}
+	TestCheck(rejectsTruncated);
+	
+	std::vector<uint8_t> extended = data;
+	extended.push_back(0);
+	TestCheck(!decode(target.data(), extended.data(), extended.size()));
+	
+	/// Magic, version and count
+	for (size_t offset : { size_t(0), size_t(4), size_t(8) })
+	{
+		std::vector<uint8_t> corrupted = data;
+		corrupted[offset] ^= 0x10;
+		TestCheck(!decode(target.data(), corrupted.data(), corrupted.size()));
+	}
+	
+	/// Without a checksum not every flip is detected, but none may make
+	/// the decoder write past the target
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		std::vector<uint8_t> corrupted = data;
+		corrupted[random() % corrupted.size()] ^= uint8_t(1 + random() % 255);
+		decode(target.data(), corrupted.data(), corrupted.size());
+	}
+	TestCheck(IsGuardIntact(target, targetSize));
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	
+	/// Blocks hold 256 vertices, counts around it leave partial blocks and
+	/// partial groups of 16
+	for (size_t stride : { 4, 12, 32, 256 })
+	{
+		for (size_t count : { 1, 15, 17, 255, 256, 257, 1000, 4099 })
+		{
+			TestVertexRoundTrip(MakeSmoothVertices(count, stride), count, stride);
+			TestVertexRoundTrip(MakeRandomVertices(count, stride, random), count, stride);
+		}
+	}
+	
+	TestIndexRoundTrip(MakeGridIndices(2, 2));
+	TestIndexRoundTrip(MakeGridIndices(100, 100));
+	TestIndexRoundTrip(MakeGridIndices(300, 300));
+	TestIndexRoundTrip(MakeRandomIndices(1, 3, random));
+	TestIndexRoundTrip(MakeRandomIndices(5000, 1000, random));
+	TestIndexRoundTrip(MakeRandomIndices(5000, 0xFFFFFFFF, random));
+	
+	{
+		const size_t count = 300;
+		const size_t stride = 12;
+		std::vector<uint8_t> data = EncodeVertexBuffer(
+			MakeSmoothVertices(count, stride).data(), count, stride);
+		TestInvalidInput(
+			data,
+			count * stride,
+			random,
+			[&](void *target, const uint8_t *data, size_t size)
+			{
+				return DecodeVertexBuffer(target, count, stride, data, size);
+			});
+		
+		TestQuietLog quiet;
+		std::vector<uint8_t> target(count * stride * 2);
+		TestCheck(!DecodeVertexBuffer(target.data(), count + 1, stride, data.data(), data.size()));
+		TestCheck(!DecodeVertexBuffer(target.data(), count, stride * 2, data.data(), data.size()));
+	}
+	
+	{
+		std::vector<uint32_t> indices = MakeGridIndices(20, 20);
+		std::vector<uint32_t> randomIndices = MakeRandomIndices(200, 5000, random);
+		indices.insert(indices.end(), randomIndices.begin(), randomIndices.end());
+		std::vector<uint8_t> data = EncodeIndexBuffer(indices.data(), indices.size());
+		for (size_t indexSize : { 2, 4 })
+		{
+			TestInvalidInput(
+				data,
+				indices.size() * indexSize,
+				random,
+				[&](void *target, const uint8_t *data, size_t size)
+				{
+					return DecodeIndexBuffer(
+						target, indices.size(), indexSize, data, size);
+				});
+		}
+	}
+	
+	return TestResult();
+}
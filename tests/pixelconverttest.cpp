@@ -0,0 +1,384 @@
+#include "test.hpp"
+
+#include <smorgasbord/image/pixelconvert.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+/// Pixel counts around the 4 and 8 values or pixels of a vector step, so
+/// that every tail length is hit, and one large count
+const size_t testCounts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 1003 };
+
+static float FloatFromBits(uint32_t bits)
+{
+	float value;
+	std::memcpy(&value, &bits, 4);
+	return value;
+}
+
+static uint32_t BitsFromFloat(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, 4);
+	return bits;
+}
+
+/// Clamped to [0, 1], NaN to 0
+static double ClampUNorm(float value)
+{
+	return value > 0 ? (value < 1 ? double(value) : 1.0) : 0.0;
+}
+
+/// Software binary16 conversions, rounded to nearest, ties to even. NaNs
+/// keep the top of their payload and become quiet, as with F16C
+static uint16_t ReferenceFloatToHalf(float value)
+{
+	const uint32_t bits = BitsFromFloat(value);
+	const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+	const uint32_t exponent = (bits >> 23) & 0xFF;
+	if (exponent == 0xFF)
+	{
+		const uint32_t mantissa = bits & 0x7FFFFF;
+		return uint16_t(sign | 0x7C00 | (mantissa != 0 ? 0x200 | (mantissa >> 13) : 0));
+	}
+	
+	const double magnitude = std::fabs(double(value));
+	if (magnitude < std::ldexp(1.0, -14))
+	{
+		/// Subnormal, rounding up to 1024 gives the smallest normal
+		return uint16_t(sign | uint32_t(std::nearbyint(std::ldexp(magnitude, 24))));
+	}
+	
+	const int halfExponent = int(exponent) - 127;
+	if (halfExponent > 15)
+	{
+		return uint16_t(sign | 0x7C00);
+	}
+	
+	/// 1024 to 2048 steps of the binary16 precision, a carry into the
+	/// exponent or to infinity happens in the addition
+	const uint32_t steps =
+		uint32_t(std::nearbyint(std::ldexp(magnitude, 10 - halfExponent)));
+	return uint16_t(sign | ((uint32_t(halfExponent + 15) << 10) + steps - 1024));
+}
+
+static float ReferenceHalfToFloat(uint16_t half)
+{
+	const uint32_t sign = uint32_t(half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1F;
+	const uint32_t mantissa = half & 0x3FF;
+	if (exponent == 0x1F)
+	{
+		return FloatFromBits(
+			sign | 0x7F800000 | (mantissa != 0 ? 0x400000 | (mantissa << 13) : 0));
+	}
+	
+	const double magnitude = exponent == 0
+		? std::ldexp(double(mantissa), -24)
+		: std::ldexp(double(mantissa + 1024), int(exponent) - 25);
+	return FloatFromBits(sign | BitsFromFloat(float(magnitude)));
+}
+
+static double ReferenceLinearToSRGBCurve(double value)
+{
+	return value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1 / 2.4) - 0.055;
+}
+
+static uint8_t ReferenceLinearToSRGB(float value)
+{
+	return uint8_t(std::floor(ReferenceLinearToSRGBCurve(ClampUNorm(value)) * 255 + 0.5));
+}
+
+static float ReferenceSRGBToLinear(uint8_t code)
+{
+	const double value = code / 255.0;
+	return float(value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4));
+}
+
+static uint8_t ReferenceFloatToUNorm8(float value)
+{
+	return uint8_t(std::nearbyint(float(ClampUNorm(value)) * 255.0f));
+}
+
+static uint16_t ReferenceFloatToUNorm16(float value)
+{
+	return uint16_t(std::nearbyint(float(ClampUNorm(value)) * 65535.0f));
+}
+
+/// Floats with the bit patterns 0, step, 2 * step... over all 2^32, which
+/// covers every exponent, both signs, infinities and NaNs
+static std::vector<float> MakeFloatSamples(uint32_t step)
+{
+	std::vector<float> values;
+	for (uint64_t bits = 0; bits < (uint64_t(1) << 32); bits += step)
+	{
+		values.push_back(FloatFromBits(uint32_t(bits)));
+	}
+	
+	return values;
+}
+
+/// Floats next to each value a rounding decision changes at: the midpoints
+/// between halves and between sRGB codes
+static std::vector<float> MakeBoundaryFloats()
+{
+	std::vector<float> boundaries;
+	for (uint32_t half = 0; half < 0x7C00; half++)
+	{
+		const double low = double(ReferenceHalfToFloat(uint16_t(half)));
+		const double high = half + 1 < 0x7C00
+			? double(ReferenceHalfToFloat(uint16_t(half + 1)))
+			: 65536.0;
+		boundaries.push_back(float((low + high) / 2));
+	}
+	
+	for (uint32_t code = 0; code < 255; code++)
+	{
+		/// Inverse of the curve at the midpoint between two codes
+		const double code05 = (code + 0.5) / 255;
+		boundaries.push_back(float(code05 <= 0.04045
+			? code05 / 12.92
+			: std::pow((code05 + 0.055) / 1.055, 2.4)));
+	}
+	
+	std::vector<float> values;
+	for (float boundary : boundaries)
+	{
+		float below = boundary;
+		float above = boundary;
+		values.push_back(boundary);
+		values.push_back(-boundary);
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			below = std::nextafter(below, 0.0f);
+			above = std::nextafter(above, 1e9f);
+			values.insert(values.end(), { below, above });
+		}
+	}
+	
+	return values;
+}
+
+static void TestHalf(const std::vector<float> &values)
+{
+	std::vector<uint16_t> allHalves(0x10000);
+	for (uint32_t i = 0; i < 0x10000; i++)
+	{
+		allHalves[i] = uint16_t(i);
+	}
+	
+	std::vector<float> floats(allHalves.size());
+	ConvertHalfToFloat(floats.data(), allHalves.data(), allHalves.size());
+	size_t mismatches = 0;
+	for (size_t i = 0; i < allHalves.size(); i++)
+	{
+		mismatches += BitsFromFloat(floats[i])
+			!= BitsFromFloat(ReferenceHalfToFloat(allHalves[i]));
+	}
+	TestCheck(mismatches == 0);
+	
+	std::vector<uint16_t> halves(values.size());
+	ConvertFloatToHalf(halves.data(), values.data(), values.size());
+	mismatches = 0;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		mismatches += halves[i] != ReferenceFloatToHalf(values[i]);
+	}
+	TestCheck(mismatches == 0);
+}
+
+static void TestUNorm(const std::vector<float> &values)
+{
+	std::vector<uint8_t> all8(256);
+	std::vector<uint16_t> all16(0x10000);
+	for (uint32_t i = 0; i < 0x10000; i++)
+	{
+		all8[i & 0xFF] = uint8_t(i);
+		all16[i] = uint16_t(i);
+	}
+	
+	std::vector<float> floats(all16.size());
+	ConvertUNorm8ToFloat(floats.data(), all8.data(), all8.size());
+	size_t mismatches = 0;
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		mismatches += floats[i] != float(i / 255.0);
+	}
+	
+	ConvertUNorm16ToFloat(floats.data(), all16.data(), all16.size());
+	for (uint32_t i = 0; i < 0x10000; i++)
+	{
+		mismatches += floats[i] != float(i / 65535.0);
+	}
+	TestCheck(mismatches == 0);
+	
+	std::vector<uint8_t> unorm8(values.size());
+	std::vector<uint16_t> unorm16(values.size());
+	ConvertFloatToUNorm8(unorm8.data(), values.data(), values.size());
+	ConvertFloatToUNorm16(unorm16.data(), values.data(), values.size());
+	mismatches = 0;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		mismatches += unorm8[i] != ReferenceFloatToUNorm8(values[i]);
+		mismatches += unorm16[i] != ReferenceFloatToUNorm16(values[i]);
+	}
+	TestCheck(mismatches == 0);
+}
+
+static void TestSRGB(const std::vector<float> &values)
+{
+	size_t mismatches = 0;
+	for (uint32_t channels = 1; channels <= 4; channels++)
+	{
+		const size_t numPixels = values.size() / channels;
+		std::vector<uint8_t> codes(numPixels * channels);
+		ConvertLinearToSRGB(codes.data(), values.data(), numPixels, channels);
+		for (size_t i = 0; i < codes.size(); i++)
+		{
+			const bool alpha = channels == 4 && i % 4 == 3;
+			mismatches += codes[i] != (alpha
+				? ReferenceFloatToUNorm8(values[i])
+				: ReferenceLinearToSRGB(values[i]));
+		}
+		
+		std::vector<uint8_t> allCodes(256 * channels);
+		for (size_t i = 0; i < allCodes.size(); i++)
+		{
+			allCodes[i] = uint8_t(i / channels);
+		}
+		
+		std::vector<float> linear(allCodes.size());
+		ConvertSRGBToLinear(linear.data(), allCodes.data(), 256, channels);
+		for (size_t i = 0; i < linear.size(); i++)
+		{
+			const bool alpha = channels == 4 && i % 4 == 3;
+			mismatches += linear[i] != (alpha
+				? float(allCodes[i] / 255.0)
+				: ReferenceSRGBToLinear(allCodes[i]));
+		}
+	}
+	TestCheck(mismatches == 0);
+}
+
+/// Every conversion on the counts of testCounts writes exactly count
+/// values, and gets the tail right
+static void TestTails(std::mt19937 &random)
+{
+	const size_t maxCount = 1003 * 4;
+	const uint8_t guardByte = 0xCD;
+	std::vector<float> values(maxCount);
+	for (float &value : values)
+	{
+		value = float(random() % 1200) / 1000.0f - 0.1f;
+	}
+	
+	size_t mismatches = 0;
+	for (size_t count : testCounts)
+	{
+		std::vector<uint16_t> halves(maxCount, 0xCDCD);
+		ConvertFloatToHalf(halves.data(), values.data(), count);
+		std::vector<uint8_t> codes(maxCount, guardByte);
+		ConvertLinearToSRGB(codes.data(), values.data(), count, 1);
+		for (size_t i = 0; i < maxCount; i++)
+		{
+			mismatches += halves[i] != (i < count ? ReferenceFloatToHalf(values[i]) : 0xCDCD);
+			mismatches += codes[i] != (i < count ? ReferenceLinearToSRGB(values[i]) : guardByte);
+		}
+		
+		std::vector<float> floats(maxCount, -1.0f);
+		ConvertHalfToFloat(floats.data(), halves.data(), count);
+		for (size_t i = 0; i < maxCount; i++)
+		{
+			mismatches += floats[i] != (i < count ? ReferenceHalfToFloat(halves[i]) : -1.0f);
+		}
+	}
+	TestCheck(mismatches == 0);
+}
+
+static void TestSwizzle(std::mt19937 &random)
+{
+	const char *swizzles[] =
+	{
+		"bgra", "abgr", "rrrr", "rrr1", "rgb1", "0g1r", "bgr", "rgb", "rg", "gr", "10", "r", "a"
+	};
+	
+	const size_t maxCount = 1003;
+	const uint8_t guardByte = 0xCD;
+	std::vector<uint8_t> source(maxCount * 4);
+	for (uint8_t &value : source)
+	{
+		value = uint8_t(random());
+	}
+	
+	size_t mismatches = 0;
+	for (uint32_t sourceChannels = 1; sourceChannels <= 4; sourceChannels++)
+	{
+		for (const char *swizzle : swizzles)
+		{
+			const uint32_t targetChannels = uint32_t(std::strlen(swizzle));
+			bool valid = true;
+			for (uint32_t c = 0; c < targetChannels; c++)
+			{
+				const char *channel = std::strchr("rgba", swizzle[c]);
+				valid = valid && (!channel || uint32_t(channel - "rgba") < sourceChannels);
+			}
+			
+			std::vector<uint8_t> target(maxCount * 4, guardByte);
+			if (!valid)
+			{
+				TestQuietLog quiet;
+				TestCheck(!SwizzlePixels(
+					target.data(), targetChannels, source.data(), sourceChannels, 4, swizzle));
+				continue;
+			}
+			
+			for (size_t count : testCounts)
+			{
+				std::fill(target.begin(), target.end(), guardByte);
+				TestCheck(SwizzlePixels(
+					target.data(), targetChannels, source.data(), sourceChannels, count, swizzle));
+				for (size_t i = 0; i < target.size(); i++)
+				{
+					uint8_t expected = guardByte;
+					if (i < count * targetChannels)
+					{
+						const char channel = swizzle[i % targetChannels];
+						const size_t pixel = i / targetChannels;
+						expected = channel == '0' ? 0
+							: channel == '1' ? 255
+							: source[pixel * sourceChannels
+								+ size_t(std::strchr("rgba", channel) - "rgba")];
+					}
+					mismatches += target[i] != expected;
+				}
+			}
+		}
+	}
+	TestCheck(mismatches == 0);
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	
+	std::vector<float> values = MakeFloatSamples(4099);
+	std::vector<float> boundaries = MakeBoundaryFloats();
+	values.insert(values.end(), boundaries.begin(), boundaries.end());
+	
+	/// Not a multiple of a vector step, so the bulk conversions have a tail
+	values.resize(values.size() / 24 * 24 + 5);
+	
+	TestHalf(values);
+	TestUNorm(values);
+	TestSRGB(values);
+	TestTails(random);
+	TestSwizzle(random);
+	
+	return TestResult();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <smorgasbord/util/log.hpp>
+
+#include <fmt/format.h>
+
+#include <iostream>
+#include <sstream>
+
+/*
+
+Tests
+-----
+
+Every .cpp file in this directory is a test executable of its own, run by
+ctest when the project is configured with SMORGASBORD_BUILD_TESTS. A test
+checks with TestCheck() and returns TestResult() from main().
+
+*/
+
+inline int &GetTestFailureCount()
+{
+	static int count = 0;
+	return count;
+}
+
+/// Prints the failed check with its line, and goes on
+#define TestCheck(check) \
+	do \
+	{ \
+		if (!(check)) \
+		{ \
+			fmt::print("{0}:{1}: check failed: {2}\n", __FILE__, __LINE__, #check); \
+			GetTestFailureCount()++; \
+		} \
+	} while (false)
+
+inline int TestResult()
+{
+	fmt::print("{0} checks failed\n", GetTestFailureCount());
+	return GetTestFailureCount() == 0 ? 0 : 1;
+}
+
+/// Discards the log while it exists, for checks of invalid input, which
+/// log an error each
+class TestQuietLog
+{
+	std::ostringstream discarded;
+
+public:
+	TestQuietLog()
+	{
+		Smorgasbord::mainLog.SetStream(discarded);
+	}
+	
+	~TestQuietLog()
+	{
+		Smorgasbord::mainLog.SetStream(std::cout);
+	}
+};
@@ -0,0 +1,255 @@
+#include "test.hpp"
+
+#include <smorgasbord/image/image.hpp>
+#include <smorgasbord/image/textureatlas.hpp>
+#include <smorgasbord/rendering/staticmesh.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+SMORGASBORD_SET_LOG(std::cout);
+
+using namespace Smorgasbord;
+
+/// Images of 1 to 120 pixels a side, every 10th below 8. Patterned images
+/// show where pixels are copied to, flat ones where colors bleed
+static std::vector<std::shared_ptr<Image>> MakeImages(
+	size_t count, bool patterned, std::mt19937 &random)
+{
+	std::vector<std::shared_ptr<Image>> images;
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::uvec2 size(1 + random() % 120, 1 + random() % 120);
+		if (i % 10 == 0)
+		{
+			size = glm::uvec2(1 + random() % 8, 1 + random() % 8);
+		}
+		
+		std::shared_ptr<Image> image = std::make_shared<Image>(size);
+		for (uint32_t y = 0; y < size.y; y++)
+		{
+			for (uint32_t x = 0; x < size.x; x++)
+			{
+				uint8_t *pixel = &image->data[(size_t(y) * size.x + x) * 4];
+				pixel[0] = uint8_t(i * 37 + (patterned ? x * 7 : 0));
+				pixel[1] = uint8_t(i * 91 + (patterned ? y * 11 : 0));
+				pixel[2] = uint8_t(i * 13 + 5);
+				pixel[3] = uint8_t(patterned ? 255 - (x + y) % 64 : 255);
+			}
+		}
+		images.push_back(image);
+	}
+	
+	return images;
+}
+
+static bool IsPowerOfTwo(uint32_t value)
+{
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+/// Cells are aligned, inside the atlas and apart, images sit in their
+/// cells with the padding around them and are copied with their edges
+/// repeated into the padding
+static void TestLayout(
+	const TextureAtlas &atlas,
+	const std::vector<std::shared_ptr<Image>> &images,
+	const TextureAtlasSettings &settings)
+{
+	TestCheck(atlas.image != nullptr);
+	TestCheck(atlas.entries.size() == images.size());
+	if (!atlas.image || atlas.entries.size() != images.size())
+	{
+		return;
+	}
+	
+	const Image &target = *atlas.image;
+	const glm::uvec2 atlasSize = target.imageSize;
+	TestCheck(atlasSize.x <= settings.maxSize && atlasSize.y <= settings.maxSize);
+	if (settings.powerOfTwo)
+	{
+		TestCheck(IsPowerOfTwo(atlasSize.x) && IsPowerOfTwo(atlasSize.y));
+	}
+	
+	const uint32_t alignment = std::max(4u, 1u << (settings.numLevels - 1));
+	size_t layoutErrors = 0;
+	size_t pixelErrors = 0;
+	for (size_t i = 0; i < atlas.entries.size(); i++)
+	{
+		const TextureAtlasEntry &entry = atlas.entries[i];
+		const Image &image = *images[i];
+		layoutErrors += entry.cellPosition.x % alignment != 0
+			|| entry.cellPosition.y % alignment != 0
+			|| entry.cellSize.x % alignment != 0
+			|| entry.cellSize.y % alignment != 0;
+		layoutErrors += entry.cellPosition.x + entry.cellSize.x > atlasSize.x
+			|| entry.cellPosition.y + entry.cellSize.y > atlasSize.y;
+		layoutErrors += entry.size != image.imageSize
+			|| entry.position != entry.cellPosition + settings.padding
+			|| entry.position.x + entry.size.x + settings.padding
+				> entry.cellPosition.x + entry.cellSize.x
+			|| entry.position.y + entry.size.y + settings.padding
+				> entry.cellPosition.y + entry.cellSize.y;
+		layoutErrors += entry.uvMin != glm::vec2(entry.position) / glm::vec2(atlasSize)
+			|| entry.uvMax != glm::vec2(entry.position + entry.size) / glm::vec2(atlasSize);
+		
+		for (size_t j = 0; j < i; j++)
+		{
+			const TextureAtlasEntry &other = atlas.entries[j];
+			layoutErrors += entry.cellPosition.x < other.cellPosition.x + other.cellSize.x
+				&& other.cellPosition.x < entry.cellPosition.x + entry.cellSize.x
+				&& entry.cellPosition.y < other.cellPosition.y + other.cellSize.y
+				&& other.cellPosition.y < entry.cellPosition.y + entry.cellSize.y;
+		}
+		
+		for (uint32_t y = 0; y < entry.cellSize.y; y++)
+		{
+			for (uint32_t x = 0; x < entry.cellSize.x; x++)
+			{
+				const glm::uvec2 cellPixel = entry.cellPosition + glm::uvec2(x, y);
+				const glm::ivec2 imagePixel = glm::clamp(
+					glm::ivec2(cellPixel) - glm::ivec2(entry.position),
+					glm::ivec2(0),
+					glm::ivec2(image.imageSize) - 1);
+				pixelErrors += std::memcmp(
+					&target.data[(size_t(cellPixel.y) * atlasSize.x + cellPixel.x) * 4],
+					&image.data[(size_t(imagePixel.y) * image.imageSize.x + imagePixel.x) * 4],
+					4) != 0;
+			}
+		}
+	}
+	
+	TestCheck(layoutErrors == 0);
+	TestCheck(pixelErrors == 0);
+}
+
+static glm::uvec2 ShiftRight(glm::uvec2 value, uint32_t shift)
+{
+	return glm::uvec2(value.x >> shift, value.y >> shift);
+}
+
+/// At every level the cells of flat images keep their color, give or take
+/// rounding, so no neighbor bleeds in
+static void TestLevels(
+	const TextureAtlas &atlas, const std::vector<std::shared_ptr<Image>> &images)
+{
+	const std::vector<std::shared_ptr<Image>> levels =
+		GenerateTextureAtlasMips(atlas, MipFilter::Kaiser, true, 1);
+	TestCheck(levels.size() == atlas.numLevels);
+	if (levels.empty())
+	{
+		return;
+	}
+	
+	TestCheck(levels[0] == atlas.image);
+	size_t bleedingTexels = 0;
+	for (uint32_t level = 0; level < levels.size(); level++)
+	{
+		const Image &image = *levels[level];
+		TestCheck(image.imageSize
+			== glm::max(ShiftRight(atlas.image->imageSize, level), glm::uvec2(1)));
+		
+		for (size_t i = 0; i < atlas.entries.size(); i++)
+		{
+			const TextureAtlasEntry &entry = atlas.entries[i];
+			const uint8_t *color = images[i]->data.data();
+			const glm::uvec2 cellMin = ShiftRight(entry.cellPosition, level);
+			const glm::uvec2 cellMax = ShiftRight(entry.cellPosition + entry.cellSize, level);
+			for (uint32_t y = cellMin.y; y < cellMax.y; y++)
+			{
+				for (uint32_t x = cellMin.x; x < cellMax.x; x++)
+				{
+					const uint8_t *texel = &image.data[(size_t(y) * image.imageSize.x + x) * 4];
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						bleedingTexels += std::abs(int(texel[c]) - int(color[c])) > 1;
+					}
+				}
+			}
+		}
+	}
+	TestCheck(bleedingTexels == 0);
+}
+
+/// Ranges of materials 0 and 1 go to two entries, coordinates outside
+/// [0, 1] are clamped, and a coordinate both use is duplicated
+static void TestRemap(const TextureAtlas &atlas)
+{
+	MeshData mesh;
+	mesh.p = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 } };
+	mesh.t = { { 0, 0 }, { 1, 0 }, { 0.5f, 0.25f }, { 2, -1 } };
+	mesh.c = { 3, 3, 3 };
+	mesh.fp = { 0, 1, 2, 0, 1, 2, 0, 1, 2 };
+	mesh.ft = { 0, 1, 2, 0, 2, 3, 0, 1, 2 };
+	
+	MeshRange first;
+	first.firstFace = 0;
+	first.numFaces = 1;
+	first.materialIndex = 0;
+	MeshRange second = first;
+	second.firstFace = 1;
+	second.materialIndex = 1;
+	mesh.ranges = { first, second };
+	
+	const TextureAtlasEntry &a = atlas.entries[3];
+	const TextureAtlasEntry &b = atlas.entries[5];
+	RemapTextureCoordinates(mesh, atlas, { 3, 5 });
+	
+	TestCheck(mesh.ft.size() == 9);
+	TestCheck(mesh.t[mesh.ft[0]] == a.uvMin);
+	TestCheck(mesh.t[mesh.ft[1]] == glm::vec2(a.uvMax.x, a.uvMin.y));
+	TestCheck(mesh.t[mesh.ft[2]] == a.Remap(glm::vec2(0.5f, 0.25f)));
+	TestCheck(mesh.t[mesh.ft[3]] == b.uvMin);
+	TestCheck(mesh.t[mesh.ft[5]] == glm::vec2(b.uvMax.x, b.uvMin.y));
+	
+	/// The third face has no range, its coordinates stay
+	TestCheck(mesh.t[mesh.ft[6]] == glm::vec2(0, 0));
+	TestCheck(mesh.t[mesh.ft[8]] == glm::vec2(0.5f, 0.25f));
+	TestCheck(mesh.ft[0] != mesh.ft[3] && mesh.ft[3] != mesh.ft[6]);
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	
+	TextureAtlasSettings settings;
+	settings.padding = 8;
+	settings.numLevels = 4;
+	
+	const std::vector<std::shared_ptr<Image>> patterned = MakeImages(300, true, random);
+	for (bool powerOfTwo : { true, false })
+	{
+		settings.powerOfTwo = powerOfTwo;
+		TextureAtlas atlas = BuildTextureAtlas(patterned, settings, 1);
+		TestLayout(atlas, patterned, settings);
+		
+		TextureAtlas threadAtlas = BuildTextureAtlas(patterned, settings, 4);
+		TestCheck(atlas.image && threadAtlas.image
+			&& atlas.image->data == threadAtlas.image->data);
+	}
+	
+	settings.powerOfTwo = true;
+	const std::vector<std::shared_ptr<Image>> flat = MakeImages(100, false, random);
+	TextureAtlas atlas = BuildTextureAtlas(flat, settings, 1);
+	TestLayout(atlas, flat, settings);
+	if (atlas.image)
+	{
+		TestLevels(atlas, flat);
+		TestRemap(atlas);
+	}
+	
+	{
+		TestQuietLog quiet;
+		TextureAtlasSettings small = settings;
+		small.maxSize = 64;
+		TestCheck(!BuildTextureAtlas(flat, small, 1).image);
+		
+		std::vector<std::shared_ptr<Image>> gray = { std::make_shared<Image>(glm::uvec2(4), 1) };
+		TestCheck(!BuildTextureAtlas(gray, settings, 1).image);
+	}
+	
+	return TestResult();
+}